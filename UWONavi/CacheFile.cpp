@@ -0,0 +1,82 @@
+#include "stdafx.h"
+#include "CacheFile.h"
+
+namespace {
+    // Start of every cache file
+    struct Stamp {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+    };
+}
+
+
+// Open a cache file and check its stamp
+bool CacheFileReader::open(const std::wstring& fileName, uint32_t magic, uint32_t version, uint64_t key)
+{
+    m_stream.open(fileName, std::ios::in | std::ios::binary);
+    if (!m_stream) {
+        return false;
+    }
+
+    Stamp stamp = {};
+    return read(&stamp, sizeof(stamp))
+        && stamp.magic == magic
+        && stamp.version == version
+        && stamp.key == key;
+}
+
+
+// Read the next bytes
+bool CacheFileReader::read(void* data, size_t size)
+{
+    if (size != 0) {
+        m_stream.read(reinterpret_cast<char*>(data), size);
+    }
+    return !!m_stream;
+}
+
+
+// Skip the next bytes
+bool CacheFileReader::skip(size_t size)
+{
+    m_stream.seekg(size, std::ios::cur);
+    return !!m_stream;
+}
+
+
+// Create the file and write the stamp
+bool CacheFileWriter::open(const std::wstring& fileName, uint32_t magic, uint32_t version, uint64_t key)
+{
+    m_fileName = fileName;
+    m_stream.open(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!m_stream) {
+        return false;
+    }
+
+    const Stamp stamp = { magic, version, key };
+    write(&stamp, sizeof(stamp));
+    return true;
+}
+
+
+// Append bytes
+void CacheFileWriter::write(const void* data, size_t size)
+{
+    if (size != 0) {
+        m_stream.write(reinterpret_cast<const char*>(data), size);
+    }
+}
+
+
+// Close the file, deleting it if anything could not be written
+bool CacheFileWriter::close()
+{
+    m_stream.close();
+    if (!m_stream) {
+        // Do not leave a truncated file that would be read next time
+        ::DeleteFile(m_fileName.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>        // For fixed-width integer types
+#include <fstream>        // For the file
+#include <string>         // For the file name
+#include <vector>         // For arrays read and written whole
+
+#include "Noncopyable.h"  // To prevent copying of the file
+
+//! @brief Reads a file written by CacheFileWriter: a stamp, then whatever the writer put after it.
+//! The stamp tells what kind of file it is, its version and the key of the data it was made from,
+//! so a foreign, outdated or stale file is refused on open and the caller just builds the data again.
+class CacheFileReader : private Noncopyable {
+private:
+    std::ifstream m_stream;     //!< Input file
+
+public:
+    //! @brief Open a cache file and check its stamp.
+    //! @return false if the file is missing or stamped with another magic, version or key
+    bool open(const std::wstring& fileName, uint32_t magic, uint32_t version, uint64_t key);
+
+    //! @brief Read the next bytes.
+    //! @return false if the file ends first; every read after a failed one fails too
+    bool read(void* data, size_t size);
+
+    //! @brief Read a value of a plain type.
+    template<typename T>
+    bool readValue(T& value) { return read(&value, sizeof(T)); }
+
+    //! @brief Read the elements of an array already sized to hold them.
+    template<typename T>
+    bool readArray(std::vector<T>& values) { return read(values.data(), values.size() * sizeof(T)); }
+
+    //! @brief Skip the next bytes.
+    //! @return false if the file ends first
+    bool skip(size_t size);
+};
+
+//! @brief Writes a cache file: a stamp (see CacheFileReader), then raw data.
+//! A file that could not be written whole is deleted on close, so a truncated one is never read back.
+class CacheFileWriter : private Noncopyable {
+private:
+    std::wstring m_fileName;    //!< Output file name, to delete it on failure
+    std::ofstream m_stream;     //!< Output file
+
+public:
+    //! @brief Create the file and write the stamp.
+    //! @return false if the file cannot be created
+    bool open(const std::wstring& fileName, uint32_t magic, uint32_t version, uint64_t key);
+
+    //! @brief Append bytes. Failures are reported by close.
+    void write(const void* data, size_t size);
+
+    //! @brief Append a value of a plain type.
+    template<typename T>
+    void writeValue(const T& value) { write(&value, sizeof(T)); }
+
+    //! @brief Append the elements of an array.
+    template<typename T>
+    void writeArray(const std::vector<T>& values) { write(values.data(), values.size() * sizeof(T)); }
+
+    //! @brief Close the file, deleting it if anything could not be written.
+    //! @return false if the file was not written whole
+    bool close();
+};
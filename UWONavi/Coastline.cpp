@@ -0,0 +1,498 @@
+#include "stdafx.h"
+#include "Coastline.h"
+#include "LandMask.h"
+#include "CacheFile.h"
+#include "WorkerThreads.h"
+#include <algorithm>
+
+const float Coastline::k_defaultTolerance = 0.5f;
+
+namespace {
+    // Header of a cache file stamped with Coastline::makeKey of the land mask traced,
+    // followed by the polyline offsets and the points
+    struct FileHeader {
+        enum : uint32_t {
+            k_Magic = 0x4C435755,   // "UWCL"
+            k_Version = 2,
+        };
+        int32_t width = 0;
+        int32_t height = 0;
+        uint32_t lineCount = 0;
+        uint32_t pointCount = 0;
+    };
+
+    // Most workers tracing tiles at the same time
+    const DWORD k_maxWorkerCount = 16;
+
+    // Segments of every marching squares case, as pairs of cell edges (0 top, 1 right, 2 bottom, 3 left)
+    // from where land starts to where it ends going clockwise around the cell; -1 ends the list.
+    // Corners are numbered clockwise from the top left; bit i of the case is set where corner i is land.
+    struct CellSegments {
+        int8_t edges[5];
+    };
+
+    CellSegments s_makeCellSegments(uint32_t landCorners)
+    {
+        CellSegments segments = { { -1, -1, -1, -1, -1 } };
+        int8_t* out = segments.edges;
+        for (int32_t i = 0; i < 4; ++i) {
+            const bool land = (landCorners >> i & 1) != 0;
+            const bool nextLand = (landCorners >> ((i + 1) % 4) & 1) != 0;
+            if (land || !nextLand) {
+                continue;
+            }
+            for (int32_t j = i + 1; ; ++j) {
+                if ((landCorners >> (j % 4) & 1) && !(landCorners >> ((j + 1) % 4) & 1)) {
+                    *out++ = int8_t(i);
+                    *out++ = int8_t(j % 4);
+                    break;
+                }
+            }
+        }
+        return segments;
+    }
+
+    // A point of a polyline while a tile is traced
+    typedef Coastline::Point Point;
+
+    // Polylines traced in one tile
+    struct TileLines {
+        std::vector<Point> points;
+        std::vector<uint32_t> lineBegin;    // First point of every polyline (without the count of all)
+    };
+
+    // What the workers share
+    struct TraceJob {
+        const LandMask* landMask;
+        float tolerance;
+        int32_t tileColumns;
+        int32_t tileRows;
+        CellSegments cellSegments[16];
+        std::vector<TileLines>* tiles;      // Written by the worker tracing each tile
+        volatile LONG nextTile;             // Next tile to trace
+    };
+
+    // Distance from a point to a segment, squared
+    float s_distanceToSegmentSquared(const Point& p, const Point& a, const Point& b)
+    {
+        const float dx = b.x - a.x;
+        const float dy = b.y - a.y;
+        const float lengthSquared = dx * dx + dy * dy;
+        float t = 0.0f;
+        if (0.0f < lengthSquared) {
+            t = max(0.0f, min(1.0f, ((p.x - a.x) * dx + (p.y - a.y) * dy) / lengthSquared));
+        }
+        const float ex = a.x + t * dx - p.x;
+        const float ey = a.y + t * dy - p.y;
+        return ex * ex + ey * ey;
+    }
+
+    // Keep the points of a polyline the simplified one needs (Douglas-Peucker, without recursion)
+    void s_simplify(const std::vector<Point>& line, float tolerance, std::vector<Point>& out)
+    {
+        std::vector<uint8_t> keep(line.size());
+        keep.front() = 1;
+        keep.back() = 1;
+        std::vector<std::pair<size_t, size_t>> spans(1, std::make_pair(size_t(0), line.size() - 1));
+        const float toleranceSquared = tolerance * tolerance;
+        while (!spans.empty()) {
+            const size_t first = spans.back().first;
+            const size_t last = spans.back().second;
+            spans.pop_back();
+            float farthestDistance = toleranceSquared;
+            size_t farthest = 0;
+            for (size_t i = first + 1; i < last; ++i) {
+                const float distance = s_distanceToSegmentSquared(line[i], line[first], line[last]);
+                if (farthestDistance < distance) {
+                    farthestDistance = distance;
+                    farthest = i;
+                }
+            }
+            if (farthest != 0) {
+                keep[farthest] = 1;
+                spans.push_back(std::make_pair(first, farthest));
+                spans.push_back(std::make_pair(farthest, last));
+            }
+        }
+        for (size_t i = 0; i < line.size(); ++i) {
+            if (keep[i]) {
+                out.push_back(line[i]);
+            }
+        }
+    }
+
+    // Trace one tile: find the cells where land meets sea, link their segments by the edge points they
+    // share, then walk the links into polylines, starting from the ends on the tile border
+    void s_traceTile(const TraceJob& job, int32_t tile, std::vector<int32_t>& next, std::vector<uint8_t>& incoming, TileLines& lines)
+    {
+        const LandMask& landMask = *job.landMask;
+        const int32_t size = Coastline::k_tileSize;
+        const int32_t left = (tile % job.tileColumns) * size;
+        const int32_t top = (tile / job.tileColumns) * size;
+        const int32_t right = min(landMask.width(), left + size);
+        const int32_t bottom = min(landMask.height() - 1, top + size);
+        const int32_t stride = size + 1;
+
+        // Edge points are keyed in the tile: (y * stride + x) * 2 for the middle of the top edge of
+        // coordinate (x, y) and its right neighbour, + 1 for the middle of the left edge of it and its lower neighbour
+        auto horizontal = [stride](int32_t x, int32_t y) { return (y * stride + x) * 2; };
+        auto vertical = [stride](int32_t x, int32_t y) { return (y * stride + x) * 2 + 1; };
+        std::vector<int32_t> touched;
+
+        for (int32_t y = top; y < bottom; ++y) {
+            const uint64_t* upper = landMask.rowBits(y);
+            const uint64_t* lower = landMask.rowBits(y + 1);
+            for (int32_t wordX = left; wordX < right; wordX += LandMask::k_wordBits) {
+                const size_t i = size_t(wordX) / LandMask::k_wordBits;
+                const uint64_t a = upper[i];
+                const uint64_t b = lower[i];
+                const uint64_t aNext = landMask.isLand(wordX + LandMask::k_wordBits, y) ? 1 : 0;
+                const uint64_t bNext = landMask.isLand(wordX + LandMask::k_wordBits, y + 1) ? 1 : 0;
+                const uint64_t aRight = a >> 1 | aNext << (LandMask::k_wordBits - 1);
+                const uint64_t bRight = b >> 1 | bNext << (LandMask::k_wordBits - 1);
+                uint64_t mixed = (a ^ b) | (a ^ aRight) | (b ^ bRight);
+                while (mixed) {
+                    const uint32_t bit = LandMask::countTrailingZeros(mixed);
+                    mixed &= mixed - 1;
+                    const int32_t x = wordX + int32_t(bit);
+                    if (right <= x) {
+                        break;
+                    }
+                    const uint32_t landCorners = uint32_t(a >> bit & 1) | uint32_t(aRight >> bit & 1) << 1
+                        | uint32_t(bRight >> bit & 1) << 2 | uint32_t(b >> bit & 1) << 3;
+                    const int32_t lx = x - left;
+                    const int32_t ly = y - top;
+                    const int32_t edgeKeys[4] = {
+                        horizontal(lx, ly), vertical(lx + 1, ly), horizontal(lx, ly + 1), vertical(lx, ly)
+                    };
+                    const int8_t* edges = job.cellSegments[landCorners].edges;
+                    for (; *edges != -1; edges += 2) {
+                        const int32_t from = edgeKeys[edges[0]];
+                        const int32_t to = edgeKeys[edges[1]];
+                        next[from] = to;
+                        incoming[to] = 1;
+                        touched.push_back(from);
+                        touched.push_back(to);
+                    }
+                }
+            }
+        }
+
+        auto pointOf = [left, top, stride](int32_t key) {
+            const int32_t x = (key / 2) % stride;
+            const int32_t y = (key / 2) / stride;
+            Point point = { float(left + x), float(top + y) };
+            if (key & 1) {
+                point.y += 0.5f;
+            }
+            else {
+                point.x += 0.5f;
+            }
+            return point;
+        };
+        std::vector<Point> line;
+        auto walk = [&](int32_t start) {
+            line.clear();
+            line.push_back(pointOf(start));
+            for (int32_t key = start; next[key] != -1; ) {
+                const int32_t to = next[key];
+                next[key] = -1;
+                line.push_back(pointOf(to));
+                key = to;
+            }
+            if (2 <= line.size()) {
+                lines.lineBegin.push_back(uint32_t(lines.points.size()));
+                s_simplify(line, job.tolerance, lines.points);
+            }
+        };
+
+        // Open polylines start where nothing leads in; whatever is left are loops
+        for (int32_t key : touched) {
+            if (next[key] != -1 && !incoming[key]) {
+                walk(key);
+            }
+        }
+        for (int32_t key : touched) {
+            if (next[key] != -1) {
+                walk(key);
+            }
+        }
+        for (int32_t key : touched) {
+            next[key] = -1;
+            incoming[key] = 0;
+        }
+    }
+
+    // Worker thread: trace tiles until none is left
+    UINT CALLBACK s_traceThunk(LPVOID arg)
+    {
+        TraceJob& job = *reinterpret_cast<TraceJob*>(arg);
+        const size_t keyCount = size_t(Coastline::k_tileSize + 1) * (Coastline::k_tileSize + 1) * 2;
+        std::vector<int32_t> next(keyCount, -1);
+        std::vector<uint8_t> incoming(keyCount);
+        const LONG tileCount = job.tileColumns * job.tileRows;
+        for (;;) {
+            const LONG tile = ::InterlockedIncrement(&job.nextTile) - 1;
+            if (tileCount <= tile) {
+                break;
+            }
+            s_traceTile(job, tile, next, incoming, (*job.tiles)[tile]);
+        }
+        return 0;
+    }
+}
+
+
+void Coastline::reset()
+{
+    m_width = 0;
+    m_height = 0;
+    m_points.clear();
+    m_lineBegin.clear();
+    m_cellColumns = 0;
+    m_cellRows = 0;
+    m_cellBegin.clear();
+    m_cellSegments.clear();
+}
+
+
+// Trace the tiles on the workers, then join their polylines in tile order
+bool Coastline::build(const LandMask& landMask, float tolerance)
+{
+    reset();
+    if (landMask.empty()) {
+        return false;
+    }
+
+    std::vector<TileLines> tiles;
+    TraceJob job;
+    job.landMask = &landMask;
+    job.tolerance = tolerance;
+    job.tileColumns = (landMask.width() + k_tileSize - 1) / k_tileSize;
+    job.tileRows = (landMask.height() + k_tileSize - 1) / k_tileSize;
+    for (uint32_t landCorners = 0; landCorners < 16; ++landCorners) {
+        job.cellSegments[landCorners] = s_makeCellSegments(landCorners);
+    }
+    tiles.resize(size_t(job.tileColumns) * job.tileRows);
+    job.tiles = &tiles;
+    job.nextTile = 0;
+
+    g_runWorkers(s_traceThunk, std::vector<LPVOID>(g_workerCount(k_maxWorkerCount), &job));
+
+    for (const TileLines& tile : tiles) {
+        const uint32_t offset = uint32_t(m_points.size());
+        for (uint32_t begin : tile.lineBegin) {
+            m_lineBegin.push_back(offset + begin);
+        }
+        m_points.insert(m_points.end(), tile.points.begin(), tile.points.end());
+    }
+    m_lineBegin.push_back(uint32_t(m_points.size()));
+    m_width = landMask.width();
+    m_height = landMask.height();
+    buildIndex();
+    return true;
+}
+
+
+// Load the polylines from the cache, else trace them and cache them
+bool Coastline::prepare(const LandMask& landMask, const std::wstring& cacheFileName)
+{
+    const uint64_t key = makeKey(landMask);
+    if (loadFromFile(cacheFileName, key)) {
+        return true;
+    }
+    if (!build(landMask)) {
+        return false;
+    }
+    saveToFile(cacheFileName, key);
+    return true;
+}
+
+
+// Load the polylines from a cache file
+bool Coastline::loadFromFile(const std::wstring& fileName, uint64_t key)
+{
+    CacheFileReader file;
+    FileHeader header;
+    if (!file.open(fileName, FileHeader::k_Magic, FileHeader::k_Version, key)
+        || !file.readValue(header)) {
+        return false;
+    }
+
+    std::vector<uint32_t> lineBegin(size_t(header.lineCount) + 1);
+    std::vector<Point> points(header.pointCount);
+    if (!file.readArray(lineBegin) || !file.readArray(points) || lineBegin.back() != header.pointCount) {
+        return false;
+    }
+
+    reset();
+    m_width = header.width;
+    m_height = header.height;
+    m_lineBegin.swap(lineBegin);
+    m_points.swap(points);
+    buildIndex();
+    return true;
+}
+
+
+// Write the polylines to a cache file
+bool Coastline::saveToFile(const std::wstring& fileName, uint64_t key) const
+{
+    CacheFileWriter file;
+    if (!file.open(fileName, FileHeader::k_Magic, FileHeader::k_Version, key)) {
+        return false;
+    }
+
+    FileHeader header;
+    header.width = m_width;
+    header.height = m_height;
+    header.lineCount = uint32_t(lineCount());
+    header.pointCount = uint32_t(m_points.size());
+    file.writeValue(header);
+    file.writeArray(m_lineBegin);
+    file.writeArray(m_points);
+    return file.close();
+}
+
+
+// Mix the tolerance into the hash of the land mask (FNV-1a)
+uint64_t Coastline::makeKey(const LandMask& landMask)
+{
+    uint32_t tolerance = 0;
+    ::memcpy(&tolerance, &k_defaultTolerance, sizeof(tolerance));
+    return (landMask.hash() ^ tolerance) * 0x100000001B3ULL;
+}
+
+
+// Count the segments of every cell, then place them by those counts. A segment is filed in every
+// cell of its bounding box; simplified segments are short, so that is rarely more than one or two.
+void Coastline::buildIndex()
+{
+    m_cellColumns = (m_width + k_cellSize - 1) / k_cellSize;
+    m_cellRows = (m_height + k_cellSize - 1) / k_cellSize;
+    m_cellBegin.assign(size_t(m_cellColumns) * m_cellRows + 1, 0);
+    m_cellSegments.clear();
+    if (m_points.empty()) {
+        return;
+    }
+
+    auto forEachCell = [this](uint32_t segment, auto function) {
+        const Point& a = m_points[segment];
+        const Point& b = m_points[segment + 1];
+        const int32_t firstColumn = int32_t(min(a.x, b.x)) / k_cellSize;
+        const int32_t lastColumn = min(m_cellColumns - 1, int32_t(max(a.x, b.x)) / k_cellSize);
+        const int32_t firstRow = int32_t(min(a.y, b.y)) / k_cellSize;
+        const int32_t lastRow = min(m_cellRows - 1, int32_t(max(a.y, b.y)) / k_cellSize);
+        for (int32_t row = firstRow; row <= lastRow; ++row) {
+            for (int32_t column = firstColumn; column <= lastColumn; ++column) {
+                function(size_t(row) * m_cellColumns + column);
+            }
+        }
+    };
+    for (size_t line = 0; line < lineCount(); ++line) {
+        for (uint32_t segment = m_lineBegin[line]; segment + 1 < m_lineBegin[line + 1]; ++segment) {
+            forEachCell(segment, [this](size_t cell) { ++m_cellBegin[cell + 1]; });
+        }
+    }
+    for (size_t i = 1; i < m_cellBegin.size(); ++i) {
+        m_cellBegin[i] += m_cellBegin[i - 1];
+    }
+    m_cellSegments.resize(m_cellBegin.back());
+    std::vector<uint32_t> next(m_cellBegin.begin(), m_cellBegin.end() - 1);
+    for (size_t line = 0; line < lineCount(); ++line) {
+        for (uint32_t segment = m_lineBegin[line]; segment + 1 < m_lineBegin[line + 1]; ++segment) {
+            forEachCell(segment, [this, &next, segment](size_t cell) { m_cellSegments[next[cell]++] = segment; });
+        }
+    }
+}
+
+
+void Coastline::segmentsInRect(float minX, float minY, float maxX, float maxY, std::vector<uint32_t>& segments) const
+{
+    segments.clear();
+    if (m_points.empty()) {
+        return;
+    }
+    const int32_t firstColumn = int32_t(::floor(minX / k_cellSize));
+    const int32_t lastColumn = min(firstColumn + m_cellColumns - 1, int32_t(::floor(maxX / k_cellSize)));
+    const int32_t firstRow = max(0, int32_t(::floor(minY / k_cellSize)));
+    const int32_t lastRow = min(m_cellRows - 1, int32_t(::floor(maxY / k_cellSize)));
+    for (int32_t row = firstRow; row <= lastRow; ++row) {
+        for (int32_t column = firstColumn; column <= lastColumn; ++column) {
+            const size_t cell = size_t(row) * m_cellColumns + ((column % m_cellColumns) + m_cellColumns) % m_cellColumns;
+            segments.insert(segments.end(), m_cellSegments.begin() + m_cellBegin[cell], m_cellSegments.begin() + m_cellBegin[cell + 1]);
+        }
+    }
+    std::sort(segments.begin(), segments.end());
+    segments.erase(std::unique(segments.begin(), segments.end()), segments.end());
+}
+
+
+// Visit the cells along the segment column by column (every cell it passes through, and only those),
+// testing the coast filed there. Cells past either edge of the world hold the segments of the cell
+// wrapped around, shifted by the width of the world.
+bool Coastline::firstIntersection(float x0, float y0, float x1, float y1, float& fraction) const
+{
+    if (m_points.empty()) {
+        return false;
+    }
+    const float width = float(m_width);
+    x0 = ::fmod(x0, width);
+    if (x0 < 0.0f) {
+        x0 += width;
+    }
+    float dx = ::fmod(x1 - x0, width);
+    if (width / 2 < dx) {
+        dx -= width;
+    }
+    else if (dx < -width / 2) {
+        dx += width;
+    }
+    x1 = x0 + dx;
+    const float dy = y1 - y0;
+
+    bool found = false;
+    fraction = 1.0f;
+    const int32_t firstColumn = int32_t(::floor(min(x0, x1) / k_cellSize));
+    const int32_t lastColumn = int32_t(::floor(max(x0, x1) / k_cellSize));
+    for (int32_t column = firstColumn; column <= lastColumn; ++column) {
+        // The part of the segment within the column, and the rows it covers there
+        float t0 = 0.0f;
+        float t1 = 1.0f;
+        if (dx != 0.0f) {
+            const float ta = (column * k_cellSize - x0) / dx;
+            const float tb = ((column + 1) * k_cellSize - x0) / dx;
+            t0 = max(0.0f, min(ta, tb));
+            t1 = min(1.0f, max(ta, tb));
+        }
+        const float ya = y0 + dy * t0;
+        const float yb = y0 + dy * t1;
+        const int32_t firstRow = max(0, int32_t(::floor(min(ya, yb) / k_cellSize)));
+        const int32_t lastRow = min(m_cellRows - 1, int32_t(::floor(max(ya, yb) / k_cellSize)));
+
+        const int32_t wrappedColumn = ((column % m_cellColumns) + m_cellColumns) % m_cellColumns;
+        const float shift = float(column - wrappedColumn) / m_cellColumns * width;
+        for (int32_t row = firstRow; row <= lastRow; ++row) {
+            const size_t cell = size_t(row) * m_cellColumns + wrappedColumn;
+            for (uint32_t i = m_cellBegin[cell]; i < m_cellBegin[cell + 1]; ++i) {
+                const Point& a = m_points[m_cellSegments[i]];
+                const Point& b = m_points[m_cellSegments[i] + 1];
+                const float ex = b.x - a.x;
+                const float ey = b.y - a.y;
+                const float denominator = dx * ey - dy * ex;
+                if (denominator == 0.0f) {
+                    continue;
+                }
+                const float ax = a.x + shift - x0;
+                const float ay = a.y - y0;
+                const float t = (ax * ey - ay * ex) / denominator;
+                const float u = (ax * dy - ay * dx) / denominator;
+                if (0.0f <= t && t <= fraction && 0.0f <= u && u <= 1.0f) {
+                    fraction = t;
+                    found = true;
+                }
+            }
+        }
+    }
+    return found;
+}
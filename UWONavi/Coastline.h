@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>        // For fixed-width integer types
+#include <string>         // For file names
+#include <vector>         // For the points
+
+#include "Noncopyable.h"  // To prevent copying of the points
+
+class LandMask;
+
+//! @brief The coast of the world as polylines, traced from the land mask.
+//! Marching squares runs between every four neighbouring coordinates of the mask, in tiles of
+//! k_tileSize spread over one worker per processor; each tile chains its edges into polylines, which
+//! are then simplified (Douglas-Peucker, within k_defaultTolerance). Polylines have land on their left
+//! as seen on the map; they close on themselves when an island fits in a tile, and otherwise end on
+//! tile borders where the next tile takes over. Segments are filed in a grid of
+//! k_cellSize cells, so the coast near a point or along a segment is found without scanning it all.
+//! Tracing a whole world takes a moment, so the polylines are kept in a cache file next to the map.
+class Coastline : private Noncopyable {
+public:
+    enum : int32_t {
+        k_tileSize = 512,       //!< World coordinates along each side of a tile traced by one worker
+        k_cellSize = 64,        //!< World coordinates along each side of a cell of the segment grid
+    };
+
+    static const float k_defaultTolerance;  //!< Farthest a simplified polyline strays from the traced one
+
+    //! @brief A point of a polyline in world coordinates (on halves, between coordinates of the mask).
+    struct Point {
+        float x;
+        float y;
+    };
+
+private:
+    int32_t m_width;                        //!< Width of the world traced
+    int32_t m_height;                       //!< Height of the world traced
+    std::vector<Point> m_points;            //!< Points of every polyline, one polyline after another
+    std::vector<uint32_t> m_lineBegin;      //!< First point of every polyline, plus the count of all
+    int32_t m_cellColumns;                  //!< Cells of the segment grid around the world
+    int32_t m_cellRows;                     //!< Cells of the segment grid from top to bottom
+    std::vector<uint32_t> m_cellBegin;      //!< First segment of every cell in m_cellSegments, plus the count of all
+    std::vector<uint32_t> m_cellSegments;   //!< Segments passing through every cell, by their first point
+
+public:
+    Coastline() :
+        m_width(),
+        m_height(),
+        m_points(),
+        m_lineBegin(),
+        m_cellColumns(),
+        m_cellRows(),
+        m_cellBegin(),
+        m_cellSegments()
+    {
+    }
+
+    //! @brief Check whether there is no coast.
+    bool empty() const { return m_points.empty(); }
+
+    //! @brief Forget the polylines.
+    void reset();
+
+    //! @brief Get the number of polylines.
+    size_t lineCount() const { return m_lineBegin.empty() ? 0 : m_lineBegin.size() - 1; }
+
+    //! @brief Get the number of points of all polylines.
+    size_t pointCount() const { return m_points.size(); }
+
+    //! @brief Get the points of a polyline.
+    const Point* linePoints(size_t line) const { return &m_points[m_lineBegin[line]]; }
+
+    //! @brief Get the number of points of a polyline.
+    size_t linePointCount(size_t line) const { return m_lineBegin[line + 1] - m_lineBegin[line]; }
+
+    //! @brief Get the first point of a segment (the segment goes to the next point).
+    const Point& segmentBegin(uint32_t segment) const { return m_points[segment]; }
+
+    //! @brief Get the last point of a segment.
+    const Point& segmentEnd(uint32_t segment) const { return m_points[segment + 1]; }
+
+    //! @brief Trace the coast of a land mask.
+    //! @param tolerance Farthest a simplified polyline may stray from the traced one
+    //! @return false if the mask is empty
+    bool build(const LandMask& landMask, float tolerance = k_defaultTolerance);
+
+    //! @brief Load the polylines from a cache file when they were traced from the same mask, else
+    //! trace them and write the cache.
+    //! @return false if they could be neither loaded nor traced
+    bool prepare(const LandMask& landMask, const std::wstring& cacheFileName);
+
+    //! @brief Load the polylines from a cache file.
+    //! @return false if the file is missing, written for another key or broken
+    bool loadFromFile(const std::wstring& fileName, uint64_t key);
+
+    //! @brief Write the polylines to a cache file.
+    //! @return false if the file cannot be written
+    bool saveToFile(const std::wstring& fileName, uint64_t key) const;
+
+    //! @brief Make the cache key of the polylines traced from a land mask.
+    static uint64_t makeKey(const LandMask& landMask);
+
+    //! @brief Collect the segments passing through the cells of a rectangle of world coordinates,
+    //! each once. x may run past either edge of the world, which wraps around.
+    void segmentsInRect(float minX, float minY, float maxX, float maxY, std::vector<uint32_t>& segments) const;
+
+    //! @brief Find where a segment first meets the coast, going the short way around the world.
+    //! @param fraction Receives how far along the segment the coast is met, from 0 to 1
+    //! @return false if the segment does not meet the coast
+    bool firstIntersection(float x0, float y0, float x1, float y1, float& fraction) const;
+
+private:
+    //! @brief File every segment in the cells it passes through
+    void buildIndex();
+};
@@ -0,0 +1,488 @@
+#include "stdafx.h"
+#include "CompressedImage.h"
+#include "Image.h"
+#include "CacheFile.h"
+#include <climits>
+
+namespace {
+    // Header of a cache file stamped with CompressedImage::fileStamp of the source image
+    struct FileHeader {
+        enum : uint32_t {
+            k_Magic = 0x43425755,   // "UWBC"
+            k_Version = 2,
+        };
+        uint32_t format = 0;        // CompressedImage::Format
+        uint32_t levelCount = 0;
+    };
+
+    // Header of every level in a cache file, followed by its blocks
+    struct LevelHeader {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t byteCount = 0;
+    };
+
+    // Bytes of one block
+    inline size_t s_blockBytes(CompressedImage::Format format)
+    {
+        return format == CompressedImage::k_Format_BC3 ? 16 : 8;
+    }
+
+    // Bytes of the blocks of a level
+    inline size_t s_levelBytes(CompressedImage::Format format, uint32_t width, uint32_t height)
+    {
+        return size_t((width + 3) / 4) * ((height + 3) / 4) * s_blockBytes(format);
+    }
+
+    // RGB888 to RGB565
+    inline uint16_t s_to565(int r, int g, int b)
+    {
+        return uint16_t(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+    }
+
+    // RGB565 to RGB888, replicating the high bits like the decoder does
+    inline void s_from565(uint16_t c, int* rgb)
+    {
+        const int r = (c >> 11) & 31;
+        const int g = (c >> 5) & 63;
+        const int b = c & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    inline void s_putLittleEndian(uint8_t* out, uint32_t value, int byteCount)
+    {
+        for (int i = 0; i < byteCount; ++i) {
+            out[i] = uint8_t(value >> (i * 8));
+        }
+    }
+
+    // Encode the colors of 16 RGBA pixels as a BC1 block in four-color mode.
+    // Endpoints are the corners of the bounding box, flipped per channel to follow the diagonal
+    // the colors lie along, and inset by 1/16 of the range so the extremes are not wasted on outliers.
+    void s_encodeColorBlock(const uint8_t (&pixels)[16][4], uint8_t* out)
+    {
+        int lo[3] = { 255, 255, 255 };
+        int hi[3] = { 0, 0, 0 };
+        int mean[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; ++i) {
+            for (int c = 0; c < 3; ++c) {
+                lo[c] = min<int>(lo[c], pixels[i][c]);
+                hi[c] = max<int>(hi[c], pixels[i][c]);
+                mean[c] += pixels[i][c];
+            }
+        }
+
+        // Red and blue run against green when they decrease as it increases
+        int covariance[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; ++i) {
+            const int g = pixels[i][1] * 16 - mean[1];
+            for (int c = 0; c < 3; ++c) {
+                covariance[c] += (pixels[i][c] * 16 - mean[c]) * g;
+            }
+        }
+
+        int end0[3], end1[3];
+        for (int c = 0; c < 3; ++c) {
+            const int inset = (hi[c] - lo[c]) / 16;
+            const int high = hi[c] - inset;
+            const int low = lo[c] + inset;
+            const bool flip = c != 1 && covariance[c] < 0;
+            end0[c] = flip ? low : high;
+            end1[c] = flip ? high : low;
+        }
+
+        uint16_t color0 = s_to565(end0[0], end0[1], end0[2]);
+        uint16_t color1 = s_to565(end1[0], end1[1], end1[2]);
+        if (color0 < color1) {
+            std::swap(color0, color1);
+        }
+
+        // Four-color mode needs color0 > color1; equal endpoints only ever use index 0
+        int palette[4][3];
+        s_from565(color0, palette[0]);
+        s_from565(color1, palette[1]);
+        for (int c = 0; c < 3; ++c) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        uint32_t indices = 0;
+        if (color0 != color1) {
+            for (int i = 0; i < 16; ++i) {
+                int best = 0;
+                int bestDistance = INT_MAX;
+                for (int p = 0; p < 4; ++p) {
+                    int distance = 0;
+                    for (int c = 0; c < 3; ++c) {
+                        const int d = pixels[i][c] - palette[p][c];
+                        distance += d * d;
+                    }
+                    if (distance < bestDistance) {
+                        bestDistance = distance;
+                        best = p;
+                    }
+                }
+                indices |= uint32_t(best) << (i * 2);
+            }
+        }
+
+        s_putLittleEndian(out, color0, 2);
+        s_putLittleEndian(out + 2, color1, 2);
+        s_putLittleEndian(out + 4, indices, 4);
+    }
+
+    // Encode the alpha of 16 RGBA pixels as a BC3 alpha block in eight-value mode
+    void s_encodeAlphaBlock(const uint8_t (&pixels)[16][4], uint8_t* out)
+    {
+        int alpha0 = 0;
+        int alpha1 = 255;
+        for (int i = 0; i < 16; ++i) {
+            alpha0 = max<int>(alpha0, pixels[i][3]);
+            alpha1 = min<int>(alpha1, pixels[i][3]);
+        }
+
+        // Index 0 and 1 are the endpoints, 2 to 7 lie evenly between them
+        int palette[8] = { alpha0, alpha1 };
+        for (int p = 2; p < 8; ++p) {
+            palette[p] = ((8 - p) * alpha0 + (p - 1) * alpha1) / 7;
+        }
+
+        uint64_t indices = 0;
+        if (alpha0 != alpha1) {
+            for (int i = 0; i < 16; ++i) {
+                int best = 0;
+                for (int p = 1; p < 8; ++p) {
+                    if (abs(pixels[i][3] - palette[p]) < abs(pixels[i][3] - palette[best])) {
+                        best = p;
+                    }
+                }
+                indices |= uint64_t(best) << (i * 3);
+            }
+        }
+
+        out[0] = uint8_t(alpha0);
+        out[1] = uint8_t(alpha1);
+        for (int i = 0; i < 6; ++i) {
+            out[2 + i] = uint8_t(indices >> (i * 8));
+        }
+    }
+
+    inline uint32_t s_getLittleEndian(const uint8_t* in, int byteCount)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < byteCount; ++i) {
+            value |= uint32_t(in[i]) << (i * 8);
+        }
+        return value;
+    }
+
+    // Decode a BC1 block into the colors of 16 RGBA pixels (alpha is left alone).
+    // Blocks written by s_encodeColorBlock are in four-color mode; three-color mode is decoded too.
+    void s_decodeColorBlock(const uint8_t* in, uint8_t (&pixels)[16][4])
+    {
+        const uint16_t color0 = uint16_t(s_getLittleEndian(in, 2));
+        const uint16_t color1 = uint16_t(s_getLittleEndian(in + 2, 2));
+        const uint32_t indices = s_getLittleEndian(in + 4, 4);
+
+        int palette[4][3];
+        s_from565(color0, palette[0]);
+        s_from565(color1, palette[1]);
+        for (int c = 0; c < 3; ++c) {
+            if (color1 < color0) {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            else {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                palette[3][c] = 0;
+            }
+        }
+
+        for (int i = 0; i < 16; ++i) {
+            const int p = (indices >> (i * 2)) & 3;
+            for (int c = 0; c < 3; ++c) {
+                pixels[i][c] = uint8_t(palette[p][c]);
+            }
+        }
+    }
+
+    // Decode a BC3 alpha block into the alpha of 16 RGBA pixels
+    void s_decodeAlphaBlock(const uint8_t* in, uint8_t (&pixels)[16][4])
+    {
+        const int alpha0 = in[0];
+        const int alpha1 = in[1];
+        int palette[8] = { alpha0, alpha1 };
+        for (int p = 2; p < 8; ++p) {
+            palette[p] = alpha1 < alpha0
+                ? ((8 - p) * alpha0 + (p - 1) * alpha1) / 7
+                : (p < 6 ? ((6 - p) * alpha0 + (p - 1) * alpha1) / 5 : (p == 6 ? 0 : 255));
+        }
+
+        uint64_t indices = 0;
+        for (int i = 0; i < 6; ++i) {
+            indices |= uint64_t(in[2 + i]) << (i * 8);
+        }
+        for (int i = 0; i < 16; ++i) {
+            pixels[i][3] = uint8_t(palette[(indices >> (i * 3)) & 7]);
+        }
+    }
+
+    // Encode a level given as RGBA rows
+    void s_encodeLevel(CompressedImage::Format format, const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& blocks)
+    {
+        const size_t blockBytes = s_blockBytes(format);
+        blocks.resize(s_levelBytes(format, width, height));
+        uint8_t* out = blocks.empty() ? NULL : &blocks[0];
+
+        for (uint32_t blockY = 0; blockY < height; blockY += 4) {
+            for (uint32_t blockX = 0; blockX < width; blockX += 4) {
+                // Blocks past the right or bottom edge repeat the last column or row
+                uint8_t pixels[16][4];
+                for (uint32_t y = 0; y < 4; ++y) {
+                    const uint32_t sy = min(blockY + y, height - 1);
+                    for (uint32_t x = 0; x < 4; ++x) {
+                        const uint32_t sx = min(blockX + x, width - 1);
+                        ::memcpy(pixels[y * 4 + x], &rgba[(size_t(sy) * width + sx) * 4], 4);
+                    }
+                }
+
+                if (format == CompressedImage::k_Format_BC3) {
+                    s_encodeAlphaBlock(pixels, out);
+                    s_encodeColorBlock(pixels, out + 8);
+                }
+                else {
+                    s_encodeColorBlock(pixels, out);
+                }
+                out += blockBytes;
+            }
+        }
+    }
+
+    // Halve a level with a box filter (a side of 1 stays 1)
+    void s_downsample(const std::vector<uint8_t>& src, uint32_t width, uint32_t height, std::vector<uint8_t>& dst, uint32_t& dstWidth, uint32_t& dstHeight)
+    {
+        dstWidth = max(1u, width / 2);
+        dstHeight = max(1u, height / 2);
+        dst.resize(size_t(dstWidth) * dstHeight * 4);
+        for (uint32_t y = 0; y < dstHeight; ++y) {
+            const uint32_t y0 = min(y * 2, height - 1);
+            const uint32_t y1 = min(y * 2 + 1, height - 1);
+            for (uint32_t x = 0; x < dstWidth; ++x) {
+                const uint32_t x0 = min(x * 2, width - 1);
+                const uint32_t x1 = min(x * 2 + 1, width - 1);
+                for (int c = 0; c < 4; ++c) {
+                    const uint32_t sum = src[(size_t(y0) * width + x0) * 4 + c] + src[(size_t(y0) * width + x1) * 4 + c]
+                        + src[(size_t(y1) * width + x0) * 4 + c] + src[(size_t(y1) * width + x1) * 4 + c];
+                    dst[(size_t(y) * dstWidth + x) * 4 + c] = uint8_t((sum + 2) / 4);
+                }
+            }
+        }
+    }
+}
+
+
+// Forget the blocks
+void CompressedImage::reset()
+{
+    m_format = k_Format_None;
+    m_width = 0;
+    m_height = 0;
+    m_levels.clear();
+}
+
+
+// Encode an image and its mip chain
+bool CompressedImage::compress(const Image& image)
+{
+    reset();
+    if (image.width() <= 0 || image.height() <= 0) {
+        return false;
+    }
+
+    const bool hasAlpha = image.pixelFormat() == k_PixelFormat_RGBA;
+    if (!hasAlpha && image.pixelFormat() != k_PixelFormat_RGB) {
+        return false;
+    }
+    const Format format = hasAlpha ? k_Format_BC3 : k_Format_BC1;
+
+    // Level 0 as RGBA rows; the image is BGR(A) with padded rows
+    uint32_t width = image.width();
+    uint32_t height = image.height();
+    std::vector<uint8_t> rgba(size_t(width) * height * 4);
+    const uint32_t bytesPerPixel = hasAlpha ? 4 : 3;
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t* src = image.imageBits() + size_t(y) * image.stride();
+        uint8_t* dst = &rgba[size_t(y) * width * 4];
+        for (uint32_t x = 0; x < width; ++x, src += bytesPerPixel, dst += 4) {
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+            dst[3] = hasAlpha ? src[3] : 255;
+        }
+    }
+
+    std::vector<uint8_t> next;
+    for (;;) {
+        Level level;
+        level.width = width;
+        level.height = height;
+        s_encodeLevel(format, rgba, width, height, level.blocks);
+        m_levels.push_back(std::move(level));
+
+        if (width == 1 && height == 1) {
+            break;
+        }
+        s_downsample(rgba, width, height, next, width, height);
+        rgba.swap(next);
+    }
+
+    m_format = format;
+    m_width = image.width();
+    m_height = image.height();
+    return true;
+}
+
+
+// Load the blocks from a cache file
+bool CompressedImage::loadFromFile(const std::wstring& fileName, uint64_t sourceStamp, uint32_t maxWidth)
+{
+    reset();
+
+    CacheFileReader file;
+    FileHeader header;
+    if (!file.open(fileName, FileHeader::k_Magic, FileHeader::k_Version, sourceStamp)
+        || !file.readValue(header)
+        || (header.format != k_Format_BC1 && header.format != k_Format_BC3)
+        || header.levelCount == 0 || 32 < header.levelCount) {
+        return false;
+    }
+
+    const Format format = Format(header.format);
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<Level> levels;
+    for (uint32_t i = 0; i < header.levelCount; ++i) {
+        LevelHeader levelHeader;
+        if (!file.readValue(levelHeader) || levelHeader.width == 0 || levelHeader.height == 0
+            || levelHeader.byteCount != s_levelBytes(format, levelHeader.width, levelHeader.height)) {
+            return false;
+        }
+        if (i == 0) {
+            width = levelHeader.width;
+            height = levelHeader.height;
+        }
+
+        // The smallest level is always kept, so something is loaded whatever the width asked for
+        if (maxWidth != 0 && maxWidth < levelHeader.width && i + 1 < header.levelCount) {
+            if (!file.skip(levelHeader.byteCount)) {
+                return false;
+            }
+            continue;
+        }
+
+        Level level;
+        level.width = levelHeader.width;
+        level.height = levelHeader.height;
+        level.blocks.resize(levelHeader.byteCount);
+        if (!file.readArray(level.blocks)) {
+            return false;
+        }
+        levels.push_back(std::move(level));
+    }
+
+    m_format = format;
+    m_width = width;
+    m_height = height;
+    m_levels.swap(levels);
+    return true;
+}
+
+
+// Decode a level into an image
+bool CompressedImage::decodeLevel(size_t index, Image& image) const
+{
+    if (m_levels.size() <= index) {
+        return false;
+    }
+
+    const Level& level = m_levels[index];
+    const bool hasAlpha = m_format == k_Format_BC3;
+    if (!image.createImage(level.width, level.height, hasAlpha ? k_PixelFormat_RGBA : k_PixelFormat_RGB)) {
+        return false;
+    }
+
+    const uint32_t bytesPerPixel = hasAlpha ? 4 : 3;
+    const size_t blockBytes = s_blockBytes(m_format);
+    const uint8_t* block = level.blocks.empty() ? NULL : &level.blocks[0];
+    for (uint32_t blockY = 0; blockY < level.height; blockY += 4) {
+        for (uint32_t blockX = 0; blockX < level.width; blockX += 4, block += blockBytes) {
+            uint8_t pixels[16][4];
+            if (hasAlpha) {
+                s_decodeAlphaBlock(block, pixels);
+                s_decodeColorBlock(block + 8, pixels);
+            }
+            else {
+                s_decodeColorBlock(block, pixels);
+            }
+
+            // The image is BGR(A) with padded rows; pixels past the edge are dropped
+            for (uint32_t y = 0; y < 4 && blockY + y < level.height; ++y) {
+                uint8_t* dst = image.mutableImageBits() + size_t(blockY + y) * image.stride() + size_t(blockX) * bytesPerPixel;
+                for (uint32_t x = 0; x < 4 && blockX + x < level.width; ++x, dst += bytesPerPixel) {
+                    const uint8_t* src = pixels[y * 4 + x];
+                    dst[0] = src[2];
+                    dst[1] = src[1];
+                    dst[2] = src[0];
+                    if (hasAlpha) {
+                        dst[3] = src[3];
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+
+// Write the blocks to a cache file
+bool CompressedImage::saveToFile(const std::wstring& fileName, uint64_t sourceStamp) const
+{
+    if (empty()) {
+        return false;
+    }
+
+    CacheFileWriter file;
+    if (!file.open(fileName, FileHeader::k_Magic, FileHeader::k_Version, sourceStamp)) {
+        return false;
+    }
+
+    FileHeader header;
+    header.format = m_format;
+    header.levelCount = uint32_t(m_levels.size());
+    file.writeValue(header);
+    for (const Level& level : m_levels) {
+        LevelHeader levelHeader;
+        levelHeader.width = level.width;
+        levelHeader.height = level.height;
+        levelHeader.byteCount = uint32_t(level.blocks.size());
+        file.writeValue(levelHeader);
+        file.writeArray(level.blocks);
+    }
+    return file.close();
+}
+
+
+// Get a stamp identifying the current contents of a file
+uint64_t CompressedImage::fileStamp(const std::wstring& fileName)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data = {};
+    if (!::GetFileAttributesEx(fileName.c_str(), GetFileExInfoStandard, &data)) {
+        return 0;
+    }
+
+    const uint64_t size = (uint64_t(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    const uint64_t writeTime = (uint64_t(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+    return writeTime ^ (size * 0x9E3779B97F4A7C15ULL);
+}
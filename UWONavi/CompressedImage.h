@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>        // For fixed-width integer types
+#include <string>         // For file names
+#include <vector>         // For the blocks of each level
+
+#include "Noncopyable.h"  // To prevent copying of the blocks
+
+class Image;
+
+//! @brief An image and its mip chain encoded in S3TC blocks, ready to be uploaded as a compressed texture.
+//! Opaque images are encoded as BC1 (DXT1, 4 bits per pixel), images with alpha as BC3 (DXT5, 8 bits per
+//! pixel). Every 4x4 pixel block is encoded on its own, so the GPU samples the blocks directly; the encoding
+//! takes a while, so the blocks are kept in a cache file next to the source image.
+class CompressedImage : private Noncopyable {
+public:
+    //! @brief Block encoding
+    enum Format : uint32_t {
+        k_Format_None,  //!< Nothing encoded
+        k_Format_BC1,   //!< 8 bytes per block: two RGB565 endpoints and 2-bit indices
+        k_Format_BC3,   //!< 16 bytes per block: an alpha block (two endpoints, 3-bit indices) and a BC1 color block
+    };
+
+    //! @brief One level of the mip chain
+    struct Level {
+        uint32_t width;                 //!< Width in pixels (blocks cover it rounded up to 4)
+        uint32_t height;                //!< Height in pixels
+        std::vector<uint8_t> blocks;    //!< Blocks in rows, top-down like Image
+    };
+
+private:
+    Format m_format;                //!< Encoding of every level
+    uint32_t m_width;               //!< Width of the full-size image (also when its level was not loaded)
+    uint32_t m_height;              //!< Height of the full-size image
+    std::vector<Level> m_levels;    //!< Level 0 is the full-size image, or the largest level loaded
+
+public:
+    CompressedImage() :
+        m_format(k_Format_None),
+        m_width(),
+        m_height(),
+        m_levels()
+    {
+    }
+
+    //! @brief Check whether nothing is encoded.
+    bool empty() const { return m_levels.empty(); }
+
+    //! @brief Get the block encoding.
+    Format format() const { return m_format; }
+
+    //! @brief Get the levels, largest first.
+    const std::vector<Level>& levels() const { return m_levels; }
+
+    //! @brief Get the width of the full-size image.
+    uint32_t width() const { return m_width; }
+
+    //! @brief Get the height of the full-size image.
+    uint32_t height() const { return m_height; }
+
+    //! @brief Forget the blocks.
+    void reset();
+
+    //! @brief Encode an RGB or RGBA image and its mip chain down to 1x1.
+    //! @return false if the image has no pixels or an unknown format
+    bool compress(const Image& image);
+
+    //! @brief Load the blocks from a cache file.
+    //! @param fileName Cache file
+    //! @param sourceStamp Stamp of the source image; a file written for another stamp is ignored
+    //! @param maxWidth Levels wider than this are skipped without being read (0 loads every level)
+    //! @return false if the file is missing, stale or broken
+    bool loadFromFile(const std::wstring& fileName, uint64_t sourceStamp, uint32_t maxWidth = 0);
+
+    //! @brief Decode a level into an RGB image (BC1) or an RGBA image (BC3).
+    //! @return false if there is no such level or the image cannot be created
+    bool decodeLevel(size_t index, Image& image) const;
+
+    //! @brief Write the blocks to a cache file.
+    //! @return false if the file cannot be written
+    bool saveToFile(const std::wstring& fileName, uint64_t sourceStamp) const;
+
+    //! @brief Get a stamp identifying the current contents of a file (its size and last write time).
+    //! @return 0 if the file does not exist
+    static uint64_t fileStamp(const std::wstring& fileName);
+};
@@ -16,21 +16,35 @@ private:
     const LPCWSTR m_coreSectionName = L"core";           // Core settings section
     const LPCWSTR m_windowSectionName = L"window";       // Window-related settings section
     const LPCWSTR m_surveyCoordSectionName = L"survey";  // Survey coordinates section
+    const LPCWSTR m_layersSectionName = L"layers";       // Map layers section
 
 #ifndef NDEBUG
     const LPCWSTR m_debugSectionName = L"debug";         // Debug settings section (only in debug mode)
 #endif
 
 public:
+    // Most map layers that can be configured (map1 to map9, one digit shortcut each)
+    static const size_t k_maxMapLayers = 9;
+
     // Configuration variables for various features
     std::wstring m_mapFileName;              // Map file name
+    std::wstring m_portsFileName;            // Port list file name (x, y and name per line)
+    std::wstring m_seaRegionsFileName;       // Image painting the named sea areas, one color each
+    std::wstring m_seaRegionNamesFileName;   // Names of the sea area colors (color and name per line)
     UINT m_pollingInterval;                  // Polling interval in milliseconds
+    UINT m_frameRateLimit;                   // Maximum frames per second (0 follows the display refresh rate)
+    double m_routeTolerance;                 // Farthest a polled point dropped from a route may lie from it, in world coordinates (0 keeps every point)
     POINT m_windowPos;                       // Position of the window
     SIZE m_windowSize;                       // Size of the window
     bool m_keepForeground;                   // Keep the application window in the foreground
     bool m_traceShipPositionEnabled;         // Enable tracing of ship positions
     bool m_speedMeterEnabled;                // Enable speed meter display
     bool m_shipVectorLineEnabled;            // Enable ship vector line display
+    bool m_scrollBlitEnabled;                // Reuse the last frame while panning and zooming
+    bool m_compressedMapEnabled;             // Upload the map as block-compressed texture (cached next to the map)
+    UINT m_mapTextureBudget;                 // Video memory in MB for keeping map layers uploaded
+    bool m_releaseHiddenResources;           // Release the map textures while the window cannot be seen
+    std::vector<std::wstring> m_mapLayerFileNames; // Map images to switch between (map1 to map9)
     POINT m_initialSurveyCoord;              // Initial survey coordinates
 
 #ifndef NDEBUG
@@ -45,13 +59,23 @@ public:
     Config(LPCWSTR fileName)
         : m_fileName(g_makeFullPath(fileName)),
         m_mapFileName(L"map.png"),
+        m_portsFileName(L"ports.txt"),
+        m_seaRegionsFileName(L"searegions.png"),
+        m_seaRegionNamesFileName(L"searegions.txt"),
         m_pollingInterval(1000),
+        m_frameRateLimit(0),
+        m_routeTolerance(1.0),
         m_windowPos(defaultPosition()),
         m_windowSize(defaultSize()),
         m_keepForeground(false),
         m_traceShipPositionEnabled(true),
         m_speedMeterEnabled(true),
         m_shipVectorLineEnabled(true),
+        m_scrollBlitEnabled(true),
+        m_compressedMapEnabled(true),
+        m_mapTextureBudget(256),
+        m_releaseHiddenResources(false),
+        m_mapLayerFileNames(),
         m_initialSurveyCoord(defaultSurveyCoord())
 #ifndef NDEBUG
         , m_debugAutoCruiseEnabled(false),
@@ -75,10 +99,26 @@ public:
         // Save core settings
         section = m_coreSectionName;
         ::WritePrivateProfileString(section, L"map", m_mapFileName.c_str(), fn);
+        ::WritePrivateProfileString(section, L"ports", m_portsFileName.c_str(), fn);
+        ::WritePrivateProfileString(section, L"seaRegions", m_seaRegionsFileName.c_str(), fn);
+        ::WritePrivateProfileString(section, L"seaRegionNames", m_seaRegionNamesFileName.c_str(), fn);
         ::WritePrivateProfileString(section, L"pollingInterval", std::to_wstring(m_pollingInterval).c_str(), fn);
+        ::WritePrivateProfileString(section, L"frameRateLimit", std::to_wstring(m_frameRateLimit).c_str(), fn);
+        ::WritePrivateProfileString(section, L"routeTolerance", std::to_wstring(m_routeTolerance).c_str(), fn);
         ::WritePrivateProfileString(section, L"traceEnabled", std::to_wstring(m_traceShipPositionEnabled).c_str(), fn);
         ::WritePrivateProfileString(section, L"speedMeterEnabled", std::to_wstring(m_speedMeterEnabled).c_str(), fn);
         ::WritePrivateProfileString(section, L"shipVectorLineEnabled", std::to_wstring(m_shipVectorLineEnabled).c_str(), fn);
+        ::WritePrivateProfileString(section, L"scrollBlitEnabled", std::to_wstring(m_scrollBlitEnabled).c_str(), fn);
+        ::WritePrivateProfileString(section, L"compressedMapEnabled", std::to_wstring(m_compressedMapEnabled).c_str(), fn);
+        ::WritePrivateProfileString(section, L"mapTextureBudget", std::to_wstring(m_mapTextureBudget).c_str(), fn);
+        ::WritePrivateProfileString(section, L"releaseHiddenResources", std::to_wstring(m_releaseHiddenResources).c_str(), fn);
+
+        // Save map layers; keys past the last layer are removed
+        section = m_layersSectionName;
+        for (size_t i = 0; i < k_maxMapLayers; ++i) {
+            const std::wstring key = L"map" + std::to_wstring(i + 1);
+            ::WritePrivateProfileString(section, key.c_str(), i < m_mapLayerFileNames.size() ? m_mapLayerFileNames[i].c_str() : NULL, fn);
+        }
 
         // Save window settings
         section = m_windowSectionName;
@@ -118,10 +158,34 @@ public:
         section = m_coreSectionName;
         ::GetPrivateProfileStringW(section, L"map", m_mapFileName.c_str(), &buf[0], buf.size(), fn);
         m_mapFileName = &buf[0];
+        ::GetPrivateProfileStringW(section, L"ports", m_portsFileName.c_str(), &buf[0], buf.size(), fn);
+        m_portsFileName = &buf[0];
+        ::GetPrivateProfileStringW(section, L"seaRegions", m_seaRegionsFileName.c_str(), &buf[0], buf.size(), fn);
+        m_seaRegionsFileName = &buf[0];
+        ::GetPrivateProfileStringW(section, L"seaRegionNames", m_seaRegionNamesFileName.c_str(), &buf[0], buf.size(), fn);
+        m_seaRegionNamesFileName = &buf[0];
         m_pollingInterval = ::GetPrivateProfileInt(section, L"pollingInterval", m_pollingInterval, fn);
+        m_frameRateLimit = ::GetPrivateProfileInt(section, L"frameRateLimit", m_frameRateLimit, fn);
+        ::GetPrivateProfileString(section, L"routeTolerance", std::to_wstring(m_routeTolerance).c_str(), &buf[0], buf.size(), fn);
+        m_routeTolerance = std::stod(std::wstring(&buf[0]));
         m_traceShipPositionEnabled = ::GetPrivateProfileInt(section, L"traceEnabled", m_traceShipPositionEnabled, fn) != 0;
         m_speedMeterEnabled = ::GetPrivateProfileInt(section, L"speedMeterEnabled", m_speedMeterEnabled, fn) != 0;
         m_shipVectorLineEnabled = ::GetPrivateProfileInt(section, L"shipVectorLineEnabled", m_shipVectorLineEnabled, fn) != 0;
+        m_scrollBlitEnabled = ::GetPrivateProfileInt(section, L"scrollBlitEnabled", m_scrollBlitEnabled, fn) != 0;
+        m_compressedMapEnabled = ::GetPrivateProfileInt(section, L"compressedMapEnabled", m_compressedMapEnabled, fn) != 0;
+        m_mapTextureBudget = ::GetPrivateProfileInt(section, L"mapTextureBudget", m_mapTextureBudget, fn);
+        m_releaseHiddenResources = ::GetPrivateProfileInt(section, L"releaseHiddenResources", m_releaseHiddenResources, fn) != 0;
+
+        // Load map layers, skipping empty keys
+        section = m_layersSectionName;
+        m_mapLayerFileNames.clear();
+        for (size_t i = 0; i < k_maxMapLayers; ++i) {
+            const std::wstring key = L"map" + std::to_wstring(i + 1);
+            ::GetPrivateProfileStringW(section, key.c_str(), L"", &buf[0], buf.size(), fn);
+            if (buf[0] != L'\0') {
+                m_mapLayerFileNames.push_back(&buf[0]);
+            }
+        }
 
         // Load window settings
         section = m_windowSectionName;
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <Windows.h>   // For POINT and SIZE
+#include <cstdint>     // For mesh indices
+#include <memory>      // For meshes shared between frames
+#include <string>      // For the speed meter text
+#include <vector>      // For line vertices
+
+class Image;
+
+// Placement of the wrapped world map on the surface being drawn.
+// Copy k of the world is drawn with its left edge at x + k * width.
+struct MapLayout {
+    float x;        //!< Left edge of the leftmost copy (never right of the view's left edge)
+    float y;        //!< Top edge of the map
+    float width;    //!< Width of one copy of the map
+    float height;   //!< Height of the map
+    float clipWidth;    //!< Width of the surface drawn to; geometry outside it is culled
+    float clipHeight;   //!< Height of the surface drawn to
+};
+
+// Part of a route line tessellated into a wide, antialiased band, in pixels of the map at one zoom level.
+// Every point has four vertices across the line: outer left, left, right, outer right. Coverage is 1 on
+// the inner two and 0 on the outer two, so interpolating it fades the edges over one pixel. Each segment
+// is three quads between the vertices of its points (see meshIndices). Immutable once built, so frames
+// drawn on the render thread share it with the cache on the UI thread.
+struct LineMesh {
+    enum {
+        k_maxPoints = 256,          //!< Points per mesh, so that 16-bit indices reach every vertex
+        k_indicesPerSegment = 18,   //!< Three quads of two triangles
+    };
+
+    float minX;                     //!< Bounds of the vertices
+    float minY;
+    float maxX;
+    float maxY;
+    std::vector<float> vertices;    //!< x, y of four vertices per point
+    std::vector<float> coverage;    //!< Coverage of every vertex
+
+    size_t pointCount() const { return coverage.size() / 4; }
+
+    // Triangle indices of the first segmentCount segments of any mesh, three quads per segment
+    static std::vector<uint16_t> meshIndices(size_t segmentCount)
+    {
+        std::vector<uint16_t> indices;
+        indices.reserve(segmentCount * k_indicesPerSegment);
+        for (size_t segment = 0; segment < segmentCount; ++segment) {
+            const uint16_t from = uint16_t(segment * 4);
+            const uint16_t to = uint16_t(from + 4);
+            for (uint16_t column = 0; column < 3; ++column) {
+                const uint16_t quad[] = {
+                    uint16_t(from + column), uint16_t(from + column + 1), uint16_t(to + column + 1),
+                    uint16_t(from + column), uint16_t(to + column + 1), uint16_t(to + column),
+                };
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        }
+        return indices;
+    }
+};
+
+// A mesh drawn at an offset in view coordinates (once for each wrapped copy it is visible in)
+struct MeshDraw {
+    std::shared_ptr<const LineMesh> mesh;   //!< Shared with the cache that built it
+    float x;                                //!< Offset of the map pixels of the mesh
+    float y;
+};
+
+// Segments drawn with one call and the state they are drawn with
+struct LineBatch {
+    float color[4];                 //!< RGBA color
+    float width;                    //!< Line width in pixels
+    bool blend;                     //!< Whether alpha blending is enabled (meshes always blend their edges)
+    std::vector<float> vertices;    //!< x, y pairs in view coordinates, two points per segment
+    std::vector<MeshDraw> meshes;   //!< Tessellated route lines, drawn after the segments
+};
+
+// One frame as a render backend draws it. Built by Renderer on the UI thread and never modified
+// afterwards, so the backend needs no access to routes, the ship or the view state.
+struct FrameDescription {
+    enum {
+        k_shipMarkSize = 16,                //!< Width and height of the ship marker in pixels
+    };
+
+    SIZE viewSize;                      //!< Size of the view
+    MapLayout layout;                   //!< Placement of the map
+    std::vector<LineBatch> lineBatches; //!< Routes and the course line, in drawing order
+    bool routeLayerEnabled;             //!< Whether fixed routes are composited from the route layer
+    bool routeLayerRedraw;              //!< Whether the route layer has to be redrawn first
+    SIZE routeLayerSize;                //!< Size of the route layer
+    POINT routeLayerOrigin;             //!< Top-left of the route layer in view coordinates
+    std::vector<LineBatch> routeLayerBatches; //!< Fixed routes in layer coordinates (only when redrawn)
+    bool preview;                       //!< Whether to transform the last snapshot instead of drawing routes
+    bool captureSnapshot;               //!< Whether to keep the map and routes of this frame for previews
+    const Image* shipIcon;              //!< Ship marker image (NULL if not drawn); stays alive while frames use it
+    std::vector<POINT> shipMarkers;     //!< Top-left of every visible copy of the ship marker
+    std::wstring speedText;             //!< Speed meter text (empty when hidden)
+};
@@ -0,0 +1,103 @@
+#include "stdafx.h"
+#include "GLExtensions.h"
+#include <cstring>
+
+namespace {
+    // Look up an entry point of the current context
+    template<typename Function>
+    inline void s_getProc(Function& function, const char* name)
+    {
+        function = reinterpret_cast<Function>(::wglGetProcAddress(name));
+    }
+
+    // Major and minor version of the current context
+    inline void s_getVersion(int& major, int& minor)
+    {
+        major = minor = 0;
+        const char* version = reinterpret_cast<const char*>(::glGetString(GL_VERSION));
+        if (version) {
+            ::sscanf(version, "%d.%d", &major, &minor);
+        }
+    }
+}
+
+
+GLExtensions::GLExtensions()
+{
+    clear();
+}
+
+
+// Look up every entry point
+void GLExtensions::load()
+{
+    clear();
+
+    int major, minor;
+    s_getVersion(major, minor);
+
+    if (isExtensionSupported("GL_EXT_framebuffer_object")) {
+        s_getProc(glGenFramebuffersEXT, "glGenFramebuffersEXT");
+        s_getProc(glDeleteFramebuffersEXT, "glDeleteFramebuffersEXT");
+        s_getProc(glBindFramebufferEXT, "glBindFramebufferEXT");
+        s_getProc(glFramebufferTexture2DEXT, "glFramebufferTexture2DEXT");
+        s_getProc(glCheckFramebufferStatusEXT, "glCheckFramebufferStatusEXT");
+    }
+
+    if (1 < major || (major == 1 && 4 <= minor)) {
+        s_getProc(glBlendFuncSeparate, "glBlendFuncSeparate");
+    }
+    if (!glBlendFuncSeparate && isExtensionSupported("GL_EXT_blend_func_separate")) {
+        s_getProc(glBlendFuncSeparate, "glBlendFuncSeparateEXT");
+    }
+
+    if (1 < major || (major == 1 && 3 <= minor)) {
+        s_getProc(glCompressedTexImage2D, "glCompressedTexImage2D");
+    }
+    if (!glCompressedTexImage2D && isExtensionSupported("GL_ARB_texture_compression")) {
+        s_getProc(glCompressedTexImage2D, "glCompressedTexImage2DARB");
+    }
+    m_s3tcTextures = isExtensionSupported("GL_EXT_texture_compression_s3tc");
+
+    // Only listed by wglGetExtensionsStringEXT, which itself has to be looked up; the entry point is enough
+    s_getProc(wglSwapIntervalEXT, "wglSwapIntervalEXT");
+
+    m_nonPowerOfTwoTextures = 2 <= major || isExtensionSupported("GL_ARB_texture_non_power_of_two");
+}
+
+
+// Forget every entry point
+void GLExtensions::clear()
+{
+    glGenFramebuffersEXT = NULL;
+    glDeleteFramebuffersEXT = NULL;
+    glBindFramebufferEXT = NULL;
+    glFramebufferTexture2DEXT = NULL;
+    glCheckFramebufferStatusEXT = NULL;
+    glBlendFuncSeparate = NULL;
+    glCompressedTexImage2D = NULL;
+    wglSwapIntervalEXT = NULL;
+    m_nonPowerOfTwoTextures = false;
+    m_s3tcTextures = false;
+}
+
+
+// Check whether the current context lists an extension
+bool GLExtensions::isExtensionSupported(const char* name)
+{
+    const char* extensions = reinterpret_cast<const char*>(::glGetString(GL_EXTENSIONS));
+    if (!extensions) {
+        return false;
+    }
+
+    // Names are separated by spaces; a plain strstr would also match a longer name starting with this one
+    const size_t length = ::strlen(name);
+    for (const char* p = ::strstr(extensions, name); p; p = ::strstr(p + length, name)) {
+        const bool startsWord = (p == extensions) || (p[-1] == ' ');
+        const bool endsWord = (p[length] == ' ') || (p[length] == '\0');
+        if (startsWord && endsWord) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+// Constants of the extensions used below (gl/GL.h only covers OpenGL 1.1)
+#ifndef GL_FRAMEBUFFER_EXT
+#define GL_FRAMEBUFFER_EXT                  0x8D40
+#define GL_COLOR_ATTACHMENT0_EXT            0x8CE0
+#define GL_FRAMEBUFFER_COMPLETE_EXT         0x8CD5
+#endif
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT     0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT    0x83F3
+#endif
+
+//! @brief OpenGL entry points beyond 1.1, resolved once the context is current.
+//! opengl32.dll only exports OpenGL 1.1; everything newer has to be looked up with
+//! wglGetProcAddress on the thread owning the context. A pointer stays NULL when the driver
+//! does not provide the function, so callers check the has...() queries first.
+class GLExtensions {
+public:
+    typedef void (APIENTRY *PFNGLGENFRAMEBUFFERSEXTPROC)(GLsizei n, GLuint* framebuffers);
+    typedef void (APIENTRY *PFNGLDELETEFRAMEBUFFERSEXTPROC)(GLsizei n, const GLuint* framebuffers);
+    typedef void (APIENTRY *PFNGLBINDFRAMEBUFFEREXTPROC)(GLenum target, GLuint framebuffer);
+    typedef void (APIENTRY *PFNGLFRAMEBUFFERTEXTURE2DEXTPROC)(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level);
+    typedef GLenum (APIENTRY *PFNGLCHECKFRAMEBUFFERSTATUSEXTPROC)(GLenum target);
+    typedef void (APIENTRY *PFNGLBLENDFUNCSEPARATEPROC)(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha);
+    typedef void (APIENTRY *PFNGLCOMPRESSEDTEXIMAGE2DPROC)(GLenum target, GLint level, GLenum internalFormat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const void* data);
+    typedef BOOL (WINAPI *PFNWGLSWAPINTERVALEXTPROC)(int interval);
+
+    // GL_EXT_framebuffer_object
+    PFNGLGENFRAMEBUFFERSEXTPROC glGenFramebuffersEXT;
+    PFNGLDELETEFRAMEBUFFERSEXTPROC glDeleteFramebuffersEXT;
+    PFNGLBINDFRAMEBUFFEREXTPROC glBindFramebufferEXT;
+    PFNGLFRAMEBUFFERTEXTURE2DEXTPROC glFramebufferTexture2DEXT;
+    PFNGLCHECKFRAMEBUFFERSTATUSEXTPROC glCheckFramebufferStatusEXT;
+
+    // OpenGL 1.4 (or GL_EXT_blend_func_separate)
+    PFNGLBLENDFUNCSEPARATEPROC glBlendFuncSeparate;
+
+    // OpenGL 1.3 (or GL_ARB_texture_compression)
+    PFNGLCOMPRESSEDTEXIMAGE2DPROC glCompressedTexImage2D;
+
+    // WGL_EXT_swap_control
+    PFNWGLSWAPINTERVALEXTPROC wglSwapIntervalEXT;
+
+private:
+    bool m_nonPowerOfTwoTextures;  //!< Whether textures may have any size (OpenGL 2.0 or GL_ARB_texture_non_power_of_two)
+    bool m_s3tcTextures;           //!< Whether BC1 to BC3 blocks can be uploaded (GL_EXT_texture_compression_s3tc)
+
+public:
+    GLExtensions();
+
+    //! @brief Look up every entry point. Must be called with the context current.
+    void load();
+
+    //! @brief Forget every entry point (the context is about to be deleted).
+    void clear();
+
+    //! @brief Offscreen rendering into textures is available.
+    bool hasFramebufferObject() const
+    {
+        return glGenFramebuffersEXT && glDeleteFramebuffersEXT && glBindFramebufferEXT
+            && glFramebufferTexture2DEXT && glCheckFramebufferStatusEXT;
+    }
+
+    //! @brief Color and alpha can be blended with different factors.
+    bool hasBlendFuncSeparate() const
+    {
+        return glBlendFuncSeparate != NULL;
+    }
+
+    //! @brief The number of display refreshes SwapBuffers waits for can be set.
+    bool hasSwapControl() const
+    {
+        return wglSwapIntervalEXT != NULL;
+    }
+
+    //! @brief Textures can be uploaded as BC1 or BC3 blocks.
+    bool hasS3tcTextures() const
+    {
+        return glCompressedTexImage2D && m_s3tcTextures;
+    }
+
+    //! @brief Textures are not restricted to power-of-two sizes.
+    bool hasNonPowerOfTwoTextures() const
+    {
+        return m_nonPowerOfTwoTextures;
+    }
+
+    //! @brief Check whether the current context lists an extension.
+    //! @param name Full extension name, e.g. "GL_EXT_framebuffer_object"
+    static bool isExtensionSupported(const char* name);
+};
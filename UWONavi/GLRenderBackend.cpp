@@ -0,0 +1,511 @@
+#include "stdafx.h"
+#include "GLRenderBackend.h"
+#include "Texture.h"
+
+
+void GLRenderBackend::setup()
+{
+	PIXELFORMATDESCRIPTOR pfd = { sizeof(pfd) };
+	pfd.nVersion = 1;
+	pfd.dwFlags = PFD_DRAW_TO_WINDOW | PFD_SUPPORT_OPENGL | PFD_DOUBLEBUFFER | PFD_SWAP_EXCHANGE;
+	pfd.iPixelType = PFD_TYPE_RGBA;
+	pfd.cColorBits = 24;
+	pfd.cAlphaBits = 8;
+	pfd.cDepthBits = 16;
+	pfd.iLayerType = PFD_MAIN_PLANE;
+	::SetPixelFormat( m_hdc, ::ChoosePixelFormat( m_hdc, &pfd ), &pfd );
+	m_hglrc = ::wglCreateContext( m_hdc );
+	::wglMakeCurrent( m_hdc, m_hglrc );
+	::glDisable( GL_DEPTH_TEST );
+	::glDisable( GL_LIGHTING );
+	::glEnable( GL_CULL_FACE );
+	::glCullFace( GL_BACK );
+
+	// Route meshes interpolate coverage across their edges; a two-texel alpha texture filtered
+	// linearly turns it into alpha, so antialiasing needs neither multisampling nor colors per vertex.
+	static const GLubyte k_coverageTexels[] = { 0, 255 };
+	::glGenTextures( 1, &m_coverageTexture );
+	::glBindTexture( GL_TEXTURE_2D, m_coverageTexture );
+	::glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	::glTexImage2D( GL_TEXTURE_2D, 0, GL_ALPHA, 2, 1, 0, GL_ALPHA, GL_UNSIGNED_BYTE, k_coverageTexels );
+	::glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	::glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	::glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP );
+	::glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP );
+	::glBindTexture( GL_TEXTURE_2D, 0 );
+	m_meshIndices = LineMesh::meshIndices( LineMesh::k_maxPoints - 1 );
+
+	// The route layer needs offscreen rendering, and separate alpha blending to keep it premultiplied
+	m_gl.load();
+	GLint maxTextureSize = 0;
+	::glGetIntegerv( GL_MAX_TEXTURE_SIZE, &maxTextureSize );
+	m_capabilities.maxLayerExtent = maxTextureSize;
+	m_capabilities.nonPowerOfTwoLayers = m_gl.hasNonPowerOfTwoTextures();
+
+	// Present in step with the display, unless a frame rate cap paces the frames instead
+	if ( m_gl.hasSwapControl() ) {
+		m_gl.wglSwapIntervalEXT( m_frameRateLimit == 0 ? 1 : 0 );
+	}
+	m_capabilities.routeLayer = m_gl.hasFramebufferObject() && m_gl.hasBlendFuncSeparate();
+	if ( m_capabilities.routeLayer ) {
+		m_gl.glGenFramebuffersEXT( 1, &m_routeLayerFramebuffer );
+
+		// Some drivers list the extension but cannot render into an RGBA texture
+		Texture probe;
+		probe.allocate( 64, 64 );
+		m_gl.glBindFramebufferEXT( GL_FRAMEBUFFER_EXT, m_routeLayerFramebuffer );
+		m_gl.glFramebufferTexture2DEXT( GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT, GL_TEXTURE_2D, probe.id(), 0 );
+		m_capabilities.routeLayer = m_gl.glCheckFramebufferStatusEXT( GL_FRAMEBUFFER_EXT ) == GL_FRAMEBUFFER_COMPLETE_EXT;
+		m_gl.glBindFramebufferEXT( GL_FRAMEBUFFER_EXT, 0 );
+	}
+}
+
+
+void GLRenderBackend::teardown()
+{
+	m_mapTextures.clear();
+	m_worldMapTexture = NULL;
+	delete m_shipIconTexture;
+	m_shipIconTexture = NULL;
+	m_shipIcon = NULL;
+	delete m_speedMeterTexture;
+	m_speedMeterTexture = NULL;
+	m_speedMeterText.clear();
+	m_projectionSize = SIZE();
+	delete m_routeLayerTexture;
+	m_routeLayerTexture = NULL;
+	delete m_snapshotTexture;
+	m_snapshotTexture = NULL;
+	m_snapshotSize = SIZE();
+	if ( m_coverageTexture ) {
+		::glDeleteTextures( 1, &m_coverageTexture );
+		m_coverageTexture = 0;
+	}
+	m_meshIndices.clear();
+	if ( m_routeLayerFramebuffer ) {
+		m_gl.glDeleteFramebuffersEXT( 1, &m_routeLayerFramebuffer );
+		m_routeLayerFramebuffer = 0;
+	}
+	m_gl.clear();
+	m_capabilities = Capabilities();
+
+	::wglMakeCurrent( NULL, NULL );
+	::wglDeleteContext( m_hglrc );
+	m_hglrc = NULL;
+}
+
+
+void GLRenderBackend::setWorldMap( const Image& image, const CompressedImage * compressed )
+{
+	m_worldMapTexture = &m_mapTextures.acquire( image, compressed, m_gl );
+	m_worldMapTexture->setHorizontalRepeat( true );
+	m_mapTextures.trim( m_worldMapTexture );
+}
+
+
+void GLRenderBackend::prefetchWorldMap( const Image& image, const CompressedImage * compressed )
+{
+	m_mapTextures.prefetch( image, compressed, m_gl, m_worldMapTexture );
+}
+
+
+void GLRenderBackend::releaseResources()
+{
+	m_mapTextures.clear();
+	m_worldMapTexture = NULL;
+	delete m_routeLayerTexture;
+	m_routeLayerTexture = NULL;
+	delete m_snapshotTexture;
+	m_snapshotTexture = NULL;
+	m_snapshotSize = SIZE();
+}
+
+
+void GLRenderBackend::drawFrame( const FrameDescription& frame )
+{
+	if ( frame.routeLayerRedraw ) {
+		drawRouteLayer( frame );
+	}
+
+	if ( m_projectionSize.cx != frame.viewSize.cx || m_projectionSize.cy != frame.viewSize.cy ) {
+		m_projectionSize = frame.viewSize;
+		::glMatrixMode( GL_PROJECTION );
+		::glLoadIdentity();
+		::glViewport( 0, 0, m_projectionSize.cx, m_projectionSize.cy );
+		::gluOrtho2D( 0, m_projectionSize.cx, m_projectionSize.cy, 0 );
+	}
+
+	::glClearColor( 0.2f, 0.2f, 0.3f, 0.0f );
+	::glClear( GL_COLOR_BUFFER_BIT );
+	::glDisable( GL_BLEND );
+
+	::glMatrixMode( GL_MODELVIEW );
+	::glLoadIdentity();
+	renderWorldMap( frame );
+
+	if ( frame.preview ) {
+		// Parts the snapshot does not cover keep the bare map until the full frame
+		renderSnapshot( frame );
+	}
+	else {
+		if ( frame.routeLayerEnabled ) {
+			renderRouteLayer( frame );
+		}
+
+		// Routes not in the layer and the course line
+		::glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+		drawLineBatches( frame.lineBatches );
+
+		// The ship marker and the speed meter are left out, previews draw them where they are then
+		if ( frame.captureSnapshot ) {
+			captureSnapshot( frame );
+		}
+	}
+
+	if ( frame.shipIcon ) {
+		renderShipMarkers( frame );
+	}
+
+	if ( !frame.speedText.empty() ) {
+		renderSpeedMeter( frame );
+	}
+
+	::glFlush();
+	::SwapBuffers( m_hdc );
+}
+
+
+void GLRenderBackend::drawLineBatches( const std::vector<LineBatch>& batches )
+{
+	::glEnableClientState( GL_VERTEX_ARRAY );
+	for ( const LineBatch& batch : batches ) {
+		if ( batch.blend ) {
+			::glEnable( GL_BLEND );
+		}
+		else {
+			::glDisable( GL_BLEND );
+		}
+		::glLineWidth( batch.width );
+		::glColor4fv( batch.color );
+		if ( !batch.vertices.empty() ) {
+			::glVertexPointer( 2, GL_FLOAT, 0, &batch.vertices[0] );
+			::glDrawArrays( GL_LINES, 0, GLsizei( batch.vertices.size() / 2 ) );
+		}
+		if ( !batch.meshes.empty() ) {
+			drawMeshes( batch );
+		}
+	}
+	::glDisableClientState( GL_VERTEX_ARRAY );
+	::glDisable( GL_BLEND );
+}
+
+
+void GLRenderBackend::drawMeshes( const LineBatch& batch )
+{
+	// Edges always blend, even on an opaque batch; the winding of the triangles follows the line
+	::glEnable( GL_BLEND );
+	::glDisable( GL_CULL_FACE );
+
+	::glEnable( GL_TEXTURE_2D );
+	::glBindTexture( GL_TEXTURE_2D, m_coverageTexture );
+	::glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
+
+	// Coverage 0 and 1 land on the centers of the two texels
+	::glMatrixMode( GL_TEXTURE );
+	::glLoadIdentity();
+	::glTranslatef( 0.25f, 0.5f, 0.0f );
+	::glScalef( 0.5f, 1.0f, 1.0f );
+	::glMatrixMode( GL_MODELVIEW );
+
+	::glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+	for ( const MeshDraw& draw : batch.meshes ) {
+		const LineMesh& mesh = *draw.mesh;
+		_ASSERT( 2 <= mesh.pointCount() && mesh.pointCount() <= LineMesh::k_maxPoints );
+
+		::glPushMatrix();
+		::glTranslatef( draw.x, draw.y, 0.0f );
+		::glVertexPointer( 2, GL_FLOAT, 0, &mesh.vertices[0] );
+		::glTexCoordPointer( 1, GL_FLOAT, 0, &mesh.coverage[0] );
+		::glDrawElements( GL_TRIANGLES, GLsizei( (mesh.pointCount() - 1) * LineMesh::k_indicesPerSegment ), GL_UNSIGNED_SHORT, &m_meshIndices[0] );
+		::glPopMatrix();
+	}
+	::glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+
+	::glMatrixMode( GL_TEXTURE );
+	::glLoadIdentity();
+	::glMatrixMode( GL_MODELVIEW );
+	::glBindTexture( GL_TEXTURE_2D, 0 );
+	::glDisable( GL_TEXTURE_2D );
+	::glEnable( GL_CULL_FACE );
+	if ( !batch.blend ) {
+		::glDisable( GL_BLEND );
+	}
+}
+
+
+void GLRenderBackend::drawRouteLayer( const FrameDescription& frame )
+{
+	const SIZE& size = frame.routeLayerSize;
+	if ( !m_routeLayerTexture || m_routeLayerTexture->width() < size.cx || m_routeLayerTexture->height() < size.cy ) {
+		delete m_routeLayerTexture;
+		m_routeLayerTexture = new Texture();
+		m_routeLayerTexture->allocate( m_capabilities.layerExtent( size.cx ), m_capabilities.layerExtent( size.cy ) );
+	}
+
+	m_gl.glBindFramebufferEXT( GL_FRAMEBUFFER_EXT, m_routeLayerFramebuffer );
+	m_gl.glFramebufferTexture2DEXT( GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT, GL_TEXTURE_2D, m_routeLayerTexture->id(), 0 );
+
+	::glViewport( 0, 0, size.cx, size.cy );
+	::glMatrixMode( GL_PROJECTION );
+	::glLoadIdentity();
+	::gluOrtho2D( 0, size.cx, size.cy, 0 );
+	::glMatrixMode( GL_MODELVIEW );
+	::glLoadIdentity();
+
+	::glClearColor( 0.0f, 0.0f, 0.0f, 0.0f );
+	::glClear( GL_COLOR_BUFFER_BIT );
+
+	// Accumulate coverage in alpha so the layer ends up premultiplied;
+	// compositing it then gives the same pixels as drawing the routes over the map directly.
+	m_gl.glBlendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+	drawLineBatches( frame.routeLayerBatches );
+
+	m_gl.glBindFramebufferEXT( GL_FRAMEBUFFER_EXT, 0 );
+
+	// Set the projection up for the view again
+	m_projectionSize = SIZE();
+}
+
+
+void GLRenderBackend::renderRouteLayer( const FrameDescription& frame )
+{
+	_ASSERT( m_routeLayerTexture != NULL );
+
+	// Rendered rows run bottom-up in the texture, and it may be larger than the layer
+	const float sRight = (float)frame.routeLayerSize.cx / m_routeLayerTexture->width();
+	const float tTop = (float)frame.routeLayerSize.cy / m_routeLayerTexture->height();
+	const float left = (float)frame.routeLayerOrigin.x;
+	const float top = (float)frame.routeLayerOrigin.y;
+	const float right = left + frame.routeLayerSize.cx;
+	const float bottom = top + frame.routeLayerSize.cy;
+
+	m_routeLayerTexture->bind();
+	::glEnable( GL_BLEND );
+	::glBlendFunc( GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+
+	::glBegin( GL_QUADS );
+
+	::glTexCoord2f( 0, tTop );
+	::glVertex2f( left, top );
+
+	::glTexCoord2f( 0, 0 );
+	::glVertex2f( left, bottom );
+
+	::glTexCoord2f( sRight, 0 );
+	::glVertex2f( right, bottom );
+
+	::glTexCoord2f( sRight, tTop );
+	::glVertex2f( right, top );
+
+	::glEnd();
+
+	::glDisable( GL_BLEND );
+	m_routeLayerTexture->unbind();
+}
+
+
+void GLRenderBackend::captureSnapshot( const FrameDescription& frame )
+{
+	const SIZE& size = frame.viewSize;
+	if ( size.cx <= 0 || size.cy <= 0 ) {
+		return;
+	}
+
+	if ( !m_snapshotTexture || m_snapshotTexture->width() < size.cx || m_snapshotTexture->height() < size.cy ) {
+		delete m_snapshotTexture;
+		m_snapshotTexture = new Texture();
+		m_snapshotTexture->allocate( m_capabilities.layerExtent( size.cx ), m_capabilities.layerExtent( size.cy ) );
+	}
+
+	m_snapshotTexture->bind();
+	::glCopyTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, 0, 0, size.cx, size.cy );
+	m_snapshotTexture->unbind();
+
+	m_snapshotLayout = frame.layout;
+	m_snapshotSize = size;
+}
+
+
+void GLRenderBackend::renderSnapshot( const FrameDescription& frame )
+{
+	const SIZE& size = m_snapshotSize;
+	if ( !m_snapshotTexture || size.cx != frame.viewSize.cx || size.cy != frame.viewSize.cy ) {
+		return;
+	}
+
+	// A point drawn at p in the snapshot lies (p - snapshot origin) map pixels into the map,
+	// which the current frame places at its own origin plus that distance times the change in zoom.
+	const MapLayout& from = m_snapshotLayout;
+	const MapLayout& to = frame.layout;
+	const float scale = to.width / from.width;
+	const float width = size.cx * scale;
+	const float height = size.cy * scale;
+	float left = to.x - from.x * scale;
+	const float top = to.y - from.y * scale;
+
+	// Both origins are normalized to the leftmost copy, so after crossing the edge of the world
+	// they may be a map width apart; take the placement nearest to the center of the view.
+	left += to.width * ::floor( ((size.cx - width) / 2.0f - left) / to.width + 0.5f );
+	const float right = left + width;
+	const float bottom = top + height;
+
+	// Rows run bottom-up in the texture, which may be larger than the view
+	const float sRight = (float)size.cx / m_snapshotTexture->width();
+	const float tTop = (float)size.cy / m_snapshotTexture->height();
+
+	m_snapshotTexture->bind();
+
+	::glBegin( GL_QUADS );
+
+	::glTexCoord2f( 0, tTop );
+	::glVertex2f( left, top );
+
+	::glTexCoord2f( 0, 0 );
+	::glVertex2f( left, bottom );
+
+	::glTexCoord2f( sRight, 0 );
+	::glVertex2f( right, bottom );
+
+	::glTexCoord2f( sRight, tTop );
+	::glVertex2f( right, top );
+
+	::glEnd();
+
+	m_snapshotTexture->unbind();
+}
+
+
+void GLRenderBackend::renderWorldMap( const FrameDescription& frame )
+{
+	if ( !m_worldMapTexture ) {
+		// No map has been set yet
+		return;
+	}
+
+	// The texture repeats horizontally, so a quad spanning the whole view width
+	// covers every visible copy; s runs from the view's left edge to its right edge in map widths.
+	const MapLayout& layout = frame.layout;
+	const float sLeft = -layout.x / layout.width;
+	const float sRight = (frame.viewSize.cx - layout.x) / layout.width;
+	const float top = layout.y;
+	const float bottom = layout.y + layout.height;
+	const float right = (float)frame.viewSize.cx;
+
+	m_worldMapTexture->bind();
+
+	::glBegin( GL_QUADS );
+
+	::glTexCoord2f( sLeft, 0 );
+	::glVertex2f( 0, top );
+
+	::glTexCoord2f( sLeft, 1 );
+	::glVertex2f( 0, bottom );
+
+	::glTexCoord2f( sRight, 1 );
+	::glVertex2f( right, bottom );
+
+	::glTexCoord2f( sRight, 0 );
+	::glVertex2f( right, top );
+
+	::glEnd();
+
+	m_worldMapTexture->unbind();
+}
+
+
+void GLRenderBackend::renderShipMarkers( const FrameDescription& frame )
+{
+	// The icon is captured once, so it is uploaded once
+	if ( !m_shipIconTexture || m_shipIcon != frame.shipIcon ) {
+		if ( !m_shipIconTexture ) {
+			m_shipIconTexture = new Texture();
+		}
+		m_shipIconTexture->setImage( *frame.shipIcon );
+		m_shipIcon = frame.shipIcon;
+	}
+
+	const float shipMarkSize = FrameDescription::k_shipMarkSize;
+	::glLineWidth( 1.0f );
+	::glEnable( GL_BLEND );
+	::glColor4f( 1.0f, 1.0f, 1.0f, 1.0f );
+	for ( const POINT& marker : frame.shipMarkers ) {
+		renderTexture( *m_shipIconTexture, (float)marker.x, (float)marker.y, shipMarkSize, shipMarkSize );
+	}
+	::glDisable( GL_BLEND );
+}
+
+
+void GLRenderBackend::drawSpeedMeterImage( const std::wstring& text, Image& image )
+{
+	// THE Hand creation texture creation
+	HDC hdcMem = ::CreateCompatibleDC( NULL );
+	::SaveDC( hdcMem );
+
+	RECT rc = { 0 };
+	::DrawText( hdcMem, text.c_str(), -1, &rc, DT_SINGLELINE | DT_RIGHT | DT_TOP | DT_CALCRECT );
+	const int width = rc.right - rc.left;
+	const int stride = width + (4 - width % 4) % 4;
+	const int height = rc.bottom - rc.top;
+	image.createImage( stride, height );
+	::SelectObject( hdcMem, image.bitmapHandle() );
+	::DrawText( hdcMem, text.c_str(), -1, &rc, DT_SINGLELINE | DT_RIGHT | DT_TOP );
+	::RestoreDC( hdcMem, -1 );
+	::DeleteDC( hdcMem );
+}
+
+
+void GLRenderBackend::renderSpeedMeter( const FrameDescription& frame )
+{
+	// The text only changes when the speed does, so keep its texture until then
+	const std::wstring& text = frame.speedText;
+	if ( !m_speedMeterTexture || text != m_speedMeterText ) {
+		Image workImage;
+		drawSpeedMeterImage( text, workImage );
+
+		if ( !m_speedMeterTexture ) {
+			m_speedMeterTexture = new Texture();
+		}
+		m_speedMeterTexture->setImage( workImage );
+		m_speedMeterText = text;
+	}
+
+	const float width = (float)m_speedMeterTexture->width();
+	const float height = (float)m_speedMeterTexture->height();
+	::glMatrixMode( GL_MODELVIEW );
+	::glLoadIdentity();
+	renderTexture( *m_speedMeterTexture, frame.viewSize.cx - width, 0.0f, width, height );
+}
+
+
+void GLRenderBackend::renderTexture( Texture & texture, float x, float y, float w, float h )
+{
+	texture.bind();
+
+	::glBegin( GL_QUADS );
+
+	::glTexCoord2d( 0, 0 );
+	::glVertex2d( x, y );
+
+	::glTexCoord2d( 0, 1 );
+	::glVertex2d( x, y + h );
+
+	::glTexCoord2d( 1, 1 );
+	::glVertex2d( x + w, y + h );
+
+	::glTexCoord2d( 1, 0 );
+	::glVertex2d( x + w, y );
+
+	::glEnd();
+
+	texture.unbind();
+}
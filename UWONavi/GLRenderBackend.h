@@ -0,0 +1,113 @@
+#pragma once
+
+#include "RenderBackend.h"  // For the interface implemented here
+#include "GLExtensions.h"   // For rendering the route layer offscreen
+#include "TextureResidency.h" // For the map layers kept on the GPU
+#include <string>           // For the speed meter text
+#include <vector>           // For the mesh indices
+
+class Texture;
+
+// Draws frames with fixed-function OpenGL into a window through WGL.
+// The context is created by setup() on the render thread and stays current there until teardown().
+class GLRenderBackend : public RenderBackend {
+private:
+    HDC m_hdc;                                //!< Device context of the window drawn to
+    UINT m_frameRateLimit;                    //!< Configured frame rate cap (0 presents on every display refresh)
+    HGLRC m_hglrc;                            //!< Handle to the OpenGL rendering context
+    GLExtensions m_gl;                        //!< Entry points beyond OpenGL 1.1
+    Capabilities m_capabilities;              //!< What the context supports (queried by setup)
+    TextureResidency m_mapTextures;           //!< Textures of the map layers shown recently
+    Texture* m_worldMapTexture;               //!< Texture of the world map drawn (owned by m_mapTextures)
+    Texture* m_shipIconTexture;               //!< Ship marker, uploaded once per icon image
+    const Image* m_shipIcon;                  //!< Image currently in m_shipIconTexture
+    Texture* m_speedMeterTexture;             //!< Speed meter text, rebuilt only when the text changes
+    std::wstring m_speedMeterText;            //!< Text currently in m_speedMeterTexture
+    SIZE m_projectionSize;                    //!< View size the projection was last set up for
+    GLuint m_routeLayerFramebuffer;           //!< Framebuffer drawing into m_routeLayerTexture
+    Texture* m_routeLayerTexture;             //!< Fixed routes around the view, premultiplied alpha
+    Texture* m_snapshotTexture;               //!< Map and routes of the last full frame
+    MapLayout m_snapshotLayout;               //!< Map placement of the last full frame
+    SIZE m_snapshotSize;                      //!< View size of the last full frame (empty if there is none)
+    GLuint m_coverageTexture;                 //!< Two alpha texels (0, 1) turning mesh coverage into alpha
+    std::vector<uint16_t> m_meshIndices;      //!< Triangle indices shared by every route mesh
+
+public:
+    // mapTextureBudget: bytes of video memory the map layers may take (the map drawn stays regardless)
+    GLRenderBackend(HDC hdc, UINT frameRateLimit, size_t mapTextureBudget) :
+        m_hdc(hdc),
+        m_frameRateLimit(frameRateLimit),
+        m_hglrc(),
+        m_gl(),
+        m_capabilities(),
+        m_mapTextures(mapTextureBudget),
+        m_worldMapTexture(),
+        m_shipIconTexture(),
+        m_shipIcon(),
+        m_speedMeterTexture(),
+        m_projectionSize(),
+        m_routeLayerFramebuffer(),
+        m_routeLayerTexture(),
+        m_snapshotTexture(),
+        m_snapshotLayout(),
+        m_snapshotSize(),
+        m_coverageTexture(),
+        m_meshIndices()
+    {
+    }
+
+    // Create the OpenGL context and make it current
+    virtual void setup();
+
+    // Release the textures and the OpenGL context
+    virtual void teardown();
+
+    virtual Capabilities capabilities() const { return m_capabilities; }
+
+    // Draw a world map from now on; its texture is uploaded (as blocks when the driver takes them)
+    // unless it is still resident, and the least recently shown maps are evicted over the budget
+    virtual void setWorldMap(const Image& image, const CompressedImage* compressed);
+
+    // Upload the texture of a world map ahead of a switch, if it fits the budget next to the map drawn
+    virtual void prefetchWorldMap(const Image& image, const CompressedImage* compressed);
+
+    // Delete the map textures, the route layer and the snapshot; the context and the small textures stay
+    virtual void releaseResources();
+
+    // Draw a frame and swap buffers
+    virtual void drawFrame(const FrameDescription& frame);
+
+private:
+    // Draw line batches with the current blend function
+    void drawLineBatches(const std::vector<LineBatch>& batches);
+
+    // Draw the route meshes of a batch with the current blend function
+    void drawMeshes(const LineBatch& batch);
+
+    // Redraw the route layer offscreen
+    void drawRouteLayer(const FrameDescription& frame);
+
+    // Composite the route layer over the map
+    void renderRouteLayer(const FrameDescription& frame);
+
+    // Keep the map and routes drawn so far as the snapshot for previews
+    void captureSnapshot(const FrameDescription& frame);
+
+    // Draw the snapshot moved and scaled to the current map placement
+    void renderSnapshot(const FrameDescription& frame);
+
+    // Render every visible copy of the world map texture with a single quad
+    void renderWorldMap(const FrameDescription& frame);
+
+    // Render every visible copy of the ship marker
+    void renderShipMarkers(const FrameDescription& frame);
+
+    // Draw the speed meter text into an RGB image with GDI, right-aligned and padded to a multiple of 4 pixels
+    static void drawSpeedMeterImage(const std::wstring& text, Image& image);
+
+    // Render the speedometer text
+    void renderSpeedMeter(const FrameDescription& frame);
+
+    // Render a texture on the screen
+    void renderTexture(Texture& texture, float x, float y, float w, float h);
+};
@@ -33,6 +33,14 @@ namespace {
     static double   s_debugAutoCruiseTurnAngle = 0.0;
 #endif
 
+    // While the game window is minimized there is nothing to capture: the worker ignores the polling
+    // timer and looks at the window again once per heartbeat, or as soon as a window is restored.
+    const DWORD k_minimizedHeartbeatInterval = 2000;
+
+    // Restoring a window only has to wake the worker, which happens by delivering this call
+    void CALLBACK s_onWindowRestored(HWINEVENTHOOK, DWORD, HWND, LONG, LONG, DWORD, DWORD) {
+    }
+
 #ifdef GVO_ANALYZE_DEBUG
     LPCWSTR const k_debugImageFileName = L"..\\debug.png";
 #endif
@@ -338,21 +346,48 @@ UINT CALLBACK GameProcess::threadMainThunk(LPVOID arg) {
  * The main routine for the worker thread. It waits on either the quit signal
  * or the polling event. If the polling event triggers, we call updateState().
  * If the quit signal triggers, we break out of the loop.
+ * While the game window is minimized, the polling event is left out of the
+ * wait: the thread sleeps until a window is restored (reported by a WinEvent
+ * hook through this thread's message queue) or the heartbeat comes around.
  */
 void GameProcess::threadMain() {
     std::vector<HANDLE> signals;
     signals.push_back(m_threadQuitSignal);
     signals.push_back(m_pollingTimerEvent);
 
+    HWINEVENTHOOK restoreHook = ::SetWinEventHook(
+        EVENT_SYSTEM_MINIMIZEEND,
+        EVENT_SYSTEM_MINIMIZEEND,
+        NULL,
+        s_onWindowRestored,
+        0,
+        0,
+        WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS
+    );
+
     while (true) {
-        DWORD ret = ::WaitForMultipleObjects(
-            static_cast<DWORD>(signals.size()),
+        const bool gameMinimized = m_window && ::IsIconic(m_window);
+        const DWORD signalCount = gameMinimized ? 1 : static_cast<DWORD>(signals.size());
+        DWORD ret = ::MsgWaitForMultipleObjects(
+            signalCount,
             signals.data(),
             FALSE,
-            INFINITE
+            gameMinimized ? k_minimizedHeartbeatInterval : INFINITE,
+            QS_ALLINPUT
         );
 
-        if (ret >= signals.size()) {
+        if (ret == WAIT_TIMEOUT) {
+            continue;
+        }
+        if (ret == WAIT_OBJECT_0 + signalCount) {
+            // Delivers the hook calls; the window is looked at again on the next pass
+            MSG msg;
+            while (::PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+                ::DispatchMessage(&msg);
+            }
+            continue;
+        }
+        if (ret >= signalCount) {
             exit(-1);
         }
 
@@ -366,6 +401,10 @@ void GameProcess::threadMain() {
             continue;
         }
     }
+
+    if (restoreHook) {
+        ::UnhookWinEvent(restoreHook);
+    }
 }
 
 /**
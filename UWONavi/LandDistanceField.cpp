@@ -0,0 +1,176 @@
+#include "stdafx.h"
+#include "LandDistanceField.h"
+#include "LandMask.h"
+#include <cmath>
+
+namespace {
+    // Squared distance of cells that are not what is measured to
+    const float k_far = 1e20f;
+
+    // How much closer land may be than the center of the nearest land cell, seen from anywhere in a cell
+    const double k_cellSlack = LandDistanceField::k_cellSize * 1.4142135623730951 + 1.0;
+
+    // Squared distance to the nearest zero of f along a line of n cells (lower envelope of parabolas,
+    // after Felzenszwalb and Huttenlocher); parabolas and bounds are scratch of n and n + 1 entries
+    void s_transformLine(const float* f, int32_t n, float* d, std::vector<int32_t>& parabolas, std::vector<float>& bounds)
+    {
+        int32_t k = 0;
+        parabolas[0] = 0;
+        bounds[0] = -k_far;
+        bounds[1] = k_far;
+        for (int32_t q = 1; q < n; ++q) {
+            float s = 0;
+            for (;;) {
+                const int32_t p = parabolas[k];
+                s = ((f[q] + float(q) * q) - (f[p] + float(p) * p)) / float(2 * q - 2 * p);
+                if (s <= bounds[k]) {
+                    --k;
+                    continue;
+                }
+                break;
+            }
+            ++k;
+            parabolas[k] = q;
+            bounds[k] = s;
+            bounds[k + 1] = k_far;
+        }
+        k = 0;
+        for (int32_t q = 0; q < n; ++q) {
+            while (bounds[k + 1] < q) {
+                ++k;
+            }
+            const int32_t p = parabolas[k];
+            d[q] = float(q - p) * (q - p) + f[p];
+        }
+    }
+
+    // Squared distance in cells from every cell to the nearest cell whose land flag equals target.
+    // Columns first (rows outside the world are land), then rows, tripled so that x wraps around.
+    void s_transform(const std::vector<uint8_t>& land, uint8_t target, int32_t columns, int32_t rows, std::vector<float>& field)
+    {
+        const int32_t longest = max(columns * 3, rows);
+        std::vector<float> line(longest);
+        std::vector<float> result(longest);
+        std::vector<int32_t> parabolas(longest);
+        std::vector<float> bounds(longest + 1);
+
+        field.resize(size_t(columns) * rows);
+        for (int32_t column = 0; column < columns; ++column) {
+            for (int32_t row = 0; row < rows; ++row) {
+                line[row] = land[size_t(row) * columns + column] == target ? 0.0f : k_far;
+            }
+            s_transformLine(line.data(), rows, result.data(), parabolas, bounds);
+            for (int32_t row = 0; row < rows; ++row) {
+                float distance = result[row];
+                if (target) {
+                    const float above = float(row + 1);
+                    const float below = float(rows - row);
+                    distance = min(distance, min(above * above, below * below));
+                }
+                field[size_t(row) * columns + column] = distance;
+            }
+        }
+        for (int32_t row = 0; row < rows; ++row) {
+            float* cells = &field[size_t(row) * columns];
+            for (int32_t copy = 0; copy < 3; ++copy) {
+                std::copy(cells, cells + columns, line.begin() + copy * columns);
+            }
+            s_transformLine(line.data(), columns * 3, result.data(), parabolas, bounds);
+            std::copy(result.begin() + columns, result.begin() + columns * 2, cells);
+        }
+    }
+}
+
+
+void LandDistanceField::reset()
+{
+    m_columns = 0;
+    m_rows = 0;
+    std::vector<int16_t>().swap(m_cells);
+}
+
+
+// Coarsen the mask a row of cells at a time (OR of its rows, then one byte per cell), then measure
+// distances to land for the sea cells and distances to sea for the land cells
+bool LandDistanceField::build(const LandMask& landMask)
+{
+    if (landMask.empty() || landMask.width() % k_cellSize != 0 || landMask.height() % k_cellSize != 0) {
+        return false;
+    }
+    const int32_t columns = landMask.width() / k_cellSize;
+    const int32_t rows = landMask.height() / k_cellSize;
+    const size_t words = (size_t(landMask.width()) + LandMask::k_wordBits - 1) / LandMask::k_wordBits;
+    const uint32_t cellMask = (1u << k_cellSize) - 1;
+
+    std::vector<uint8_t> land(size_t(columns) * rows);
+    std::vector<uint64_t> merged(words);
+    for (int32_t row = 0; row < rows; ++row) {
+        std::fill(merged.begin(), merged.end(), 0);
+        for (int32_t y = row * k_cellSize; y < (row + 1) * k_cellSize; ++y) {
+            const uint64_t* bits = landMask.rowBits(y);
+            for (size_t word = 0; word < words; ++word) {
+                merged[word] |= bits[word];
+            }
+        }
+        for (int32_t column = 0; column < columns; ++column) {
+            const uint32_t x = uint32_t(column) * k_cellSize;
+            land[size_t(row) * columns + column] = (merged[x / LandMask::k_wordBits] >> (x % LandMask::k_wordBits) & cellMask) != 0;
+        }
+    }
+
+    std::vector<float> toLand;
+    std::vector<float> toSea;
+    s_transform(land, 1, columns, rows, toLand);
+    s_transform(land, 0, columns, rows, toSea);
+
+    std::vector<int16_t> cells(land.size());
+    for (size_t i = 0; i < cells.size(); ++i) {
+        const double distance = ::sqrt(double(land[i] ? toSea[i] : toLand[i])) * k_cellSize;
+        const int16_t clamped = int16_t(min(distance, double(k_maxDistance)));
+        cells[i] = land[i] ? -clamped : clamped;
+    }
+
+    m_columns = columns;
+    m_rows = rows;
+    m_cells.swap(cells);
+    return true;
+}
+
+
+// Sphere tracing: from a sea cell, no land is nearer than its distance less k_cellSlack, so the course
+// can skip that far; where that is less than a coordinate, the mask is checked a cell's length exactly
+bool LandDistanceField::findLandfall(const LandMask& landMask, double x, double y, double directionX, double directionY,
+    double maxDistance, double& distance) const
+{
+    const double length = ::sqrt(directionX * directionX + directionY * directionY);
+    if (m_cells.empty() || length <= 0.0) {
+        return false;
+    }
+    const double unitX = directionX / length;
+    const double unitY = directionY / length;
+    auto coordX = [&](double along) { return int32_t(::floor(x + unitX * along + 0.5)); };
+    auto coordY = [&](double along) { return int32_t(::floor(y + unitY * along + 0.5)); };
+
+    // Leave the land under the start behind (a ship in port), a coordinate at a time
+    double along = 0.0;
+    for (; landMask.isLand(coordX(along), coordY(along)); along += 1.0) {
+        if (maxDistance <= along) {
+            return false;
+        }
+    }
+
+    while (along < maxDistance) {
+        const double safe = distanceAt(coordX(along), coordY(along)) - k_cellSlack;
+        if (1.0 <= safe) {
+            along += safe;
+            continue;
+        }
+        for (int32_t i = 0; i < k_cellSize && along < maxDistance; ++i, along += 1.0) {
+            if (landMask.isLand(coordX(along), coordY(along))) {
+                distance = along;
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>        // For fixed-width integer types
+#include <vector>         // For the distances
+
+#include "Noncopyable.h"  // To prevent copying of the distances
+
+class LandMask;
+
+//! @brief How far every part of the world is from land, to trace straight courses in few steps.
+//! The land mask is coarsened into cells of k_cellSize x k_cellSize world coordinates (a cell is land
+//! if any coordinate in it is), and every cell keeps the distance in world coordinates from its center
+//! to the center of the nearest cell of the other kind: positive at sea, negative on land. Distances are
+//! exact Euclidean ones (one pass down the columns, then one along the rows, wrapping around the world),
+//! clamped to k_maxDistance; 4 MB cover the whole world and a lookup is a single index.
+class LandDistanceField : private Noncopyable {
+public:
+    enum : int32_t {
+        k_cellSize = 8,         //!< World coordinates along each side of a cell
+        k_maxDistance = 32767,  //!< Farthest distance kept; farther cells keep this
+    };
+
+private:
+    int32_t m_columns;              //!< Cells around the world
+    int32_t m_rows;                 //!< Cells from top to bottom
+    std::vector<int16_t> m_cells;   //!< Signed distance of every cell, row by row
+
+public:
+    LandDistanceField() :
+        m_columns(),
+        m_rows(),
+        m_cells()
+    {
+    }
+
+    //! @brief Check whether there are no distances.
+    bool empty() const { return m_cells.empty(); }
+
+    //! @brief Forget the distances.
+    void reset();
+
+    //! @brief Measure the distances of a land mask.
+    //! @return false if the mask is empty or not a whole number of cells
+    bool build(const LandMask& landMask);
+
+    //! @brief Get the signed distance of the cell holding a world coordinate (x wraps around).
+    //! Rows above and below the world are land.
+    int32_t distanceAt(int32_t x, int32_t y) const
+    {
+        if (y < 0 || m_rows <= y / k_cellSize || m_cells.empty()) {
+            return -k_cellSize;
+        }
+        const int32_t width = m_columns * k_cellSize;
+        x %= width;
+        if (x < 0) {
+            x += width;
+        }
+        return m_cells[size_t(y / k_cellSize) * m_columns + x / k_cellSize];
+    }
+
+    //! @brief Follow a straight course from a point until it reaches land.
+    //! Steps as far as the distance of the cell allows, then checks coordinates one by one near the
+    //! coast. Land under the start (a ship in port) is left behind before the trace begins.
+    //! Every step moves on by a coordinate at least, so a course skimming a coast costs at most one
+    //! mask lookup per coordinate of maxDistance; the open sea takes a few dozen steps.
+    //! @param landMask The mask the distances were measured from
+    //! @param x, y Start in world coordinates
+    //! @param directionX, directionY Direction of the course (any length but zero)
+    //! @param maxDistance Farthest to follow the course
+    //! @param distance Receives how far along the course land is reached
+    //! @return false if no land is reached within maxDistance
+    bool findLandfall(const LandMask& landMask, double x, double y, double directionX, double directionY,
+        double maxDistance, double& distance) const;
+};
@@ -0,0 +1,257 @@
+#include "stdafx.h"
+#include "LandMask.h"
+#include "Image.h"
+#include "CacheFile.h"
+#include "WorkerThreads.h"
+
+namespace {
+    // Header of a cache file stamped with CompressedImage::fileStamp of the source image,
+    // followed by the words of every row
+    struct FileHeader {
+        enum : uint32_t {
+            k_Magic = 0x4D4C5755,   // "UWLM"
+            k_Version = 2,
+        };
+        int32_t width = 0;
+        int32_t height = 0;
+    };
+
+    // Most bands of rows classified at the same time
+    const DWORD k_maxWorkerCount = 16;
+
+    // Rows of the mask one worker classifies
+    struct Band {
+        const Image* image;                         //!< Map image
+        const std::vector<uint32_t>* columnOffsets; //!< Byte offset in an image row of every world column
+        int32_t width;                              //!< Width of the world
+        int32_t height;                             //!< Height of the world
+        size_t wordsPerRow;                         //!< Words of one mask row
+        uint64_t* bits;                             //!< Mask rows (this band writes only its own)
+        int32_t rowBegin;                           //!< First row of the band
+        int32_t rowEnd;                             //!< Row past the band
+    };
+
+    // Classify the rows of a band; world rows falling on the same image row are copied
+    UINT CALLBACK s_classifyBandThunk(LPVOID arg)
+    {
+        const Band& band = *reinterpret_cast<const Band*>(arg);
+        const Image& image = *band.image;
+        const std::vector<uint32_t>& columnOffsets = *band.columnOffsets;
+
+        int32_t previousImageRow = -1;
+        for (int32_t y = band.rowBegin; y < band.rowEnd; ++y) {
+            uint64_t* row = band.bits + size_t(y) * band.wordsPerRow;
+            const int32_t imageRow = int32_t(int64_t(y) * image.height() / band.height);
+            if (imageRow == previousImageRow) {
+                ::memcpy(row, row - band.wordsPerRow, band.wordsPerRow * sizeof(uint64_t));
+                continue;
+            }
+            previousImageRow = imageRow;
+
+            // The image is BGR(A); coordinates past the width are land, so runs never cross the row end
+            const uint8_t* pixels = image.imageBits() + size_t(imageRow) * image.stride();
+            for (size_t i = 0; i < band.wordsPerRow; ++i) {
+                uint64_t word = 0;
+                for (uint32_t bit = 0; bit < LandMask::k_wordBits; ++bit) {
+                    const size_t x = i * LandMask::k_wordBits + bit;
+                    if (int32_t(x) < band.width) {
+                        const uint8_t* pixel = pixels + columnOffsets[x];
+                        if (LandMask::isSeaColor(pixel[2], pixel[1], pixel[0])) {
+                            continue;
+                        }
+                    }
+                    word |= uint64_t(1) << bit;
+                }
+                row[i] = word;
+            }
+        }
+        return 0;
+    }
+}
+
+
+// Forget the bits
+void LandMask::reset()
+{
+    m_width = 0;
+    m_height = 0;
+    m_wordsPerRow = 0;
+    m_bits.clear();
+    m_bits.shrink_to_fit();
+}
+
+
+// Classify every world coordinate by the map pixel it falls on
+bool LandMask::build(const Image& image, int32_t width, int32_t height)
+{
+    reset();
+    if (image.width() <= 0 || image.height() <= 0 || width <= 0 || height <= 0) {
+        return false;
+    }
+    const uint32_t bytesPerPixel = image.pixelFormat() == k_PixelFormat_RGBA ? 4 : 3;
+    if (image.pixelFormat() != k_PixelFormat_RGBA && image.pixelFormat() != k_PixelFormat_RGB) {
+        return false;
+    }
+
+    const size_t wordsPerRow = (size_t(width) + k_wordBits - 1) / k_wordBits;
+    std::vector<uint64_t> bits(wordsPerRow * height);
+    std::vector<uint32_t> columnOffsets(width);
+    for (int32_t x = 0; x < width; ++x) {
+        columnOffsets[x] = uint32_t(int64_t(x) * image.width() / width) * bytesPerPixel;
+    }
+
+    const DWORD workerCount = g_workerCount(k_maxWorkerCount);
+    const int32_t bandHeight = (height + int32_t(workerCount) - 1) / int32_t(workerCount);
+
+    std::vector<Band> bands;
+    for (int32_t top = 0; top < height; top += bandHeight) {
+        Band band;
+        band.image = &image;
+        band.columnOffsets = &columnOffsets;
+        band.width = width;
+        band.height = height;
+        band.wordsPerRow = wordsPerRow;
+        band.bits = &bits[0];
+        band.rowBegin = top;
+        band.rowEnd = min(height, top + bandHeight);
+        bands.push_back(band);
+    }
+
+    std::vector<LPVOID> args;
+    for (Band& band : bands) {
+        args.push_back(&band);
+    }
+    g_runWorkers(s_classifyBandThunk, args);
+
+    m_width = width;
+    m_height = height;
+    m_wordsPerRow = wordsPerRow;
+    m_bits.swap(bits);
+    return true;
+}
+
+
+// Count the sea coordinates of a row from x rightwards
+int32_t LandMask::seaRunLength(int32_t x, int32_t y, int32_t maxLength) const
+{
+    if (maxLength <= 0 || isLand(x, y)) {
+        return 0;
+    }
+
+    x %= m_width;
+    if (x < 0) {
+        x += m_width;
+    }
+    const uint64_t* row = &m_bits[size_t(y) * m_wordsPerRow];
+    int32_t length = 0;
+    while (length < maxLength) {
+        // Land bits of the rest of this word; the padding past the width is land, so the row end stops the scan too
+        const uint32_t bit = uint32_t(x) % k_wordBits;
+        const uint64_t land = row[uint32_t(x) / k_wordBits] >> bit;
+        if (land) {
+            const int32_t run = int32_t(countTrailingZeros(land));
+            if (x + run < m_width) {
+                return min(maxLength, length + run);
+            }
+        }
+        const int32_t step = min(int32_t(k_wordBits - bit), m_width - x);
+        length += step;
+        x += step;
+        if (x == m_width) {
+            // A row of sea all the way round is sea however far the span goes
+            if (m_width <= length) {
+                return maxLength;
+            }
+            x = 0;
+        }
+    }
+    return maxLength;
+}
+
+
+// Walk the segment a coordinate at a time along its longer axis
+bool LandMask::isSeaSegment(int32_t x0, int32_t y0, int32_t x1, int32_t y1) const
+{
+    int32_t dx = x1 - x0;
+    if (m_width / 2 < dx) {
+        dx -= m_width;
+    }
+    else if (dx < -m_width / 2) {
+        dx += m_width;
+    }
+    const int32_t dy = y1 - y0;
+
+    const int32_t stepCount = max(abs(dx), abs(dy));
+    for (int32_t i = 0; i <= stepCount; ++i) {
+        const double t = stepCount ? double(i) / stepCount : 0.0;
+        if (isLand(x0 + int32_t(::floor(dx * t + 0.5)), y0 + int32_t(::floor(dy * t + 0.5)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// FNV-1a taking a whole word at a time, over the size and every word of the bits
+uint64_t LandMask::hash() const
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    auto mix = [&hash](uint64_t value) {
+        hash = (hash ^ value) * 0x100000001B3ULL;
+    };
+    mix(uint64_t(m_width));
+    mix(uint64_t(m_height));
+    for (uint64_t word : m_bits) {
+        mix(word);
+    }
+    return hash;
+}
+
+
+// Load the bits from a cache file
+bool LandMask::loadFromFile(const std::wstring& fileName, uint64_t sourceStamp, int32_t width, int32_t height)
+{
+    reset();
+
+    CacheFileReader file;
+    FileHeader header;
+    if (!file.open(fileName, FileHeader::k_Magic, FileHeader::k_Version, sourceStamp)
+        || !file.readValue(header)
+        || header.width != width || header.height != height
+        || width <= 0 || height <= 0) {
+        return false;
+    }
+
+    const size_t wordsPerRow = (size_t(width) + k_wordBits - 1) / k_wordBits;
+    std::vector<uint64_t> bits(wordsPerRow * height);
+    if (!file.readArray(bits)) {
+        return false;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_wordsPerRow = wordsPerRow;
+    m_bits.swap(bits);
+    return true;
+}
+
+
+// Write the bits to a cache file
+bool LandMask::saveToFile(const std::wstring& fileName, uint64_t sourceStamp) const
+{
+    if (empty()) {
+        return false;
+    }
+
+    CacheFileWriter file;
+    if (!file.open(fileName, FileHeader::k_Magic, FileHeader::k_Version, sourceStamp)) {
+        return false;
+    }
+
+    FileHeader header;
+    header.width = m_width;
+    header.height = m_height;
+    file.writeValue(header);
+    file.writeArray(m_bits);
+    return file.close();
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>        // For fixed-width integer types
+#include <intrin.h>       // For the bit scan
+#include <string>         // For file names
+#include <vector>         // For the bits
+
+#include "Noncopyable.h"  // To prevent copying of the bits
+
+class Image;
+
+//! @brief Where the world is land and where it is sea, one bit per world coordinate.
+//! Built from the colors of the map image, scaled to the world (k_worldWidth x k_worldHeight by default);
+//! x wraps around like the game world, rows above and below the world count as land. Rows are packed in
+//! 64-bit words, so a point is one lookup and a span of a row is checked a word at a time. Classifying a
+//! large map takes a moment on every core, so the bits are kept in a cache file next to the map image.
+class LandMask : private Noncopyable {
+public:
+    enum : uint32_t {
+        k_wordBits = 64,    //!< Coordinates per word
+    };
+
+private:
+    int32_t m_width;                //!< Width of the world in coordinates
+    int32_t m_height;               //!< Height of the world in coordinates
+    size_t m_wordsPerRow;           //!< Words of one row (coordinates past the width are land)
+    std::vector<uint64_t> m_bits;   //!< Rows top-down; bit x % 64 of word x / 64 is set where x is land
+
+public:
+    LandMask() :
+        m_width(),
+        m_height(),
+        m_wordsPerRow(),
+        m_bits()
+    {
+    }
+
+    //! @brief Check whether nothing is classified.
+    bool empty() const { return m_bits.empty(); }
+
+    //! @brief Get the width of the world in coordinates.
+    int32_t width() const { return m_width; }
+
+    //! @brief Get the height of the world in coordinates.
+    int32_t height() const { return m_height; }
+
+    //! @brief Forget the bits.
+    void reset();
+
+    //! @brief Classify every coordinate of a world of the given size by the map pixel it falls on.
+    //! Rows are split between worker threads, one per processor.
+    //! @return false if the image has no pixels or an unknown format
+    bool build(const Image& image, int32_t width, int32_t height);
+
+    //! @brief Check whether a world coordinate is land. x wraps around; y outside the world is land.
+    bool isLand(int32_t x, int32_t y) const
+    {
+        if (y < 0 || m_height <= y || m_bits.empty()) {
+            return true;
+        }
+        x %= m_width;
+        if (x < 0) {
+            x += m_width;
+        }
+        return (m_bits[size_t(y) * m_wordsPerRow + uint32_t(x) / k_wordBits] >> (uint32_t(x) % k_wordBits) & 1) != 0;
+    }
+
+    //! @brief Check whether a world coordinate is sea.
+    bool isSea(int32_t x, int32_t y) const { return !isLand(x, y); }
+
+    //! @brief Get the words of row y (0 <= y < height), to scan a row a word at a time.
+    const uint64_t* rowBits(int32_t y) const { return &m_bits[size_t(y) * m_wordsPerRow]; }
+
+    //! @brief Count the sea coordinates of row y from x rightwards (wrapping around), up to maxLength.
+    //! @return 0 if x is land, maxLength if the whole span is sea
+    int32_t seaRunLength(int32_t x, int32_t y, int32_t maxLength) const;
+
+    //! @brief Check whether length coordinates of row y from x rightwards (wrapping around) are all sea.
+    bool isSeaSpan(int32_t x, int32_t y, int32_t length) const
+    {
+        return seaRunLength(x, y, length) == length;
+    }
+
+    //! @brief Check whether every coordinate of the straight segment between two points is sea.
+    //! The segment goes the short way around the world, like Vector(POINT, POINT).
+    bool isSeaSegment(int32_t x0, int32_t y0, int32_t x1, int32_t y1) const;
+
+    //! @brief Hash the size and the bits, so that data derived from them can tell a changed map.
+    uint64_t hash() const;
+
+    //! @brief Load the bits from a cache file.
+    //! @param fileName Cache file
+    //! @param sourceStamp Stamp of the source image; a file written for another stamp is ignored
+    //! @param width Width of the world the bits must have been built for
+    //! @param height Height of the world the bits must have been built for
+    //! @return false if the file is missing, stale or broken
+    bool loadFromFile(const std::wstring& fileName, uint64_t sourceStamp, int32_t width, int32_t height);
+
+    //! @brief Write the bits to a cache file.
+    //! @return false if the file cannot be written
+    bool saveToFile(const std::wstring& fileName, uint64_t sourceStamp) const;
+
+    //! @brief Classify a map pixel: sea where blue clearly dominates.
+    static bool isSeaColor(uint8_t r, uint8_t g, uint8_t b)
+    {
+        return 64 <= b && r + 32 <= b && g <= b + 16;
+    }
+
+    //! @brief Get the index of the lowest set bit of a word that is not zero, to find where a run of
+    //! row bits ends. Scans 32 bits at a time, which the x86 build also has.
+    static uint32_t countTrailingZeros(uint64_t word)
+    {
+        unsigned long index = 0;
+        if (_BitScanForward(&index, uint32_t(word))) {
+            return index;
+        }
+        _BitScanForward(&index, uint32_t(word >> 32));
+        return index + 32;
+    }
+};
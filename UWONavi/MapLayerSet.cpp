@@ -0,0 +1,142 @@
+#include "stdafx.h"
+#include <process.h>
+#include <algorithm>
+#include "UWONavi.h"
+#include "MapLayerSet.h"
+
+/**
+ * Registers the layers in configuration order.
+ * - The map shown at startup keeps its place when it is one of the layers
+ *   (file names compare case-insensitively), and is put first otherwise.
+ * - Nothing is decoded here; activate() the startup layer afterwards.
+ */
+void MapLayerSet::setup(const std::wstring& activeFileName, const std::vector<std::wstring>& fileNames, bool compressed) {
+    clear();
+
+    std::vector<std::wstring> names(fileNames);
+    auto found = std::find_if(names.begin(), names.end(), [&activeFileName](const std::wstring& name) {
+        return ::lstrcmpiW(name.c_str(), activeFileName.c_str()) == 0;
+    });
+    if (found == names.end()) {
+        found = names.insert(names.begin(), activeFileName);
+    }
+    m_activeIndex = found - names.begin();
+
+    for (size_t i = 0; i < names.size(); ++i) {
+        std::unique_ptr<Layer> layer(new Layer());
+        layer->fileName = names[i];
+        layer->loader = NULL;
+        layer->wantPreview = false;
+        layer->loaded = false;
+        layer->failed = false;
+        layer->compressed = compressed;
+        layer->notifyWindow = NULL;
+        layer->notifyMessage = 0;
+        layer->index = i;
+        m_layers.push_back(std::move(layer));
+    }
+}
+
+/**
+ * Joins the loaders still running (they cannot be interrupted while
+ * decoding) and releases every map.
+ */
+void MapLayerSet::clear() {
+    for (const std::unique_ptr<Layer>& layer : m_layers) {
+        if (layer->loader) {
+            ::WaitForSingleObject(layer->loader, INFINITE);
+            ::CloseHandle(layer->loader);
+            layer->loader = NULL;
+        }
+    }
+    m_layers.clear();
+    m_activeIndex = 0;
+}
+
+/**
+ * Returns the decoded map of a layer.
+ * - A loader started by prefetch() is joined first; its results are only
+ *   read after that, so the layer needs no lock.
+ * - A layer nobody prefetched is decoded on the calling thread.
+ */
+const WorldMap* MapLayerSet::load(size_t index) {
+    Layer& layer = *m_layers[index];
+    if (layer.loader) {
+        ::WaitForSingleObject(layer.loader, INFINITE);
+        ::CloseHandle(layer.loader);
+        layer.loader = NULL;
+    }
+    if (!layer.loaded && !layer.failed) {
+        decode(layer);
+    }
+    return layer.loaded ? &layer.map : NULL;
+}
+
+const WorldMap* MapLayerSet::activate(size_t index) {
+    const WorldMap* map = load(index);
+    if (map) {
+        m_activeIndex = index;
+    }
+    return map;
+}
+
+/**
+ * Decodes a layer in the background.
+ * - A layer already decoded is reported right away; one being decoded
+ *   reports itself when done; one that failed is not tried again.
+ * - A preview is only worth decoding when the map is not there yet.
+ */
+void MapLayerSet::prefetch(size_t index, HWND window, UINT message, bool preview) {
+    Layer& layer = *m_layers[index];
+    if (layer.loader || layer.failed) {
+        return;
+    }
+    if (layer.loaded) {
+        ::PostMessage(window, message, index, k_Stage_Loaded);
+        return;
+    }
+
+    layer.wantPreview = preview;
+    layer.notifyWindow = window;
+    layer.notifyMessage = message;
+    layer.loader = reinterpret_cast<HANDLE>(::_beginthreadex(
+        NULL,
+        0,
+        loaderThunk,
+        &layer,
+        0,
+        NULL
+    ));
+}
+
+/**
+ * Decodes the image of a layer, its land/sea mask and coastline, and its
+ * block-compressed texture when enabled (each read from a cache next to the
+ * image, built on a miss), then measures its distances from land.
+ */
+void MapLayerSet::decode(Layer& layer) {
+    layer.loaded = layer.map.loadFromFile(layer.fileName);
+    layer.failed = !layer.loaded;
+    if (layer.loaded) {
+        layer.map.prepareLandMask();
+        layer.map.prepareCoastline();
+        layer.map.prepareLandDistanceField();
+    }
+    if (layer.loaded && layer.compressed) {
+        layer.map.prepareCompressedImage();
+    }
+}
+
+/**
+ * Loader thread. The preview is complete before it is reported and never
+ * touched again, so the window may draw it while the map is decoded.
+ */
+UINT CALLBACK MapLayerSet::loaderThunk(LPVOID arg) {
+    Layer* layer = reinterpret_cast<Layer*>(arg);
+    if (layer->wantPreview && layer->preview.loadPreview(layer->fileName, k_previewWidth)) {
+        ::PostMessage(layer->notifyWindow, layer->notifyMessage, layer->index, k_Stage_Preview);
+    }
+    decode(*layer);
+    ::PostMessage(layer->notifyWindow, layer->notifyMessage, layer->index, k_Stage_Loaded);
+    return 0;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <Windows.h>      // For the loader threads and the completion message
+#include <memory>         // For owning the layers
+#include <string>         // For file names
+#include <vector>         // For the layers
+
+#include "Noncopyable.h"  // To prevent copying of the maps
+#include "WorldMap.h"     // For the map of each layer
+
+//! @brief The map images the user switches between (political, terrain, trade map, ...).
+//! Every layer stays decoded once loaded, so switching only has to hand its map to the renderer,
+//! whose texture residency keeps the recently shown ones on the GPU. Layers can be decoded ahead
+//! of a switch on a background thread, showing a low-resolution preview first when the texture
+//! cache allows; otherwise they are decoded when first activated. Used from the UI thread.
+class MapLayerSet : private Noncopyable {
+public:
+    //! @brief What a loader reports in the LPARAM of its messages
+    enum Stage {
+        k_Stage_Preview,    //!< The preview is decoded (the map is still loading)
+        k_Stage_Loaded,     //!< The loader is done; load() returns the map, or NULL if it failed
+    };
+
+    enum {
+        k_previewWidth = 1024,  //!< Widest texture cache level decoded for a preview
+    };
+
+private:
+    //! @brief A layer and the state of its map
+    struct Layer {
+        std::wstring fileName;  //!< Map image as configured
+        WorldMap map;           //!< Decoded map (valid once loaded)
+        WorldMap preview;       //!< Low-resolution map (valid once the loader reported it)
+        bool wantPreview;       //!< Whether the loader decodes the preview first
+        HANDLE loader;          //!< Thread decoding the map in the background (NULL if none is running or unjoined)
+        bool loaded;            //!< Whether the map has been decoded
+        bool failed;            //!< Whether decoding failed; the layer is not tried again
+        bool compressed;        //!< Whether to prepare the block-compressed texture too
+        HWND notifyWindow;      //!< Window told when the loader is done
+        UINT notifyMessage;     //!< Message posted to it with the layer index in WPARAM
+        size_t index;           //!< Position in the set
+    };
+
+    std::vector<std::unique_ptr<Layer>> m_layers;
+    size_t m_activeIndex;       //!< Layer drawn now
+
+public:
+    MapLayerSet() :
+        m_layers(),
+        m_activeIndex()
+    {
+    }
+
+    ~MapLayerSet() { clear(); }
+
+    //! @brief Register the layers. The active map comes first unless it is one of them.
+    //! @param activeFileName Map image shown at startup
+    //! @param fileNames Further map images to switch to
+    //! @param compressed Whether to prepare block-compressed textures of the maps
+    void setup(const std::wstring& activeFileName, const std::vector<std::wstring>& fileNames, bool compressed);
+
+    //! @brief Wait for the loaders and forget every layer.
+    void clear();
+
+    //! @brief Get the number of layers.
+    size_t count() const { return m_layers.size(); }
+
+    //! @brief Get the configured file name of a layer.
+    const std::wstring& fileName(size_t index) const { return m_layers[index]->fileName; }
+
+    //! @brief Get the index of the layer drawn now.
+    size_t activeIndex() const { return m_activeIndex; }
+
+    //! @brief Get the map of the layer drawn now (loaded by activate).
+    const WorldMap& active() const { return m_layers[m_activeIndex]->map; }
+
+    //! @brief Get the map of a layer, decoding it now unless it is (or waiting for the loader).
+    //! @return NULL if the map cannot be loaded
+    const WorldMap* load(size_t index);
+
+    //! @brief Load a layer and make it the active one.
+    //! @return NULL if the map cannot be loaded; the active layer is left as it is
+    const WorldMap* activate(size_t index);
+
+    //! @brief Get the preview of a layer, once a loader has posted k_Stage_Preview for it.
+    const WorldMap& preview(size_t index) const { return m_layers[index]->preview; }
+
+    //! @brief Start decoding a layer on a background thread.
+    //! Once it is decoded, message is posted to window with the layer index in WPARAM and
+    //! k_Stage_Loaded in LPARAM (right away if it already is); the window then gets the map with
+    //! load() and can prefetch its texture. With preview, the loader first decodes a preview from
+    //! the texture cache, if there is one, and posts k_Stage_Preview.
+    void prefetch(size_t index, HWND window, UINT message, bool preview = false);
+
+private:
+    //! @brief Decode the map of a layer (on whichever thread)
+    static void decode(Layer& layer);
+
+    //! @brief Loader thread entry point
+    static UINT CALLBACK loaderThunk(LPVOID arg);
+};
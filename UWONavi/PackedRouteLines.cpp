@@ -0,0 +1,75 @@
+#include "stdafx.h"
+#include "PackedRouteLines.h"
+
+namespace {
+    // Quantize a normalized coordinate to world coordinates
+    inline int32_t s_quantize(float value, int32_t worldSize)
+    {
+        return int32_t(::floor(double(value) * worldSize + 0.5));
+    }
+}
+
+
+void PackedRouteLines::reset()
+{
+    std::vector<uint8_t>().swap(m_bytes);
+    std::vector<LineEntry>().swap(m_lines);
+    m_pointCount = 0;
+}
+
+
+// Most points take a byte per coordinate; the buffer is trimmed to its size at the end
+void PackedRouteLines::pack(const Lines& lines)
+{
+    reset();
+    size_t lineCount = 0;
+    size_t pointCount = 0;
+    for (const Line& line : lines) {
+        lineCount += line.empty() ? 0 : 1;
+        pointCount += line.size();
+    }
+    m_lines.reserve(lineCount);
+    m_bytes.reserve(pointCount * 2 + lineCount * 4);
+
+    for (const Line& line : lines) {
+        if (line.empty()) {
+            continue;
+        }
+        const LineEntry entry = { uint32_t(m_bytes.size()), uint32_t(line.size()) };
+        m_lines.push_back(entry);
+
+        int32_t x = 0;
+        int32_t y = 0;
+        for (const NormalizedPoint& point : line) {
+            const int32_t nextX = s_quantize(point.x(), k_worldWidth);
+            const int32_t nextY = s_quantize(point.y(), k_worldHeight);
+            writeSigned(nextX - x);
+            writeSigned(nextY - y);
+            x = nextX;
+            y = nextY;
+        }
+        m_pointCount += line.size();
+    }
+    std::vector<uint8_t>(m_bytes).swap(m_bytes);
+}
+
+
+void PackedRouteLines::unpack(Lines& lines) const
+{
+    lines.clear();
+    for (size_t i = 0; i < m_lines.size(); ++i) {
+        const LineView view = line(i);
+        lines.push_back(Line(view.begin(), view.end()));
+    }
+}
+
+
+void PackedRouteLines::writeSigned(int32_t value)
+{
+    uint32_t zigzag = (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+    while (0x80 <= zigzag) {
+        m_bytes.push_back(uint8_t(zigzag | 0x80));
+        zigzag >>= 7;
+    }
+    m_bytes.push_back(uint8_t(zigzag));
+}
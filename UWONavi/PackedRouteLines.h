@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstddef>           // For ptrdiff_t
+#include <cstdint>           // For fixed-width integer types
+#include <deque>             // For the lines packed and unpacked
+#include <iterator>          // For the iterator category
+#include <vector>            // For the bytes
+#include "NormalizedPoint.h" // For route points
+#include "UWONavi.h"         // For the size of the world
+
+//! @brief The lines of a fixed route, frozen into one flat buffer.
+//! Points are quantized to world coordinates (which polled points are to begin with, so nothing is
+//! lost) and stored as the difference from the previous point of their line, zigzag-encoded in
+//! groups of 7 bits. A ship moves a few coordinates per poll, so a point takes 2 bytes instead of 8.
+//! Points are decoded on demand by iterating over a line; empty lines are not kept.
+class PackedRouteLines {
+public:
+    typedef std::vector<NormalizedPoint> Line;   // Same layout as ShipRoute::Line
+    typedef std::deque<Line> Lines;              // Same layout as ShipRoute::Lines
+
+    //! @brief Decodes the points of a line one by one.
+    class PointIterator {
+    public:
+        typedef std::input_iterator_tag iterator_category;   // Points are decoded on the fly, so * returns a value
+        typedef NormalizedPoint value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const NormalizedPoint* pointer;
+        typedef NormalizedPoint reference;
+
+    private:
+        const uint8_t* m_next;  //!< Bytes of the point after the current one
+        size_t m_remaining;     //!< Points left, the current one included
+        int32_t m_x;            //!< Current point in world coordinates
+        int32_t m_y;
+
+    public:
+        //! @brief The end of any line.
+        PointIterator() :
+            m_next(),
+            m_remaining(),
+            m_x(),
+            m_y()
+        {
+        }
+
+        //! @brief The first of count points encoded from bytes.
+        PointIterator(const uint8_t* bytes, size_t count) :
+            m_next(bytes),
+            m_remaining(count),
+            m_x(),
+            m_y()
+        {
+            if (m_remaining != 0) {
+                decode();
+            }
+        }
+
+        NormalizedPoint operator*() const
+        {
+            return NormalizedPoint(float(m_x) / k_worldWidth, float(m_y) / k_worldHeight);
+        }
+
+        PointIterator& operator++()
+        {
+            if (--m_remaining != 0) {
+                decode();
+            }
+            return *this;
+        }
+
+        PointIterator operator++(int)
+        {
+            PointIterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        //! @brief Compare positions within the same line.
+        bool operator==(const PointIterator& rhs) const { return m_remaining == rhs.m_remaining; }
+        bool operator!=(const PointIterator& rhs) const { return m_remaining != rhs.m_remaining; }
+
+    private:
+        // Add the next difference to the current point
+        void decode()
+        {
+            m_x += readSigned(m_next);
+            m_y += readSigned(m_next);
+        }
+    };
+
+    //! @brief The points of one line, for range-based for loops.
+    class LineView {
+    private:
+        const uint8_t* m_bytes;
+        size_t m_count;
+
+    public:
+        LineView(const uint8_t* bytes, size_t count) :
+            m_bytes(bytes),
+            m_count(count)
+        {
+        }
+
+        PointIterator begin() const { return PointIterator(m_bytes, m_count); }
+        PointIterator end() const { return PointIterator(); }
+        size_t size() const { return m_count; }
+    };
+
+private:
+    //! @brief Where a line lies in the buffer.
+    struct LineEntry {
+        uint32_t byteOffset;    //!< First byte of the line
+        uint32_t pointCount;    //!< Points of the line (at least one)
+    };
+
+    std::vector<uint8_t> m_bytes;       //!< Points of every line, one line after another
+    std::vector<LineEntry> m_lines;     //!< Every line
+    size_t m_pointCount;                //!< Points of all lines
+
+public:
+    PackedRouteLines() :
+        m_bytes(),
+        m_lines(),
+        m_pointCount()
+    {
+    }
+
+    //! @brief Check whether there are no points.
+    bool empty() const { return m_pointCount == 0; }
+
+    //! @brief Forget the points and release their memory.
+    void reset();
+
+    //! @brief Replace the points with those of some lines.
+    void pack(const Lines& lines);
+
+    //! @brief Decode every line.
+    void unpack(Lines& lines) const;
+
+    //! @brief Get the number of lines.
+    size_t lineCount() const { return m_lines.size(); }
+
+    //! @brief Get the number of points of all lines.
+    size_t pointCount() const { return m_pointCount; }
+
+    //! @brief Get the points of a line.
+    LineView line(size_t index) const
+    {
+        return LineView(&m_bytes[m_lines[index].byteOffset], m_lines[index].pointCount);
+    }
+
+    //! @brief Get the bytes allocated for the points.
+    size_t memoryUsage() const
+    {
+        return m_bytes.capacity() + m_lines.capacity() * sizeof(LineEntry);
+    }
+
+private:
+    // Read a zigzag-encoded value of 7-bit groups, lowest first, moving past it
+    static int32_t readSigned(const uint8_t*& bytes)
+    {
+        uint32_t value = 0;
+        for (uint32_t shift = 0; ; shift += 7) {
+            const uint8_t byte = *bytes++;
+            value |= uint32_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        return int32_t(value >> 1) ^ -int32_t(value & 1);
+    }
+
+    // Append a value as readSigned reads it
+    void writeSigned(int32_t value);
+};
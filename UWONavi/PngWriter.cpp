@@ -0,0 +1,185 @@
+#include "stdafx.h"
+#include "PngWriter.h"
+
+namespace {
+    // Largest payload of a stored deflate block
+    const size_t k_maxBlockSize = 65535;
+
+    // Adler-32 modulus, and the number of bytes that can be summed before reducing without overflow
+    const uint32_t k_adlerBase = 65521;
+    const size_t k_adlerRun = 5552;
+
+    // CRC-32 (as used by PNG chunks) over a range, continuing from crc
+    uint32_t s_crc32(uint32_t crc, const uint8_t* data, size_t size)
+    {
+        static uint32_t table[256];
+        static bool initialized = false;
+        if (!initialized) {
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                table[n] = c;
+            }
+            initialized = true;
+        }
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i) {
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    // Append a 32-bit value in network byte order
+    inline void s_putBigEndian(std::vector<uint8_t>& buffer, uint32_t value)
+    {
+        buffer.push_back(uint8_t(value >> 24));
+        buffer.push_back(uint8_t(value >> 16));
+        buffer.push_back(uint8_t(value >> 8));
+        buffer.push_back(uint8_t(value));
+    }
+}
+
+
+// Create the file and write the image header
+bool PngWriter::open(const std::wstring& fileName, uint32_t width, uint32_t height)
+{
+    m_stream.open(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!m_stream) {
+        return false;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_rowCount = 0;
+    m_adlerA = 1;
+    m_adlerB = 0;
+    m_headerWritten = false;
+    m_block.clear();
+    m_block.reserve(k_maxBlockSize);
+
+    static const uint8_t k_signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    m_stream.write(reinterpret_cast<const char*>(k_signature), sizeof(k_signature));
+
+    // 8 bits per channel, truecolor, deflate, adaptive filtering, no interlace
+    std::vector<uint8_t> header;
+    s_putBigEndian(header, width);
+    s_putBigEndian(header, height);
+    header.push_back(8);
+    header.push_back(2);
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+    writeChunk("IHDR", &header[0], header.size());
+
+    return bool(m_stream);
+}
+
+
+// Append the next row
+bool PngWriter::writeRow(const uint8_t* rgb)
+{
+    _ASSERT(m_rowCount < m_height);
+
+    // Every row starts with its filter type; rows are stored unfiltered
+    const uint8_t filter = 0;
+    const uint8_t* parts[] = { &filter, rgb };
+    const size_t sizes[] = { 1, size_t(m_width) * 3 };
+    for (int part = 0; part < 2; ++part) {
+        const uint8_t* data = parts[part];
+        size_t size = sizes[part];
+        while (0 < size) {
+            const size_t count = min(size, k_maxBlockSize - m_block.size());
+            m_block.insert(m_block.end(), data, data + count);
+            data += count;
+            size -= count;
+            if (m_block.size() == k_maxBlockSize) {
+                flushBlock(false);
+            }
+        }
+    }
+
+    ++m_rowCount;
+    return bool(m_stream);
+}
+
+
+// Finish the image and close the file
+bool PngWriter::close()
+{
+    if (!m_stream.is_open()) {
+        return false;
+    }
+
+    // The last block may be empty, it only marks the end of the stream
+    flushBlock(true);
+
+    std::vector<uint8_t> checksum;
+    s_putBigEndian(checksum, (m_adlerB << 16) | m_adlerA);
+    writeChunk("IDAT", &checksum[0], checksum.size());
+    writeChunk("IEND", NULL, 0);
+
+    const bool succeeded = bool(m_stream) && m_rowCount == m_height;
+    m_stream.close();
+    return succeeded;
+}
+
+
+// Write a chunk with its length and CRC
+void PngWriter::writeChunk(const char* type, const uint8_t* data, size_t size)
+{
+    std::vector<uint8_t> prefix;
+    s_putBigEndian(prefix, uint32_t(size));
+    prefix.insert(prefix.end(), type, type + 4);
+    m_stream.write(reinterpret_cast<const char*>(&prefix[0]), prefix.size());
+    if (0 < size) {
+        m_stream.write(reinterpret_cast<const char*>(data), size);
+    }
+
+    // The CRC covers the type and the data, not the length
+    uint32_t crc = s_crc32(0, reinterpret_cast<const uint8_t*>(type), 4);
+    crc = s_crc32(crc, data, size);
+    std::vector<uint8_t> suffix;
+    s_putBigEndian(suffix, crc);
+    m_stream.write(reinterpret_cast<const char*>(&suffix[0]), suffix.size());
+}
+
+
+// Write the block being filled as a stored deflate block inside an IDAT chunk
+void PngWriter::flushBlock(bool final)
+{
+    // Adler-32 covers the uncompressed data
+    const uint8_t* data = m_block.empty() ? NULL : &m_block[0];
+    for (size_t offset = 0; offset < m_block.size(); offset += k_adlerRun) {
+        const size_t end = min(m_block.size(), offset + k_adlerRun);
+        for (size_t i = offset; i < end; ++i) {
+            m_adlerA += data[i];
+            m_adlerB += m_adlerA;
+        }
+        m_adlerA %= k_adlerBase;
+        m_adlerB %= k_adlerBase;
+    }
+
+    std::vector<uint8_t> chunk;
+    chunk.reserve(m_block.size() + 7);
+    if (!m_headerWritten) {
+        // zlib header: deflate with a 32K window, no preset dictionary, check bits
+        chunk.push_back(0x78);
+        chunk.push_back(0x01);
+        m_headerWritten = true;
+    }
+
+    // Stored block: BFINAL and BTYPE 00 padded to a byte, then LEN and NLEN little-endian
+    const uint16_t length = uint16_t(m_block.size());
+    chunk.push_back(final ? 1 : 0);
+    chunk.push_back(uint8_t(length));
+    chunk.push_back(uint8_t(length >> 8));
+    chunk.push_back(uint8_t(~length));
+    chunk.push_back(uint8_t(uint16_t(~length) >> 8));
+    chunk.insert(chunk.end(), m_block.begin(), m_block.end());
+    writeChunk("IDAT", &chunk[0], chunk.size());
+
+    m_block.clear();
+}
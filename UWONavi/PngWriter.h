@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>        // For fixed-width integer types
+#include <fstream>        // For the output file
+#include <string>         // For the file name
+#include <vector>         // For the block being filled
+
+#include "Noncopyable.h"  // To prevent copying of the writer
+
+//! @brief Writes an RGB PNG file row by row, so images far larger than memory can be written.
+//! Rows are wrapped in stored (uncompressed) deflate blocks: every decoder reads them, the file is
+//! about as large as the raw pixels, and no row has to be kept once it has been written.
+class PngWriter : private Noncopyable {
+private:
+    std::ofstream m_stream;         //!< Output file
+    uint32_t m_width;               //!< Width of the image in pixels
+    uint32_t m_height;              //!< Height of the image in pixels
+    uint32_t m_rowCount;            //!< Rows written so far
+    uint32_t m_adlerA;              //!< Running Adler-32 of the uncompressed data (low half)
+    uint32_t m_adlerB;              //!< Running Adler-32 of the uncompressed data (high half)
+    bool m_headerWritten;           //!< Whether the zlib header has gone out with an IDAT chunk
+    std::vector<uint8_t> m_block;   //!< Uncompressed data of the deflate block being filled
+
+public:
+    PngWriter() :
+        m_width(),
+        m_height(),
+        m_rowCount(),
+        m_adlerA(1),
+        m_adlerB(0),
+        m_headerWritten(false)
+    {
+    }
+
+    //! @brief Create the file and write the image header.
+    //! @return false if the file cannot be created
+    bool open(const std::wstring& fileName, uint32_t width, uint32_t height);
+
+    //! @brief Append the next row.
+    //! @param rgb width * 3 bytes, red first
+    //! @return false if the file cannot be written
+    bool writeRow(const uint8_t* rgb);
+
+    //! @brief Finish the image and close the file. Every row must have been written.
+    //! @return false if the file cannot be written or rows are missing
+    bool close();
+
+private:
+    // Write a chunk with its length and CRC
+    void writeChunk(const char* type, const uint8_t* data, size_t size);
+
+    // Write the block being filled as a stored deflate block inside an IDAT chunk
+    void flushBlock(bool final);
+};
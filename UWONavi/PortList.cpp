@@ -0,0 +1,155 @@
+#include "stdafx.h"
+#include "PortList.h"
+#include "UWONavi.h"
+#include <fstream>
+
+namespace {
+    const int32_t k_cellColumns = k_worldWidth / PortList::k_cellSize;
+    const int32_t k_cellRows = k_worldHeight / PortList::k_cellSize;
+
+    // Parse "x<TAB>y<TAB>name"
+    bool s_parsePort(const std::string& line, Port& port)
+    {
+        const size_t xEnd = line.find('\t');
+        const size_t yEnd = xEnd == std::string::npos ? std::string::npos : line.find('\t', xEnd + 1);
+        if (yEnd == std::string::npos || yEnd + 1 == line.size()) {
+            return false;
+        }
+        char* end = NULL;
+        const long x = ::strtol(line.c_str(), &end, 10);
+        if (xEnd == 0 || end != line.c_str() + xEnd) {
+            return false;
+        }
+        const long y = ::strtol(line.c_str() + xEnd + 1, &end, 10);
+        if (yEnd == xEnd + 1 || end != line.c_str() + yEnd) {
+            return false;
+        }
+        if (x < 0 || k_worldWidth <= x || y < 0 || k_worldHeight <= y) {
+            return false;
+        }
+        port.worldCoord.x = x;
+        port.worldCoord.y = y;
+        port.name = g_wideFromUtf8(line.substr(yEnd + 1));
+        return true;
+    }
+}
+
+
+// Read the ports from a file, one per line
+bool PortList::loadFromFile(const std::wstring& fileName)
+{
+    std::ifstream ifs;
+    ifs.open(fileName, std::ios::in | std::ios::binary);
+    if (!ifs) {
+        return false;
+    }
+
+    std::vector<Port> ports;
+    std::string line;
+    bool firstLine = true;
+    while (std::getline(ifs, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (firstLine && line.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+            line.erase(0, 3);  // Byte order mark
+        }
+        firstLine = false;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        Port port;
+        if (s_parsePort(line, port)) {
+            ports.push_back(port);
+        }
+    }
+    m_ports.swap(ports);
+    buildIndex();
+    return true;
+}
+
+
+// Count the ports of every cell, then place them by those counts
+void PortList::buildIndex()
+{
+    m_cellBegin.assign(size_t(k_cellColumns) * k_cellRows + 1, 0);
+    m_cellPorts.resize(m_ports.size());
+    for (const Port& port : m_ports) {
+        ++m_cellBegin[(port.worldCoord.y / k_cellSize) * k_cellColumns + port.worldCoord.x / k_cellSize + 1];
+    }
+    for (size_t i = 1; i < m_cellBegin.size(); ++i) {
+        m_cellBegin[i] += m_cellBegin[i - 1];
+    }
+    std::vector<uint32_t> next(m_cellBegin.begin(), m_cellBegin.end() - 1);
+    for (size_t i = 0; i < m_ports.size(); ++i) {
+        const POINT& worldCoord = m_ports[i].worldCoord;
+        m_cellPorts[next[(worldCoord.y / k_cellSize) * k_cellColumns + worldCoord.x / k_cellSize]++] = uint32_t(i);
+    }
+}
+
+
+std::vector<POINT> PortList::worldCoords() const
+{
+    std::vector<POINT> worldCoords;
+    worldCoords.reserve(m_ports.size());
+    for (const Port& port : m_ports) {
+        worldCoords.push_back(port.worldCoord);
+    }
+    return worldCoords;
+}
+
+
+// Look at the cells ring by ring around the cell of the position. Every port outside ring r is
+// more than r cells away, so the search stops once the nearest port found is closer than that.
+const Port* PortList::findNearest(const POINT& worldCoord, int32_t maxDistance) const
+{
+    if (m_ports.empty()) {
+        return NULL;
+    }
+    const int32_t x = ((worldCoord.x % k_worldWidth) + k_worldWidth) % k_worldWidth;
+    const int32_t y = max(0, min(k_worldHeight - 1, int32_t(worldCoord.y)));
+    const int32_t column = x / k_cellSize;
+    const int32_t row = y / k_cellSize;
+    const int32_t maxRadius = min((maxDistance + k_cellSize - 1) / k_cellSize, (k_cellColumns - 1) / 2);
+
+    const Port* nearest = NULL;
+    int64_t nearestDistance = int64_t(maxDistance) * maxDistance + 1;
+    for (int32_t radius = 0; radius <= maxRadius; ++radius) {
+        for (int32_t dy = -radius; dy <= radius; ++dy) {
+            const int32_t cellRow = row + dy;
+            if (cellRow < 0 || k_cellRows <= cellRow) {
+                continue;
+            }
+            const int32_t step = (dy == -radius || dy == radius) ? 1 : 2 * radius;
+            for (int32_t dx = -radius; dx <= radius; dx += step) {
+                const int32_t cell = cellRow * k_cellColumns + (column + dx + k_cellColumns) % k_cellColumns;
+                for (uint32_t i = m_cellBegin[cell]; i < m_cellBegin[cell + 1]; ++i) {
+                    const Port& port = m_ports[m_cellPorts[i]];
+                    int32_t distanceX = abs(port.worldCoord.x - x);
+                    distanceX = min(distanceX, k_worldWidth - distanceX);
+                    const int32_t distanceY = port.worldCoord.y - y;
+                    const int64_t distance = int64_t(distanceX) * distanceX + int64_t(distanceY) * distanceY;
+                    if (distance < nearestDistance) {
+                        nearestDistance = distance;
+                        nearest = &port;
+                    }
+                }
+            }
+        }
+        const int64_t ringDistance = int64_t(radius) * k_cellSize;
+        if (nearest && nearestDistance <= ringDistance * ringDistance) {
+            break;
+        }
+    }
+    return nearest;
+}
+
+
+std::wstring PortList::placeName(const POINT& worldCoord) const
+{
+    const Port* port = findNearest(worldCoord);
+    if (port) {
+        return port->name;
+    }
+    return std::to_wstring(worldCoord.x) + L"," + std::to_wstring(worldCoord.y);
+}
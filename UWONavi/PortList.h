@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Windows.h>      // For POINT
+#include <cstdint>        // For fixed-width integer types
+#include <string>         // For names and file names
+#include <vector>         // For the ports
+
+//! @brief A port of the world.
+struct Port {
+    std::wstring name;  //!< Name shown to the user
+    POINT worldCoord;   //!< Position in world coordinates
+};
+
+//! @brief The ports read from a text file, one per line:
+//!     x<TAB>y<TAB>name
+//! with x and y in world coordinates and the file encoded in UTF-8. Empty lines and lines starting
+//! with '#' are skipped, as are lines that do not parse. Landmarks go in the same file as ports.
+//! The ports are also filed in a grid of k_cellSize cells, so the nearest one to a position is
+//! found by looking at a few cells around it (x wraps around like the game world).
+class PortList {
+public:
+    enum : int32_t {
+        k_cellSize = 256,           //!< World coordinates along each side of a grid cell
+        k_nearbyDistance = 512,     //!< How far from a port a position is still named after it
+    };
+
+private:
+    std::vector<Port> m_ports;              //!< Ports in file order
+    std::vector<uint32_t> m_cellBegin;      //!< First port of every grid cell in m_cellPorts, plus the count of all
+    std::vector<uint32_t> m_cellPorts;      //!< Ports of every grid cell, cell by cell
+
+public:
+    PortList() :
+        m_ports(),
+        m_cellBegin(),
+        m_cellPorts()
+    {
+    }
+
+    //! @brief Read the ports from a file, replacing those read before.
+    //! @return false if the file cannot be opened
+    bool loadFromFile(const std::wstring& fileName);
+
+    //! @brief Check whether there are no ports.
+    bool empty() const { return m_ports.empty(); }
+
+    //! @brief Get the number of ports.
+    size_t size() const { return m_ports.size(); }
+
+    //! @brief Get a port by index.
+    const Port& operator[](size_t index) const { return m_ports[index]; }
+
+    //! @brief Get the index of a port of the list.
+    size_t indexOf(const Port& port) const { return size_t(&port - m_ports.data()); }
+
+    //! @brief Get the positions of all ports, in the same order.
+    std::vector<POINT> worldCoords() const;
+
+    //! @brief Find the port nearest to a world coordinate.
+    //! @param maxDistance Farthest port to consider, less than half the world wide
+    //! @return NULL if no port is that close
+    const Port* findNearest(const POINT& worldCoord, int32_t maxDistance = k_nearbyDistance) const;
+
+    //! @brief Get the name to show for a world coordinate: the nearby port, or "x,y" when there is none.
+    std::wstring placeName(const POINT& worldCoord) const;
+
+private:
+    //! @brief File every port in its grid cell
+    void buildIndex();
+};
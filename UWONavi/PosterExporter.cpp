@@ -0,0 +1,103 @@
+#include "stdafx.h"
+#include "PosterExporter.h"
+#include "UWONavi.h"
+#include "WorldMap.h"
+#include "Renderer.h"
+#include "SoftwareRenderBackend.h"
+#include "PngWriter.h"
+#include "WorkerThreads.h"
+
+namespace {
+    // Framebuffer memory of one band; the band height follows from the poster width
+    const size_t k_bandBytes = 16 * 1024 * 1024;
+
+    // Most bands rendered at the same time, each with its own framebuffer
+    const DWORD k_maxWorkerCount = 8;
+
+    // One band of the poster and the worker rendering it
+    struct Band : private Noncopyable {
+        Renderer describer;             //!< Describes the band; never set up, only its description is used
+        SoftwareRenderBackend backend;  //!< Rasterizes the band
+        const ShipRouteList* routes;    //!< Routes to draw
+        bool favoritesOnly;             //!< Whether to draw only favorite routes
+        double viewScale;               //!< Zoom level of the poster
+        SIZE mapSize;                   //!< Size of the poster
+        RECT tile;                      //!< Rows of the poster in this band
+    };
+
+    UINT CALLBACK s_renderBandThunk(LPVOID arg)
+    {
+        Band* band = reinterpret_cast<Band*>(arg);
+        FrameDescription frame = FrameDescription();
+        band->describer.describeMapTile(frame, band->viewScale, band->mapSize, band->tile, band->routes, band->favoritesOnly);
+        band->backend.drawFrame(frame);
+        return 0;
+    }
+}
+
+
+// Render and write the poster
+bool PosterExporter::run(const Options& options)
+{
+    const SIZE& fullSize = m_worldMap->size();
+    const double viewScale = double(options.width) / fullSize.cx;
+    const SIZE mapSize = { options.width, LONG(fullSize.cy * viewScale) };
+    if (mapSize.cx <= 0 || mapSize.cy <= 0) {
+        return false;
+    }
+
+    PngWriter writer;
+    if (!writer.open(options.outputFileName, mapSize.cx, mapSize.cy)) {
+        return false;
+    }
+
+    const DWORD workerCount = g_workerCount(k_maxWorkerCount);
+    const LONG bandHeight = max(LONG(1), LONG(k_bandBytes / (size_t(mapSize.cx) * 4)));
+
+    std::vector<std::unique_ptr<Band>> bands;
+    for (DWORD i = 0; i < workerCount; ++i) {
+        std::unique_ptr<Band> band(new Band());
+        band->backend.setup();
+        band->backend.setWorldMap(m_worldMap->image(), NULL);
+        band->routes = m_routes;
+        band->favoritesOnly = options.favoritesOnly;
+        band->viewScale = viewScale;
+        band->mapSize = mapSize;
+        bands.push_back(std::move(band));
+    }
+
+    // Render a round of bands in parallel, then write them top to bottom
+    bool succeeded = true;
+    std::vector<uint8_t> row(size_t(mapSize.cx) * 3);
+    for (LONG top = 0; succeeded && top < mapSize.cy; ) {
+        std::vector<LPVOID> args;
+        for (DWORD i = 0; i < workerCount && top < mapSize.cy; ++i) {
+            Band& band = *bands[i];
+            const RECT tile = { 0, top, mapSize.cx, min(mapSize.cy, top + bandHeight) };
+            band.tile = tile;
+            top = tile.bottom;
+            args.push_back(&band);
+        }
+        g_runWorkers(s_renderBandThunk, args);
+
+        for (size_t i = 0; succeeded && i < args.size(); ++i) {
+            const SoftwareRenderBackend& backend = bands[i]->backend;
+            const std::vector<uint32_t>& pixels = backend.framePixels();
+            const SIZE& size = backend.frameSize();
+            for (LONG y = 0; succeeded && y < size.cy; ++y) {
+                const uint32_t* src = &pixels[size_t(y) * size.cx];
+                for (LONG x = 0; x < size.cx; ++x) {
+                    row[x * 3 + 0] = uint8_t(src[x] >> 16);
+                    row[x * 3 + 1] = uint8_t(src[x] >> 8);
+                    row[x * 3 + 2] = uint8_t(src[x]);
+                }
+                succeeded = writer.writeRow(&row[0]);
+            }
+        }
+    }
+
+    for (const std::unique_ptr<Band>& band : bands) {
+        band->backend.teardown();
+    }
+    return writer.close() && succeeded;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Windows.h>      // For LONG
+#include <string>         // For the output file name
+
+#include "Noncopyable.h"  // For preventing copying of the exporter
+
+class WorldMap;
+class ShipRouteList;
+
+//! @brief Exports the whole world map with routes as one large PNG, without a window.
+//! The poster is cut into bands of full rows; worker threads rasterize a few bands at a time with
+//! SoftwareRenderBackend, and the bands are streamed to the file in order. Peak memory is bounded
+//! by the bands in flight, whatever the size of the poster.
+class PosterExporter : private Noncopyable {
+public:
+    //! @brief What to export.
+    struct Options {
+        std::wstring outputFileName;    //!< PNG file to write
+        LONG width;                     //!< Width of the poster in pixels (the height follows the map)
+        bool favoritesOnly;             //!< Whether to draw only routes marked as favorite
+    };
+
+private:
+    const WorldMap* m_worldMap;         //!< Map drawn under the routes
+    const ShipRouteList* m_routes;      //!< Routes to draw
+
+public:
+    PosterExporter(const WorldMap* worldMap, const ShipRouteList* routes) :
+        m_worldMap(worldMap),
+        m_routes(routes)
+    {
+    }
+
+    //! @brief Render and write the poster.
+    //! @return false if the file cannot be written
+    bool run(const Options& options);
+};
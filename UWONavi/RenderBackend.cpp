@@ -0,0 +1,15 @@
+#include "stdafx.h"
+#include "RenderBackend.h"
+
+
+LONG RenderBackend::Capabilities::layerExtent( LONG extent ) const
+{
+	if ( nonPowerOfTwoLayers ) {
+		return extent;
+	}
+	LONG size = 1;
+	while ( size < extent ) {
+		size <<= 1;
+	}
+	return size;
+}
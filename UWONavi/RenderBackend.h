@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Noncopyable.h"      // For preventing copying of backends
+#include "FrameDescription.h" // For the frames a backend draws
+
+class Image;
+class CompressedImage;
+
+// Draws frame descriptions. Renderer owns one backend and calls it only from its render thread.
+// Describing a frame (wrap-around, culling, route passes, overlay placement) stays in Renderer,
+// so every backend draws exactly the same geometry and only rasterizes it differently.
+class RenderBackend : private Noncopyable {
+public:
+    // What the backend supports; Renderer describes frames accordingly
+    struct Capabilities {
+        bool routeLayer;                //!< Whether fixed routes can be kept in an offscreen layer
+        LONG maxLayerExtent;            //!< Largest width or height of an offscreen layer
+        bool nonPowerOfTwoLayers;       //!< Whether layers may have any size (otherwise powers of two)
+
+        // Size of a layer holding extent pixels
+        LONG layerExtent(LONG extent) const;
+
+        // Check whether a layer of this size can be allocated
+        bool canAllocateLayer(const SIZE& size) const
+        {
+            return layerExtent(size.cx) <= maxLayerExtent && layerExtent(size.cy) <= maxLayerExtent;
+        }
+    };
+
+    virtual ~RenderBackend() {}
+
+    // Prepare for drawing; called on the render thread before anything else
+    virtual void setup() = 0;
+
+    // Release everything setup() and drawing created; called on the render thread last
+    virtual void teardown() = 0;
+
+    // What the backend supports (valid after setup)
+    virtual Capabilities capabilities() const = 0;
+
+    // Set the world map image, and its blocks if it has been block-compressed (NULL otherwise);
+    // the caller keeps both alive until teardown
+    virtual void setWorldMap(const Image& image, const CompressedImage* compressed) = 0;
+
+    // Prepare a world map that may be set soon, so that setting it is quick; the map drawn stays
+    virtual void prefetchWorldMap(const Image& image, const CompressedImage* compressed) = 0;
+
+    // Release the large resources while nothing is shown: the world maps and every cached layer.
+    // Drawing needs setWorldMap again afterwards.
+    virtual void releaseResources() = 0;
+
+    // Draw a frame and present it
+    virtual void drawFrame(const FrameDescription& frame) = 0;
+};
@@ -2,10 +2,10 @@
 #include "Renderer.h"
 #include "WorldMap.h"
 #include "Config.h"
-#include "Texture.h"
+#include "GLRenderBackend.h"
 #include "ShipRouteList.h"
 #include "ShipRoute.h"
-
+#include <process.h>
 
 
 namespace {
@@ -13,6 +13,27 @@ namespace {
 	const double k_minScale = 0.125;	// 12.5%
 	const double k_maxScale = 4.00;		// 400%
 
+	// Extra pixels around the view within which geometry is still drawn (covers wide lines)
+	const float k_cullMargin = 8.0f;
+
+	// Largest error in pixels allowed when drawing a route from a simplified level
+	const double k_lodPixelTolerance = 0.5;
+
+	// Zoom from which the coastline is drawn over the map, whose pixels turn blocky
+	const double k_coastlineMinScale = 2.00;	// 200%
+
+	// Pixels the route layer extends beyond each edge of the view, so that panning
+	// (and trace mode following the ship) can go on for a while before it is redrawn
+	const LONG k_routeLayerMargin = 256;
+
+	// FNV-1a, used to fold route revisions into a signature
+	const uint64_t k_hashSeed = 14695981039346656037ULL;
+
+	inline uint64_t s_hashCombine( uint64_t hash, uint64_t value )
+	{
+		return (hash ^ value) * 1099511628211ULL;
+	}
+
 	// Professor Google says "the outer circumference of the earth is 40,075 km", "1 knot is 1.85200 km"
 	// 1 World coordinates are 40,075 km / 16384 points
 	// 0.4 hours in game with real time 1 second
@@ -27,27 +48,123 @@ namespace {
 		static const double k_knotFactor = (2 * M_PI * 6378.137) / 16384.0 / 0.4 / 1.852;
 		return velocity * k_knotFactor;
 	}
+
+	// Nautical miles of a distance in world coordinates, on the same scale as s_velocityByKnot
+	inline double s_distanceByNauticalMile( const double distance )
+	{
+		static const double k_nauticalMileFactor = (2 * M_PI * 6378.137) / 16384.0 / 1.852;
+		return distance * k_nauticalMileFactor;
+	}
+
+	// The speed, followed by the distance and the time (real minutes and seconds) to landfall when there is one
+	inline std::wstring s_speedMeterText( const double shipVelocity, const double landfallDistance )
+	{
+		wchar_t buf[64] = { 0 };
+		if ( 0.0 <= landfallDistance && 0.0 < shipVelocity ) {
+			const int seconds = int( min( landfallDistance / shipVelocity, 359999.0 ) );
+			swprintf( buf, _countof( buf ), L"%.2f kt  land %.0f nm %d:%02d", s_velocityByKnot( shipVelocity ),
+				s_distanceByNauticalMile( landfallDistance ), seconds / 60, seconds % 60 );
+		}
+		else {
+			swprintf( buf, _countof( buf ), L"%.2f kt", s_velocityByKnot( shipVelocity ) );
+		}
+		return buf;
+	}
+
+	template<typename Batch>
+	inline void s_setColor( Batch& batch, float r, float g, float b, float a )
+	{
+		batch.color[0] = r;
+		batch.color[1] = g;
+		batch.color[2] = b;
+		batch.color[3] = a;
+	}
+
+	inline bool s_isEqualPoint( const POINT& lhs, const POINT& rhs )
+	{
+		return lhs.x == rhs.x && lhs.y == rhs.y;
+	}
+}
+
+
+bool Renderer::FrameKey::operator==( const FrameKey& rhs ) const
+{
+	return viewSize.cx == rhs.viewSize.cx
+		&& viewSize.cy == rhs.viewSize.cy
+		&& viewScale == rhs.viewScale
+		&& s_isEqualPoint( mapOrigin, rhs.mapOrigin )
+		&& s_isEqualPoint( shipPoint, rhs.shipPoint )
+		&& s_isEqualPoint( courseEnd, rhs.courseEnd )
+		&& shipIcon == rhs.shipIcon
+		&& speedText == rhs.speedText
+		&& routeSignature == rhs.routeSignature
+		&& s_isEqualPoint( liveTailPoint, rhs.liveTailPoint )
+		&& preview == rhs.preview;
+}
+
+
+bool Renderer::RouteLayerKey::operator==( const RouteLayerKey& rhs ) const
+{
+	return viewScale == rhs.viewScale
+		&& routeLod == rhs.routeLod
+		&& routeSignature == rhs.routeSignature;
 }
 
 
 void Renderer::setup( const Config * config, HDC hdcPrimary, const WorldMap * worldMap )
 {
-	m_hdcPrimary = hdcPrimary;
+	setup( config, std::unique_ptr<RenderBackend>( new GLRenderBackend( hdcPrimary, config->m_frameRateLimit, size_t( config->m_mapTextureBudget ) << 20 ) ), worldMap );
+}
+
+
+void Renderer::setup( const Config * config, std::unique_ptr<RenderBackend> backend, const WorldMap * worldMap )
+{
+	m_backend = std::move( backend );
 	setConfig( config );
-	setupGL();
-	setWorldMap( worldMap );
+
+	// The backend is set up and used on the render thread only (the GL context stays current there)
+	m_threadQuitSignal = ::CreateEvent( NULL, TRUE, FALSE, NULL );
+	m_renderThread = reinterpret_cast<HANDLE>(::_beginthreadex(
+		NULL,
+		0,
+		threadMainThunk,
+		this,
+		0,
+		NULL
+		));
+	if ( !m_renderThread ) {
+		// No thread could be started: draw on the calling thread instead, which then owns the backend
+		::OutputDebugStringA( "render thread not started, drawing inline\n" );
+		::CloseHandle( m_threadQuitSignal );
+		m_threadQuitSignal = NULL;
+	}
+	runOnRenderThread( [this]() {
+		m_backend->setup();
+		m_capabilities = m_backend->capabilities();
+	} );
+	if ( worldMap ) {
+		setWorldMap( worldMap );
+	}
 }
 
 
 void Renderer::teardown()
 {
-	delete m_worldMapTexture;
-	m_worldMapTexture = NULL;
-
-	::wglMakeCurrent( NULL, NULL );
-	::wglDeleteContext( m_hglrc );
-	m_hglrc = NULL;
-	m_hdcPrimary = NULL;
+	if ( m_renderThread ) {
+		::SetEvent( m_threadQuitSignal );
+		::WaitForSingleObject( m_renderThread, INFINITE );
+		::CloseHandle( m_renderThread );
+		::CloseHandle( m_threadQuitSignal );
+		m_threadQuitSignal = NULL;
+		m_renderThread = NULL;
+	}
+	else if ( m_backend ) {
+		m_backend->teardown();
+	}
+	m_pendingFrame.reset();
+	m_hasLastFrame = false;
+	m_hasRouteLayer = false;
+	m_backend.reset();
 }
 
 
@@ -56,62 +173,142 @@ void Renderer::setConfig( const Config * config )
 	m_focusPointInWorldCoord = config->m_initialSurveyCoord;
 	m_shipPointInWorld.x = -1;
 	m_shipPointInWorld.y = -1;
+	m_shipMotion.reset();
 	m_shipVectorLineEnabled = config->m_shipVectorLineEnabled;
 	m_speedMeterEnabled = config->m_speedMeterEnabled;
 	m_traceShipEnabled = config->m_traceShipPositionEnabled;
+	m_scrollBlitEnabled = config->m_scrollBlitEnabled;
 }
 
 
-void Renderer::setupGL()
+void Renderer::runOnRenderThread( const std::function<void()>& function )
 {
-	PIXELFORMATDESCRIPTOR pfd = { sizeof(pfd) };
-	pfd.nVersion = 1;
-	pfd.dwFlags = PFD_DRAW_TO_WINDOW | PFD_SUPPORT_OPENGL | PFD_DOUBLEBUFFER | PFD_SWAP_EXCHANGE;
-	pfd.iPixelType = PFD_TYPE_RGBA;
-	pfd.cColorBits = 24;
-	pfd.cAlphaBits = 8;
-	pfd.cDepthBits = 16;
-	pfd.iLayerType = PFD_MAIN_PLANE;
-	::SetPixelFormat( m_hdcPrimary, ::ChoosePixelFormat( m_hdcPrimary, &pfd ), &pfd );
-	m_hglrc = ::wglCreateContext( m_hdcPrimary );
-	::wglMakeCurrent( m_hdcPrimary, m_hglrc );
-	::glDisable( GL_DEPTH_TEST );
-	::glDisable( GL_LIGHTING );
-	::glEnable( GL_CULL_FACE );
-	::glCullFace( GL_BACK );
-	::wglMakeCurrent( NULL, NULL );
+	if ( !m_renderThread ) {
+		function();
+		return;
+	}
+
+	RenderTask task = { function, ::CreateEvent( NULL, TRUE, FALSE, NULL ) };
+	::EnterCriticalSection( &m_lock );
+	m_tasks.push_back( task );
+	::LeaveCriticalSection( &m_lock );
+	::SetEvent( m_wakeEvent );
+
+	::WaitForSingleObject( task.doneEvent, INFINITE );
+	::CloseHandle( task.doneEvent );
+}
+
+
+void Renderer::postToRenderThread( const std::function<void()>& function )
+{
+	if ( !m_renderThread ) {
+		function();
+		return;
+	}
+
+	RenderTask task = { function, NULL };
+	::EnterCriticalSection( &m_lock );
+	m_tasks.push_back( task );
+	::LeaveCriticalSection( &m_lock );
+	::SetEvent( m_wakeEvent );
+}
+
+
+UINT CALLBACK Renderer::threadMainThunk( LPVOID arg )
+{
+	Renderer * self = reinterpret_cast<Renderer *>(arg);
+	self->threadMain();
+	return 0;
+}
+
+
+void Renderer::threadMain()
+{
+	HANDLE handles[] = { m_threadQuitSignal, m_wakeEvent };
+	for ( ;; ) {
+		const DWORD waitResult = ::WaitForMultipleObjects( _countof( handles ), handles, FALSE, INFINITE );
+		if ( waitResult == WAIT_OBJECT_0 ) {
+			break;
+		}
+
+		// Take everything queued so far; tasks first, since a frame may rely on what a task set up
+		::EnterCriticalSection( &m_lock );
+		std::vector<RenderTask> tasks;
+		tasks.swap( m_tasks );
+		std::unique_ptr<FrameDescription> frame( std::move( m_pendingFrame ) );
+		::LeaveCriticalSection( &m_lock );
+
+		for ( const RenderTask& task : tasks ) {
+			task.function();
+			if ( task.doneEvent ) {
+				::SetEvent( task.doneEvent );
+			}
+		}
+
+		if ( frame ) {
+			m_backend->drawFrame( *frame );
+		}
+
+		::EnterCriticalSection( &m_lock );
+		if ( !m_pendingFrame ) {
+			::SetEvent( m_idleEvent );
+		}
+		::LeaveCriticalSection( &m_lock );
+	}
+
+	m_backend->teardown();
 }
 
 
 void Renderer::setWorldMap( const WorldMap * worldMap )
 {
-	::wglMakeCurrent( m_hdcPrimary, m_hglrc );
+	// The route layer and the last frame were drawn for the size of the previous map
 	m_worldMap = worldMap;
-	m_worldMapTexture = new Texture();
-	m_worldMapTexture->setImage( worldMap->image() );
-	::glFlush();
-	::wglMakeCurrent( NULL, NULL );
+	m_hasLastFrame = false;
+	m_hasRouteLayer = false;
+	m_resourcesReleased = false;
+	runOnRenderThread( [this, worldMap]() {
+		const CompressedImage& compressed = worldMap->compressedImage();
+		m_backend->setWorldMap( worldMap->image(), compressed.empty() ? NULL : &compressed );
+	} );
+}
+
+
+void Renderer::prefetchWorldMap( const WorldMap * worldMap )
+{
+	postToRenderThread( [this, worldMap]() {
+		const CompressedImage& compressed = worldMap->compressedImage();
+		m_backend->prefetchWorldMap( worldMap->image(), compressed.empty() ? NULL : &compressed );
+	} );
+}
+
+
+void Renderer::releaseResources()
+{
+	if ( m_resourcesReleased ) {
+		return;
+	}
+	m_resourcesReleased = true;
+	m_hasLastFrame = false;
+	m_hasRouteLayer = false;
+	postToRenderThread( [this]() {
+		m_backend->releaseResources();
+	} );
 }
 
 
 void Renderer::setViewSize( const SIZE& viewSize )
 {
+	// The projection follows the size recorded in each frame description
 	m_viewSize = viewSize;
-	::wglMakeCurrent( m_hdcPrimary, m_hglrc );
-	::glMatrixMode( GL_PROJECTION );
-	::glLoadIdentity();
-	::glViewport( 0, 0, m_viewSize.cx, m_viewSize.cy );
-	::gluOrtho2D( 0, m_viewSize.cx, m_viewSize.cy, 0 );
-	::glFlush();
-	::wglMakeCurrent( NULL, NULL );
 }
 
 
 SIZE Renderer::scaledMapSize() const
 {
 	SIZE size = {
-		LONG( m_worldMap->image().width() * m_viewScale ),
-		LONG( m_worldMap->image().height() * m_viewScale )
+		LONG( m_worldMap->size().cx * m_viewScale ),
+		LONG( m_worldMap->size().cy * m_viewScale )
 	};
 	return size;
 }
@@ -137,10 +334,47 @@ POINT Renderer::mapOriginInView() const
 }
 
 
+MapLayout Renderer::mapLayout() const
+{
+	const SIZE mapSize = scaledMapSize();
+	const POINT mapTopLeft = mapOriginInView();
+
+	// Start from the copy whose left edge is at or left of the view's left edge
+	LONG xOrigin = mapTopLeft.x;
+	if ( 0 < xOrigin ) {
+		xOrigin = (xOrigin % mapSize.cx) - mapSize.cx;
+	}
+
+	MapLayout layout = {
+		(float)xOrigin,
+		(float)mapTopLeft.y,
+		(float)mapSize.cx,
+		(float)mapSize.cy,
+		(float)m_viewSize.cx,
+		(float)m_viewSize.cy
+	};
+	return layout;
+}
+
+
+bool Renderer::visibleCopyRange( const MapLayout& layout, float minX, float maxX, int& first, int& last ) const
+{
+	// Copy k places the span at [minX, maxX] + layout.x + k * layout.width;
+	// keep the copies for which that interval overlaps the surface (plus the cull margin).
+	first = int( ::ceil( (-k_cullMargin - layout.x - maxX) / layout.width ) );
+	last = int( ::floor( (layout.clipWidth + k_cullMargin - layout.x - minX) / layout.width ) );
+	return first <= last;
+}
+
+
 void Renderer::offsetFocusInViewCoord( const POINT& offset )
 {
-	const double dx = ((double)offset.x / m_viewScale) / m_worldMap->image().width();
-	const double dy = ((double)offset.y / m_viewScale) / m_worldMap->image().height();
+	if ( !m_worldMap ) {
+		return;
+	}
+
+	const double dx = ((double)offset.x / m_viewScale) / m_worldMap->size().cx;
+	const double dy = ((double)offset.y / m_viewScale) / m_worldMap->size().cy;
 
 	LONG x = m_focusPointInWorldCoord.x + LONG( dx * k_worldWidth );
 	LONG y = m_focusPointInWorldCoord.y + LONG( dy * k_worldHeight );
@@ -208,6 +442,26 @@ POINT Renderer::drawOffsetFromWorldCoord( const POINT&worldCoord ) const
 }
 
 
+bool Renderer::worldCoordFromViewCoord( const POINT& viewCoord, POINT& worldCoord ) const
+{
+	if ( !m_worldMap ) {
+		return false;
+	}
+
+	// The copies of the map repeat every layout.width pixels from the leftmost one
+	const MapLayout layout = mapLayout();
+	const double xInMap = ::fmod( viewCoord.x - layout.x, layout.width );
+	const double yInMap = viewCoord.y - layout.y;
+	if ( yInMap < 0 || layout.height <= yInMap ) {
+		return false;
+	}
+
+	worldCoord.x = LONG( (xInMap < 0 ? xInMap + layout.width : xInMap) / layout.width * k_worldWidth );
+	worldCoord.y = LONG( yInMap / layout.height * k_worldHeight );
+	return true;
+}
+
+
 void Renderer::setShipPositionInWorld( const POINT& shipPositionInWorld )
 {
 	if ( m_traceShipEnabled ) {
@@ -217,56 +471,159 @@ void Renderer::setShipPositionInWorld( const POINT& shipPositionInWorld )
 }
 
 
-void Renderer::render( const Vector& shipVector, double shipVelocity, Texture * shipTexture, const ShipRouteList * shipRouteList )
+void Renderer::addShipSample( const POINT& shipPositionInWorld, const Vector& shipVector, double shipVelocity, DWORD timeStamp )
 {
-	::wglMakeCurrent( m_hdcPrimary, m_hglrc );
-	::glClearColor( 0.2f, 0.2f, 0.3f, 0.0f );
-	::glClear( GL_COLOR_BUFFER_BIT );
-	::glDisable( GL_BLEND );
+	m_shipMotion.addSample( shipPositionInWorld, shipVector, shipVelocity, timeStamp );
+}
 
-	renderMap( shipVector, shipTexture, shipRouteList );
 
-	if ( m_speedMeterEnabled ) {
-		renderSpeedMeter( shipVelocity );
+void Renderer::setLandfall( bool hasLandfall, const POINT& landfallInWorld )
+{
+	m_hasLandfall = hasLandfall;
+	m_landfallInWorld = landfallInWorld;
+}
+
+
+double Renderer::landfallDistance( const Vector& shipVector ) const
+{
+	if ( !m_hasLandfall || shipVector.length() == 0.0 ) {
+		return -1.0;
+	}
+	// The ship has moved on since the landfall was traced, so measure along the course from where it is now
+	const Vector toLandfall( m_shipPointInWorld, m_landfallInWorld );
+	return max( 0.0, (toLandfall.x() * shipVector.x() + toLandfall.y() * shipVector.y()) / shipVector.length() );
+}
+
+
+bool Renderer::advanceShipMotion( DWORD now )
+{
+	if ( !m_shipMotion.hasSample() ) {
+		return false;
 	}
+	// Trace mode recenters on the predicted position too, so the map glides instead of stepping once per poll
+	setShipPositionInWorld( m_shipMotion.predictedPosition( now ) );
+	return m_shipMotion.isMoving( now );
+}
 
-	::glFlush();
-	::SwapBuffers( m_hdcPrimary );
-	::wglMakeCurrent( NULL, NULL );
+
+bool Renderer::checkFrameChanged( const Vector& shipVector, double shipVelocity, const Image * shipIcon, const ShipRouteList * shipRouteList )
+{
+	if ( m_worldMap && m_hasLastFrame && makeFrameKey( shipVector, shipVelocity, shipIcon, shipRouteList ) == m_lastFrameKey ) {
+		++m_skippedFrameCount;
+		return false;
+	}
+	return true;
 }
 
 
-void Renderer::renderMap( const Vector& shipVector, Texture * shipTexture, const ShipRouteList * shipRouteList )
+Renderer::FrameKey Renderer::makeFrameKey( const Vector& shipVector, double shipVelocity, const Image * shipIcon, const ShipRouteList * shipRouteList ) const
 {
-	_ASSERT( m_worldMapTexture != NULL );
+	FrameKey key = {};
+	key.viewSize = m_viewSize;
+	key.viewScale = m_viewScale;
+	key.mapOrigin = mapOriginInView();
+	key.shipIcon = shipIcon;
+	key.preview = isPreviewing();
+
+	key.shipPoint.x = key.shipPoint.y = -1;
+	if ( 0 <= m_shipPointInWorld.x && 0 <= m_shipPointInWorld.y ) {
+		key.shipPoint = drawOffsetFromWorldCoord( m_shipPointInWorld );
+		if ( shipVector.length() != 0.0 && m_shipVectorLineEnabled ) {
+			const double landfall = landfallDistance( shipVector );
+			const LONG courseLength = 0.0 <= landfall ? LONG( landfall ) : k_worldHeight;
+			key.courseEnd = drawOffsetFromWorldCoord( shipVector.pointFromOriginWithLength( m_shipPointInWorld, courseLength ) );
+		}
+	}
 
+	if ( m_speedMeterEnabled ) {
+		key.speedText = s_speedMeterText( shipVelocity, landfallDistance( shipVector ) );
+	}
+
+	// Points appended to the route being sailed do not change any revision,
+	// they show up as its tail moving to another pixel instead.
 	const SIZE mapSize = scaledMapSize();
+	uint64_t signature = s_hashCombine( k_hashSeed, shipRouteList->revision() );
+	for ( const ShipRoutePtr route : shipRouteList->getList() ) {
+		signature = s_hashCombine( signature, uint64_t( route.get() ) );
+		signature = s_hashCombine( signature, route->revision() );
 
-	const POINT mapTopLeft = mapOriginInView();
-	int xDrawOrigin, yDrawOrigin;
-	xDrawOrigin = mapTopLeft.x;
-	yDrawOrigin = mapTopLeft.y;
-	if ( 0 < xDrawOrigin ) {
-		xDrawOrigin = (xDrawOrigin % mapSize.cx) - mapSize.cx;
+		if ( !route->isFixed() && !route->isEmptyRoute() ) {
+			const NormalizedPoint& tail = route->metadata().lastPoint;
+			key.liveTailPoint.x = LONG( ::floor( tail.x() * mapSize.cx ) );
+			key.liveTailPoint.y = LONG( ::floor( tail.y() * mapSize.cy ) );
+		}
+	}
+	key.routeSignature = signature;
+
+	return key;
+}
+
+
+void Renderer::render( const Vector& shipVector, double shipVelocity, const Image * shipIcon, const ShipRouteList * shipRouteList )
+{
+	std::unique_ptr<FrameDescription> frame( new FrameDescription() );
+	frame->viewSize = m_viewSize;
+	frame->shipIcon = NULL;
+	m_frameVertexCount = 0;
+	++m_renderedFrameCount;
+
+	// Coming back from being hidden with the map texture released
+	if ( m_resourcesReleased && m_worldMap ) {
+		setWorldMap( m_worldMap );
 	}
-	const int xInitial = xDrawOrigin;	// The leftmost x coordinate of drawing start
-	int drawn = xInitial;
 
-	// Draw world map side by side
-	// (Omit drawing optimization)
-	::glMatrixMode( GL_MODELVIEW );
-	::glLoadIdentity();
-	::glTranslatef( (float)xDrawOrigin, (float)yDrawOrigin, 0 );
-	while ( drawn < m_viewSize.cx ) {
-		// Draw a map
-		renderTexture( *m_worldMapTexture, (float)mapSize.cx, (float)mapSize.cy );
+	// Until a map is set (while it loads at startup), frames only clear the view
+	if ( m_worldMap ) {
+		frame->preview = isPreviewing();
+		frame->captureSnapshot = m_scrollBlitEnabled && !frame->preview;
+		m_lastFrameKey = makeFrameKey( shipVector, shipVelocity, shipIcon, shipRouteList );
+		m_hasLastFrame = true;
+		describeMap( *frame, shipVector, shipIcon, shipRouteList );
+	}
 
-		// Draw one route
-		renderShipRouteList( mapSize.cx, mapSize.cy, shipRouteList );
+	if ( m_speedMeterEnabled ) {
+		frame->speedText = s_speedMeterText( shipVelocity, landfallDistance( shipVector ) );
+	}
 
-		xDrawOrigin += mapSize.cx;
-		drawn += mapSize.cx;
-		::glTranslatef( (float)mapSize.cx, 0.0f, 0.0f );
+	if ( !m_renderThread ) {
+		m_backend->drawFrame( *frame );
+		return;
+	}
+
+	// A frame the render thread has not started yet is replaced, only the latest state matters.
+	// A route layer redraw it carried still has to happen though, the new frame relies on it.
+	::EnterCriticalSection( &m_lock );
+	if ( m_pendingFrame && m_pendingFrame->routeLayerRedraw && !frame->routeLayerRedraw ) {
+		frame->routeLayerRedraw = true;
+		frame->routeLayerBatches.swap( m_pendingFrame->routeLayerBatches );
+	}
+	m_pendingFrame = std::move( frame );
+	::ResetEvent( m_idleEvent );
+	::LeaveCriticalSection( &m_lock );
+	::SetEvent( m_wakeEvent );
+}
+
+
+void Renderer::waitForIdle()
+{
+	if ( m_renderThread ) {
+		::WaitForSingleObject( m_idleEvent, INFINITE );
+	}
+}
+
+
+void Renderer::describeMap( FrameDescription& frame, const Vector& shipVector, const Image * shipIcon, const ShipRouteList * shipRouteList )
+{
+	// Every wrapped copy of the world is handled in a single pass:
+	// the map is one quad with repeating texture coordinates, and each line segment is
+	// emitted only for the copies in which it is actually visible.
+	const MapLayout layout = mapLayout();
+	frame.layout = layout;
+
+	// A preview shows the routes and the course line of the last full frame
+	if ( !frame.preview ) {
+		describeCoastline( frame, layout );
+		describeRoutes( frame, shipRouteList );
 	}
 
 
@@ -278,237 +635,351 @@ void Renderer::renderMap( const Vector& shipVector, Texture * shipTexture, const
 	const POINT shipPointOffset = drawOffsetFromWorldCoord( m_shipPointInWorld );
 
 	// Draw a course prediction line
-	if ( shipVector.length() != 0.0 && m_shipVectorLineEnabled ) {
-		const float lineWidth = max<float>( 1, float( 1 * m_viewScale ) );
-		::glLineWidth( lineWidth );
-		::glColor3f( 255, 0, 255 );
+	if ( !frame.preview && shipVector.length() != 0.0 && m_shipVectorLineEnabled ) {
+		LineBatch course = { { 1.0f, 0.0f, 1.0f, 1.0f }, max<float>( 1, float( 1 * m_viewScale ) ), false };
 
-		const LONG k_lineLength = k_worldHeight;
+		// The line stops at the coast when the course reaches one
+		const double landfall = landfallDistance( shipVector );
+		const LONG lineLength = 0.0 <= landfall ? LONG( landfall ) : k_worldHeight;
 		const POINT reachPointOffset = drawOffsetFromWorldCoord(
-			shipVector.pointFromOriginWithLength( m_shipPointInWorld, k_lineLength )
+			shipVector.pointFromOriginWithLength( m_shipPointInWorld, lineLength )
 			);
 
-		// Draw as much as the visible map image
-		drawn = xInitial;
-		xDrawOrigin = xInitial;
-		::glMatrixMode( GL_MODELVIEW );
-		::glLoadIdentity();
-		::glTranslatef( (float)xDrawOrigin, (float)yDrawOrigin, 0 );
-		while ( drawn < m_viewSize.cx ) {
-			::glBegin( GL_LINES );
-			::glVertex2i( shipPointOffset.x, shipPointOffset.y );
-			::glVertex2i( reachPointOffset.x, reachPointOffset.y );
-			::glEnd();
-
-			xDrawOrigin += mapSize.cx;
-			drawn += mapSize.cx;
-			::glTranslatef( (float)mapSize.cx, 0.0f, 0.0f );
+		appendWrappedSegment( course.vertices, layout,
+			(float)shipPointOffset.x, (float)shipPointOffset.y,
+			(float)reachPointOffset.x, (float)reachPointOffset.y );
+		if ( !course.vertices.empty() ) {
+			m_frameVertexCount += course.vertices.size() / 2;
+			frame.lineBatches.push_back( std::move( course ) );
 		}
 	}
 
 
 	// Draw the position of own ship
-	if ( shipTexture ) {
-		const float shipMarkSize = 16.0f;
-
-		// Draw as much as the visible map image
-		drawn = xInitial;
-		xDrawOrigin = xInitial;
-		::glMatrixMode( GL_MODELVIEW );
-		::glLoadIdentity();
-		::glLineWidth( 1.0f );
-		::glTranslatef( (float)xDrawOrigin, (float)yDrawOrigin, 0 );
-		while ( drawn < m_viewSize.cx ) {
-			const float x = shipPointOffset.x - shipMarkSize / 2.0f;
-			const float y = shipPointOffset.y - shipMarkSize / 2.0f;
-
-			::glEnable( GL_BLEND );
-			::glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
-			::glColor4f( 1.0f, 1.0f, 1.0f, 1.0f );
-			renderTexture( *shipTexture, x, y, shipMarkSize, shipMarkSize );
-			::glDisable( GL_BLEND );
-
-			xDrawOrigin += mapSize.cx;
-			drawn += mapSize.cx;
-			::glTranslatef( (float)mapSize.cx, 0.0f, 0.0f );
+	if ( shipIcon ) {
+		const float shipMarkSize = FrameDescription::k_shipMarkSize;
+		const float x = shipPointOffset.x - shipMarkSize / 2.0f;
+		const float y = layout.y + shipPointOffset.y - shipMarkSize / 2.0f;
+
+		int first = 0, last = -1;
+		visibleCopyRange( layout, x, x + shipMarkSize, first, last );
+
+		frame.shipIcon = shipIcon;
+		for ( int k = first; k <= last; ++k ) {
+			const POINT marker = { LONG( layout.x + k * layout.width + x ), LONG( y ) };
+			frame.shipMarkers.push_back( marker );
 		}
 	}
 }
 
 
-void Renderer::renderShipRouteList( int width, int height, const ShipRouteList * shipRouteList )
+void Renderer::describeRoutes( FrameDescription& frame, const ShipRouteList * shipRouteList )
 {
-	_ASSERT( 0 <= width );
-	_ASSERT( 0 <= height );
+	frame.routeLayerEnabled = false;
+	frame.routeLayerRedraw = false;
+
+	// Meshes of deleted routes are not needed anymore
+	m_routeMeshCache.prune();
+
+	const SIZE layerSize = { m_viewSize.cx + 2 * k_routeLayerMargin, m_viewSize.cy + 2 * k_routeLayerMargin };
+	if ( !m_capabilities.routeLayer || !m_capabilities.canAllocateLayer( layerSize ) ) {
+		describeShipRouteList( frame.lineBatches, frame.layout, shipRouteList, k_allRoutes );
+		return;
+	}
+
+	// Fixed routes only change when the list is edited, so they are drawn once into a layer
+	// a little larger than the view and composited as one quad. The layer is redrawn when
+	// the list or the zoom changes, or when the view leaves it.
+	const RouteLayerKey key = makeRouteLayerKey( shipRouteList );
+	POINT origin;
+	if ( !m_hasRouteLayer || !(key == m_routeLayerKey) || !routeLayerOrigin( frame.layout, origin ) ) {
+		const LONG mapWidth = LONG( frame.layout.width );
+		m_routeLayerSize = layerSize;
+		m_routeLayerPosition.x = (-k_routeLayerMargin - LONG( frame.layout.x )) % mapWidth;
+		if ( m_routeLayerPosition.x < 0 ) {
+			m_routeLayerPosition.x += mapWidth;
+		}
+		m_routeLayerPosition.y = -k_routeLayerMargin - LONG( frame.layout.y );
+		m_routeLayerKey = key;
+		m_hasRouteLayer = true;
+
+		const MapLayout layerLayout = {
+			-(float)m_routeLayerPosition.x,
+			-(float)m_routeLayerPosition.y,
+			frame.layout.width,
+			frame.layout.height,
+			(float)m_routeLayerSize.cx,
+			(float)m_routeLayerSize.cy
+		};
+		describeShipRouteList( frame.routeLayerBatches, layerLayout, shipRouteList, k_staticRoutes );
+		frame.routeLayerRedraw = true;
+
+		const bool covered = routeLayerOrigin( frame.layout, origin );
+		_ASSERT( covered );
+		(void)covered;
+	}
+
+	frame.routeLayerEnabled = true;
+	frame.routeLayerSize = m_routeLayerSize;
+	frame.routeLayerOrigin = origin;
+
+	// The route being sailed grows with every poll and is drawn every frame
+	describeShipRouteList( frame.lineBatches, frame.layout, shipRouteList, k_liveRoutes );
+}
+
+
+void Renderer::describeMapTile( FrameDescription& frame, double viewScale, const SIZE& mapSize, const RECT& tile, const ShipRouteList * shipRouteList, bool favoritesOnly )
+{
+	// Line widths and route simplification follow the zoom level like on screen
+	m_viewScale = viewScale;
+	m_frameVertexCount = 0;
+
+	frame.viewSize.cx = tile.right - tile.left;
+	frame.viewSize.cy = tile.bottom - tile.top;
+	const MapLayout layout = {
+		-(float)tile.left,
+		-(float)tile.top,
+		(float)mapSize.cx,
+		(float)mapSize.cy,
+		(float)frame.viewSize.cx,
+		(float)frame.viewSize.cy
+	};
+	frame.layout = layout;
+	frame.routeLayerEnabled = false;
+	frame.routeLayerRedraw = false;
+	frame.preview = false;
+	frame.captureSnapshot = false;
+	frame.shipIcon = NULL;
+
+	describeShipRouteList( frame.lineBatches, layout, shipRouteList, favoritesOnly ? k_favoriteRoutes : k_allRoutes );
+}
+
+
+Renderer::RouteLayerKey Renderer::makeRouteLayerKey( const ShipRouteList * shipRouteList ) const
+{
+	RouteLayerKey key = {};
+	key.viewScale = m_viewScale;
+	key.routeLod = m_routeLodEnabled;
+
+	// The list revision covers routes being added, removed or reordered
+	uint64_t signature = s_hashCombine( k_hashSeed, shipRouteList->revision() );
+	for ( const ShipRoutePtr route : shipRouteList->getList() ) {
+		if ( route->isFixed() ) {
+			signature = s_hashCombine( signature, uint64_t( route.get() ) );
+			signature = s_hashCombine( signature, route->revision() );
+		}
+	}
+	key.routeSignature = signature;
+
+	return key;
+}
+
+
+bool Renderer::routeLayerOrigin( const MapLayout& layout, POINT& origin ) const
+{
+	// The layer repeats with the map; take the copy starting at or left of the view's left edge
+	const LONG mapWidth = LONG( layout.width );
+	LONG left = (LONG( layout.x ) + m_routeLayerPosition.x) % mapWidth;
+	if ( 0 < left ) {
+		left -= mapWidth;
+	}
+	const LONG top = LONG( layout.y ) + m_routeLayerPosition.y;
+	origin.x = left;
+	origin.y = top;
+
+	// Only the rows of the view showing the map have to be covered
+	const LONG visibleTop = max<LONG>( 0, LONG( layout.y ) );
+	const LONG visibleBottom = min<LONG>( m_viewSize.cy, LONG( layout.y + layout.height ) );
+	return m_viewSize.cx <= left + m_routeLayerSize.cx
+		&& top <= visibleTop
+		&& visibleBottom <= top + m_routeLayerSize.cy;
+}
+
+
+void Renderer::describeShipRouteList( std::vector<LineBatch>& batches, const MapLayout& layout, const ShipRouteList * shipRouteList, RouteSet routeSet )
+{
+	_ASSERT( 0 < layout.width );
+	_ASSERT( 0 < layout.height );
 	_ASSERT(shipRouteList != NULL);
 
 	// TODO: Taco code
 
 	const float lineWidth = max<float>( 1, float( 1 * m_viewScale ) );
 	const float hilightLineWidth = lineWidth * 1.5f;
-	::glLineWidth( lineWidth );
+
+	// World coordinates covered by one pixel at this zoom decide which simplified level is good enough
+	const double lodTolerance = m_routeLodEnabled ? k_lodPixelTolerance * k_worldWidth / layout.width : 0.0;
+
+	// Whether a route belongs to the set being described
+	auto isInSet = [routeSet]( const ShipRoutePtr& route ) {
+		if ( routeSet == k_favoriteRoutes ) {
+			return route->isFavorite();
+		}
+		return routeSet == k_allRoutes || (routeSet == k_liveRoutes) == !route->isFixed();
+	};
+
+	// The GL state each batch is drawn with, changed in the same order the passes used to change it
+	LineBatch state = { { 1.0f, 1.0f, 1.0f, 1.0f }, lineWidth, false };
 	// Draw translucency other than the latest route
 	if ( 1 < shipRouteList->getList().size() ) {
-		::glEnable( GL_BLEND );
-		::glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
-		::glColor4f( 1.0f, 1.0f, 1.0f, 0.5f );
+		state.blend = true;
 	}
 
 	// Drawing a route that is neither favorite nor highlight
-	::glLineWidth( lineWidth );
-	::glColor4f( 1.0f, 1.0f, 1.0f, 0.5f );
+	s_setColor( state, 1.0f, 1.0f, 1.0f, 0.5f );
 	for ( const ShipRoutePtr route : shipRouteList->getList() ) {
-		if ( route->isFavorite() || route->isHilight() ) {
+		if ( !isInSet( route ) || route->isFavorite() || route->isHilight() ) {
 			continue;
 		}
 		// Drawing only the latest route opaque
 		if ( shipRouteList->getList().back() == route ) {
-			::glLineWidth( lineWidth );
-			::glColor3f( 1.0f, 1.0f, 1.0f );
-			::glDisable( GL_BLEND );
+			state.width = lineWidth;
+			s_setColor( state, 1.0f, 1.0f, 1.0f, 1.0f );
+			state.blend = false;
 		}
-
-		if ( route->isFavorite() ) {
-			::glColor4f( 1.0f, 1.0f, 0.0f, 0.75f );
-			if ( route->isHilight() ) {
-				::glLineWidth( hilightLineWidth );
-			}
-		}
-		renderLines( route, (float)width, (float)height );
+		describeLines( batches, layout, state, route, lodTolerance );
 	}
 
 	// Draw a favorite route
-	::glColor4f( 1.0f, 1.0f, 0.0f, 0.75f );
-	::glEnable( GL_BLEND );
+	s_setColor( state, 1.0f, 1.0f, 0.0f, 0.75f );
+	state.blend = true;
 	for ( const ShipRoutePtr route : shipRouteList->getList() ) {
-		if ( !route->isFavorite() || route->isHilight() ) {
+		if ( !isInSet( route ) || !route->isFavorite() || route->isHilight() ) {
 			continue;
 		}
 
 		// Drawing only the latest route opaque
 		if ( shipRouteList->getList().back() == route ) {
-			::glDisable( GL_BLEND );
-		}
-
-		if ( route->isHilight() ) {
-			::glLineWidth( hilightLineWidth );
+			state.blend = false;
 		}
-		renderLines( route, (float)width, (float)height );
+		describeLines( batches, layout, state, route, lodTolerance );
 	}
 
 	// Show highlight route
-	::glEnable( GL_BLEND );
-	::glLineWidth( hilightLineWidth );
+	state.blend = true;
+	state.width = hilightLineWidth;
 	for ( const ShipRoutePtr route : shipRouteList->getList() ) {
-		if ( !route->isHilight() ) {
+		if ( !isInSet( route ) || !route->isHilight() ) {
 			continue;
 		}
 
 		if ( route->isFavorite() ) {
-			::glColor4f( 1.0f, 1.0f, 0.0f, 0.75f );
+			s_setColor( state, 1.0f, 1.0f, 0.0f, 0.75f );
 		}
 		else {
-			::glColor4f( 0.5f, 1.0f, 1.0f, 0.75f );
+			s_setColor( state, 0.5f, 1.0f, 1.0f, 0.75f );
 		}
 
 		// Drawing only the latest route opaque
 		if ( shipRouteList->getList().back() == route ) {
-			::glDisable( GL_BLEND );
+			state.blend = false;
 		}
 
-		renderLines( route, (float)width, (float)height );
+		describeLines( batches, layout, state, route, lodTolerance );
 	}
-
-	::glDisable( GL_BLEND );
 }
 
 
-void Renderer::renderSpeedMeter( double shipVelocity )
+void Renderer::describeLines( std::vector<LineBatch>& batches, const MapLayout& layout, const LineBatch& state, const ShipRoutePtr shipRoute, double lodTolerance )
 {
-	// THE Hand creation texture creation
-
-	HDC hdcMem = ::CreateCompatibleDC( m_hdcPrimary );
-	::SaveDC( hdcMem );
-
-	const double velocity = s_velocityByKnot( shipVelocity );
-	wchar_t buf[4096] = { 0 };
-	swprintf( buf, _countof( buf ), L"%.2f kt", velocity );
-
-	RECT rc = { 0 };
-	::DrawText( hdcMem, buf, -1, &rc, DT_SINGLELINE | DT_RIGHT | DT_TOP | DT_CALCRECT );
-	const int width = rc.right - rc.left;
-	const int stride = width + (4 - width % 4) % 4;
-	const int height = rc.bottom - rc.top;
-	Image workImage;
-	workImage.createImage( stride, height );
-	::SelectObject( hdcMem, workImage.bitmapHandle() );
-	::DrawText( hdcMem, buf, -1, &rc, DT_SINGLELINE | DT_RIGHT | DT_TOP );
-	::RestoreDC( hdcMem, -1 );
-	::DeleteDC( hdcMem );
-
-	Texture workTexture;
-	workTexture.setImage( workImage );
-
-	::glMatrixMode( GL_MODELVIEW );
-	::glLoadIdentity();
-	renderTexture( workTexture, float( m_viewSize.cx - stride ), 0.0f, (float)stride, (float)height );
-}
+	// A route whose bounding box misses the surface is skipped before its meshes are built or its points decoded
+	const ShipRoute::Metadata& metadata = shipRoute->metadata();
+	if ( metadata.pointCount == 0 ) {
+		return;
+	}
+	const float reach = state.width;
+	if ( layout.clipHeight + k_cullMargin < layout.y + metadata.top * layout.height - reach
+		|| layout.y + metadata.bottom * layout.height + reach < -k_cullMargin ) {
+		return;
+	}
+	int firstCopy, lastCopy;
+	if ( !visibleCopyRange( layout, metadata.west * layout.width - reach, (metadata.west + metadata.span) * layout.width + reach, firstCopy, lastCopy ) ) {
+		return;
+	}
 
+	LineBatch batch = state;
+	// An unblended batch is opaque; only the antialiased edges of its meshes blend
+	if ( !batch.blend ) {
+		batch.color[3] = 1.0f;
+	}
+	const RouteMeshCache::Key key = { layout.width, layout.height, batch.width, lodTolerance };
+	for ( const std::shared_ptr<const LineMesh>& mesh : m_routeMeshCache.meshes( shipRoute, key ) ) {
+		// The world does not wrap vertically, so a mesh above or below the surface is never visible
+		if ( layout.clipHeight + k_cullMargin < layout.y + mesh->minY || layout.y + mesh->maxY < -k_cullMargin ) {
+			continue;
+		}
 
-void Renderer::renderLines( const ShipRoutePtr shipRoute, float mapWidth, float mapHeight )
-{
-	for ( const ShipRoute::Line & line : shipRoute->getLines() ) {
-		if ( line.size() < 2 ) {
-			// Can not draw a line with less than 2 points
+		int first, last;
+		if ( !visibleCopyRange( layout, mesh->minX, mesh->maxX, first, last ) ) {
 			continue;
 		}
-		::glBegin( GL_LINE_STRIP );
-		for ( const NormalizedPoint & point : line ) {
-			const float x = point.x() * mapWidth;
-			const float y = point.y() * mapHeight;
-			::glVertex2f( x, y );
+		for ( int k = first; k <= last; ++k ) {
+			const MeshDraw draw = { mesh, layout.x + k * layout.width, layout.y };
+			batch.meshes.push_back( draw );
+			m_frameVertexCount += mesh->coverage.size();
 		}
-		::glEnd();
 	}
-}
 
-
-void Renderer::renderTexture( Texture & texture, float w, float h )
-{
-	renderTexture( texture, 0, 0, w, h );
+	if ( !batch.meshes.empty() ) {
+		batches.push_back( std::move( batch ) );
+	}
 }
 
-void Renderer::renderTexture( Texture & texture, float x, float y, float w, float h )
-{
-	texture.bind();
-
-	::glBegin( GL_QUADS );
-
-	::glTexCoord2d( 0, 0 );
-	::glVertex2d( x, y );
-
-	::glTexCoord2d( 0, 1 );
-	::glVertex2d( x, y + h );
 
-	::glTexCoord2d( 1, 1 );
-	::glVertex2d( x + w, y + h );
-
-	::glTexCoord2d( 1, 0 );
-	::glVertex2d( x + w, y );
-
-	::glEnd();
-
-	texture.unbind();
+void Renderer::describeCoastline( FrameDescription& frame, const MapLayout& layout )
+{
+	if ( m_viewScale < k_coastlineMinScale || !m_worldMap || m_worldMap->coastline().empty() ) {
+		return;
+	}
+	const Coastline& coastline = m_worldMap->coastline();
+
+	// The visible part of the world, which may run past the right edge of the first copy
+	const float worldPerPixelX = k_worldWidth / layout.width;
+	const float worldPerPixelY = k_worldHeight / layout.height;
+	std::vector<uint32_t> segments;
+	coastline.segmentsInRect(
+		(-k_cullMargin - layout.x) * worldPerPixelX,
+		(-k_cullMargin - layout.y) * worldPerPixelY,
+		(layout.clipWidth + k_cullMargin - layout.x) * worldPerPixelX,
+		(layout.clipHeight + k_cullMargin - layout.y) * worldPerPixelY,
+		segments );
+
+	LineBatch coast = { { 0.25f, 0.2f, 0.15f, 1.0f }, 1.0f, false };
+	for ( uint32_t segment : segments ) {
+		const Coastline::Point& from = coastline.segmentBegin( segment );
+		const Coastline::Point& to = coastline.segmentEnd( segment );
+		appendWrappedSegment( coast.vertices, layout,
+			from.x / worldPerPixelX, from.y / worldPerPixelY,
+			to.x / worldPerPixelX, to.y / worldPerPixelY );
+	}
+	if ( !coast.vertices.empty() ) {
+		m_frameVertexCount += coast.vertices.size() / 2;
+		frame.lineBatches.push_back( std::move( coast ) );
+	}
 }
 
 
-Texture * Renderer::createTextureFromImage( const Image & image )
+void Renderer::appendWrappedSegment( std::vector<float>& vertices, const MapLayout& layout, float x1, float y1, float x2, float y2 ) const
 {
-	::wglMakeCurrent( m_hdcPrimary, m_hglrc );
-	std::auto_ptr<Texture> texture( new Texture() );
-	texture->setImage( image );
-	::glFlush();
-	::wglMakeCurrent( NULL, NULL );
+	// The world does not wrap vertically, so a segment above or below the surface is never visible
+	const float top = layout.y + min( y1, y2 );
+	const float bottom = layout.y + max( y1, y2 );
+	if ( layout.clipHeight + k_cullMargin < top || bottom < -k_cullMargin ) {
+		return;
+	}
 
-	return texture.release();
+	int first, last;
+	if ( !visibleCopyRange( layout, min( x1, x2 ), max( x1, x2 ), first, last ) ) {
+		return;
+	}
+
+	const float y1InView = layout.y + y1;
+	const float y2InView = layout.y + y2;
+	for ( int k = first; k <= last; ++k ) {
+		const float xOffset = layout.x + k * layout.width;
+		vertices.push_back( x1 + xOffset );
+		vertices.push_back( y1InView );
+		vertices.push_back( x2 + xOffset );
+		vertices.push_back( y2InView );
+	}
 }
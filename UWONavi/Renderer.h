@@ -5,51 +5,175 @@
 #include "Vector.h"       // For vector operations, like ship direction
 #include "Image.h"        // For image manipulation (loading textures)
 #include "ShipRoute.h"    // For ship routes and related operations
+#include "ShipMotion.h"   // For the ship position between telemetry samples
+#include "RenderBackend.h" // For the backend drawing frame descriptions
+#include "RouteMeshCache.h" // For route lines tessellated once per zoom level
+#include <string>         // For the speed meter text
+#include <functional>     // For work handed to the render thread
+#include <memory>         // For owning the backend
 
 class Config;            // Forward declaration for Config class
 class WorldMap;         // Forward declaration for WorldMap class
-class Texture;          // Forward declaration for Texture class
 class ShipRouteList;    // Forward declaration for ShipRouteList class
 
 // Renderer is responsible for rendering the world map, ship position, routes, and overlays.
+// The UI thread describes each frame (view transform, ship state, route geometry) and hands the
+// description to a dedicated render thread, which draws it with a RenderBackend: OpenGL into the
+// window, or a software framebuffer when running headless.
 class Renderer : private Noncopyable {
 private:
-    // Private member variables for rendering and map management
+    // Which routes of the list a pass describes
+    enum RouteSet {
+        k_allRoutes,        //!< Every route
+        k_staticRoutes,     //!< Fixed routes, which only change when the list is edited
+        k_liveRoutes,       //!< The route being sailed
+        k_favoriteRoutes,   //!< Routes marked as favorite
+    };
+
+    // Everything the route layer's contents depend on; the layer is redrawn when it changes
+    struct RouteLayerKey {
+        double viewScale;           //!< Zoom level
+        bool routeLod;              //!< Whether routes are drawn from their simplified levels
+        uint64_t routeSignature;    //!< Combined revisions of the route list and its fixed routes
+
+        bool operator==(const RouteLayerKey& rhs) const;
+    };
+
+    // Everything that decides what a frame looks like on screen, in pixels where it applies.
+    // Two frames with equal keys are identical, so the second one does not have to be drawn.
+    struct FrameKey {
+        SIZE viewSize;              //!< Size of the view
+        double viewScale;           //!< Zoom level
+        POINT mapOrigin;            //!< Top-left of the map in view coordinates
+        POINT shipPoint;            //!< Ship marker in map pixels ({-1, -1} when unknown)
+        POINT courseEnd;            //!< End of the course line in map pixels ({0, 0} when hidden)
+        const Image* shipIcon;      //!< Ship marker image (NULL until the icon is captured)
+        std::wstring speedText;     //!< Speed meter text (empty when hidden)
+        uint64_t routeSignature;    //!< Combined revisions of the route list and its routes
+        POINT liveTailPoint;        //!< Tail of the route being sailed in map pixels
+        bool preview;               //!< Whether the frame is a preview made from the last full frame
+
+        bool operator==(const FrameKey& rhs) const;
+    };
+
+    // A call run on the render thread, which the UI thread may wait for
+    struct RenderTask {
+        std::function<void()> function; //!< Work to run with the context current
+        HANDLE doneEvent;               //!< Signaled once the work has run (NULL if nobody waits)
+    };
+
+    // State owned by the UI thread
     const WorldMap* m_worldMap;            //!< World map object
-    Texture* m_worldMapTexture;            //!< Texture for the world map
-    HDC m_hdcPrimary;                         //!< Handle to the primary device context
-    HGLRC m_hglrc;                            //!< Handle to the OpenGL rendering context
     SIZE m_viewSize;                          //!< Size of the rendering window
     double m_viewScale;                       //!< Current zoom level of the map
     POINT m_focusPointInWorldCoord;           //!< World coordinates of the center of the view
     POINT m_shipPointInWorld;                 //!< Position of the ship in world coordinates
+    ShipMotion m_shipMotion;                  //!< Predicts the ship position between telemetry samples
+    bool m_hasLandfall;                       //!< Whether the course of the ship reaches land
+    POINT m_landfallInWorld;                  //!< Where the course of the ship reaches land, in world coordinates
     bool m_shipVectorLineEnabled;             //!< Flag to control ship vector line rendering
     bool m_speedMeterEnabled;                 //!< Flag to control speedometer rendering
     bool m_traceShipEnabled;                  //!< Flag to control ship position tracking
+    bool m_routeLodEnabled;                   //!< Flag to draw routes from their simplified levels
+    bool m_scrollBlitEnabled;                 //!< Flag to preview pan and zoom from the last full frame
+    bool m_interactive;                       //!< Whether the user is panning or zooming right now
+    size_t m_frameVertexCount;                //!< Line vertices submitted during the last frame
+    FrameKey m_lastFrameKey;                  //!< Key of the last frame drawn
+    bool m_hasLastFrame;                      //!< Whether m_lastFrameKey is valid
+    size_t m_renderedFrameCount;              //!< Frames drawn so far
+    size_t m_skippedFrameCount;               //!< Frames skipped because nothing changed on screen
+    RenderBackend::Capabilities m_capabilities; //!< What the backend supports (queried once it is set up)
+    bool m_hasRouteLayer;                     //!< Whether the route layer has been described
+    RouteLayerKey m_routeLayerKey;            //!< What the route layer was described for
+    POINT m_routeLayerPosition;               //!< Top-left of the route layer in map pixels (x within one copy)
+    SIZE m_routeLayerSize;                    //!< Size of the route layer
+    RouteMeshCache m_routeMeshCache;          //!< Tessellated route lines (UI thread)
+    bool m_resourcesReleased;                 //!< Whether the backend released the map texture (uploaded again by the next frame)
+
+    // State owned by the render thread
+    std::unique_ptr<RenderBackend> m_backend; //!< Draws the frames (created by setup, used only on the render thread)
+
+    // Shared between the threads; the queue is guarded by m_lock
+    HANDLE m_renderThread;                    //!< Thread owning the backend (NULL if it could not be started: the UI thread owns it)
+    HANDLE m_threadQuitSignal;                //!< Signal to stop the render thread
+    HANDLE m_wakeEvent;                       //!< Signaled when a frame or a task is queued
+    HANDLE m_idleEvent;                       //!< Signaled while no frame is queued or being drawn
+    CRITICAL_SECTION m_lock;                  //!< Critical section for the queue below
+    std::unique_ptr<FrameDescription> m_pendingFrame; //!< Latest frame not yet drawn (older ones are dropped)
+    std::vector<RenderTask> m_tasks;          //!< Calls waiting to run on the render thread
 
 public:
     // Constructor: Initializes all member variables with default values
     Renderer() :
-        m_hdcPrimary(),
+        m_worldMap(),
         m_viewSize(),
         m_viewScale(1.0),
         m_focusPointInWorldCoord(),
         m_shipPointInWorld(),
+        m_shipMotion(),
+        m_hasLandfall(false),
+        m_landfallInWorld(),
         m_shipVectorLineEnabled(true),
         m_speedMeterEnabled(true),
-        m_traceShipEnabled(true)
+        m_traceShipEnabled(true),
+        m_routeLodEnabled(true),
+        m_scrollBlitEnabled(true),
+        m_interactive(false),
+        m_frameVertexCount(),
+        m_lastFrameKey(),
+        m_hasLastFrame(false),
+        m_renderedFrameCount(),
+        m_skippedFrameCount(),
+        m_capabilities(),
+        m_hasRouteLayer(false),
+        m_routeLayerKey(),
+        m_routeLayerPosition(),
+        m_routeLayerSize(),
+        m_routeMeshCache(),
+        m_resourcesReleased(false),
+        m_backend(),
+        m_renderThread(),
+        m_threadQuitSignal(),
+        m_wakeEvent(::CreateEvent(NULL, FALSE, FALSE, NULL)),
+        m_idleEvent(::CreateEvent(NULL, TRUE, TRUE, NULL))
     {
+        ::InitializeCriticalSection(&m_lock);
     }
 
-    // Destructor: Currently empty, but can be extended for cleanup
-    ~Renderer() {}
+    // Destructor: releases the synchronization objects (teardown() stops the thread)
+    ~Renderer()
+    {
+        ::CloseHandle(m_idleEvent);
+        ::CloseHandle(m_wakeEvent);
+        ::DeleteCriticalSection(&m_lock);
+    }
 
-    // Setup the renderer with config, primary device context, and world map
+    // Setup the renderer with config, primary device context, and world map, and start the render thread.
+    // Frames are drawn with OpenGL into the window of the device context. The map may be NULL while it
+    // is still loading; frames then only clear the view until setWorldMap.
     void setup(const Config* config, HDC hdcPrimary, const WorldMap* worldMap);
 
-    // Clean up resources, including OpenGL context and textures
+    // Setup the renderer to draw with a given backend (e.g. headless), and start the render thread
+    void setup(const Config* config, std::unique_ptr<RenderBackend> backend, const WorldMap* worldMap);
+
+    // Stop the render thread and clean up resources, including the backend
     void teardown();
 
+    // Draw another world map (a map layer) from now on; the caller keeps it alive until teardown.
+    // Quick when its texture was prefetched or shown recently, otherwise it is uploaded first.
+    void setWorldMap(const WorldMap* worldMap);
+
+    // Get the world map drawn (NULL until one is set)
+    const WorldMap* worldMap() const { return m_worldMap; }
+
+    // Start uploading the texture of a world map likely to be set soon, without waiting for it.
+    // The caller keeps the map alive until teardown.
+    void prefetchWorldMap(const WorldMap* worldMap);
+
+    // Release the large GPU resources (map textures, route layer, snapshot) while the window cannot be
+    // seen, without waiting for it. The next frame rendered uploads the map drawn again.
+    void releaseResources();
+
     // Set the view size (rendering window size)
     void setViewSize(const SIZE& viewSize);
 
@@ -63,36 +187,82 @@ public:
     // Getter for the current view scale
     inline double viewScale() const { return m_viewScale; }
 
+    // Get the world coordinate shown at a point of the view (x within the world).
+    // Returns false without a map or when the point is above or below the map.
+    bool worldCoordFromViewCoord(const POINT& viewCoord, POINT& worldCoord) const;
+
     // Offset the focus point in the view (for drag functionality)
     void offsetFocusInViewCoord(const POINT& offset);
 
     // Set the position of the ship in world coordinates
     void setShipPositionInWorld(const POINT& shipPositionInWorld);
 
+    // Add a telemetry sample of the ship; from now on the ship is drawn where it is predicted to be
+    void addShipSample(const POINT& shipPositionInWorld, const Vector& shipVector, double shipVelocity, DWORD timeStamp);
+
+    // Move the ship (and the view, when tracing it) to its predicted position at a time.
+    // Returns true while the prediction keeps changing, that is while frames should be drawn at display rate.
+    bool advanceShipMotion(DWORD now);
+
+    // Set where the course of the ship reaches land (traced once per poll), or that it reaches none.
+    // The course line stops there, and the speed meter shows how far it is and how long it takes.
+    void setLandfall(bool hasLandfall, const POINT& landfallInWorld);
+
     // Enable or disable ship position tracking (ship trace)
     void enableTraceShip(bool enabled) { m_traceShipEnabled = enabled; }
 
     // Enable or disable the ship vector line (ship's heading)
     void setVisibleShipRoute(bool visible) { m_shipVectorLineEnabled = visible; }
 
-    // Render the scene: map, ship vector, speed meter, and ship routes
-    void render(const Vector& shipVector, double shipVelocity, Texture* shipTexture, const ShipRouteList* shipRouteList);
+    // Render the scene: map, ship vector, speed meter, and ship routes.
+    // Describes the frame and queues it for the render thread; returns without waiting for it to be drawn.
+    void render(const Vector& shipVector, double shipVelocity, const Image* shipIcon, const ShipRouteList* shipRouteList);
+
+    // Wait until the render thread has drawn every queued frame
+    void waitForIdle();
+
+    // Check whether rendering now would change anything on screen since the last frame drawn.
+    // Returns false, and counts the frame as skipped, when it would be identical.
+    bool checkFrameChanged(const Vector& shipVector, double shipVelocity, const Image* shipIcon, const ShipRouteList* shipRouteList);
+
+    // Frame statistics: frames drawn, and frames skipped by checkFrameChanged
+    size_t renderedFrameCount() const { return m_renderedFrameCount; }
+    size_t skippedFrameCount() const { return m_skippedFrameCount; }
 
     // Enable or disable the speedometer display
     void enableSpeedMeter(bool enabled) { m_speedMeterEnabled = enabled; }
 
-    // Create a texture from an image (for rendering)
-    Texture* createTextureFromImage(const Image& image);
+    // Enable or disable previewing pan and zoom by transforming the last full frame
+    void enableScrollBlit(bool enabled) { m_scrollBlitEnabled = enabled; }
+
+    // Mark the start or the end of panning or zooming. While it lasts, frames are previews made
+    // from the last full frame (with scroll blit enabled); the caller redraws once it ends.
+    void setInteractive(bool interactive) { m_interactive = interactive; }
+
+    // Enable or disable drawing routes from their simplified levels (for comparison)
+    void enableRouteLod(bool enabled) { m_routeLodEnabled = enabled; }
+
+    // Number of line vertices submitted while rendering the last frame
+    size_t frameVertexCount() const { return m_frameVertexCount; }
+
+    // Describe a tile of the whole map at a zoom level: the map and the routes, without the ship or overlays.
+    // The tile is given in pixels of the map scaled to mapSize. Needs no setup; the frame can be drawn by any
+    // backend on any thread, and the view of this renderer is left alone apart from the zoom level (poster export).
+    void describeMapTile(FrameDescription& frame, double viewScale, const SIZE& mapSize, const RECT& tile, const ShipRouteList* shipRouteList, bool favoritesOnly);
 
 private:
     // Initialize configuration settings (like initial survey coordinates)
     void setConfig(const Config* config);
 
-    // Initialize OpenGL context and settings
-    void setupGL();
+    // Run a call on the render thread and wait until it is done (run right away without a render thread)
+    void runOnRenderThread(const std::function<void()>& function);
 
-    // Set the world map for rendering (apply texture)
-    void setWorldMap(const WorldMap* worldMap);
+    // Queue a call for the render thread without waiting for it (run right away without a render thread)
+    void postToRenderThread(const std::function<void()>& function);
+
+    // Render thread entry point and main loop
+    static UINT CALLBACK threadMainThunk(LPVOID arg);
+    void threadMain();
 
     // Get the size of the scaled map based on the current view scale
     SIZE scaledMapSize() const;
@@ -100,24 +270,49 @@ private:
     // Get the origin (top-left corner) of the map in view coordinates
     POINT mapOriginInView() const;
 
+    // Get the placement of the leftmost wrapped copy of the map for this frame
+    MapLayout mapLayout() const;
+
+    // Get the range of wrapped copies in which a horizontal span [minX, maxX] of the map is visible.
+    // Returns false if the span is not visible in any copy.
+    bool visibleCopyRange(const MapLayout& layout, float minX, float maxX, int& first, int& last) const;
+
     // Calculate the drawing offset in view coordinates based on world coordinates
     POINT drawOffsetFromWorldCoord(const POINT& worldCoord) const;
 
-    // Render the world map and associated elements
-    void renderMap(const Vector& shipVector, Texture* shipTexture, const ShipRouteList* shipRouteList);
+    // Whether frames are currently previews made from the last full frame
+    bool isPreviewing() const { return m_interactive && m_scrollBlitEnabled; }
+
+    // Build the key describing what a frame with this state would show
+    FrameKey makeFrameKey(const Vector& shipVector, double shipVelocity, const Image* shipIcon, const ShipRouteList* shipRouteList) const;
+
+    // Distance from the ship to where its course reaches land, along the course (negative without landfall)
+    double landfallDistance(const Vector& shipVector) const;
+
+    // Describe the map, routes, course line and ship marker of a frame (UI thread)
+    void describeMap(FrameDescription& frame, const Vector& shipVector, const Image* shipIcon, const ShipRouteList* shipRouteList);
+
+    // Describe the routes of a frame: fixed routes through the route layer when possible, the live route directly (UI thread)
+    void describeRoutes(FrameDescription& frame, const ShipRouteList* shipRouteList);
+
+    // Describe the coastline over the map where the map is zoomed in far enough for its pixels to show (UI thread)
+    void describeCoastline(FrameDescription& frame, const MapLayout& layout);
+
+    // Build the key deciding whether the route layer has to be redrawn
+    RouteLayerKey makeRouteLayerKey(const ShipRouteList* shipRouteList) const;
 
-    // Render the list of ship routes
-    void renderShipRouteList(int width, int height, const ShipRouteList* shipRouteList);
+    // Get where the route layer is in the view; returns false if it does not cover the visible part of the map
+    bool routeLayerOrigin(const MapLayout& layout, POINT& origin) const;
 
-    // Render the speedometer with the ship's velocity
-    void renderSpeedMeter(double shipVelocity);
+    // Describe a set of routes of the list as batches placed by layout (UI thread)
+    void describeShipRouteList(std::vector<LineBatch>& batches, const MapLayout& layout, const ShipRouteList* shipRouteList, RouteSet routeSet);
 
-    // Render the individual lines of a ship route
-    void renderLines(const ShipRoutePtr shipRoute, float mapWidth, float mapHeight);
+    // Add the lines of a ship route, simplified as far as lodTolerance (world coordinates) allows, as a batch drawn with state.
+    // The lines are drawn from meshes tessellated for the batch's width, once for each wrapped copy they are visible in.
+    void describeLines(std::vector<LineBatch>& batches, const MapLayout& layout, const LineBatch& state, const ShipRoutePtr shipRoute, double lodTolerance);
 
-    // Render a texture on the screen
-    void renderTexture(Texture& texture, float w, float h);
-    void renderTexture(Texture& texture, float x, float y, float w, float h);
+    // Queue a segment given in map coordinates once for each wrapped copy it is visible in
+    void appendWrappedSegment(std::vector<float>& vertices, const MapLayout& layout, float x1, float y1, float x2, float y2) const;
 
     // Helper function to get the center point of the view
     inline POINT viewCenterPoint() const {
@@ -0,0 +1,209 @@
+#include "stdafx.h"
+#include "RendererBenchmark.h"
+#include "UWONavi.h"
+#include "Config.h"
+#include "WorldMap.h"
+#include "Renderer.h"
+#include "SoftwareRenderBackend.h"
+#include "ShipRouteList.h"
+#include <fstream>
+#include <map>
+#include <random>
+
+namespace {
+    // Frames panned after the first frame of each zoom level; the route layer is reused by most of them
+    const int k_panFrameCount = 8;
+
+    // Pixels the view moves east per panned frame
+    const LONG k_panStep = 24;
+
+    // World coordinates sailed per route point, and the largest turn per point in radians
+    const double k_stepLength = 8.0;
+    const double k_maxTurn = 0.05;
+
+    // The ship sits in the middle of the world heading east-northeast, so the course line crosses the view
+    const POINT k_shipPosition = { k_worldWidth / 2, k_worldHeight / 2 };
+    const double k_shipVelocity = 4.0;
+
+    // Build a deterministic route history: random walks from random starting points
+    void s_buildRoutes(const RendererBenchmark::Scene& scene, ShipRouteList& routes)
+    {
+        std::mt19937 random(1);
+        std::uniform_real_distribution<double> turn(-k_maxTurn, k_maxTurn);
+        std::uniform_real_distribution<double> start(0.0, 1.0);
+        for (int r = 0; r < scene.routeCount; ++r) {
+            double x = start(random) * k_worldWidth;
+            double y = start(random) * k_worldHeight;
+            double heading = start(random) * 2.0 * M_PI;
+            for (int i = 0; i < scene.pointsPerRoute; ++i) {
+                heading += turn(random);
+                x += ::cos(heading) * k_stepLength;
+                y += ::sin(heading) * k_stepLength;
+                if (x < 0.0) {
+                    x += k_worldWidth;
+                }
+                else if (k_worldWidth <= x) {
+                    x -= k_worldWidth;
+                }
+                if (y < 0.0 || k_worldHeight <= y) {
+                    heading = -heading;  // Bounce off the poles
+                    y = max(0.0, min(double(k_worldHeight - 1), y));
+                }
+                routes.addRoutePoint(NormalizedPoint(float(x / k_worldWidth), float(y / k_worldHeight)));
+            }
+            // The last route stays open, like the one being sailed
+            if (r + 1 < scene.routeCount) {
+                routes.closeRoute();
+            }
+        }
+    }
+
+    // Key of a result in the golden file
+    std::string s_goldenKey(const std::string& scene, double viewScale)
+    {
+        char key[128];
+        ::snprintf(key, sizeof(key), "%s@%.3f", scene.c_str(), viewScale);
+        return key;
+    }
+
+    double s_milliseconds(int64_t ticks)
+    {
+        return double(ticks) * 1000.0 / double(g_queryPerformanceFrequency());
+    }
+}
+
+
+// The scenes run by the /benchmark command line switch
+std::vector<RendererBenchmark::Scene> RendererBenchmark::defaultScenes()
+{
+    const Scene scenes[] = {
+        { "sparse", 10, 1000, { 1280, 720 } },
+        { "dense", 200, 1000, { 1280, 720 } },
+        { "long", 4, 50000, { 1280, 720 } },
+        { "wide", 100, 1000, { 5760, 1080 } },
+    };
+    return std::vector<Scene>(scenes, scenes + _countof(scenes));
+}
+
+
+// Render every scene at every zoom level
+void RendererBenchmark::run(const std::vector<Scene>& scenes)
+{
+    const Vector shipVector(2.0, -1.0);
+    for (const Scene& scene : scenes) {
+        ShipRouteList routes;
+        s_buildRoutes(scene, routes);
+
+        // The renderer owns the backend; it is only read while the render thread is idle
+        SoftwareRenderBackend* backend = new SoftwareRenderBackend();
+        Renderer renderer;
+        renderer.setup(m_config, std::unique_ptr<RenderBackend>(backend), m_worldMap);
+        renderer.setViewSize(scene.viewSize);
+        renderer.enableTraceShip(true);
+        renderer.setVisibleShipRoute(true);
+        renderer.enableRouteLod(true);
+        // The software backend draws the text with its own glyphs, so the checksums do not depend on the fonts installed
+        renderer.enableSpeedMeter(true);
+
+        renderer.resetViewScale();
+        while (renderer.zoomOut()) {
+        }
+        for (;;) {
+            Result result = {};
+            result.scene = scene.name;
+            result.viewScale = renderer.viewScale();
+
+            renderer.setShipPositionInWorld(k_shipPosition);
+            int64_t perfBegin = g_queryPerformanceCounter();
+            renderer.render(shipVector, k_shipVelocity, NULL, &routes);
+            renderer.waitForIdle();
+            result.firstFrameTime = s_milliseconds(g_queryPerformanceCounter() - perfBegin);
+
+            const POINT panOffset = { k_panStep, 0 };
+            perfBegin = g_queryPerformanceCounter();
+            for (int i = 0; i < k_panFrameCount; ++i) {
+                renderer.offsetFocusInViewCoord(panOffset);
+                renderer.render(shipVector, k_shipVelocity, NULL, &routes);
+                renderer.waitForIdle();
+            }
+            result.panFrameTime = s_milliseconds(g_queryPerformanceCounter() - perfBegin) / k_panFrameCount;
+            result.vertexCount = renderer.frameVertexCount();
+            result.checksum = backend->frameChecksum();
+            m_results.push_back(result);
+
+            if (!renderer.zoomIn()) {
+                break;
+            }
+        }
+        renderer.teardown();
+    }
+}
+
+
+// Tab separated table of the results
+std::string RendererBenchmark::report() const
+{
+    std::string report = "scene\tscale\tvertices\tfirst ms\tpan ms\tchecksum\n";
+    for (const Result& result : m_results) {
+        char line[256];
+        ::snprintf(line, sizeof(line), "%s\t%.1f%%\t%u\t%.2f\t%.2f\t%016llx\n",
+            result.scene.c_str(),
+            result.viewScale * 100.0,
+            unsigned(result.vertexCount),
+            result.firstFrameTime,
+            result.panFrameTime,
+            (unsigned long long)result.checksum);
+        report += line;
+    }
+    return report;
+}
+
+
+// Compare the checksums with a golden file; without one nothing is checked, which fails
+bool RendererBenchmark::checkGolden(const std::wstring& fileName, std::string& mismatches) const
+{
+    std::ifstream ifs;
+    ifs.open(fileName, std::ios::in);
+    if (!ifs) {
+        mismatches += "golden file missing (record it with /benchmark record)\n";
+        return false;
+    }
+
+    // One "scene@scale checksum" pair per line
+    std::map<std::string, uint64_t> golden;
+    std::string key;
+    std::string checksum;
+    while (ifs >> key >> checksum) {
+        golden[key] = ::strtoull(checksum.c_str(), NULL, 16);
+    }
+
+    bool matched = true;
+    for (const Result& result : m_results) {
+        const std::string resultKey = s_goldenKey(result.scene, result.viewScale);
+        const auto it = golden.find(resultKey);
+        if (it == golden.end()) {
+            mismatches += resultKey + " missing from the golden file\n";
+            matched = false;
+        }
+        else if (it->second != result.checksum) {
+            mismatches += resultKey + " differs from the golden image\n";
+            matched = false;
+        }
+    }
+    return matched;
+}
+
+
+// Write one "scene@scale checksum" pair per line
+bool RendererBenchmark::recordGolden(const std::wstring& fileName) const
+{
+    std::ofstream ofs;
+    ofs.open(fileName, std::ios::out | std::ios::trunc);
+    for (const Result& result : m_results) {
+        char line[256];
+        ::snprintf(line, sizeof(line), "%s %016llx\n", s_goldenKey(result.scene, result.viewScale).c_str(), (unsigned long long)result.checksum);
+        ofs << line;
+    }
+    ofs.close();
+    return bool(ofs);
+}
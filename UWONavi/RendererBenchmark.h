@@ -0,0 +1,73 @@
+#pragma once
+
+#include <Windows.h>      // For SIZE
+#include <cstdint>        // For checksums
+#include <string>         // For scene names and the report
+#include <vector>         // For scenes and results
+
+#include "Noncopyable.h"  // For preventing copying of the benchmark
+
+class Config;
+class WorldMap;
+
+//! @brief Renders scripted scenes headless and reports how long each frame takes.
+//! Every scene is drawn by a Renderer with a SoftwareRenderBackend, so the times cover describing
+//! the frame (wrap-around, culling, route passes) as well as rasterizing it, and no window or
+//! OpenGL context is needed. Each zoom level of a scene ends with a checksum of the frame, which
+//! is compared against a golden file recorded by an earlier run with the same map image.
+class RendererBenchmark : private Noncopyable {
+public:
+    //! @brief A synthetic route history drawn into a view of a given size.
+    struct Scene {
+        std::string name;       //!< Name used in the report and the golden file (no spaces)
+        int routeCount;         //!< Number of routes; all but the last are fixed
+        int pointsPerRoute;     //!< Points of each route
+        SIZE viewSize;          //!< Size of the view drawn to
+    };
+
+    //! @brief Measurements of one scene at one zoom level.
+    struct Result {
+        std::string scene;      //!< Scene name
+        double viewScale;       //!< Zoom level
+        size_t vertexCount;     //!< Line vertices described for the last frame
+        double firstFrameTime;  //!< Milliseconds for the first frame, which also draws the route layer
+        double panFrameTime;    //!< Mean milliseconds of the frames panning afterwards
+        uint64_t checksum;      //!< Checksum of the last frame's pixels
+    };
+
+private:
+    const Config* m_config;         //!< Settings the renderer is set up with
+    const WorldMap* m_worldMap;     //!< Map drawn under the routes
+    std::vector<Result> m_results;  //!< Results of every run so far
+
+public:
+    RendererBenchmark(const Config* config, const WorldMap* worldMap) :
+        m_config(config),
+        m_worldMap(worldMap),
+        m_results()
+    {
+    }
+
+    //! @brief The scenes run by the /benchmark command line switch.
+    //! A few long routes, many short ones, and a view wider than the map at low zoom levels.
+    static std::vector<Scene> defaultScenes();
+
+    //! @brief Render every scene at every zoom level and keep the results.
+    void run(const std::vector<Scene>& scenes);
+
+    //! @brief Results of every run so far.
+    const std::vector<Result>& results() const { return m_results; }
+
+    //! @brief Tab separated table of the results.
+    std::string report() const;
+
+    //! @brief Compare the checksums with a golden file.
+    //! @param fileName Golden file path
+    //! @param mismatches Receives one line per result differing from the golden file, or missing from it
+    //! @return false if any result differs from the golden file or cannot be checked (a missing file fails)
+    bool checkGolden(const std::wstring& fileName, std::string& mismatches) const;
+
+    //! @brief Write the checksums as the golden file, replacing it.
+    //! @return false if the file cannot be written
+    bool recordGolden(const std::wstring& fileName) const;
+};
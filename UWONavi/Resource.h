@@ -64,3 +64,24 @@
 #define IDM_DEBUG_CLOSE_ROUTE                   40020  // Menu option to close a route during debugging
 #define IDM_TOGGLE_FAVORITE                     40021  // Menu option to toggle the route as a favorite
 #define IDM_JOINT_LATEST_ROUTE                  40022  // Menu option to join the latest ship route
+#define IDM_DEBUG_ROUTE_LOD_BENCHMARK           40023  // Menu option to benchmark route LOD vertex counts during debugging
+#define IDM_MAP_LAYER_1                         40024  // Menu option to switch to map layer 1 (layers 2 to 9 follow)
+#define IDM_MAP_LAYER_2                         40025  // Shortcut to switch to map layer 2
+#define IDM_MAP_LAYER_3                         40026  // Shortcut to switch to map layer 3
+#define IDM_MAP_LAYER_4                         40027  // Shortcut to switch to map layer 4
+#define IDM_MAP_LAYER_5                         40028  // Shortcut to switch to map layer 5
+#define IDM_MAP_LAYER_6                         40029  // Shortcut to switch to map layer 6
+#define IDM_MAP_LAYER_7                         40030  // Shortcut to switch to map layer 7
+#define IDM_MAP_LAYER_8                         40031  // Shortcut to switch to map layer 8
+#define IDM_MAP_LAYER_9                         40032  // Shortcut to switch to map layer 9
+#define IDM_PREFETCH_MAP_LAYER_1                40033  // Shortcut to prefetch map layer 1 (layers 2 to 9 follow)
+#define IDM_PREFETCH_MAP_LAYER_2                40034  // Shortcut to prefetch map layer 2
+#define IDM_PREFETCH_MAP_LAYER_3                40035  // Shortcut to prefetch map layer 3
+#define IDM_PREFETCH_MAP_LAYER_4                40036  // Shortcut to prefetch map layer 4
+#define IDM_PREFETCH_MAP_LAYER_5                40037  // Shortcut to prefetch map layer 5
+#define IDM_PREFETCH_MAP_LAYER_6                40038  // Shortcut to prefetch map layer 6
+#define IDM_PREFETCH_MAP_LAYER_7                40039  // Shortcut to prefetch map layer 7
+#define IDM_PREFETCH_MAP_LAYER_8                40040  // Shortcut to prefetch map layer 8
+#define IDM_PREFETCH_MAP_LAYER_9                40041  // Shortcut to prefetch map layer 9
+#define IDM_PLAN_ROUTE_FROM                     40042  // Menu option to start a planned route at the clicked point
+#define IDM_PLAN_ROUTE_TO                       40043  // Menu option to plan a sea route to the clicked point
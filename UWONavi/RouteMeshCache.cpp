@@ -0,0 +1,207 @@
+#include "stdafx.h"
+#include "RouteMeshCache.h"
+#include <limits>
+
+
+namespace {
+	// Longest miter, in half line widths; sharper joins are cut off there
+	const float k_miterLimit = 2.0f;
+
+	// Segments shorter than this (in pixels) have no direction to join with
+	const float k_minSegmentLength = 1.0e-4f;
+
+	// Unit normal to the left of the direction from a to b; false if the points coincide
+	inline bool s_normal( float ax, float ay, float bx, float by, float& nx, float& ny )
+	{
+		const float dx = bx - ax;
+		const float dy = by - ay;
+		const float length = ::sqrt( dx * dx + dy * dy );
+		if ( length < k_minSegmentLength ) {
+			return false;
+		}
+		nx = -dy / length;
+		ny = dx / length;
+		return true;
+	}
+}
+
+
+const RouteMeshCache::Meshes& RouteMeshCache::meshes( const ShipRoutePtr& route, const Key& key )
+{
+	Entry& entry = m_entries[route.get()];
+	if ( entry.route.lock() != route ) {
+		// A new route, possibly at the address of one deleted since
+		entry.route = route;
+		entry.buckets.clear();
+	}
+
+	// Bring the bucket of this key to the front, replacing the least recently used one if it is missing
+	bool found = false;
+	for ( size_t i = 0; i < entry.buckets.size(); ++i ) {
+		if ( entry.buckets[i].key == key ) {
+			std::rotate( entry.buckets.begin(), entry.buckets.begin() + i, entry.buckets.begin() + i + 1 );
+			found = true;
+			break;
+		}
+	}
+	if ( !found ) {
+		if ( k_bucketsPerRoute <= entry.buckets.size() ) {
+			entry.buckets.pop_back();
+		}
+		Bucket bucket = Bucket();
+		bucket.key = key;
+		entry.buckets.insert( entry.buckets.begin(), std::move( bucket ) );
+	}
+
+	Bucket& bucket = entry.buckets.front();
+
+	// A fixed route only changes with its revision; its packed points are decoded only to build meshes
+	if ( found && bucket.revision == route->revision() && route->isFixed() ) {
+		return bucket.meshes;
+	}
+	ShipRoute::Lines decoded;
+	const ShipRoute::Lines& lines = route->getLinesForTolerance( key.lodTolerance, decoded );
+	const size_t tailCount = lines.empty() ? 0 : lines.back().size();
+	const NormalizedPoint tail = tailCount == 0 ? NormalizedPoint() : lines.back().back();
+
+	if ( found && bucket.revision == route->revision() ) {
+		if ( bucket.tailCount == tailCount && bucket.tail.isEqualValue( tail ) ) {
+			return bucket.meshes;
+		}
+
+		// Only the last line grew (or its provisional last point moved); keep the meshes
+		// whose points were all committed and tessellate the rest of the line again.
+		size_t keep = 0;
+		while ( keep < bucket.spans.size() && bucket.spans[keep].complete ) {
+			++keep;
+		}
+		size_t lineIndex = 0;
+		size_t firstPoint = 0;
+		if ( keep < bucket.spans.size() ) {
+			lineIndex = bucket.spans[keep].lineIndex;
+			firstPoint = bucket.spans[keep].firstPoint;
+		}
+		else if ( !bucket.spans.empty() ) {
+			lineIndex = bucket.spans.back().lineIndex + 1;
+		}
+		bucket.meshes.resize( keep );
+		bucket.spans.resize( keep );
+		build( bucket, lines, lineIndex, firstPoint );
+	}
+	else {
+		bucket.meshes.clear();
+		bucket.spans.clear();
+		build( bucket, lines, 0, 0 );
+	}
+
+	bucket.revision = route->revision();
+	bucket.tailCount = tailCount;
+	bucket.tail = tail;
+	return bucket.meshes;
+}
+
+
+void RouteMeshCache::prune()
+{
+	for ( auto it = m_entries.begin(); it != m_entries.end(); ) {
+		if ( it->second.route.expired() ) {
+			it = m_entries.erase( it );
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+
+void RouteMeshCache::build( Bucket& bucket, const ShipRoute::Lines& lines, size_t lineIndex, size_t firstPoint )
+{
+	for ( ; lineIndex < lines.size(); ++lineIndex, firstPoint = 0 ) {
+		const ShipRoute::Line& line = lines[lineIndex];
+		if ( line.size() < firstPoint + 2 ) {
+			continue;
+		}
+
+		// Consecutive meshes share their boundary point, so the line stays continuous
+		const size_t lastIndex = line.size() - 1;
+		const bool lastLine = lineIndex + 1 == lines.size();
+		for ( size_t first = firstPoint; first < lastIndex; ) {
+			const size_t last = min( lastIndex, first + LineMesh::k_maxPoints - 1 );
+			bucket.meshes.push_back( tessellate( bucket.key, line, first, last ) );
+
+			// The join at the last point depends on the next one, and only the last point
+			// of the route's last line may still change
+			const MeshSpan span = { lineIndex, first, !lastLine || last + 2 <= lastIndex };
+			bucket.spans.push_back( span );
+			first = last;
+		}
+	}
+}
+
+
+std::shared_ptr<const LineMesh> RouteMeshCache::tessellate( const Key& key, const ShipRoute::Line& line, size_t first, size_t last )
+{
+	// Inner vertices are fully covered, outer vertices one pixel further out are not;
+	// coverage falls off linearly over the pixel straddling the edge.
+	const float halfWidth = key.lineWidth / 2.0f;
+	const float inner = max( 0.0f, halfWidth - 0.5f );
+	const float outer = halfWidth + 0.5f;
+	const float offsets[4] = { outer, inner, -inner, -outer };
+	const float coverage[4] = { 0.0f, 1.0f, 1.0f, 0.0f };
+
+	std::shared_ptr<LineMesh> mesh( new LineMesh() );
+	mesh->vertices.reserve( (last - first + 1) * 8 );
+	mesh->coverage.reserve( (last - first + 1) * 4 );
+	mesh->minX = mesh->minY = std::numeric_limits<float>::max();
+	mesh->maxX = mesh->maxY = -std::numeric_limits<float>::max();
+
+	for ( size_t i = first; i <= last; ++i ) {
+		const float x = line[i].x() * key.mapWidth;
+		const float y = line[i].y() * key.mapHeight;
+
+		// Normals of the segments before and after the point
+		float inX = 0, inY = 0, outX = 0, outY = 0;
+		const bool hasIn = 0 < i && s_normal( line[i - 1].x() * key.mapWidth, line[i - 1].y() * key.mapHeight, x, y, inX, inY );
+		const bool hasOut = i + 1 < line.size() && s_normal( x, y, line[i + 1].x() * key.mapWidth, line[i + 1].y() * key.mapHeight, outX, outY );
+
+		// Miter join: offset along the bisector of the normals, lengthened so the band keeps its
+		// width on both segments, up to the miter limit. Ends are cut square.
+		float nx = 0.0f, ny = 1.0f, scale = 1.0f;
+		if ( hasIn && hasOut ) {
+			const float sumX = inX + outX;
+			const float sumY = inY + outY;
+			const float length = ::sqrt( sumX * sumX + sumY * sumY );
+			if ( length < k_minSegmentLength ) {
+				// The line turns back on itself
+				nx = inX;
+				ny = inY;
+			}
+			else {
+				nx = sumX / length;
+				ny = sumY / length;
+				scale = min( k_miterLimit, 1.0f / max( 1.0f / k_miterLimit, nx * inX + ny * inY ) );
+			}
+		}
+		else if ( hasIn ) {
+			nx = inX;
+			ny = inY;
+		}
+		else if ( hasOut ) {
+			nx = outX;
+			ny = outY;
+		}
+
+		for ( int v = 0; v < 4; ++v ) {
+			const float vx = x + nx * offsets[v] * scale;
+			const float vy = y + ny * offsets[v] * scale;
+			mesh->vertices.push_back( vx );
+			mesh->vertices.push_back( vy );
+			mesh->coverage.push_back( coverage[v] );
+			mesh->minX = min( mesh->minX, vx );
+			mesh->minY = min( mesh->minY, vy );
+			mesh->maxX = max( mesh->maxX, vx );
+			mesh->maxY = max( mesh->maxY, vy );
+		}
+	}
+	return mesh;
+}
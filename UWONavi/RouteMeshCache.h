@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Noncopyable.h"      // For preventing copying of the cache
+#include "FrameDescription.h" // For the meshes handed to frames
+#include "ShipRoute.h"        // For the routes tessellated
+#include <unordered_map>      // For the entries of the routes
+#include <memory>             // For meshes shared with frames
+#include <vector>             // For the meshes of a route
+
+// Tessellated route lines, kept per route and zoom level so that a frame only places meshes.
+// Each route keeps the meshes of its two most recently drawn zoom levels. A route's revision
+// changing rebuilds its meshes; while the live route grows at its end, only the mesh at its tail
+// is rebuilt. Used on the thread describing frames only.
+class RouteMeshCache : private Noncopyable {
+public:
+    // What meshes are built for: the map size in pixels, the line width and the simplified level
+    struct Key {
+        float mapWidth;
+        float mapHeight;
+        float lineWidth;
+        double lodTolerance;
+
+        bool operator==(const Key& other) const
+        {
+            return mapWidth == other.mapWidth && mapHeight == other.mapHeight
+                && lineWidth == other.lineWidth && lodTolerance == other.lodTolerance;
+        }
+    };
+
+    typedef std::vector<std::shared_ptr<const LineMesh>> Meshes;
+
+private:
+    enum {
+        k_bucketsPerRoute = 2,        //!< Zoom levels kept per route
+    };
+
+    // Where a mesh lies in the route's lines, for extending the live route
+    struct MeshSpan {
+        size_t lineIndex;           //!< Line the mesh belongs to
+        size_t firstPoint;          //!< First point of the line in the mesh
+        bool complete;              //!< Whether every point it depends on was committed when it was built
+    };
+
+    // Meshes of a route for one key
+    struct Bucket {
+        Key key;
+        uint32_t revision;          //!< Route revision the meshes were built for
+        size_t tailCount;           //!< Points of the last line when built
+        NormalizedPoint tail;       //!< Last point of the last line when built (it moves while simplifying)
+        Meshes meshes;
+        std::vector<MeshSpan> spans;    //!< Parallel to meshes
+    };
+
+    // Buckets of a route, most recently used first
+    struct Entry {
+        ShipRouteWeakPtr route;     //!< Tells a new route apart from a deleted one at the same address
+        std::vector<Bucket> buckets;
+    };
+
+    std::unordered_map<const ShipRoute*, Entry> m_entries;
+
+public:
+    RouteMeshCache() :
+        m_entries()
+    {
+    }
+
+    // Get the meshes of a route for a key, building or extending them as needed
+    const Meshes& meshes(const ShipRoutePtr& route, const Key& key);
+
+    // Forget routes that no longer exist
+    void prune();
+
+    // Forget every route
+    void clear() { m_entries.clear(); }
+
+private:
+    // Tessellate the lines of a bucket from a line and point onwards, appending meshes and spans
+    static void build(Bucket& bucket, const ShipRoute::Lines& lines, size_t lineIndex, size_t firstPoint);
+
+    // Tessellate points [first, last] of a line into one mesh; joins use the points around them
+    static std::shared_ptr<const LineMesh> tessellate(const Key& key, const ShipRoute::Line& line, size_t first, size_t last);
+};
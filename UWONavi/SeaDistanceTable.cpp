@@ -0,0 +1,378 @@
+#include "stdafx.h"
+#include "SeaDistanceTable.h"
+#include "SeaRouteFinder.h"
+#include "LandMask.h"
+#include "CacheFile.h"
+#include "WorkerThreads.h"
+#include <cfloat>
+#include <climits>
+#include <queue>
+
+namespace {
+    // Header of a cache file stamped with SeaDistanceTable::makeKey of the table,
+    // followed by the distances, the route offsets and the route points
+    struct FileHeader {
+        enum : uint32_t {
+            k_Magic = 0x44535755,   // "UWSD"
+            k_Version = 3,
+        };
+        uint32_t portCount = 0;
+        uint32_t pointCount = 0;
+    };
+
+    // Most workers searching from ports at the same time
+    const DWORD k_maxWorkerCount = 16;
+
+    // Cost of a diagonal step relative to a straight one
+    const float k_diagonalCost = 1.41421356f;
+
+    // Flags kept with the step that reached a node
+    const uint8_t k_noStep = 0x0F;      // Not reached, or the start
+    const uint8_t k_stepMask = 0x0F;
+    const uint8_t k_targetFlag = 0x80;  // A port still to be reached is on the node
+
+    // A port without sea nearby
+    const uint32_t k_noNode = UINT32_MAX;
+
+    inline uint32_t s_packPoint(const POINT& point)
+    {
+        return uint32_t(point.x) | uint32_t(point.y) << 16;
+    }
+
+    inline POINT s_unpackPoint(uint32_t packed)
+    {
+        const POINT point = { LONG(packed & 0xFFFF), LONG(packed >> 16) };
+        return point;
+    }
+
+    // A node waiting to be settled; the nearest comes first
+    struct OpenEntry {
+        float cost;
+        uint32_t id;
+
+        bool operator<(const OpenEntry& rhs) const
+        {
+            return rhs.cost < cost;
+        }
+    };
+
+    // What the workers share
+    struct BuildJob {
+        const LandMask* landMask;
+        int32_t nodeSpacing;
+        int32_t columns;
+        int32_t rows;
+        std::vector<uint8_t> exits;                 // Open steps out of every node (SeaRouteFinder::findExits)
+        std::vector<uint32_t> portNodes;            // Sea node next to every port
+        std::vector<float>* distances;              // Written by the worker of the lower port of each pair
+        std::vector<std::vector<uint32_t>>* routes; // Route of every pair, written likewise
+        size_t portCount;
+        volatile LONG nextPort;                     // Next port to search from
+    };
+
+    // Index of the pair from < to among all pairs of n ports
+    inline size_t s_pairIndex(size_t from, size_t to, size_t n)
+    {
+        return from * n - from * (from + 1) / 2 + (to - from - 1);
+    }
+
+    // Find the sea node nearest to a port; the nearest of the first ring of nodes holding one wins
+    uint32_t s_nearestSeaNode(const BuildJob& job, const POINT& worldCoord)
+    {
+        const int32_t column = min(job.columns - 1, int32_t(worldCoord.x) / job.nodeSpacing);
+        const int32_t row = min(job.rows - 1, int32_t(worldCoord.y) / job.nodeSpacing);
+        for (int32_t radius = 0; radius <= SeaDistanceTable::k_snapRadius; ++radius) {
+            uint32_t best = k_noNode;
+            int32_t bestDistance = INT_MAX;
+            for (int32_t dy = -radius; dy <= radius; ++dy) {
+                const int32_t y = row + dy;
+                if (y < 0 || job.rows <= y) {
+                    continue;
+                }
+                for (int32_t dx = -radius; dx <= radius; ++dx) {
+                    if (abs(dx) != radius && abs(dy) != radius) {
+                        continue;
+                    }
+                    const uint32_t id = uint32_t(y) * job.columns + (column + dx + job.columns) % job.columns;
+                    const int32_t distance = dx * dx + dy * dy;
+                    if (distance < bestDistance && job.exits[id]) {
+                        bestDistance = distance;
+                        best = id;
+                    }
+                }
+            }
+            if (best != k_noNode) {
+                return best;
+            }
+        }
+        return k_noNode;
+    }
+
+    // Search from one port until every later port is reached, then shorten and measure the routes to them
+    void s_searchFromPort(BuildJob& job, size_t from, std::vector<float>& cost, std::vector<uint8_t>& step)
+    {
+        const uint32_t start = job.portNodes[from];
+        if (start == k_noNode) {
+            return;
+        }
+
+        std::fill(cost.begin(), cost.end(), FLT_MAX);
+        std::fill(step.begin(), step.end(), k_noStep);
+        size_t targetCount = 0;
+        for (size_t to = from + 1; to < job.portCount; ++to) {
+            const uint32_t node = job.portNodes[to];
+            if (node != k_noNode && !(step[node] & k_targetFlag)) {
+                step[node] |= k_targetFlag;
+                ++targetCount;
+            }
+        }
+
+        std::priority_queue<OpenEntry> open;
+        cost[start] = 0.0f;
+        open.push(OpenEntry{ 0.0f, start });
+        while (!open.empty() && 0 < targetCount) {
+            const OpenEntry entry = open.top();
+            open.pop();
+            if (cost[entry.id] < entry.cost) {
+                continue;
+            }
+            if (step[entry.id] & k_targetFlag) {
+                step[entry.id] &= ~k_targetFlag;
+                --targetCount;
+            }
+
+            const int32_t column = int32_t(entry.id % job.columns);
+            const int32_t row = int32_t(entry.id / job.columns);
+            for (uint8_t i = 0; i < 8; ++i) {
+                if (!(job.exits[entry.id] >> i & 1)) {
+                    continue;
+                }
+                const int32_t nextRow = row + SeaRouteFinder::k_neighbourSteps[i][1];
+                const int32_t nextColumn = (column + SeaRouteFinder::k_neighbourSteps[i][0] + job.columns) % job.columns;
+                const uint32_t next = uint32_t(nextRow) * job.columns + nextColumn;
+                const float nextCost = entry.cost + (4 <= i ? k_diagonalCost : 1.0f);
+                if (nextCost < cost[next]) {
+                    cost[next] = nextCost;
+                    step[next] = (step[next] & k_targetFlag) | i;
+                    open.push(OpenEntry{ nextCost, next });
+                }
+            }
+        }
+
+        // Walk back from every later port along the steps that reached it
+        std::vector<POINT> path;
+        std::vector<POINT> route;
+        for (size_t to = from + 1; to < job.portCount; ++to) {
+            const uint32_t goal = job.portNodes[to];
+            if (goal == k_noNode || cost[goal] == FLT_MAX) {
+                continue;
+            }
+            path.clear();
+            for (uint32_t id = goal; ; ) {
+                const int32_t column = int32_t(id % job.columns);
+                const int32_t row = int32_t(id / job.columns);
+                const POINT center = {
+                    column * job.nodeSpacing + job.nodeSpacing / 2,
+                    row * job.nodeSpacing + job.nodeSpacing / 2
+                };
+                path.push_back(center);
+                const uint8_t i = step[id] & k_stepMask;
+                if (id == start || i == k_noStep) {
+                    break;
+                }
+                const int32_t previousRow = row - SeaRouteFinder::k_neighbourSteps[i][1];
+                const int32_t previousColumn = (column - SeaRouteFinder::k_neighbourSteps[i][0] + job.columns) % job.columns;
+                id = uint32_t(previousRow) * job.columns + previousColumn;
+            }
+            std::reverse(path.begin(), path.end());
+            SeaRouteFinder::shortenPath(*job.landMask, path, route);
+
+            const int32_t width = job.landMask->width();
+            double length = 0.0;
+            std::vector<uint32_t>& packed = (*job.routes)[s_pairIndex(from, to, job.portCount)];
+            packed.reserve(route.size());
+            for (size_t i = 0; i < route.size(); ++i) {
+                packed.push_back(s_packPoint(route[i]));
+                if (0 < i) {
+                    int32_t dx = abs(route[i].x - route[i - 1].x);
+                    dx = min(dx, width - dx);
+                    const int32_t dy = route[i].y - route[i - 1].y;
+                    length += ::sqrt(double(dx) * dx + double(dy) * dy);
+                }
+            }
+            (*job.distances)[from * job.portCount + to] = float(length);
+            (*job.distances)[to * job.portCount + from] = float(length);
+        }
+    }
+
+    // Take the next port to search from until none is left
+    UINT CALLBACK s_buildThunk(LPVOID arg)
+    {
+        BuildJob& job = *reinterpret_cast<BuildJob*>(arg);
+        std::vector<float> cost(size_t(job.columns) * job.rows);
+        std::vector<uint8_t> step(size_t(job.columns) * job.rows);
+        for (;;) {
+            const size_t from = size_t(::InterlockedIncrement(&job.nextPort) - 1);
+            if (job.portCount <= from) {
+                break;
+            }
+            s_searchFromPort(job, from, cost, step);
+        }
+        return 0;
+    }
+}
+
+
+// The route of the lower port to the higher one is kept; the other way round it is read backwards
+bool SeaDistanceTable::route(size_t from, size_t to, std::vector<POINT>& points) const
+{
+    points.clear();
+    if (from == to || distance(from, to) < 0.0f) {
+        return from == to;
+    }
+    const size_t pair = pairIndex(min(from, to), max(from, to));
+    for (uint32_t i = m_routeBegin[pair]; i < m_routeBegin[pair + 1]; ++i) {
+        points.push_back(s_unpackPoint(m_routePoints[i]));
+    }
+    if (to < from) {
+        std::reverse(points.begin(), points.end());
+    }
+    return true;
+}
+
+
+// Search from every port in parallel
+bool SeaDistanceTable::build(const LandMask& landMask, const std::vector<POINT>& ports, int32_t nodeSpacing, DWORD workerCount)
+{
+    if (landMask.empty() || nodeSpacing <= 0) {
+        return false;
+    }
+
+    const size_t portCount = ports.size();
+    const size_t pairCount = portCount * (portCount - min(portCount, size_t(1))) / 2;
+    std::vector<float> distances(portCount * portCount, -1.0f);
+    for (size_t i = 0; i < portCount; ++i) {
+        distances[i * portCount + i] = 0.0f;
+    }
+    std::vector<std::vector<uint32_t>> routes(pairCount);
+
+    BuildJob job;
+    job.landMask = &landMask;
+    job.nodeSpacing = nodeSpacing;
+    job.columns = landMask.width() / nodeSpacing;
+    job.rows = landMask.height() / nodeSpacing;
+    // Steps open as in SeaRouteFinder, so a diagonal one never squeezes between two corners of land
+    SeaRouteFinder::findExits(landMask, nodeSpacing, job.exits);
+    for (const POINT& port : ports) {
+        job.portNodes.push_back(s_nearestSeaNode(job, port));
+    }
+    job.distances = &distances;
+    job.routes = &routes;
+    job.portCount = portCount;
+    job.nextPort = 0;
+
+    g_runWorkers(s_buildThunk, std::vector<LPVOID>(usedWorkerCount(workerCount, portCount), &job));
+
+    // Pack the routes one after another
+    std::vector<uint32_t> routeBegin(pairCount + 1);
+    std::vector<uint32_t> routePoints;
+    for (size_t i = 0; i < pairCount; ++i) {
+        routeBegin[i] = uint32_t(routePoints.size());
+        routePoints.insert(routePoints.end(), routes[i].begin(), routes[i].end());
+    }
+    routeBegin[pairCount] = uint32_t(routePoints.size());
+
+    m_portCount = portCount;
+    m_distances.swap(distances);
+    m_routeBegin.swap(routeBegin);
+    m_routePoints.swap(routePoints);
+    return true;
+}
+
+
+// Clamp the threads asked for to the ports and k_maxWorkerCount
+DWORD SeaDistanceTable::usedWorkerCount(DWORD workerCount, size_t portCount)
+{
+    if (workerCount == 0) {
+        workerCount = g_workerCount(k_maxWorkerCount);
+    }
+    return max(DWORD(1), min(k_maxWorkerCount, min(workerCount, DWORD(max(portCount, size_t(1))))));
+}
+
+
+// Load the table from the cache, else build it and cache it
+bool SeaDistanceTable::prepare(const LandMask& landMask, const std::vector<POINT>& ports, const std::wstring& cacheFileName)
+{
+    const uint64_t key = makeKey(landMask, ports, k_defaultNodeSpacing);
+    if (loadFromFile(cacheFileName, key)) {
+        return true;
+    }
+    if (!build(landMask, ports)) {
+        return false;
+    }
+    saveToFile(cacheFileName, key);
+    return true;
+}
+
+
+// Load the table from a cache file
+bool SeaDistanceTable::loadFromFile(const std::wstring& fileName, uint64_t key)
+{
+    CacheFileReader file;
+    FileHeader header;
+    if (!file.open(fileName, FileHeader::k_Magic, FileHeader::k_Version, key)
+        || !file.readValue(header)) {
+        return false;
+    }
+
+    const size_t portCount = header.portCount;
+    const size_t pairCount = portCount * (portCount - min(portCount, size_t(1))) / 2;
+    std::vector<float> distances(portCount * portCount);
+    std::vector<uint32_t> routeBegin(pairCount + 1);
+    std::vector<uint32_t> routePoints(header.pointCount);
+    if (!file.readArray(distances) || !file.readArray(routeBegin) || !file.readArray(routePoints)
+        || routeBegin.back() != header.pointCount) {
+        return false;
+    }
+
+    m_portCount = portCount;
+    m_distances.swap(distances);
+    m_routeBegin.swap(routeBegin);
+    m_routePoints.swap(routePoints);
+    return true;
+}
+
+
+// Write the table to a cache file
+bool SeaDistanceTable::saveToFile(const std::wstring& fileName, uint64_t key) const
+{
+    CacheFileWriter file;
+    if (!file.open(fileName, FileHeader::k_Magic, FileHeader::k_Version, key)) {
+        return false;
+    }
+
+    FileHeader header;
+    header.portCount = uint32_t(m_portCount);
+    header.pointCount = uint32_t(m_routePoints.size());
+    file.writeValue(header);
+    file.writeArray(m_distances);
+    file.writeArray(m_routeBegin);
+    file.writeArray(m_routePoints);
+    return file.close();
+}
+
+
+// Mix the ports and the spacing into the hash of the land mask (FNV-1a, a value at a time)
+uint64_t SeaDistanceTable::makeKey(const LandMask& landMask, const std::vector<POINT>& ports, int32_t nodeSpacing)
+{
+    uint64_t key = landMask.hash();
+    auto mix = [&key](uint64_t value) {
+        key = (key ^ value) * 0x100000001B3ULL;
+    };
+    mix(uint64_t(nodeSpacing));
+    mix(ports.size());
+    for (const POINT& port : ports) {
+        mix(s_packPoint(port));
+    }
+    return key;
+}
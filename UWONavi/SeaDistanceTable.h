@@ -0,0 +1,88 @@
+#pragma once
+
+#include <Windows.h>      // For POINT and DWORD
+#include <cstdint>        // For fixed-width integer types
+#include <string>         // For file names
+#include <vector>         // For the table
+
+#include "Noncopyable.h"  // To prevent copying of the table
+
+class LandMask;
+
+//! @brief Sea distances between every pair of ports, with the route of each pair.
+//! Built once per map and list of ports: from every port, Dijkstra covers a grid of nodes every nodeSpacing
+//! world coordinates (8-connected, wrapping around in x, steps open as SeaRouteFinder::findExits finds them)
+//! until every later port is reached; each node path is then shortened like SeaRouteFinder routes and
+//! measured leg by leg. Ports are searched from in parallel, one worker per processor. The table is kept in
+//! a cache file keyed by a hash of the land mask, the ports and the spacing, so later lookups cost nothing.
+class SeaDistanceTable : private Noncopyable {
+public:
+    enum : int32_t {
+        k_defaultNodeSpacing = 8,   //!< World coordinates between neighbouring nodes
+        k_snapRadius = 16,          //!< Nodes searched around a port on land for the nearest sea
+    };
+
+private:
+    size_t m_portCount;                     //!< Ports of the table
+    std::vector<float> m_distances;         //!< Distance from every port to every port, row by row (-1 without a sea route)
+    std::vector<uint32_t> m_routeBegin;     //!< First point of the route of every pair from < to in m_routePoints, plus the count of all
+    std::vector<uint32_t> m_routePoints;    //!< Turning points of the routes; x in the low and y in the high 16 bits
+
+public:
+    SeaDistanceTable() :
+        m_portCount(),
+        m_distances(),
+        m_routeBegin(),
+        m_routePoints()
+    {
+    }
+
+    //! @brief Check whether nothing is in the table.
+    bool empty() const { return m_distances.empty(); }
+
+    //! @brief Get the number of ports of the table.
+    size_t portCount() const { return m_portCount; }
+
+    //! @brief Get the sea distance between two ports in world coordinates.
+    //! @return -1 if no sea route connects them (or a port has no sea nearby)
+    float distance(size_t from, size_t to) const { return m_distances[from * m_portCount + to]; }
+
+    //! @brief Get the turning points of the route between two ports, from the sea next to the first port to
+    //! the sea next to the second one. Legs crossing the edge of the world are less than half the world wide.
+    //! @return false if no sea route connects them
+    bool route(size_t from, size_t to, std::vector<POINT>& points) const;
+
+    //! @brief Compute the table.
+    //! @param landMask Land and sea of the world
+    //! @param ports Positions of the ports in world coordinates
+    //! @param nodeSpacing World coordinates between neighbouring nodes; smaller is more exact but slower
+    //! @param workerCount Threads to search with (0 for one per processor)
+    //! @return false if the land mask is empty
+    bool build(const LandMask& landMask, const std::vector<POINT>& ports, int32_t nodeSpacing = k_defaultNodeSpacing, DWORD workerCount = 0);
+
+    //! @brief Get the threads build searches with when asked for workerCount (0 for one per processor):
+    //! at least one, at most one per port and 16 in all.
+    static DWORD usedWorkerCount(DWORD workerCount, size_t portCount);
+
+    //! @brief Load the table from a cache file when it was built for the same key, else build and cache it.
+    //! @return false if it could be neither loaded nor built
+    bool prepare(const LandMask& landMask, const std::vector<POINT>& ports, const std::wstring& cacheFileName);
+
+    //! @brief Load the table from a cache file.
+    //! @return false if the file is missing, written for another key or broken
+    bool loadFromFile(const std::wstring& fileName, uint64_t key);
+
+    //! @brief Write the table to a cache file.
+    //! @return false if the file cannot be written
+    bool saveToFile(const std::wstring& fileName, uint64_t key) const;
+
+    //! @brief Make the cache key of a table built from a land mask, ports and node spacing.
+    static uint64_t makeKey(const LandMask& landMask, const std::vector<POINT>& ports, int32_t nodeSpacing);
+
+private:
+    //! @brief Index of the pair from < to among all pairs.
+    size_t pairIndex(size_t from, size_t to) const
+    {
+        return from * m_portCount - from * (from + 1) / 2 + (to - from - 1);
+    }
+};
@@ -0,0 +1,160 @@
+#include "stdafx.h"
+#include "SeaRegionMap.h"
+#include "UWONavi.h"
+#include "Image.h"
+#include <bitset>
+#include <fstream>
+
+namespace {
+    // Parse "RRGGBB<TAB>name" into the color as 0xRRGGBB
+    bool s_parseRegionName(const std::string& line, uint32_t& color, std::wstring& name)
+    {
+        if (line.size() < 8 || line[6] != '\t') {
+            return false;
+        }
+        char* end = NULL;
+        color = ::strtoul(line.substr(0, 6).c_str(), &end, 16);
+        if (*end != '\0') {
+            return false;
+        }
+        name = g_wideFromUtf8(line.substr(7));
+        return true;
+    }
+}
+
+
+void SeaRegionMap::setup(const std::wstring& imageFileName, const std::wstring& namesFileName)
+{
+    m_imageFileName = imageFileName;
+    m_namesFileName = namesFileName;
+    m_loadTried = false;
+    m_columns = 0;
+    m_rows = 0;
+    m_cells.clear();
+    m_names.clear();
+}
+
+
+// Read the names, then sample the image at the center of every cell
+bool SeaRegionMap::load()
+{
+    m_loadTried = true;
+
+    std::ifstream ifs;
+    ifs.open(m_namesFileName, std::ios::in | std::ios::binary);
+    if (!ifs) {
+        return false;
+    }
+    std::vector<std::wstring> names(1);
+    std::vector<uint32_t> colors(1);
+    std::string line;
+    while (std::getline(ifs, line) && names.size() <= k_maxRegions) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (names.size() == 1 && line.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+            line.erase(0, 3);  // Byte order mark
+        }
+        uint32_t color = 0;
+        std::wstring name;
+        if (s_parseRegionName(line, color, name)) {
+            colors.push_back(color);
+            names.push_back(name);
+        }
+    }
+
+    Image image;
+    if (!image.loadFromFile(m_imageFileName) || image.width() <= 0 || image.height() <= 0) {
+        return false;
+    }
+    const uint32_t bytesPerPixel = image.pixelFormat() == k_PixelFormat_RGBA ? 4 : 3;
+
+    const int32_t columns = k_worldWidth / k_cellSize;
+    const int32_t rows = k_worldHeight / k_cellSize;
+    std::vector<uint8_t> cells(size_t(columns) * rows);
+    uint32_t lastColor = 0;
+    uint8_t lastRegion = k_noRegion;
+    for (int32_t row = 0; row < rows; ++row) {
+        const int32_t imageRow = int32_t((int64_t(row) * k_cellSize + k_cellSize / 2) * image.height() / k_worldHeight);
+        const uint8_t* pixels = image.imageBits() + size_t(imageRow) * image.stride();
+        for (int32_t column = 0; column < columns; ++column) {
+            const int32_t imageColumn = int32_t((int64_t(column) * k_cellSize + k_cellSize / 2) * image.width() / k_worldWidth);
+            const uint8_t* pixel = pixels + size_t(imageColumn) * bytesPerPixel;
+            const uint32_t color = uint32_t(pixel[2]) << 16 | uint32_t(pixel[1]) << 8 | pixel[0];
+            if (color != lastColor || column == 0) {
+                lastColor = color;
+                lastRegion = k_noRegion;
+                for (size_t i = 1; i < colors.size(); ++i) {
+                    if (colors[i] == color) {
+                        lastRegion = uint8_t(i);
+                        break;
+                    }
+                }
+            }
+            cells[size_t(row) * columns + column] = lastRegion;
+        }
+    }
+
+    m_columns = columns;
+    m_rows = rows;
+    m_cells.swap(cells);
+    m_names.swap(names);
+    return true;
+}
+
+
+// Step along every leg one cell at a time, so no cell it passes through is skipped
+void SeaRegionMap::regionsCrossed(const ShipRoute::Lines& lines, std::vector<uint8_t>& regions)
+{
+    regions.clear();
+    if (!m_loadTried) {
+        load();
+    }
+    if (m_cells.empty()) {
+        return;
+    }
+
+    std::bitset<k_maxRegions + 1> found;
+    found.set(k_noRegion);
+    auto visit = [&](const POINT& worldCoord) {
+        const uint8_t region = regionAt(worldCoord);
+        if (!found[region]) {
+            found.set(region);
+            regions.push_back(region);
+        }
+    };
+
+    const int32_t width = m_columns * k_cellSize;
+    for (const ShipRoute::Line& line : lines) {
+        for (size_t i = 0; i < line.size(); ++i) {
+            const POINT to = {
+                LONG(::round(line[i].x() * k_worldWidth)),
+                LONG(::round(line[i].y() * k_worldHeight))
+            };
+            if (i == 0) {
+                visit(to);
+                continue;
+            }
+            const POINT from = {
+                LONG(::round(line[i - 1].x() * k_worldWidth)),
+                LONG(::round(line[i - 1].y() * k_worldHeight))
+            };
+            int32_t dx = to.x - from.x;
+            if (width / 2 < dx) {
+                dx -= width;
+            }
+            else if (dx < -width / 2) {
+                dx += width;
+            }
+            const int32_t dy = to.y - from.y;
+            const int32_t steps = max(abs(dx), abs(dy)) / k_cellSize + 1;
+            for (int32_t step = 1; step <= steps; ++step) {
+                const POINT worldCoord = {
+                    LONG(from.x + int64_t(dx) * step / steps),
+                    LONG(from.y + int64_t(dy) * step / steps)
+                };
+                visit(worldCoord);
+            }
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Windows.h>      // For POINT
+#include <cstdint>        // For fixed-width integer types
+#include <string>         // For names and file names
+#include <vector>         // For the cells
+
+#include "Noncopyable.h"  // To prevent copying of the cells
+#include "ShipRoute.h"    // For the lines of routes
+
+//! @brief Which named sea area every world coordinate belongs to.
+//! The areas come from an image painted over the world map, one color per area, and a text file
+//! naming the colors, one per line:
+//!     RRGGBB<TAB>name
+//! in hexadecimal and UTF-8; pixels of other colors belong to no area. The image is sampled once
+//! into one byte per k_cellSize x k_cellSize world coordinates (2 MB for the whole world), so a
+//! lookup is a single index. Nothing is read until the first lookup.
+class SeaRegionMap : private Noncopyable {
+public:
+    enum : int32_t {
+        k_cellSize = 8,         //!< World coordinates along each side of a cell
+        k_noRegion = 0,         //!< Region of coordinates outside every area
+        k_maxRegions = 255,     //!< Most areas (regions 1 to 255)
+    };
+
+private:
+    std::wstring m_imageFileName;       //!< Image painting the areas
+    std::wstring m_namesFileName;       //!< Names of the colors of the image
+    bool m_loadTried;                   //!< Whether the files were read (or failed to be)
+    int32_t m_columns;                  //!< Cells around the world
+    int32_t m_rows;                     //!< Cells from top to bottom
+    std::vector<uint8_t> m_cells;       //!< Region of every cell, row by row
+    std::vector<std::wstring> m_names;  //!< Name of every region (empty for k_noRegion)
+
+public:
+    SeaRegionMap() :
+        m_imageFileName(),
+        m_namesFileName(),
+        m_loadTried(),
+        m_columns(),
+        m_rows(),
+        m_cells(),
+        m_names()
+    {
+    }
+
+    //! @brief Remember the files to read on the first lookup, forgetting the areas read before.
+    void setup(const std::wstring& imageFileName, const std::wstring& namesFileName);
+
+    //! @brief Read the files now instead of on the first lookup.
+    //! @return false if either file cannot be read
+    bool load();
+
+    //! @brief Get the region of a world coordinate (x wraps around).
+    //! @return k_noRegion outside every area, or when the files cannot be read
+    uint8_t regionAt(const POINT& worldCoord)
+    {
+        if (!m_loadTried) {
+            load();
+        }
+        if (m_cells.empty() || worldCoord.y < 0 || m_rows <= worldCoord.y / k_cellSize) {
+            return k_noRegion;
+        }
+        const int32_t width = m_columns * k_cellSize;
+        const int32_t x = ((int32_t(worldCoord.x) % width) + width) % width;
+        return m_cells[size_t(worldCoord.y / k_cellSize) * m_columns + x / k_cellSize];
+    }
+
+    //! @brief Get the name of a region.
+    const std::wstring& regionName(uint8_t region) const
+    {
+        static const std::wstring k_noName;
+        return region < m_names.size() ? m_names[region] : k_noName;
+    }
+
+    //! @brief Get the regions a route passes through, in the order it first enters them.
+    //! Every leg is followed cell by cell, the short way around the world.
+    void regionsCrossed(const ShipRoute::Lines& lines, std::vector<uint8_t>& regions);
+};
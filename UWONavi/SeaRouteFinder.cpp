@@ -0,0 +1,571 @@
+#include "stdafx.h"
+#include "SeaRouteFinder.h"
+#include "LandMask.h"
+#include <cfloat>
+#include <climits>
+#include <queue>
+
+namespace {
+    // Cost of a diagonal step relative to a straight one
+    const float k_diagonalCost = 1.41421356f;
+
+    // Nodes of a cell
+    const int32_t k_nodesPerCell = SeaRouteFinder::k_cellNodes * SeaRouteFinder::k_cellNodes;
+
+    // What the search knows about a node
+    struct SearchNode {
+        float g;            // Cost of the best path found from the start
+        uint32_t parent;    // Node before it on that path
+        bool closed;        // Whether that path is known to be the shortest
+    };
+
+    // A node the search has not reached yet
+    const SearchNode k_unreachedNode = { FLT_MAX, 0, false };
+
+    // A node waiting to be expanded; the lowest estimate comes first, ties go to the node furthest along
+    struct OpenEntry {
+        float f;            // Cost so far plus the estimate to the goal
+        float g;            // Cost so far when queued (stale once the node was reached more cheaply)
+        uint32_t id;        // Node index
+
+        bool operator<(const OpenEntry& rhs) const
+        {
+            return rhs.f < f || (f == rhs.f && g < rhs.g);
+        }
+    };
+
+    // Distance between two columns the short way around
+    inline int32_t s_wrappedDistance(int32_t a, int32_t b, int32_t columns)
+    {
+        const int32_t d = abs(a - b) % columns;
+        return min(d, columns - d);
+    }
+
+    // Cost of the shortest path on an open 8-connected grid
+    inline float s_octileDistance(int32_t dx, int32_t dy)
+    {
+        return float(abs(dx - dy)) + k_diagonalCost * min(dx, dy);
+    }
+
+    // Regions linked across cell borders; a step is one cell
+    class RegionGraph {
+        const std::vector<uint32_t>& m_linkBegin;
+        const std::vector<uint32_t>& m_links;
+        const std::vector<uint32_t>& m_regionCells;
+        int32_t m_cellColumns;
+        std::vector<SearchNode> m_nodes;
+
+    public:
+        RegionGraph(const std::vector<uint32_t>& linkBegin, const std::vector<uint32_t>& links, const std::vector<uint32_t>& regionCells, int32_t cellColumns) :
+            m_linkBegin(linkBegin),
+            m_links(links),
+            m_regionCells(regionCells),
+            m_cellColumns(cellColumns),
+            m_nodes(regionCells.size(), k_unreachedNode)
+        {
+        }
+
+        SearchNode& at(uint32_t id) { return m_nodes[id]; }
+
+        float estimate(uint32_t id, uint32_t goal) const
+        {
+            const int32_t cell = int32_t(m_regionCells[id]);
+            const int32_t goalCell = int32_t(m_regionCells[goal]);
+            return s_octileDistance(
+                s_wrappedDistance(cell % m_cellColumns, goalCell % m_cellColumns, m_cellColumns),
+                abs(cell / m_cellColumns - goalCell / m_cellColumns));
+        }
+
+        template<class Visit>
+        void forEachStep(uint32_t id, const Visit& visit) const
+        {
+            for (uint32_t i = m_linkBegin[id]; i < m_linkBegin[id + 1]; ++i) {
+                visit(m_links[i], 1.0f);
+            }
+        }
+    };
+
+    // Sea nodes of the cells of a corridor, 8-connected through the steps whose whole leg is sea.
+    // Node states are kept in one block per corridor cell.
+    class CorridorGrid {
+        const std::vector<uint8_t>& m_nodeExits;
+        const std::vector<int32_t>& m_slots;
+        int32_t m_nodeColumns;
+        int32_t m_nodeRows;
+        int32_t m_cellColumns;
+        std::vector<SearchNode> m_nodes;
+
+        int32_t slotOf(int32_t column, int32_t row) const
+        {
+            return m_slots[size_t(row / SeaRouteFinder::k_cellNodes) * m_cellColumns + column / SeaRouteFinder::k_cellNodes];
+        }
+
+    public:
+        CorridorGrid(const std::vector<uint8_t>& nodeExits, const std::vector<int32_t>& slots, int32_t nodeColumns, int32_t nodeRows, int32_t cellColumns, int32_t slotCount) :
+            m_nodeExits(nodeExits),
+            m_slots(slots),
+            m_nodeColumns(nodeColumns),
+            m_nodeRows(nodeRows),
+            m_cellColumns(cellColumns),
+            m_nodes(size_t(slotCount) * k_nodesPerCell, k_unreachedNode)
+        {
+        }
+
+        SearchNode& at(uint32_t id)
+        {
+            const int32_t column = int32_t(id % m_nodeColumns);
+            const int32_t row = int32_t(id / m_nodeColumns);
+            return m_nodes[size_t(slotOf(column, row)) * k_nodesPerCell
+                + (row % SeaRouteFinder::k_cellNodes) * SeaRouteFinder::k_cellNodes + column % SeaRouteFinder::k_cellNodes];
+        }
+
+        float estimate(uint32_t id, uint32_t goal) const
+        {
+            return s_octileDistance(
+                s_wrappedDistance(int32_t(id % m_nodeColumns), int32_t(goal % m_nodeColumns), m_nodeColumns),
+                abs(int32_t(id / m_nodeColumns) - int32_t(goal / m_nodeColumns)));
+        }
+
+        template<class Visit>
+        void forEachStep(uint32_t id, const Visit& visit) const
+        {
+            const int32_t column = int32_t(id % m_nodeColumns);
+            const int32_t row = int32_t(id / m_nodeColumns);
+            const uint8_t exits = m_nodeExits[id];
+            for (int32_t i = 0; i < 8; ++i) {
+                if (!(exits & (1 << i))) {
+                    continue;
+                }
+                const int32_t nextRow = row + SeaRouteFinder::k_neighbourSteps[i][1];
+                const int32_t nextColumn = (column + SeaRouteFinder::k_neighbourSteps[i][0] + m_nodeColumns) % m_nodeColumns;
+                if (slotOf(nextColumn, nextRow) < 0) {
+                    continue;
+                }
+                visit(uint32_t(nextRow) * m_nodeColumns + nextColumn, i < 4 ? 1.0f : k_diagonalCost);
+            }
+        }
+    };
+
+    // A* from start to goal over a graph holding the node states
+    template<class Graph>
+    bool s_findPath(Graph& graph, uint32_t start, uint32_t goal, std::vector<uint32_t>& path)
+    {
+        path.clear();
+        std::priority_queue<OpenEntry> open;
+        SearchNode& first = graph.at(start);
+        first.g = 0.0f;
+        first.parent = start;
+        open.push(OpenEntry{ graph.estimate(start, goal), 0.0f, start });
+
+        while (!open.empty()) {
+            const OpenEntry entry = open.top();
+            open.pop();
+            SearchNode& node = graph.at(entry.id);
+            if (node.closed || node.g < entry.g) {
+                continue;
+            }
+            node.closed = true;
+
+            if (entry.id == goal) {
+                for (uint32_t id = goal; ; id = graph.at(id).parent) {
+                    path.push_back(id);
+                    if (id == start) {
+                        break;
+                    }
+                }
+                std::reverse(path.begin(), path.end());
+                return true;
+            }
+
+            graph.forEachStep(entry.id, [&](uint32_t id, float cost) {
+                const float g = entry.g + cost;
+                SearchNode& next = graph.at(id);
+                if (next.closed || next.g <= g) {
+                    return;
+                }
+                next.g = g;
+                next.parent = entry.id;
+                open.push(OpenEntry{ g + graph.estimate(id, goal), g, id });
+            });
+        }
+        return false;
+    }
+}
+
+
+// Neighbours of a grid node: straight ones first, then diagonal ones
+const int32_t SeaRouteFinder::k_neighbourSteps[8][2] = {
+    { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 },
+    { 1, 1 }, { -1, -1 }, { 1, -1 }, { -1, 1 },
+};
+
+
+// Sample the land mask at every node center, then build the regions
+SeaRouteFinder::SeaRouteFinder(const LandMask& landMask) :
+    m_landMask(&landMask),
+    m_nodeColumns(landMask.width() / k_nodeSpacing),
+    m_nodeRows(landMask.height() / k_nodeSpacing),
+    m_cellColumns((m_nodeColumns + k_cellNodes - 1) / k_cellNodes),
+    m_cellRows((m_nodeRows + k_cellNodes - 1) / k_cellNodes),
+    m_nodeRegions(size_t(m_nodeColumns) * m_nodeRows),
+    m_nodeExits(),
+    m_cellRegions(),
+    m_regionCells(),
+    m_linkBegin(),
+    m_links(),
+    m_corridorSlots(size_t(m_cellColumns) * m_cellRows, -1)
+{
+    for (int32_t row = 0; row < m_nodeRows; ++row) {
+        for (int32_t column = 0; column < m_nodeColumns; ++column) {
+            m_nodeRegions[size_t(row) * m_nodeColumns + column] =
+                landMask.isSea(column * k_nodeSpacing + k_nodeSpacing / 2, row * k_nodeSpacing + k_nodeSpacing / 2);
+        }
+    }
+    findExits(landMask, k_nodeSpacing, m_nodeExits);
+    labelRegions();
+    linkRegions();
+}
+
+
+// Check the leg to every straight neighbour once, from the node left of or above it. A diagonal step also
+// needs both ways around it through straight steps open, so paths never squeeze between two corners of land,
+// and regions flooded through straight steps hold everything diagonal steps reach.
+void SeaRouteFinder::findExits(const LandMask& landMask, int32_t nodeSpacing, std::vector<uint8_t>& exits)
+{
+    const int32_t width = landMask.width();
+    const int32_t columns = width / nodeSpacing;
+    const int32_t rows = landMask.height() / nodeSpacing;
+    exits.assign(size_t(columns) * rows, 0);
+    if (columns <= 0 || rows <= 0) {
+        return;
+    }
+
+    std::vector<uint8_t> seaNodes(exits.size());
+    for (int32_t row = 0; row < rows; ++row) {
+        for (int32_t column = 0; column < columns; ++column) {
+            seaNodes[size_t(row) * columns + column] =
+                landMask.isSea(column * nodeSpacing + nodeSpacing / 2, row * nodeSpacing + nodeSpacing / 2);
+        }
+    }
+    auto wrapColumn = [columns](int32_t column) {
+        return column < 0 ? column + columns : (columns <= column ? column - columns : column);
+    };
+    // Open step i from a sea node to a neighbour within the rows
+    auto open = [&](int32_t column, int32_t row, int32_t i) {
+        const int32_t nextColumn = wrapColumn(column + k_neighbourSteps[i][0]);
+        const size_t next = size_t(row + k_neighbourSteps[i][1]) * columns + nextColumn;
+        if (!seaNodes[next]) {
+            return;
+        }
+        // The coordinates LandMask::isSeaSegment visits on a straight or diagonal leg, between two sea centers;
+        // they are read from the rows directly, as they are within the world once x wraps
+        const int32_t x = column * nodeSpacing + nodeSpacing / 2;
+        const int32_t y = row * nodeSpacing + nodeSpacing / 2;
+        for (int32_t k = 1; k < nodeSpacing; ++k) {
+            int32_t legX = x + k_neighbourSteps[i][0] * k;
+            if (legX < 0) {
+                legX += width;
+            }
+            else if (width <= legX) {
+                legX -= width;
+            }
+            const uint64_t* bits = landMask.rowBits(y + k_neighbourSteps[i][1] * k);
+            if (bits[uint32_t(legX) / LandMask::k_wordBits] >> (uint32_t(legX) % LandMask::k_wordBits) & 1) {
+                return;
+            }
+        }
+        exits[size_t(row) * columns + column] |= 1 << i;
+        exits[next] |= 1 << (i ^ 1);
+    };
+    for (int32_t row = 0; row < rows; ++row) {
+        for (int32_t column = 0; column < columns; ++column) {
+            if (!seaNodes[size_t(row) * columns + column]) {
+                continue;
+            }
+            open(column, row, 0);
+            if (row + 1 < rows) {
+                open(column, row, 2);
+            }
+        }
+    }
+    // Diagonals down to the right (step 4) and down to the left (step 7); straight exits are all known by now
+    for (int32_t row = 0; row + 1 < rows; ++row) {
+        const uint8_t* rowExits = &exits[size_t(row) * columns];
+        const uint8_t* below = rowExits + columns;
+        for (int32_t column = 0; column < columns; ++column) {
+            if (!(rowExits[column] & (1 << 2))) {
+                continue;
+            }
+            if ((rowExits[column] & (1 << 0)) && (below[column] & (1 << 0)) && (rowExits[wrapColumn(column + 1)] & (1 << 2))) {
+                open(column, row, 4);
+            }
+            if ((rowExits[column] & (1 << 1)) && (below[column] & (1 << 1)) && (rowExits[wrapColumn(column - 1)] & (1 << 2))) {
+                open(column, row, 7);
+            }
+        }
+    }
+}
+
+
+// Flood the sea of every cell from each node not labelled yet, through open straight steps. They are enough:
+// a diagonal step needs both ways around it open, so it never joins anything they do not.
+void SeaRouteFinder::labelRegions()
+{
+    m_cellRegions.assign(size_t(m_cellColumns) * m_cellRows + 1, 0);
+    m_regionCells.clear();
+
+    std::vector<POINT> pending;
+    for (int32_t cellRow = 0; cellRow < m_cellRows; ++cellRow) {
+        for (int32_t cellColumn = 0; cellColumn < m_cellColumns; ++cellColumn) {
+            const uint32_t cell = uint32_t(cellRow) * m_cellColumns + cellColumn;
+            const int32_t rowBegin = cellRow * k_cellNodes;
+            const int32_t rowEnd = min(m_nodeRows, rowBegin + k_cellNodes);
+            const int32_t columnBegin = cellColumn * k_cellNodes;
+            const int32_t columnEnd = min(m_nodeColumns, columnBegin + k_cellNodes);
+
+            // Sea nodes hold 1 until labelled; labels start from 2 and drop by one at the end. Exits can leave
+            // every node of a cell a region of its own, so labels go up to k_cellNodes * k_cellNodes + 1
+            static_assert(k_cellNodes * k_cellNodes + 1 <= 0xFFFF, "region labels overflow.");
+            uint16_t label = 1;
+            for (int32_t row = rowBegin; row < rowEnd; ++row) {
+                for (int32_t column = columnBegin; column < columnEnd; ++column) {
+                    if (m_nodeRegions[size_t(row) * m_nodeColumns + column] != 1) {
+                        continue;
+                    }
+                    ++label;
+                    m_regionCells.push_back(cell);
+                    m_nodeRegions[size_t(row) * m_nodeColumns + column] = label;
+                    const POINT seed = { column, row };
+                    pending.push_back(seed);
+                    while (!pending.empty()) {
+                        const POINT node = pending.back();
+                        pending.pop_back();
+                        const uint8_t exits = m_nodeExits[size_t(node.y) * m_nodeColumns + node.x];
+                        for (int32_t i = 0; i < 4; ++i) {
+                            const POINT next = { node.x + k_neighbourSteps[i][0], node.y + k_neighbourSteps[i][1] };
+                            if (!(exits & (1 << i)) || next.x < columnBegin || columnEnd <= next.x || next.y < rowBegin || rowEnd <= next.y) {
+                                continue;
+                            }
+                            uint16_t& region = m_nodeRegions[size_t(next.y) * m_nodeColumns + next.x];
+                            if (region == 1) {
+                                region = label;
+                                pending.push_back(next);
+                            }
+                        }
+                    }
+                }
+            }
+            for (int32_t row = rowBegin; row < rowEnd; ++row) {
+                for (int32_t column = columnBegin; column < columnEnd; ++column) {
+                    uint16_t& region = m_nodeRegions[size_t(row) * m_nodeColumns + column];
+                    if (region != 0) {
+                        --region;
+                    }
+                }
+            }
+            m_cellRegions[cell + 1] = uint32_t(m_regionCells.size());
+        }
+    }
+}
+
+
+// Link two regions wherever a straight step joins sea nodes of theirs across the right or bottom border of a cell;
+// the last cell of a row borders the first one, the last row borders nothing
+void SeaRouteFinder::linkRegions()
+{
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    auto regionOf = [this](int32_t column, int32_t row) {
+        const uint32_t cell = uint32_t(row / k_cellNodes) * m_cellColumns + column / k_cellNodes;
+        return m_cellRegions[cell] + m_nodeRegions[size_t(row) * m_nodeColumns + column] - 1;
+    };
+    auto link = [&](int32_t column, int32_t row, int32_t nextColumn, int32_t nextRow, int32_t step) {
+        if (m_nodeExits[size_t(row) * m_nodeColumns + column] & (1 << step)) {
+            const uint32_t region = regionOf(column, row);
+            const uint32_t nextRegion = regionOf(nextColumn, nextRow);
+            pairs.push_back(std::make_pair(region, nextRegion));
+            pairs.push_back(std::make_pair(nextRegion, region));
+        }
+    };
+    for (int32_t row = 0; row < m_nodeRows; ++row) {
+        for (int32_t column = k_cellNodes - 1; column < m_nodeColumns + k_cellNodes - 1; column += k_cellNodes) {
+            const int32_t east = min(column, m_nodeColumns - 1);
+            link(east, row, (east + 1) % m_nodeColumns, row, 0);
+        }
+    }
+    for (int32_t row = k_cellNodes - 1; row < m_nodeRows - 1; row += k_cellNodes) {
+        for (int32_t column = 0; column < m_nodeColumns; ++column) {
+            link(column, row, column, row + 1, 2);
+        }
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+    m_linkBegin.assign(m_regionCells.size() + 1, 0);
+    m_links.clear();
+    m_links.reserve(pairs.size());
+    for (const std::pair<uint32_t, uint32_t>& pair : pairs) {
+        ++m_linkBegin[pair.first + 1];
+        m_links.push_back(pair.second);
+    }
+    for (size_t i = 1; i < m_linkBegin.size(); ++i) {
+        m_linkBegin[i] += m_linkBegin[i - 1];
+    }
+}
+
+
+// Find the shortest sea route between two world coordinates
+bool SeaRouteFinder::findRoute(const POINT& from, const POINT& to, std::vector<POINT>& route)
+{
+    route.clear();
+    if (m_nodeColumns <= 0 || m_nodeRows <= 0) {
+        return false;
+    }
+
+    POINT startNode, goalNode;
+    if (!nearestSeaNode(from, startNode) || !nearestSeaNode(to, goalNode)) {
+        return false;
+    }
+
+    // Cross the regions first; regions link exactly where nodes do, so without a region path there is no route
+    auto regionOf = [this](const POINT& node) {
+        const uint32_t cell = uint32_t(node.y / k_cellNodes) * m_cellColumns + node.x / k_cellNodes;
+        return m_cellRegions[cell] + m_nodeRegions[size_t(node.y) * m_nodeColumns + node.x] - 1;
+    };
+    std::vector<uint32_t> regionPath;
+    {
+        RegionGraph regions(m_linkBegin, m_links, m_regionCells, m_cellColumns);
+        if (!s_findPath(regions, regionOf(startNode), regionOf(goalNode), regionPath)) {
+            return false;
+        }
+    }
+
+    // Search the nodes within the cells along the region path and their neighbours. The regions of the path
+    // are connected sea within those cells, so the search always gets through.
+    std::fill(m_corridorSlots.begin(), m_corridorSlots.end(), -1);
+    int32_t slotCount = 0;
+    for (uint32_t region : regionPath) {
+        const int32_t cellColumn = int32_t(m_regionCells[region]) % m_cellColumns;
+        const int32_t cellRow = int32_t(m_regionCells[region]) / m_cellColumns;
+        for (int32_t dy = -1; dy <= 1; ++dy) {
+            const int32_t row = cellRow + dy;
+            if (row < 0 || m_cellRows <= row) {
+                continue;
+            }
+            for (int32_t dx = -1; dx <= 1; ++dx) {
+                int32_t& slot = m_corridorSlots[size_t(row) * m_cellColumns + (cellColumn + dx + m_cellColumns) % m_cellColumns];
+                if (slot < 0) {
+                    slot = slotCount++;
+                }
+            }
+        }
+    }
+    std::vector<uint32_t> nodePath;
+    {
+        CorridorGrid corridor(m_nodeExits, m_corridorSlots, m_nodeColumns, m_nodeRows, m_cellColumns, slotCount);
+        const uint32_t start = uint32_t(startNode.y) * m_nodeColumns + startNode.x;
+        const uint32_t goal = uint32_t(goalNode.y) * m_nodeColumns + goalNode.x;
+        if (!s_findPath(corridor, start, goal, nodePath)) {
+            return false;
+        }
+    }
+
+    std::vector<POINT> path;
+    path.reserve(nodePath.size());
+    for (uint32_t node : nodePath) {
+        const POINT center = {
+            LONG(node % m_nodeColumns) * k_nodeSpacing + k_nodeSpacing / 2,
+            LONG(node / m_nodeColumns) * k_nodeSpacing + k_nodeSpacing / 2
+        };
+        path.push_back(center);
+    }
+    shortenPath(*m_landMask, path, route);
+
+    // Start and end exactly at the points asked for when they are at sea and in sight of the route
+    const int32_t width = m_landMask->width();
+    const POINT exactFrom = { ((from.x % width) + width) % width, from.y };
+    const POINT exactTo = { ((to.x % width) + width) % width, to.y };
+    if (m_landMask->isSea(exactFrom.x, exactFrom.y) && hasLineOfSight(exactFrom, route[min(size_t(1), route.size() - 1)])) {
+        route.front() = exactFrom;
+    }
+    if (m_landMask->isSea(exactTo.x, exactTo.y) && hasLineOfSight(route[route.size() < 2 ? 0 : route.size() - 2], exactTo)) {
+        route.back() = exactTo;
+    }
+    return true;
+}
+
+
+// Search rings of nodes around the point; the nearest sea node of the first ring holding one wins
+bool SeaRouteFinder::nearestSeaNode(const POINT& worldCoord, POINT& node) const
+{
+    const int32_t width = m_landMask->width();
+    const int32_t column = (((worldCoord.x % width) + width) % width) / k_nodeSpacing;
+    const int32_t row = max(0, min(m_nodeRows - 1, int32_t(worldCoord.y) / k_nodeSpacing));
+
+    for (int32_t radius = 0; radius <= k_snapRadius; ++radius) {
+        int32_t bestDistance = INT_MAX;
+        for (int32_t dy = -radius; dy <= radius; ++dy) {
+            for (int32_t dx = -radius; dx <= radius; ++dx) {
+                if (abs(dx) != radius && abs(dy) != radius) {
+                    continue;
+                }
+                const int32_t distance = dx * dx + dy * dy;
+                if (distance < bestDistance && isSeaNode(column + dx, row + dy)) {
+                    bestDistance = distance;
+                    node.x = (column + dx + m_nodeColumns) % m_nodeColumns;
+                    node.y = row + dy;
+                }
+            }
+        }
+        if (bestDistance != INT_MAX) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool SeaRouteFinder::hasLineOfSight(const POINT& from, const POINT& to) const
+{
+    return m_landMask->isSeaSegment(from.x, from.y, to.x, to.y);
+}
+
+
+// Greedy string pulling: from each turning point, the furthest node in sight becomes the next one.
+// Gallop ahead while the leg stays clear, then bisect between the last clear and the first blocked node,
+// so long open legs take a few sight checks instead of one per node.
+void SeaRouteFinder::shortenPath(const LandMask& landMask, const std::vector<POINT>& path, std::vector<POINT>& route)
+{
+    auto hasLineOfSight = [&landMask](const POINT& from, const POINT& to) {
+        return landMask.isSeaSegment(from.x, from.y, to.x, to.y);
+    };
+    route.clear();
+    if (path.empty()) {
+        return;
+    }
+    route.push_back(path.front());
+
+    size_t anchor = 0;
+    while (anchor + 1 < path.size()) {
+        size_t reach = anchor + 1;  // Each point is in sight of the next
+        size_t blocked = path.size();
+        for (size_t step = 1; reach < path.size() - 1; step *= 2) {
+            const size_t next = min(reach + step, path.size() - 1);
+            if (!hasLineOfSight(path[anchor], path[next])) {
+                blocked = next;
+                break;
+            }
+            reach = next;
+        }
+        while (reach + 1 < blocked) {
+            const size_t middle = (reach + blocked) / 2;
+            if (hasLineOfSight(path[anchor], path[middle])) {
+                reach = middle;
+            }
+            else {
+                blocked = middle;
+            }
+        }
+        route.push_back(path[reach]);
+        anchor = reach;
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <Windows.h>      // For POINT
+#include <cstdint>        // For fixed-width integer types
+#include <vector>         // For the grids and the route
+
+#include "Noncopyable.h"  // To prevent copying of the grids
+
+class LandMask;
+
+//! @brief Finds the shortest sea route between two world coordinates.
+//! The search runs on a grid of nodes every k_nodeSpacing world coordinates, a node being sea when the land
+//! mask is sea at its center; x wraps around like the game world. A step between neighbouring nodes is open only
+//! when every coordinate of its leg is sea, so land narrower than the spacing is never stepped over. To stay quick across the whole world it is
+//! hierarchical: the grid is cut into cells of k_cellNodes x k_cellNodes nodes, the connected sea of each cell
+//! forms a region, and regions link where their sea meets across a cell border. A* first crosses the regions,
+//! which also tells at once when no route exists, then A* on the nodes is confined to the cells along that path
+//! and their neighbours. The node path is finally shortened to the fewest straight legs whose every coordinate is sea.
+class SeaRouteFinder : private Noncopyable {
+public:
+    enum : int32_t {
+        k_nodeSpacing = 4,  //!< World coordinates between neighbouring nodes
+        k_cellNodes = 16,   //!< Nodes along each side of a coarse cell
+        k_snapRadius = 32,  //!< Nodes searched around a point on land for the nearest sea
+    };
+
+    //! @brief Steps to the neighbours of a node: 4 straight ones, then 4 diagonal ones; step i ^ 1 goes back.
+    static const int32_t k_neighbourSteps[8][2];
+
+private:
+    const LandMask* m_landMask;             //!< Land and sea of the world
+    int32_t m_nodeColumns;                  //!< Nodes around the world
+    int32_t m_nodeRows;                     //!< Nodes from top to bottom
+    int32_t m_cellColumns;                  //!< Cells around the world
+    int32_t m_cellRows;                     //!< Cells from top to bottom
+    std::vector<uint16_t> m_nodeRegions;    //!< Region of every node within its cell (from 1, at most one per node of the cell), 0 for land
+    std::vector<uint8_t> m_nodeExits;       //!< Open steps out of every node (bit i for neighbour i: 4 straight, then 4 diagonal)
+    std::vector<uint32_t> m_cellRegions;    //!< Index of the first region of every cell among all regions, plus the count of all
+    std::vector<uint32_t> m_regionCells;    //!< Cell of every region
+    std::vector<uint32_t> m_linkBegin;      //!< First link of every region in m_links, plus the count of all
+    std::vector<uint32_t> m_links;          //!< Regions next to every region across a cell border
+    std::vector<int32_t> m_corridorSlots;   //!< Where the nodes of every corridor cell are kept during a search (-1 outside)
+
+public:
+    //! @brief Build the nodes and regions of a land mask; the mask is kept alive and unchanged by the caller.
+    explicit SeaRouteFinder(const LandMask& landMask);
+
+    //! @brief Get the land mask searched.
+    const LandMask& landMask() const { return *m_landMask; }
+
+    //! @brief Find the shortest sea route between two world coordinates. Points on land start or end at
+    //! the nearest sea within k_snapRadius nodes.
+    //! @param route Receives the turning points in world coordinates (x within the world), from first to last;
+    //! legs crossing the edge of the world are less than half the world wide, like those of ShipRoute
+    //! @return false if either point has no sea nearby or no sea route connects them
+    bool findRoute(const POINT& from, const POINT& to, std::vector<POINT>& route);
+
+    //! @brief Shorten a path of sea points, each in sight of the next, to the fewest legs whose every
+    //! coordinate is sea (greedy string pulling).
+    static void shortenPath(const LandMask& landMask, const std::vector<POINT>& path, std::vector<POINT>& route);
+
+    //! @brief Find the open steps of a grid of nodes every nodeSpacing world coordinates, a node being sea
+    //! when the land mask is sea at its center. A step is open when every coordinate of its leg is sea, and a
+    //! diagonal one also needs both ways around it through straight steps open, so paths never squeeze between
+    //! two corners of land.
+    //! @param exits Receives the open steps out of every node, row by row (bit i for k_neighbourSteps[i]);
+    //! land nodes have none
+    static void findExits(const LandMask& landMask, int32_t nodeSpacing, std::vector<uint8_t>& exits);
+
+private:
+    //! @brief Check whether a node is sea (x wraps around)
+    bool isSeaNode(int32_t column, int32_t row) const
+    {
+        if (row < 0 || m_nodeRows <= row) {
+            return false;
+        }
+        column = ((column % m_nodeColumns) + m_nodeColumns) % m_nodeColumns;
+        return m_nodeRegions[size_t(row) * m_nodeColumns + column] != 0;
+    }
+
+    //! @brief Label the connected sea of every cell
+    void labelRegions();
+
+    //! @brief Link the regions meeting across every cell border
+    void linkRegions();
+
+    //! @brief Find the sea node nearest to a world coordinate
+    bool nearestSeaNode(const POINT& worldCoord, POINT& node) const;
+
+    //! @brief Check whether every world coordinate on the straight leg between two points is sea
+    bool hasLineOfSight(const POINT& from, const POINT& to) const;
+};
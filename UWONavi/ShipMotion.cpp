@@ -0,0 +1,122 @@
+#include "stdafx.h"
+#include "ShipMotion.h"
+#include "UWONavi.h"
+
+namespace {
+    // How long the ship keeps being extrapolated after the last sample.
+    // Covers one late poll; after that the ship waits for telemetry instead of sailing on its own.
+    const LONG k_maxExtrapolationTime = 2000;
+
+    // Time over which the difference between prediction and a new sample is faded out
+    const LONG k_correctionTime = 300;
+
+    // Differences beyond this many world coordinates are not faded (teleport, entering a port, lost survey)
+    const double k_snapDistance = 256.0;
+
+    // Milliseconds elapsed since a timestamp, never negative
+    inline LONG s_elapsed(DWORD now, DWORD since)
+    {
+        return max(LONG(0), LONG(now - since));
+    }
+
+    // Shortest east-west difference between two x coordinates on the wrapped world
+    inline double s_wrappedDeltaX(double dx)
+    {
+        if (k_worldWidth / 2 < dx) {
+            dx -= k_worldWidth;
+        }
+        else if (dx < -k_worldWidth / 2) {
+            dx += k_worldWidth;
+        }
+        return dx;
+    }
+}
+
+
+// Add a telemetry sample
+void ShipMotion::addSample(const POINT& position, const Vector& direction, double velocity, DWORD timeStamp)
+{
+    m_errorX = 0.0;
+    m_errorY = 0.0;
+    if (m_hasSample) {
+        // Keep drawing from where the ship was predicted to be and fade toward the sample
+        double x, y;
+        predict(timeStamp, x, y);
+        const double dx = s_wrappedDeltaX(x - position.x);
+        const double dy = y - position.y;
+        if (::sqrt(dx * dx + dy * dy) < k_snapDistance) {
+            m_errorX = dx;
+            m_errorY = dy;
+        }
+    }
+
+    m_x = position.x;
+    m_y = position.y;
+    m_velocityX = 0.0;
+    m_velocityY = 0.0;
+    if (0.0 < velocity && 0.0 < direction.length()) {
+        const Vector v = direction.normalizedVector(velocity / 1000.0);
+        m_velocityX = v.x();
+        m_velocityY = v.y();
+    }
+    m_sampleTime = timeStamp;
+    m_hasSample = true;
+}
+
+
+// Forget every sample
+void ShipMotion::reset()
+{
+    *this = ShipMotion();
+}
+
+
+// Get the predicted ship position
+POINT ShipMotion::predictedPosition(DWORD now) const
+{
+    double x, y;
+    predict(now, x, y);
+    const POINT p = {
+        LONG(::floor(x + 0.5)) % k_worldWidth,
+        LONG(::floor(y + 0.5)),
+    };
+    return p;
+}
+
+
+// Check whether the predicted position still changes over time
+bool ShipMotion::isMoving(DWORD now) const
+{
+    if (!m_hasSample) {
+        return false;
+    }
+    const LONG elapsed = s_elapsed(now, m_sampleTime);
+    const bool sailing = (m_velocityX != 0.0 || m_velocityY != 0.0) && elapsed < k_maxExtrapolationTime;
+    const bool correcting = (m_errorX != 0.0 || m_errorY != 0.0) && elapsed < k_correctionTime;
+    return sailing || correcting;
+}
+
+
+// Exact predicted position in world coordinates
+void ShipMotion::predict(DWORD now, double& x, double& y) const
+{
+    if (!m_hasSample) {
+        x = m_x;
+        y = m_y;
+        return;
+    }
+
+    const LONG elapsed = s_elapsed(now, m_sampleTime);
+    const double t = min(elapsed, k_maxExtrapolationTime);
+    const double fade = max(0.0, 1.0 - double(elapsed) / k_correctionTime);
+
+    x = m_x + m_velocityX * t + m_errorX * fade;
+    y = m_y + m_velocityY * t + m_errorY * fade;
+
+    // East-west wraps around, north-south stops at the edge of the map
+    x = ::fmod(x, double(k_worldWidth));
+    if (x < 0.0) {
+        x += k_worldWidth;
+    }
+    y = max(0.0, min(double(k_worldHeight - 1), y));
+}
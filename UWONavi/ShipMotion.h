@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Windows.h>   // For POINT and DWORD
+#include "Vector.h"    // For the ship's heading
+
+//! @brief Predicts the ship position between telemetry samples.
+//! Samples arrive once per polling interval; between them the position is extrapolated along the
+//! last heading at the last velocity so the ship can be drawn at display rate. When a sample
+//! disagrees with the prediction, the difference is faded out over a short time instead of
+//! making the ship jump.
+class ShipMotion {
+private:
+    double m_x;             //!< Position of the last sample in world coordinates
+    double m_y;
+    double m_velocityX;     //!< Velocity of the last sample in world coordinates per millisecond
+    double m_velocityY;
+    double m_errorX;        //!< Prediction error at the last sample, faded out after it
+    double m_errorY;
+    DWORD m_sampleTime;     //!< Timestamp of the last sample (timeGetTime)
+    bool m_hasSample;       //!< Whether a sample has been added
+
+public:
+    ShipMotion() :
+        m_x(),
+        m_y(),
+        m_velocityX(),
+        m_velocityY(),
+        m_errorX(),
+        m_errorY(),
+        m_sampleTime(),
+        m_hasSample(false)
+    {
+    }
+
+    //! @brief Add a telemetry sample.
+    //! @param position Ship position in world coordinates
+    //! @param direction Heading of the ship (need not be normalized)
+    //! @param velocity Speed in world coordinates per second
+    //! @param timeStamp Time the sample was captured (timeGetTime)
+    void addSample(const POINT& position, const Vector& direction, double velocity, DWORD timeStamp);
+
+    //! @brief Check whether a sample has been added.
+    bool hasSample() const { return m_hasSample; }
+
+    //! @brief Forget every sample (the next one is taken as is).
+    void reset();
+
+    //! @brief Get the predicted ship position.
+    //! @param now Current time (timeGetTime)
+    //! @return The position in world coordinates, or the last sample if there is nothing to predict
+    POINT predictedPosition(DWORD now) const;
+
+    //! @brief Check whether the predicted position still changes over time.
+    //! @param now Current time (timeGetTime)
+    //! @return true while the ship is extrapolated or a correction is being faded out
+    bool isMoving(DWORD now) const;
+
+private:
+    // Exact predicted position in world coordinates
+    void predict(DWORD now, double& x, double& y) const;
+};
@@ -9,13 +9,19 @@ namespace {
     struct ChunkHeader {
         enum : uint32_t {
             k_Version1 = 1,  // Version 1 of the route data
+            k_Version2 = 2,  // Version 2: the metadata block follows the header (read only; older builds refuse it)
         };
-        const uint32_t version = k_Version1;  // Version of the data chunk
+        uint32_t version = k_Version1;  // Version of the data chunk; the metadata goes in the trailer of ShipRouteList
         uint32_t lineCount = 0;  // Number of lines in the route
     };
 
+    // The metadata block is read and written as is, so its layout is part of the file format
+    static_assert(sizeof(ShipRoute::Metadata) == 64, "bad metadata size.");
+
     const float k_worldLoopThreshold = 0.5f;  // Threshold to handle world wrapping (when crossing the world boundary)
 
+    const double k_pi = 3.14159265358979323846;
+
     // Converts a normalized point to a denormalized point with actual coordinates
     inline POINT s_denormalizedPoint(const NormalizedPoint& point)
     {
@@ -44,6 +50,9 @@ namespace {
     }
 }
 
+// One world coordinate: the rounding of polled positions, which lets straight legs zigzag by a coordinate
+const double ShipRoute::k_defaultTolerance = 1.0;
+
 // Serialize the ship route into an output stream
 std::ostream& operator<<(std::ostream& os, ShipRoute& shipRoute)
 {
@@ -52,17 +61,33 @@ std::ostream& operator<<(std::ostream& os, ShipRoute& shipRoute)
         throw std::runtime_error("output stream error.");
     }
 
-    ChunkHeader header;
-    header.lineCount = shipRoute.getLines().size();  // Set the number of lines in the route
-    os.write(reinterpret_cast<const char*>(&header), sizeof(header));  // Write the header to the stream
-
-    // Write each line in the route to the stream
-    for (const auto& line : shipRoute.getLines()) {
+    auto writeLine = [&os](const ShipRoute::Line& line) {
         const size_t count = line.size();
         os.write(reinterpret_cast<const char*>(&count), sizeof(count));  // Write the number of points in the line
         if (!line.empty()) {
             os.write(reinterpret_cast<const char*>(&line[0]), sizeof(line[0]) * line.size());  // Write the points in the line
         }
+    };
+
+    ChunkHeader header;
+    if (shipRoute.isFixed()) {
+        // Decode one packed line at a time
+        const PackedRouteLines& packedLines = shipRoute.getPackedLines();
+        header.lineCount = packedLines.lineCount();  // Set the number of lines in the route
+        os.write(reinterpret_cast<const char*>(&header), sizeof(header));  // Write the header to the stream
+        for (size_t i = 0; i < packedLines.lineCount(); ++i) {
+            const PackedRouteLines::LineView view = packedLines.line(i);
+            writeLine(ShipRoute::Line(view.begin(), view.end()));
+        }
+    }
+    else {
+        header.lineCount = shipRoute.getLines().size();  // Set the number of lines in the route
+        os.write(reinterpret_cast<const char*>(&header), sizeof(header));  // Write the header to the stream
+
+        // Write each line in the route to the stream
+        for (const auto& line : shipRoute.getLines()) {
+            writeLine(line);
+        }
     }
 
     _ASSERT(os.good());
@@ -80,12 +105,18 @@ std::istream& operator>>(std::istream& is, ShipRoute& shipRoute)
     ChunkHeader header;
     is.read(reinterpret_cast<char*>(&header), sizeof(header));  // Read the header from the stream
 
-    if (header.version != ChunkHeader::k_Version1) {
+    if (header.version != ChunkHeader::k_Version1 && header.version != ChunkHeader::k_Version2) {
         throw std::runtime_error("unknown file version.");
     }
 
+    ShipRoute::Metadata metadata;
+    if (header.version == ChunkHeader::k_Version2) {
+        is.read(reinterpret_cast<char*>(&metadata), sizeof(metadata));  // Read the metadata block
+    }
+
     shipRoute.setFavorite(true);
-    shipRoute.setFix(true);
+
+    double length = 0.0;
 
     // Read each line in the route from the stream
     for (size_t k = 0; k < header.lineCount; ++k) {
@@ -97,13 +128,23 @@ std::istream& operator>>(std::istream& is, ShipRoute& shipRoute)
             if (!shipRoute.getLines().empty() && !tmp.empty()) {
                 auto p1 = shipRoute.getLines().back().back();
                 auto p2 = tmp.front();
-                shipRoute.m_length += Vector(s_denormalizedPoint(p1), s_denormalizedPoint(p2)).length();  // Add distance between last point of the last line and first point of this line
+                length += Vector(s_denormalizedPoint(p1), s_denormalizedPoint(p2)).length();  // Add distance between last point of the last line and first point of this line
             }
-            shipRoute.m_length += s_calcLineLength(tmp);  // Add the length of the current line to the total route length
+            length += s_calcLineLength(tmp);  // Add the length of the current line to the total route length
             shipRoute.addLine(std::move(tmp));  // Add the line to the route
         }
     }
 
+    // Counts and bounds are recounted from the points just read; the length and the times come from the
+    // block, as the points kept while recording are fewer than those sailed through (version 1 has neither,
+    // they are restored from the trailer of the route list)
+    if (header.version == ChunkHeader::k_Version1) {
+        metadata.length = length;
+    }
+    shipRoute.m_metadata = metadata;
+    shipRoute.countLines(shipRoute.getLines());
+    shipRoute.setFix(true);  // Also builds the simplified levels from the loaded lines and packs them
+
     _ASSERT(is.good());
     return is;  // Return the input stream
 }
@@ -113,6 +154,10 @@ void ShipRoute::addRoutePoint(const NormalizedPoint& point)
 {
     _ASSERT(!isFixed());  // Ensure the route is not fixed before adding new points
 
+    const size_t lineCount = m_lines.size();
+    const int64_t now = int64_t(std::time(nullptr));
+    m_metadata.updatedTime = now;
+
     // If there are no lines in the route, start a new line
     if (m_lines.empty()) {
         m_lines.push_back(Line());
@@ -123,11 +168,20 @@ void ShipRoute::addRoutePoint(const NormalizedPoint& point)
     // If the line is empty, just add the first point
     if (line.empty()) {
         line.push_back(point);
+        if (m_metadata.pointCount == 0) {
+            m_metadata.createdTime = now;
+        }
+        includePoint(point, true);
+        ++m_metadata.lineCount;
+        m_lod.update(m_lines);
+        if (lineCount != m_lines.size()) {
+            ++m_revision;
+        }
         return;
     }
 
     Vector vector(s_denormalizedPoint(line.back()), s_denormalizedPoint(point));  // Create a vector between the last point and the new point
-    m_length += vector.length();  // Add the distance to the total length
+    m_metadata.length += vector.length();  // Add the distance to the total length
 
     const NormalizedPoint& prevPoint = line.back();
     if (prevPoint.isEqualValue(point)) {  // If the point is equal to the previous one, don't add it
@@ -142,6 +196,9 @@ void ShipRoute::addRoutePoint(const NormalizedPoint& point)
 
         line.push_back(leftSideSubPoint);
         m_lines.emplace(m_lines.end(), std::move(Line{ rightSideSubPoint, point }));
+        includePoint(leftSideSubPoint, true);
+        includePoint(rightSideSubPoint, true);
+        ++m_metadata.lineCount;
     }
     else if (point.x() < prevPoint.x() && (k_worldLoopThreshold <= (prevPoint.x() - point.x()))) {
         // Wrap around the world to the right
@@ -150,10 +207,188 @@ void ShipRoute::addRoutePoint(const NormalizedPoint& point)
 
         line.push_back(rightSideSubPoint);
         m_lines.emplace(m_lines.end(), std::move(Line{ leftSideSubPoint, point }));
+        includePoint(rightSideSubPoint, true);
+        includePoint(leftSideSubPoint, true);
+        ++m_metadata.lineCount;
+    }
+    else if (extendSector(point)) {
+        // Still on the same straight leg: move the last point on instead of adding one
+        line.back() = point;
+        includePoint(point, false);
+        m_lod.updateLastPoint(m_lines);
+        return;
     }
     else {
         line.push_back(point);  // Otherwise, just add the point to the line
     }
+    includePoint(point, true);
+    startSector();
+    m_lod.update(m_lines);  // Extend the simplified levels with the new point
+    if (lineCount != m_lines.size()) {
+        ++m_revision;  // Crossed the world's edge, a new line was started
+    }
+}
+
+// Fix or unfix the route, moving its points between the packed buffer and the editable lines
+void ShipRoute::setFix(bool isFixed)
+{
+    if (isFixed && !m_fixed) {
+        // The live route was simplified incrementally; redo it properly now that it can no longer grow
+        m_lod.rebuild(m_lines);
+        m_packedLines.pack(m_lines);
+        Lines().swap(m_lines);
+    }
+    else if (!isFixed && m_fixed) {
+        m_sector.valid = false;
+        m_packedLines.unpack(m_lines);
+        m_packedLines.reset();
+        m_lod.rebuild(m_lines);
+    }
+    if (m_fixed != isFixed) {
+        ++m_revision;
+    }
+    m_fixed = isFixed;
+}
+
+// Copy the full-detail lines, decoding them if the route is fixed
+void ShipRoute::copyLines(Lines& lines) const
+{
+    if (isFixed()) {
+        m_packedLines.unpack(lines);
+    }
+    else {
+        lines = m_lines;
+    }
+}
+
+// Get the bytes allocated for the full-detail points
+size_t ShipRoute::pointMemoryUsage() const
+{
+    if (isFixed()) {
+        return m_packedLines.memoryUsage();
+    }
+    size_t bytes = 0;
+    for (const Line& line : m_lines) {
+        bytes += sizeof(line) + line.capacity() * sizeof(NormalizedPoint);
+    }
+    return bytes;
+}
+
+// Start the sector from the anchor towards the last point; points nearer than the tolerance allow any direction
+void ShipRoute::startSector()
+{
+    m_sector.valid = false;
+    if (m_tolerance <= 0.0 || m_lines.empty() || m_lines.back().size() < 2) {
+        return;
+    }
+    const Line& line = m_lines.back();
+    const POINT anchor = s_denormalizedPoint(line[line.size() - 2]);
+    const POINT last = s_denormalizedPoint(line.back());
+    const double dx = double(last.x - anchor.x);
+    const double dy = double(last.y - anchor.y);
+    const double distance = ::sqrt(dx * dx + dy * dy);
+    const double spread = distance <= m_tolerance ? k_pi : ::asin(m_tolerance / distance);
+
+    m_sector.valid = true;
+    m_sector.direction = ::atan2(dy, dx);
+    m_sector.low = -spread;
+    m_sector.high = spread;
+    m_sector.reach = distance;
+}
+
+// A point in the sector, no nearer to the anchor than any point covered, keeps every covered point within
+// the tolerance of the segment from the anchor to it; its own spread then narrows the sector
+bool ShipRoute::extendSector(const NormalizedPoint& point)
+{
+    if (!m_sector.valid || m_lines.empty() || m_lines.back().size() < 2) {
+        return false;
+    }
+    const Line& line = m_lines.back();
+    const POINT anchor = s_denormalizedPoint(line[line.size() - 2]);
+    const POINT next = s_denormalizedPoint(point);
+    const double dx = double(next.x - anchor.x);
+    const double dy = double(next.y - anchor.y);
+    const double distance = ::sqrt(dx * dx + dy * dy);
+    if (distance < m_sector.reach) {
+        return false;
+    }
+    const double direction = ::remainder(::atan2(dy, dx) - m_sector.direction, 2.0 * k_pi);
+    if (direction < m_sector.low || m_sector.high < direction) {
+        return false;
+    }
+
+    const double spread = distance <= m_tolerance ? k_pi : ::asin(m_tolerance / distance);
+    m_sector.low = max(m_sector.low, direction - spread);
+    m_sector.high = min(m_sector.high, direction + spread);
+    m_sector.reach = distance;
+    return true;
+}
+
+// Recount the metadata of some lines, point by point as they were recorded
+void ShipRoute::countLines(const Lines& lines)
+{
+    m_metadata.pointCount = 0;
+    m_metadata.lineCount = 0;
+    for (const Line& line : lines) {
+        for (const NormalizedPoint& point : line) {
+            includePoint(point, true);
+        }
+        m_metadata.lineCount += line.empty() ? 0 : 1;
+    }
+}
+
+// Widen the bounding box to a point, on whichever side of it adds less width. Points past the world's
+// edges (the ends of lines crossing them) fold back into the world first.
+void ShipRoute::includePoint(const NormalizedPoint& point, bool isNew)
+{
+    float x = point.x() - ::floor(point.x());
+    if (1.0f <= x) {
+        x = 0.0f;  // A point just short of an edge can round onto the far one
+    }
+
+    if (m_metadata.pointCount == 0) {
+        m_metadata.firstPoint = point;
+        m_metadata.west = x;
+        m_metadata.span = 0.0f;
+        m_metadata.top = point.y();
+        m_metadata.bottom = point.y();
+    }
+    else {
+        float east = x - m_metadata.west;  // How far east of west the point lies, around the world
+        if (east < 0.0f) {
+            east += 1.0f;
+        }
+        if (m_metadata.span < east) {
+            const float westward = 1.0f - east;  // How far west of west it lies
+            if (westward < east - m_metadata.span) {
+                m_metadata.west = x;
+                m_metadata.span = min(m_metadata.span + westward, 1.0f);
+            }
+            else {
+                m_metadata.span = east;
+            }
+        }
+        m_metadata.top = min(m_metadata.top, point.y());
+        m_metadata.bottom = max(m_metadata.bottom, point.y());
+    }
+    m_metadata.lastPoint = point;
+    if (isNew) {
+        ++m_metadata.pointCount;
+    }
+}
+
+// Replace the lines after an edit, rebuilding the simplified levels and packing them if fixed
+void ShipRoute::replaceLines(Lines& lines)
+{
+    m_sector.valid = false;
+    countLines(lines);
+    m_lod.rebuild(lines);
+    if (isFixed()) {
+        m_packedLines.pack(lines);
+    }
+    else {
+        m_lines.swap(lines);
+    }
 }
 
 // Join the current route with another route (concatenate them)
@@ -163,20 +398,32 @@ void ShipRoute::jointPreviousLinesWithRoute(const ShipRoute& srcRoute)
     if (srcRoute.isEmptyRoute()) {
         return;
     }
+
+    Lines tmp;
+    srcRoute.copyLines(tmp);  // Get the lines from the source route
+
+    // The joined route was recorded from the start of the source route to the end of this one
+    if (srcRoute.m_metadata.createdTime != 0 && (m_metadata.createdTime == 0 || srcRoute.m_metadata.createdTime < m_metadata.createdTime)) {
+        m_metadata.createdTime = srcRoute.m_metadata.createdTime;
+    }
+    m_metadata.updatedTime = max(m_metadata.updatedTime, srcRoute.m_metadata.updatedTime);
+
+    // Add the length of the source route to the current route's total length
+    m_metadata.length += srcRoute.m_metadata.length;
+
     // If the current route is empty, just copy the source route's lines
     if (isEmptyRoute()) {
-        m_lines = srcRoute.m_lines;
+        replaceLines(tmp);
+        ++m_revision;
         return;
     }
 
-    // Add the length of the source route to the current route's total length
-    m_length += srcRoute.m_length;
-
-    Lines tmp = srcRoute.m_lines;  // Get the lines from the source route
+    Lines lines;
+    copyLines(lines);  // Get the lines of the current route
 
     // Get the last line from the source route and the first line from the current route
     Line& prevLine = tmp.back();
-    Line& nextLine = m_lines.front();
+    Line& nextLine = lines.front();
 
     // If both lines are non-empty, calculate the distance between the last point of the source route and the first point of the current route
     if (!prevLine.empty() && !nextLine.empty()) {
@@ -184,17 +431,18 @@ void ShipRoute::jointPreviousLinesWithRoute(const ShipRoute& srcRoute)
         NormalizedPoint nextPoint = nextLine.front();
 
         const double betweenLength = Vector(s_denormalizedPoint(prevPoint), s_denormalizedPoint(nextPoint)).length();
-        m_length += betweenLength;  // Add the distance between the two lines to the total length
+        m_metadata.length += betweenLength;  // Add the distance between the two lines to the total length
 
         // Handle world wrapping between the two lines
         if ((std::max(prevPoint.x(), nextPoint.x()) - std::min(prevPoint.x(), nextPoint.x())) < k_worldLoopThreshold) {
             prevLine.insert(prevLine.end(), nextLine.begin(), nextLine.end());  // Merge the two lines
-            m_lines.erase(m_lines.begin());  // Remove the first line from the current route
+            lines.erase(lines.begin());  // Remove the first line from the current route
         }
     }
 
-    tmp.insert(tmp.end(), m_lines.begin(), m_lines.end());  // Add the current route's lines to the temporary lines
-    m_lines.swap(tmp);  // Swap the current lines with the temporary lines
+    tmp.insert(tmp.end(), lines.begin(), lines.end());  // Add the current route's lines to the temporary lines
+    replaceLines(tmp);  // Lines were merged in front, the simplified levels start over
+    ++m_revision;
 
     // Set the route's favorite status based on the favorite status of the source route
     setFavorite(isFavorite() | srcRoute.isFavorite());
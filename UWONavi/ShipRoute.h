@@ -1,8 +1,11 @@
 #pragma once
 
 #include <deque>             // For using deque container to store lines
+#include <cstdint>           // For the fixed-size fields of the metadata
 #include <ctime>             // For time-related functions
 #include "NormalizedPoint.h" // For using normalized points to represent coordinates
+#include "ShipRouteLod.h"    // For the simplified levels used when zoomed out
+#include "PackedRouteLines.h" // For the points of fixed routes
 
 //! @brief Represents a ship's route with a series of points and related metadata.
 class ShipRoute {
@@ -13,12 +16,47 @@ public:
     typedef std::vector<NormalizedPoint> Line;   // Each line in the route is a vector of normalized points
     typedef std::deque<Line> Lines;                  // A deque of lines, each representing a segment of the route
 
+    static const double k_defaultTolerance;  //!< Farthest a point dropped while recording lies from the line kept
+
+    //! @brief What is known about the route as a whole, kept up to date point by point so that reading
+    //! it costs nothing, and written to the route file as is.
+    //! The bounding box wraps around the world: it spans eastwards from west, past the edge if need be.
+    struct Metadata {
+        int64_t createdTime = 0;    //!< When the first point was recorded (seconds since 1970, 0 if unknown)
+        int64_t updatedTime = 0;    //!< When the ship's position was last recorded (0 if unknown)
+        double length = 0.0;        //!< Distance sailed in world coordinates, every polled point counted
+        uint32_t pointCount = 0;    //!< Points of all lines
+        uint32_t lineCount = 0;     //!< Lines holding points; one more for every crossing of the world's edge
+        NormalizedPoint firstPoint; //!< First point of the first line
+        NormalizedPoint lastPoint;  //!< Last point of the last line
+        float west = 0.0f;          //!< Bounding box: x it spans eastwards from, in [0, 1)
+        float span = 0.0f;          //!< Bounding box: width, at most 1
+        float top = 0.0f;           //!< Bounding box: least y
+        float bottom = 0.0f;        //!< Bounding box: greatest y
+    };
+
 private:
-    Lines m_lines;            //!< Stores all the lines in the route (each line is a series of points)
-    double m_length = 0.0;    //!< The total length of the route (in the same units as the points)
+    //! @brief Directions from the anchor (the second last point of the last line) the last point may
+    //! move on in, while the last segment still passes within tolerance of every point it replaced.
+    //! Narrowed by every point it takes over, so checking a new point is O(1).
+    struct Sector {
+        bool valid = false;       //!< Whether the sector describes the last segment of the last line
+        double direction = 0.0;   //!< Direction the sector is measured from, in radians
+        double low = 0.0;         //!< Least direction allowed, relative to direction
+        double high = 0.0;        //!< Greatest direction allowed, relative to direction
+        double reach = 0.0;       //!< Distance from the anchor of the farthest point covered, in world coordinates
+    };
+
+    Lines m_lines;            //!< Stores all the lines in the route (each line is a series of points); empty once fixed
+    PackedRouteLines m_packedLines; //!< The lines of a fixed route, frozen into a compact buffer
+    Metadata m_metadata;      //!< Counts, end points, bounds, times and length of the route
     bool m_favorite = false;  //!< Flag to indicate if the route is marked as a favorite
     bool m_hilight = false;   //!< Flag to indicate if the route is highlighted
     bool m_fixed = false;     //!< Flag to indicate if the route is fixed (not editable)
+    ShipRouteLod m_lod;       //!< Simplified copies of m_lines for drawing at low zoom
+    uint32_t m_revision = 0;  //!< Bumped on every change except extending the last line with a point
+    double m_tolerance = k_defaultTolerance;  //!< Farthest a point dropped while recording lies from the line kept (0 keeps every point)
+    Sector m_sector;          //!< Where the last point of the route being recorded may move on to
 
 public:
     // Default constructor
@@ -27,16 +65,81 @@ public:
     ~ShipRoute() = default;
 
     //! @attention Add a new point to the route.
+    //! While the ship sails straight, the last point of the route moves on to the new point instead, as long
+    //! as every point passed over stays within the tolerance of the line; the length counts every point.
     //! @param point The new normalized point to add to the route.
     void addRoutePoint(const NormalizedPoint& point);
 
-    //! @brief Get the lines (segments) of the ship's route.
+    //! @brief Set how far points dropped while recording may lie from the line kept.
+    //! @param tolerance Distance in world coordinates (0 keeps every point).
+    void setTolerance(double tolerance)
+    {
+        m_tolerance = tolerance;
+    }
+
+    //! @brief Get the lines (segments) of the route being recorded.
+    //! A fixed route keeps its points packed instead; see copyLines() and getPackedLines().
     //! @return A constant reference to the lines of the route.
     const Lines& getLines() const
     {
+        _ASSERT(!isFixed());
+        return m_lines;
+    }
+
+    //! @brief Get the points of a fixed route, decoded on demand line by line.
+    const PackedRouteLines& getPackedLines() const
+    {
+        return m_packedLines;
+    }
+
+    //! @brief Copy the full-detail lines, decoding them if the route is fixed.
+    //! @param lines Receives the lines.
+    void copyLines(Lines& lines) const;
+
+    //! @brief Get the first and the last point of the route.
+    //! @return `false` if the route has no points.
+    bool getEndPoints(NormalizedPoint& first, NormalizedPoint& last) const
+    {
+        first = m_metadata.firstPoint;
+        last = m_metadata.lastPoint;
+        return m_metadata.pointCount != 0;
+    }
+
+    //! @brief Get the counts, end points, bounds, times and length of the route.
+    const Metadata& metadata() const
+    {
+        return m_metadata;
+    }
+
+    //! @brief Take the length and times of the route from metadata saved with it.
+    //! Counts, end points and bounds stay as counted from the lines.
+    void restoreMetadata(const Metadata& saved)
+    {
+        m_metadata.createdTime = saved.createdTime;
+        m_metadata.updatedTime = saved.updatedTime;
+        m_metadata.length = saved.length;
+    }
+
+    //! @brief Get the lines simplified as far as an error tolerance allows.
+    //! @param tolerance Allowed error in world coordinates (e.g. half a pixel at the current zoom).
+    //! @param decoded Receives the full-detail lines of a fixed route when they are needed.
+    //! @return The coarsest simplified lines within the tolerance, or the full-detail lines.
+    const Lines& getLinesForTolerance(double tolerance, Lines& decoded) const
+    {
+        const Lines* lines = m_lod.linesForTolerance(tolerance);
+        if (lines) {
+            return *lines;
+        }
+        if (isFixed()) {
+            m_packedLines.unpack(decoded);
+            return decoded;
+        }
         return m_lines;
     }
 
+    //! @brief Get the bytes allocated for the full-detail points.
+    size_t pointMemoryUsage() const;
+
     //! @brief Check if the route is marked as a favorite.
     //! @return `true` if the route is a favorite, `false` otherwise.
     bool isFavorite() const
@@ -48,6 +151,9 @@ public:
     //! @param favorite `true` to mark the route as a favorite, `false` to unmark it.
     void setFavorite(bool favorite)
     {
+        if (m_favorite != favorite) {
+            ++m_revision;
+        }
         m_favorite = favorite;
     }
 
@@ -62,6 +168,9 @@ public:
     //! @param hilight `true` to highlight the route, `false` to remove the highlight.
     void setHilight(bool hilight)
     {
+        if (m_hilight != hilight) {
+            ++m_revision;
+        }
         m_hilight = hilight;
     }
 
@@ -73,17 +182,7 @@ public:
     //! @return `true` if the route is empty, `false` otherwise.
     bool isEmptyRoute() const
     {
-        if (m_lines.empty()) {
-            return true;  // The route is empty if no lines exist
-        }
-
-        // Check if all lines are empty
-        for (auto line : m_lines) {
-            if (!line.empty()) {
-                return false;  // The route is not empty if any line contains points
-            }
-        }
-        return true;
+        return m_metadata.pointCount == 0;
     }
 
     //! @brief Check if the route is fixed (non-editable).
@@ -94,27 +193,51 @@ public:
     }
 
     //! @brief Set whether the route is fixed.
+    //! Fixing the route freezes its points into a compact buffer; allowing edits again decodes them.
     //! @param isFixed `true` to make the route fixed, `false` to allow edits.
-    void setFix(bool isFixed)
+    void setFix(bool isFixed);
+
+    //! @brief Get the revision of the route.
+    //! Changes whenever the route changes other than by a point appended to its last line,
+    //! which the renderer tracks through the position of the route's tail instead.
+    //! @return The current revision.
+    uint32_t revision() const
     {
-        m_fixed = isFixed;
+        return m_revision;
     }
 
     //! @brief Get the total length of the route.
     //! @return The total length of the route in the same units as the points.
     double length() const
     {
-        return m_length;
+        return m_metadata.length;
     }
 
     //! @brief Add a new line to the route (a new segment).
+    //! @note Neither the simplified levels nor the metadata are updated; callers rebuild them once all lines are added.
     //! @param line The line (a series of normalized points) to add to the route.
     void addLine(Line&& line)
     {
+        _ASSERT(!isFixed());
         m_lines.push_back(line);  // Add the line to the list of lines
     }
 
 private:
+    //! @brief Replace the lines after an edit, rebuilding the simplified levels and packing them if fixed.
+    //! The metadata is recounted from the lines; its length and times are left to the caller.
+    void replaceLines(Lines& lines);
+
+    //! @brief Recount the points, lines, end points and bounds of some lines into the metadata.
+    void countLines(const Lines& lines);
+
+    //! @brief Add a point to the metadata: counted if it is a new one, else only moving the last point.
+    void includePoint(const NormalizedPoint& point, bool isNew);
+
+    //! @brief Start the sector of the last segment of the last line.
+    void startSector();
+
+    //! @brief Check whether the last point may move on to a new point, narrowing the sector if so.
+    bool extendSector(const NormalizedPoint& point);
 };
 
 typedef std::shared_ptr<ShipRoute> ShipRoutePtr;    // A shared pointer to a ship route
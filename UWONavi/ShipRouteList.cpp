@@ -13,6 +13,19 @@ namespace {
     };
 
     typedef FileHeaderV1 FileHeader;  // Alias for the file header structure
+
+    // Trailer after the routes, followed by the metadata of every route in the same order.
+    // Readers of version 1 stop after the routes, so older builds still read the file.
+    struct MetadataTrailer {
+        enum : uint32_t {
+            k_Magic = 0x4D525755,   // "UWRM"
+            k_Version1 = 1,
+        };
+        uint32_t magic = k_Magic;
+        uint32_t version = k_Version1;
+        uint32_t routeCount = 0;  // Number of metadata blocks, one per route
+        uint32_t reserved = 0;
+    };
 }
 
 
@@ -37,6 +50,17 @@ std::ostream& operator <<(std::ostream& os, const ShipRouteList& shipRouteList)
         }
     }
 
+    // Write the metadata of the same routes after them
+    MetadataTrailer trailer;
+    trailer.routeCount = fileHeader.favoritsCount;
+    os.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+    for (const auto& shipRoute : shipRouteList.m_shipRouteList) {
+        if (shipRoute->isFavorite()) {
+            const ShipRoute::Metadata& metadata = shipRoute->metadata();
+            os.write(reinterpret_cast<const char*>(&metadata), sizeof(metadata));
+        }
+    }
+
     const auto tailPos = os.tellp();  // Get the position after writing all the routes
 
     os.seekp(headPos, std::ios::beg);  // Go back to the position of the header
@@ -72,9 +96,25 @@ std::istream& operator >>(std::istream& is, ShipRouteList& shipRouteList)
         workRouteList.push_back(std::move(shipRoute));  // Add the route to the list
     }
 
+    // Restore the length and times of the routes from the trailer, if the file has one
+    if (is.peek() != std::char_traits<char>::eof()) {
+        MetadataTrailer trailer;
+        is.read(reinterpret_cast<char*>(&trailer), sizeof(trailer));
+        if (trailer.magic == MetadataTrailer::k_Magic
+            && trailer.version == MetadataTrailer::k_Version1
+            && trailer.routeCount == fileHeader.favoritsCount) {
+            for (const auto& shipRoute : workRouteList) {
+                ShipRoute::Metadata metadata;
+                is.read(reinterpret_cast<char*>(&metadata), sizeof(metadata));
+                shipRoute->restoreMetadata(metadata);
+            }
+        }
+    }
+
     shipRouteList.m_shipRouteList.swap(workRouteList);  // Swap the new list with the current one
+    ++shipRouteList.m_revision;
 
-    _ASSERT(is.good());  // Ensure the input stream is still good after reading
+    _ASSERT(!is.fail());  // Ensure the input stream is still good after reading (it may be at the end)
     return is;  // Return the input stream
 }
 
@@ -84,6 +124,7 @@ void ShipRouteList::closeRoute()
 {
     if (!m_shipRouteList.empty()) {
         m_shipRouteList.back()->setFix(true);  // Mark the last route as fixed
+        ++m_revision;
     }
 }
 
@@ -102,6 +143,53 @@ void ShipRouteList::addRoutePoint(const NormalizedPoint point)
 }
 
 
+// Add a finished route through the given points, before the route being recorded
+void ShipRouteList::addPlannedRoute(const std::vector<NormalizedPoint>& points)
+{
+    if (points.empty()) {
+        return;
+    }
+    ShipRoutePtr shipRoute(new ShipRoute());
+    shipRoute->setTolerance(m_routeTolerance);  // Waypoints in line with their neighbours are dropped too
+    for (const auto& point : points) {
+        shipRoute->addRoutePoint(point);  // Legs crossing the edge of the world are split like recorded ones
+    }
+    shipRoute->setFix(true);
+
+    auto it = m_shipRouteList.end();
+    if (!m_shipRouteList.empty() && !m_shipRouteList.back()->isFixed()) {
+        --it;  // Keep the route being recorded last
+    }
+    m_shipRouteList.insert(it, shipRoute);
+    ++m_revision;
+
+    if (m_observer) {
+        m_observer->onShipRouteListAddRoute(shipRoute);  // Notify the observer about the new route
+    }
+}
+
+
+// Put routes loaded in the background in front of the routes recorded in the meantime
+void ShipRouteList::prependRoutes(ShipRouteList& loaded)
+{
+    if (loaded.m_shipRouteList.empty()) {
+        return;
+    }
+    RouteList added;
+    added.swap(loaded.m_shipRouteList);
+    ++loaded.m_revision;
+
+    m_shipRouteList.insert(m_shipRouteList.begin(), added.begin(), added.end());
+    ++m_revision;
+
+    if (m_observer) {
+        for (const auto& shipRoute : added) {
+            m_observer->onShipRouteListAddRoute(shipRoute);  // Notify the observer about each route added
+        }
+    }
+}
+
+
 // Remove a specific ship route from the list
 void ShipRouteList::removeShipRoute(ShipRoutePtr shipRoute)
 {
@@ -112,6 +200,7 @@ void ShipRouteList::removeShipRoute(ShipRoutePtr shipRoute)
     }
     ShipRoutePtr removeTarget = shipRoute;
     m_shipRouteList.erase(it);  // Erase the route from the list
+    ++m_revision;
 
     if (m_observer) {
         m_observer->onShipRouteListRemoveItem(removeTarget);  // Notify the observer about the route removal
@@ -123,6 +212,7 @@ void ShipRouteList::removeShipRoute(ShipRoutePtr shipRoute)
 void ShipRouteList::clearAllItems()
 {
     m_shipRouteList.clear();  // Clear the list of routes
+    ++m_revision;
     if (m_observer) {
         m_observer->onShipRouteListRemoveAllItems();  // Notify the observer that all routes have been removed
     }
@@ -134,6 +224,8 @@ void ShipRouteList::addRoute()
 {
     // Add a new empty route to the list
     m_shipRouteList.push_back(ShipRoutePtr(new ShipRoute()));
+    m_shipRouteList.back()->setTolerance(m_routeTolerance);
+    ++m_revision;
     if (m_observer) {
         m_observer->onShipRouteListAddRoute(m_shipRouteList.back());  // Notify the observer about the new route
     }
@@ -178,6 +270,7 @@ void ShipRouteList::joinPreviousRouteAtReverseIndex(int reverseIndex)
     ShipRoutePtr prevRoute = *itPrev;
 
     m_shipRouteList.erase(itPrev);  // Remove the previous route from the list
+    ++m_revision;
 
     // Handle world wrapping when joining the two routes
     bool isHilight = prevRoute->isHilight() | baseRoute->isHilight();  // Combine the highlight status of both routes
@@ -21,6 +21,8 @@ private:
     RouteList m_shipRouteList;  //!< List of ship routes
     IShipRouteListObserver* m_observer = nullptr;  //!< Observer to notify about route list changes
     size_t m_maxRouteCountWithoutFavorits = 30;  //!< Maximum number of routes allowed without favorites
+    uint32_t m_revision = 0;  //!< Bumped whenever routes are added, removed, closed or joined
+    double m_routeTolerance = ShipRoute::k_defaultTolerance;  //!< Tolerance of the routes recorded (see ShipRoute::setTolerance)
 
 public:
     ShipRouteList() = default;  // Default constructor
@@ -33,6 +35,13 @@ public:
         m_observer = observer;  // Set the observer
     }
 
+    //! @brief Set how far points dropped while recording routes may lie from the lines kept, from the next route on.
+    //! @param tolerance Distance in world coordinates (0 keeps every point)
+    void setRouteTolerance(double tolerance)
+    {
+        m_routeTolerance = tolerance;
+    }
+
     //! @brief Close the current route by marking it as fixed (non-editable).
     void closeRoute();
 
@@ -40,6 +49,18 @@ public:
     //! @param point The point to add to the route
     void addRoutePoint(const NormalizedPoint point);
 
+    //! @brief Add a finished route through the given points, such as a planned one. The route being recorded
+    //! stays last, so that new positions keep extending it.
+    //! @param points The turning points of the route, from first to last
+    void addPlannedRoute(const std::vector<NormalizedPoint>& points);
+
+    //! @brief Get the revision of the list itself (not of the routes in it).
+    //! @return The current revision
+    uint32_t revision() const
+    {
+        return m_revision;
+    }
+
     //! @brief Get the list of all ship routes.
     //! @return A constant reference to the list of ship routes
     const RouteList& getList() const
@@ -81,6 +102,10 @@ public:
     //! @brief Clear all ship routes from the list.
     void clearAllItems();
 
+    //! @brief Put routes loaded in the background in front of the routes recorded in the meantime.
+    //! @param loaded The routes read from file; left empty
+    void prependRoutes(ShipRouteList& loaded);
+
     //! @brief Join the current route with a previous route at a specific reverse index.
     //! @param reverseIndex The reverse index of the route to join with
     void joinPreviousRouteAtReverseIndex(int reverseIndex);
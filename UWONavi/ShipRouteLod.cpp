@@ -0,0 +1,223 @@
+#include "stdafx.h"
+#include "ShipRouteLod.h"
+#include "UWONavi.h"
+
+namespace {
+    // Longest run of source points a live-route segment may absorb before it is committed.
+    // Bounds the cost of one update while the ship sails straight for a long time.
+    const size_t k_maxPendingPoints = 256;
+
+    // Distance in world coordinates from a point to the segment [a, b]
+    inline double s_distanceFromSegment(const NormalizedPoint& p, const NormalizedPoint& a, const NormalizedPoint& b)
+    {
+        const double px = p.x() * k_worldWidth;
+        const double py = p.y() * k_worldHeight;
+        const double ax = a.x() * k_worldWidth;
+        const double ay = a.y() * k_worldHeight;
+        const double dx = b.x() * k_worldWidth - ax;
+        const double dy = b.y() * k_worldHeight - ay;
+
+        const double lengthSquared = dx * dx + dy * dy;
+        double t = 0.0;
+        if (0.0 < lengthSquared) {
+            t = ((px - ax) * dx + (py - ay) * dy) / lengthSquared;
+            t = max(0.0, min(1.0, t));
+        }
+        const double ex = px - (ax + t * dx);
+        const double ey = py - (ay + t * dy);
+        return ::sqrt(ex * ex + ey * ey);
+    }
+
+    // Douglas-Peucker simplification; returns the indices of the kept points in order
+    std::vector<size_t> s_simplifyLine(const ShipRouteLod::Line& line, double tolerance)
+    {
+        std::vector<size_t> kept;
+        if (line.size() <= 2) {
+            for (size_t i = 0; i < line.size(); ++i) {
+                kept.push_back(i);
+            }
+            return kept;
+        }
+
+        std::vector<bool> keep(line.size(), false);
+        keep.front() = true;
+        keep.back() = true;
+
+        // Explicit stack instead of recursion, a route line can hold tens of thousands of points
+        std::vector<std::pair<size_t, size_t>> ranges;
+        ranges.emplace_back(0, line.size() - 1);
+        while (!ranges.empty()) {
+            const size_t first = ranges.back().first;
+            const size_t last = ranges.back().second;
+            ranges.pop_back();
+
+            double farthest = 0.0;
+            size_t farthestIndex = first;
+            for (size_t i = first + 1; i < last; ++i) {
+                const double distance = s_distanceFromSegment(line[i], line[first], line[last]);
+                if (farthest < distance) {
+                    farthest = distance;
+                    farthestIndex = i;
+                }
+            }
+
+            if (tolerance < farthest) {
+                keep[farthestIndex] = true;
+                ranges.emplace_back(first, farthestIndex);
+                ranges.emplace_back(farthestIndex, last);
+            }
+        }
+
+        for (size_t i = 0; i < line.size(); ++i) {
+            if (keep[i]) {
+                kept.push_back(i);
+            }
+        }
+        return kept;
+    }
+}
+
+
+// Rebuild every level from scratch with Douglas-Peucker
+void ShipRouteLod::rebuild(const Lines& lines)
+{
+    for (size_t levelIndex = 0; levelIndex < k_levelCount; ++levelIndex) {
+        Level& level = m_levels[levelIndex];
+        level.lines.clear();
+        level.anchorIndex = 0;
+
+        for (const Line& source : lines) {
+            if (source.empty()) {
+                continue;
+            }
+            const std::vector<size_t> kept = s_simplifyLine(source, levelTolerance(levelIndex));
+
+            Line simplified;
+            simplified.reserve(kept.size());
+            for (size_t index : kept) {
+                simplified.push_back(source[index]);
+            }
+            level.lines.push_back(std::move(simplified));
+
+            // The last kept point is always the line's end; the one before it is the anchor
+            // from which update() keeps extending the line.
+            level.anchorIndex = (2 <= kept.size()) ? kept[kept.size() - 2] : 0;
+        }
+    }
+
+    m_syncedLineIndex = lines.empty() ? 0 : lines.size() - 1;
+    m_syncedPointCount = lines.empty() ? 0 : lines.back().size();
+}
+
+
+// Feed the points appended to the route since the last call into every level
+void ShipRouteLod::update(const Lines& lines)
+{
+    if (lines.empty()) {
+        return;
+    }
+    _ASSERT(m_syncedLineIndex < lines.size());
+
+    for (;;) {
+        const Line& source = lines[m_syncedLineIndex];
+        for (; m_syncedPointCount < source.size(); ++m_syncedPointCount) {
+            for (size_t levelIndex = 0; levelIndex < k_levelCount; ++levelIndex) {
+                appendPoint(m_levels[levelIndex], levelIndex, source, m_syncedPointCount);
+            }
+        }
+
+        // Stay on the last line, the next point will extend it
+        if (lines.size() <= m_syncedLineIndex + 1) {
+            break;
+        }
+        ++m_syncedLineIndex;
+        m_syncedPointCount = 0;
+    }
+}
+
+
+// The provisional last point of every level follows the moved point if the segment from the level's anchor
+// still covers the points in between; otherwise the point before it is committed, as update() would have
+void ShipRouteLod::updateLastPoint(const Lines& lines)
+{
+    if (lines.empty() || lines.back().size() < 2) {
+        return;
+    }
+    _ASSERT(m_syncedLineIndex + 1 == lines.size() && m_syncedPointCount == lines.back().size());
+
+    const Line& source = lines.back();
+    const size_t pointIndex = source.size() - 1;
+    const NormalizedPoint& point = source[pointIndex];
+    for (size_t levelIndex = 0; levelIndex < k_levelCount; ++levelIndex) {
+        Level& level = m_levels[levelIndex];
+        Line& line = level.lines.back();
+
+        bool fits = (pointIndex - level.anchorIndex) <= k_maxPendingPoints;
+        const double tolerance = levelTolerance(levelIndex);
+        for (size_t i = level.anchorIndex + 1; fits && i < pointIndex; ++i) {
+            if (tolerance < s_distanceFromSegment(source[i], source[level.anchorIndex], point)) {
+                fits = false;
+            }
+        }
+
+        if (fits) {
+            line.back() = point;
+        }
+        else {
+            line.back() = source[pointIndex - 1];
+            level.anchorIndex = pointIndex - 1;
+            line.push_back(point);
+        }
+    }
+}
+
+
+// Get the coarsest level whose error stays within a tolerance
+const ShipRouteLod::Lines* ShipRouteLod::linesForTolerance(double tolerance) const
+{
+    for (size_t levelIndex = k_levelCount; 0 < levelIndex; --levelIndex) {
+        if (levelTolerance(levelIndex - 1) <= tolerance) {
+            return &m_levels[levelIndex - 1].lines;
+        }
+    }
+    return nullptr;
+}
+
+
+// Append one source point to the last line of a level
+void ShipRouteLod::appendPoint(Level& level, size_t levelIndex, const Line& source, size_t pointIndex)
+{
+    const NormalizedPoint& point = source[pointIndex];
+
+    // First point of a new source line
+    if (pointIndex == 0) {
+        level.lines.push_back(Line{ point });
+        level.anchorIndex = 0;
+        return;
+    }
+
+    Line& line = level.lines.back();
+    if (line.size() < 2) {
+        line.push_back(point);
+        return;
+    }
+
+    // The last point of the simplified line is provisional and always follows the newest source point.
+    // Slide it forward as long as the segment from the anchor still covers every point it skips.
+    bool fits = (pointIndex - level.anchorIndex) <= k_maxPendingPoints;
+    const double tolerance = levelTolerance(levelIndex);
+    for (size_t i = level.anchorIndex + 1; fits && i < pointIndex; ++i) {
+        if (tolerance < s_distanceFromSegment(source[i], source[level.anchorIndex], point)) {
+            fits = false;
+        }
+    }
+
+    if (fits) {
+        line.back() = point;
+    }
+    else {
+        // Commit the previous point and start a new segment from it
+        level.anchorIndex = pointIndex - 1;
+        line.push_back(point);
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <deque>             // For the simplified lines of each level
+#include <vector>            // For the points of a simplified line
+#include "NormalizedPoint.h" // For route points
+
+//! @brief Level-of-detail pyramid of a ship route's lines.
+//! Level i keeps the route simplified so that no dropped point lies farther than
+//! levelTolerance(i) world coordinates from the simplified line. Tolerances double from one
+//! level to the next, so each level serves one halving of the zoom range.
+//! Fixed routes are simplified once with Douglas-Peucker; the live route is extended point by
+//! point so that polling never rebuilds the whole pyramid.
+class ShipRouteLod {
+public:
+    typedef std::vector<NormalizedPoint> Line;   // Same layout as ShipRoute::Line
+    typedef std::deque<Line> Lines;              // Same layout as ShipRoute::Lines
+
+    enum : size_t {
+        k_levelCount = 6,    //!< Number of simplified levels (tolerance 1 .. 32 world coordinates)
+    };
+
+private:
+    //! @brief Simplified lines of one level plus the state needed to extend its last line.
+    struct Level {
+        Lines lines;              //!< Simplified lines (one per source line)
+        size_t anchorIndex = 0;   //!< Source index of the last committed point of the last line
+    };
+
+    Level m_levels[k_levelCount];  //!< Levels from finest to coarsest
+    size_t m_syncedLineIndex = 0;  //!< Source line currently being extended
+    size_t m_syncedPointCount = 0; //!< Points of that source line already fed to the levels
+
+public:
+    ShipRouteLod() = default;
+    ~ShipRouteLod() = default;
+
+    //! @brief Get the tolerance of a level in world coordinates.
+    static double levelTolerance(size_t level)
+    {
+        return double(size_t(1) << level);
+    }
+
+    //! @brief Rebuild every level from scratch with Douglas-Peucker.
+    //! @param lines The route's full-detail lines
+    void rebuild(const Lines& lines);
+
+    //! @brief Feed the points appended to the route since the last call into every level.
+    //! Only valid while the route grows at its end (ShipRoute::addRoutePoint).
+    //! @param lines The route's full-detail lines
+    void update(const Lines& lines);
+
+    //! @brief Follow the last point of the route, which moved on to a newer position (see
+    //! ShipRoute::addRoutePoint) after it was fed to the levels with update().
+    //! @param lines The route's full-detail lines
+    void updateLastPoint(const Lines& lines);
+
+    //! @brief Get the coarsest level whose error stays within a tolerance.
+    //! @param tolerance Allowed error in world coordinates
+    //! @return The simplified lines, or nullptr if even the finest level is too coarse
+    const Lines* linesForTolerance(double tolerance) const;
+
+private:
+    // Append one source point to the last line of a level
+    void appendPoint(Level& level, size_t levelIndex, const Line& source, size_t pointIndex);
+};
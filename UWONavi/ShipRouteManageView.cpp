@@ -6,6 +6,8 @@
 #include "UWONavi.h"
 #include "Resource.h"
 #include "ShipRouteList.h"
+#include "PortList.h"
+#include "SeaRegionMap.h"
 
 //***********************************************************
 //                 Constants and Helper Functions
@@ -14,16 +16,38 @@ namespace {
     // This constant holds the window class name used for creation
     static const wchar_t* const k_windowClassName = L"{8DFEDF35-DD1F-4907-8BC1-12C0CD7080B5}";
 
-    // Helper function to transform the normalized point into a string
-    // It multiplies x and y by some world width/height, rounds them, and
-    // combines them into a formatted string like "123,456".
-    inline std::wstring s_makePointString(const NormalizedPoint& point)
+    // Helper function to transform the normalized point into world coordinates
+    // It multiplies x and y by the world width/height and rounds them.
+    inline POINT s_worldCoordFromPoint(const NormalizedPoint& point)
     {
-        std::wstring str;
-        str = std::to_wstring(static_cast<int>(::round(point.x() * k_worldWidth)))
-            + L","
-            + std::to_wstring(static_cast<int>(::round(point.y() * k_worldHeight)));
-        return std::move(str);
+        POINT worldCoord;
+        worldCoord.x = static_cast<LONG>(::round(point.x() * k_worldWidth));
+        worldCoord.y = static_cast<LONG>(::round(point.y() * k_worldHeight));
+        return worldCoord;
+    }
+
+    // Helper function to describe a point for tooltips: the nearby port with the
+    // coordinates, like "Lisbon (123,456)", or only the coordinates, like "123,456".
+    inline std::wstring s_makePlaceString(const PortList& portList, const NormalizedPoint& point)
+    {
+        const POINT worldCoord = s_worldCoordFromPoint(point);
+        std::wstring str = std::to_wstring(worldCoord.x) + L"," + std::to_wstring(worldCoord.y);
+        if (const Port* port = portList.findNearest(worldCoord)) {
+            str = port->name + L" (" + str + L")";
+        }
+        return str;
+    }
+
+    // Helper function to describe a time of the route metadata for tooltips, like "2024-05-01 13:45".
+    inline std::wstring s_makeTimeString(int64_t time)
+    {
+        const time_t value = static_cast<time_t>(time);
+        tm local = {};
+        wchar_t buf[32] = {};
+        if (::localtime_s(&local, &value) != 0 || ::wcsftime(buf, _countof(buf), L"%Y-%m-%d %H:%M", &local) == 0) {
+            return L"-";
+        }
+        return buf;
     }
 }
 
@@ -38,10 +62,12 @@ ShipRouteManageView::~ShipRouteManageView()
 //***********************************************************
 //          Setup and Teardown Methods
 //***********************************************************
-bool ShipRouteManageView::setup(ShipRouteList& shipRouteList)
+bool ShipRouteManageView::setup(ShipRouteList& shipRouteList, const PortList& portList, SeaRegionMap& seaRegionMap)
 {
-    // Store the provided route list pointer and create the dialog.
+    // Store the provided route list, port list and sea area pointers and create the dialog.
     m_routeList = &shipRouteList;
+    m_portList = &portList;
+    m_seaRegionMap = &seaRegionMap;
     m_hwnd = ::CreateDialogParam(
         g_hinst,
         MAKEINTRESOURCE(IDD_SHIPROUTEMANAGEVIEW),
@@ -263,29 +289,28 @@ void ShipRouteManageView::onNotify(LPNMHDR nmh)
             // Fill in text for different columns based on route data
             if (item.mask & LVIF_TEXT) {
                 std::wstring str;
+                NormalizedPoint firstPoint;
+                NormalizedPoint lastPoint;
+                const bool hasPoints = route->getEndPoints(firstPoint, lastPoint);
                 switch (item.iSubItem) {
                 case k_ColumnIndex_StartPoint:
-                    if (route->getLines().empty()) {
+                    if (!hasPoints) {
                         str = L"-";
                     }
                     else {
-                        if (!route->getLines().front().empty()) {
-                            str = s_makePointString(route->getLines().front().front());
-                        }
+                        str = m_portList->placeName(s_worldCoordFromPoint(firstPoint));
                     }
                     break;
                 case k_ColumnIndex_EndPoint:
-                    if (route->getLines().empty()) {
+                    if (!hasPoints) {
                         str = L"-";
                     }
                     else {
-                        if (!route->getLines().back().empty()) {
-                            str = s_makePointString(route->getLines().back().back());
-                        }
+                        str = m_portList->placeName(s_worldCoordFromPoint(lastPoint));
                     }
                     break;
                 case k_ColumnIndex_Length:
-                    if (route->getLines().empty()) {
+                    if (!hasPoints) {
                         str = L"-";
                     }
                     else {
@@ -296,7 +321,7 @@ void ShipRouteManageView::onNotify(LPNMHDR nmh)
                 default:
                     break;
                 }
-                ::lstrcpy(item.pszText, str.c_str());
+                ::lstrcpyn(item.pszText, str.c_str(), item.cchTextMax);
             }
 
             // Assign an image index for the favorite (star) or blank icon
@@ -311,6 +336,34 @@ void ShipRouteManageView::onNotify(LPNMHDR nmh)
         }
         break;
 
+        case LVN_GETINFOTIP:
+        {
+            // Shows the ports and coordinates of both ends of the route under the cursor,
+            // and the sea areas it passes through
+            LPNMLVGETINFOTIP infoTip = reinterpret_cast<LPNMLVGETINFOTIP>(nmh);
+            ShipRoutePtr route = m_routeList->getRouteAtReverseIndex(infoTip->iItem);
+            NormalizedPoint firstPoint;
+            NormalizedPoint lastPoint;
+            if (!route || !route->getEndPoints(firstPoint, lastPoint)) {
+                break;
+            }
+            std::wstring str = L"Departure: " + s_makePlaceString(*m_portList, firstPoint)
+                + L"\nArrival: " + s_makePlaceString(*m_portList, lastPoint);
+            const ShipRoute::Metadata& metadata = route->metadata();
+            if (metadata.createdTime != 0) {
+                str += L"\nRecorded: " + s_makeTimeString(metadata.createdTime) + L" - " + s_makeTimeString(metadata.updatedTime);
+            }
+            ShipRoute::Lines lines;
+            route->copyLines(lines);
+            std::vector<uint8_t> regions;
+            m_seaRegionMap->regionsCrossed(lines, regions);
+            for (size_t i = 0; i < regions.size(); ++i) {
+                str += (i == 0 ? L"\nSeas: " : L", ") + m_seaRegionMap->regionName(regions[i]);
+            }
+            ::lstrcpyn(infoTip->pszText, str.c_str(), infoTip->cchTextMax);
+        }
+        break;
+
         case NM_RCLICK:
             // On right-click, display a context menu for the selected route if its valid.
             if (ShipRoutePtr selectedRoute = m_selectedRoute.lock()) {
@@ -385,7 +438,7 @@ void ShipRouteManageView::setupRouteList()
     m_listViewCtrl = ::GetDlgItem(m_hwnd, IDC_SHIPROUTELIST);
 
     // Configure extended styles for the ListView
-    DWORD exStyle = LVS_EX_GRIDLINES | LVS_EX_FULLROWSELECT;
+    DWORD exStyle = LVS_EX_GRIDLINES | LVS_EX_FULLROWSELECT | LVS_EX_INFOTIP;
     ListView_SetExtendedListViewStyle(m_listViewCtrl, exStyle);
 
     // Create an image list and add two icons (blank and star).
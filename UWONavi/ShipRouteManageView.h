@@ -2,6 +2,9 @@
 #include "Noncopyable.h"
 #include "ShipRouteList.h"
 
+class PortList;
+class SeaRegionMap;
+
 //! @brief A view that manages and interacts with a list of ship routes.
 class ShipRouteManageView : private Noncopyable, public IShipRouteListObserver {
 private:
@@ -20,6 +23,8 @@ private:
 
     HWND m_hwnd = nullptr;                  //!< Handle to the window (for GUI interactions)
     ShipRouteList* m_routeList = nullptr;  //!< Pointer to the list of ship routes
+    const PortList* m_portList = nullptr;  //!< Ports naming the start and end of the routes
+    SeaRegionMap* m_seaRegionMap = nullptr; //!< Sea areas the routes pass through
 
     HWND m_listViewCtrl = nullptr;         //!< Handle to the list view control (UI element)
     int m_selectionIndex = -1;             //!< Index of the currently selected route (if any)
@@ -33,7 +38,9 @@ public:
 
     //! @brief Initializes the route view with the provided route list.
     //! @param shipRouteList The list of ship routes to be managed
-    bool setup(ShipRouteList& shipRouteList);
+    //! @param portList The ports to name the start and end of the routes after
+    //! @param seaRegionMap The sea areas to list for every route
+    bool setup(ShipRouteList& shipRouteList, const PortList& portList, SeaRegionMap& seaRegionMap);
 
     //! @brief Cleans up resources and terminates the route view.
     void teardown();
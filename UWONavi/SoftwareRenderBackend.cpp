@@ -0,0 +1,500 @@
+#include "stdafx.h"
+#include "SoftwareRenderBackend.h"
+#include "Image.h"
+
+
+namespace {
+	// Same background as the GL backend: (0.2, 0.2, 0.3, 0.0)
+	const uint32_t k_clearPixel = 0x0033334D;
+
+	// Largest layer the backend allocates; only there to keep a broken frame from exhausting memory
+	const LONG k_maxLayerExtent = 16384;
+
+	// A glyph of the speed meter text: 5 x 7 pixels, the leftmost one in bit 4 of each row
+	struct Glyph {
+		wchar_t character;
+		uint8_t rows[7];
+	};
+
+	// Every character the speed meter writes; any other one is left blank
+	const Glyph k_glyphs[] = {
+		{ L'0', { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E } },
+		{ L'1', { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+		{ L'2', { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F } },
+		{ L'3', { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E } },
+		{ L'4', { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 } },
+		{ L'5', { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E } },
+		{ L'6', { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E } },
+		{ L'7', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 } },
+		{ L'8', { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E } },
+		{ L'9', { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C } },
+		{ L'.', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C } },
+		{ L':', { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 } },
+		{ L'-', { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 } },
+		{ L'a', { 0x00, 0x00, 0x0E, 0x01, 0x0F, 0x11, 0x0F } },
+		{ L'd', { 0x01, 0x01, 0x0D, 0x13, 0x11, 0x11, 0x0F } },
+		{ L'k', { 0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12 } },
+		{ L'l', { 0x0C, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+		{ L'm', { 0x00, 0x00, 0x1A, 0x15, 0x15, 0x11, 0x11 } },
+		{ L'n', { 0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11 } },
+		{ L't', { 0x08, 0x08, 0x1C, 0x08, 0x08, 0x09, 0x06 } },
+	};
+
+	// Glyph pixels are drawn this many pixels wide and high, about the size of the system font
+	const LONG k_glyphScale = 2;
+
+	// Glyph pixels from one character to the next, and from the top of the text to the bottom,
+	// with a pixel of margin around the glyphs
+	const LONG k_glyphAdvance = 6;
+	const LONG k_glyphLineHeight = 9;
+
+	inline uint32_t s_channel( uint32_t pixel, int shift )
+	{
+		return (pixel >> shift) & 0xFF;
+	}
+
+	inline uint32_t s_toByte( float value )
+	{
+		return uint32_t( max( 0.0f, min( 1.0f, value ) ) * 255.0f + 0.5f );
+	}
+
+	// Pixel of an RGB or RGBA image as 0xAARRGGBB (RGB images are opaque)
+	inline uint32_t s_imagePixel( const Image& image, LONG x, LONG y )
+	{
+		const uint8_t * row = image.imageBits() + y * image.stride();
+		if ( image.pixelFormat() == k_PixelFormat_RGBA ) {
+			const uint8_t * p = row + x * 4;
+			return (uint32_t( p[3] ) << 24) | (uint32_t( p[2] ) << 16) | (uint32_t( p[1] ) << 8) | p[0];
+		}
+		const uint8_t * p = row + x * 3;
+		return 0xFF000000 | (uint32_t( p[2] ) << 16) | (uint32_t( p[1] ) << 8) | p[0];
+	}
+
+	// src * a + dst * (1 - a) for every channel; alpha blends the same way unless the target is premultiplied,
+	// where it accumulates coverage (the GL backend's glBlendFuncSeparate with GL_ONE for alpha)
+	inline uint32_t s_blend( uint32_t dst, uint32_t src, bool premultiplied )
+	{
+		const uint32_t a = s_channel( src, 24 );
+		const uint32_t inv = 255 - a;
+		uint32_t out = 0;
+		for ( int shift = 0; shift < 24; shift += 8 ) {
+			out |= ((s_channel( src, shift ) * a + s_channel( dst, shift ) * inv + 127) / 255) << shift;
+		}
+		const uint32_t srcAlpha = premultiplied ? 255 * a : a * a;
+		out |= ((srcAlpha + s_channel( dst, 24 ) * inv + 127) / 255) << 24;
+		return out;
+	}
+
+	// src + dst * (1 - src alpha), for compositing a premultiplied layer
+	inline uint32_t s_blendPremultiplied( uint32_t dst, uint32_t src )
+	{
+		const uint32_t inv = 255 - s_channel( src, 24 );
+		uint32_t out = 0;
+		for ( int shift = 0; shift < 32; shift += 8 ) {
+			out |= min<uint32_t>( 255, s_channel( src, shift ) + (s_channel( dst, shift ) * inv + 127) / 255 ) << shift;
+		}
+		return out;
+	}
+
+	// First pixel whose center is at or after a coordinate
+	inline LONG s_firstPixel( float coord )
+	{
+		return LONG( ::ceil( coord - 0.5f ) );
+	}
+
+	// Twice the signed area of the triangle (a, b, p); its sign tells the side of a->b that p is on.
+	// Computed from the endpoints in a fixed order, so an edge shared by two triangles gives
+	// exactly opposite values in both and no pixel center on it is drawn twice or missed.
+	inline float s_edge( float ax, float ay, float bx, float by, float px, float py )
+	{
+		if ( bx < ax || (bx == ax && by < ay) ) {
+			return -((ax - bx) * (py - by) - (ay - by) * (px - bx));
+		}
+		return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+	}
+
+	// Whether a pixel center exactly on an edge belongs to the triangle on its positive side;
+	// of the two directions of a shared edge, exactly one does.
+	inline bool s_ownsEdge( float ax, float ay, float bx, float by )
+	{
+		return ay < by || (ay == by && bx < ax);
+	}
+}
+
+
+void SoftwareRenderBackend::Surface::resize( const SIZE& newSize )
+{
+	size = newSize;
+	pixels.resize( size_t( max<LONG>( 0, size.cx ) ) * size_t( max<LONG>( 0, size.cy ) ) );
+}
+
+
+void SoftwareRenderBackend::teardown()
+{
+	m_framebuffer = Surface();
+	m_routeLayer = Surface();
+	m_snapshot = Surface();
+	m_hasSnapshot = false;
+	m_speedMeter = Surface();
+	m_speedMeterText.clear();
+	m_worldMap = NULL;
+}
+
+
+RenderBackend::Capabilities SoftwareRenderBackend::capabilities() const
+{
+	Capabilities capabilities = { true, k_maxLayerExtent, true };
+	return capabilities;
+}
+
+
+void SoftwareRenderBackend::drawFrame( const FrameDescription& frame )
+{
+	if ( frame.routeLayerRedraw ) {
+		m_routeLayer.resize( frame.routeLayerSize );
+		clear( m_routeLayer, 0 );
+		drawLineBatches( m_routeLayer, frame.routeLayerBatches, true );
+	}
+
+	m_framebuffer.resize( frame.viewSize );
+	clear( m_framebuffer, k_clearPixel );
+	drawWorldMap( frame );
+
+	if ( frame.preview ) {
+		// Parts the snapshot does not cover keep the bare map until the full frame
+		drawSnapshot( frame );
+	}
+	else {
+		if ( frame.routeLayerEnabled ) {
+			drawRouteLayer( frame );
+		}
+
+		// Routes not in the layer and the course line
+		drawLineBatches( m_framebuffer, frame.lineBatches, false );
+
+		// The ship marker and the speed meter are left out, previews draw them where they are then
+		if ( frame.captureSnapshot ) {
+			m_snapshot = m_framebuffer;
+			m_snapshotLayout = frame.layout;
+			m_hasSnapshot = true;
+		}
+	}
+
+	if ( frame.shipIcon ) {
+		drawShipMarkers( frame );
+	}
+
+	if ( !frame.speedText.empty() ) {
+		drawSpeedMeter( frame );
+	}
+}
+
+
+uint64_t SoftwareRenderBackend::frameChecksum() const
+{
+	uint64_t hash = 14695981039346656037ULL;
+	auto combine = [&hash]( uint64_t value ) {
+		hash = (hash ^ value) * 1099511628211ULL;
+	};
+	combine( uint64_t( m_framebuffer.size.cx ) );
+	combine( uint64_t( m_framebuffer.size.cy ) );
+	for ( const uint32_t pixel : m_framebuffer.pixels ) {
+		combine( pixel );
+	}
+	return hash;
+}
+
+
+void SoftwareRenderBackend::clear( Surface& surface, uint32_t pixel )
+{
+	std::fill( surface.pixels.begin(), surface.pixels.end(), pixel );
+}
+
+
+void SoftwareRenderBackend::drawWorldMap( const FrameDescription& frame )
+{
+	if ( !m_worldMap ) {
+		// No map has been set yet
+		return;
+	}
+
+	// Nearest sampling with the map repeating horizontally, the same as the GL texture;
+	// the source column only depends on the view column, so it is looked up once per frame.
+	const MapLayout& layout = frame.layout;
+	const Image& image = *m_worldMap;
+	const SIZE& size = m_framebuffer.size;
+
+	std::vector<LONG> columns( size.cx );
+	for ( LONG x = 0; x < size.cx; ++x ) {
+		const float s = (x + 0.5f - layout.x) / layout.width;
+		LONG column = LONG( ::floor( (s - ::floor( s )) * image.width() ) );
+		columns[x] = min( column, image.width() - 1 );
+	}
+
+	const LONG top = max<LONG>( 0, s_firstPixel( layout.y ) );
+	const LONG bottom = min<LONG>( size.cy, s_firstPixel( layout.y + layout.height ) );
+	for ( LONG y = top; y < bottom; ++y ) {
+		const float t = (y + 0.5f - layout.y) / layout.height;
+		const LONG row = min( LONG( t * image.height() ), image.height() - 1 );
+		uint32_t * dst = &m_framebuffer.pixels[size_t( y ) * size.cx];
+		for ( LONG x = 0; x < size.cx; ++x ) {
+			dst[x] = s_imagePixel( image, columns[x], row );
+		}
+	}
+}
+
+
+void SoftwareRenderBackend::drawLineBatches( Surface& surface, const std::vector<LineBatch>& batches, bool premultiplied )
+{
+	for ( const LineBatch& batch : batches ) {
+		for ( size_t i = 0; i + 3 < batch.vertices.size(); i += 4 ) {
+			drawLine( surface, batch,
+				batch.vertices[i], batch.vertices[i + 1],
+				batch.vertices[i + 2], batch.vertices[i + 3],
+				premultiplied );
+		}
+		drawMeshes( surface, batch, premultiplied );
+	}
+}
+
+
+void SoftwareRenderBackend::drawMeshes( Surface& surface, const LineBatch& batch, bool premultiplied )
+{
+	static const std::vector<uint16_t> indices = LineMesh::meshIndices( LineMesh::k_maxPoints - 1 );
+
+	for ( const MeshDraw& draw : batch.meshes ) {
+		const LineMesh& mesh = *draw.mesh;
+		_ASSERT( mesh.pointCount() <= LineMesh::k_maxPoints );
+
+		const size_t indexCount = (mesh.pointCount() - 1) * LineMesh::k_indicesPerSegment;
+		for ( size_t i = 0; i < indexCount; i += 3 ) {
+			float x[3], y[3], coverage[3];
+			for ( int v = 0; v < 3; ++v ) {
+				const uint16_t index = indices[i + v];
+				x[v] = mesh.vertices[index * 2] + draw.x;
+				y[v] = mesh.vertices[index * 2 + 1] + draw.y;
+				coverage[v] = mesh.coverage[index];
+			}
+			drawTriangle( surface, batch, x, y, coverage, premultiplied );
+		}
+	}
+}
+
+
+void SoftwareRenderBackend::drawTriangle( Surface& surface, const LineBatch& batch, const float * x, const float * y, const float * coverage, bool premultiplied )
+{
+	float area = s_edge( x[0], y[0], x[1], y[1], x[2], y[2] );
+	if ( area == 0.0f ) {
+		return;
+	}
+
+	// Order the vertices so that the inside is on the positive side of every edge
+	int order[3] = { 0, 1, 2 };
+	if ( area < 0.0f ) {
+		std::swap( order[1], order[2] );
+		area = -area;
+	}
+	float vx[3], vy[3], vc[3];
+	for ( int v = 0; v < 3; ++v ) {
+		vx[v] = x[order[v]];
+		vy[v] = y[order[v]];
+		vc[v] = coverage[order[v]];
+	}
+
+	const LONG left = max<LONG>( 0, s_firstPixel( min( vx[0], min( vx[1], vx[2] ) ) ) );
+	const LONG right = min<LONG>( surface.size.cx, s_firstPixel( max( vx[0], max( vx[1], vx[2] ) ) ) + 1 );
+	const LONG top = max<LONG>( 0, s_firstPixel( min( vy[0], min( vy[1], vy[2] ) ) ) );
+	const LONG bottom = min<LONG>( surface.size.cy, s_firstPixel( max( vy[0], max( vy[1], vy[2] ) ) ) + 1 );
+
+	// Edge i runs between the two vertices other than i, so its value weights vertex i
+	bool owns[3];
+	for ( int e = 0; e < 3; ++e ) {
+		const int a = (e + 1) % 3;
+		const int b = (e + 2) % 3;
+		owns[e] = s_ownsEdge( vx[a], vy[a], vx[b], vy[b] );
+	}
+
+	const uint32_t rgb = (s_toByte( batch.color[0] ) << 16) | (s_toByte( batch.color[1] ) << 8) | s_toByte( batch.color[2] );
+	for ( LONG py = top; py < bottom; ++py ) {
+		const float cy = py + 0.5f;
+		uint32_t * row = &surface.pixels[size_t( py ) * surface.size.cx];
+		for ( LONG px = left; px < right; ++px ) {
+			const float cx = px + 0.5f;
+			float w[3];
+			bool inside = true;
+			for ( int e = 0; e < 3 && inside; ++e ) {
+				const int a = (e + 1) % 3;
+				const int b = (e + 2) % 3;
+				w[e] = s_edge( vx[a], vy[a], vx[b], vy[b], cx, cy );
+				inside = 0.0f < w[e] || (w[e] == 0.0f && owns[e]);
+			}
+			if ( !inside ) {
+				continue;
+			}
+
+			const float pixelCoverage = (w[0] * vc[0] + w[1] * vc[1] + w[2] * vc[2]) / area;
+			const uint32_t src = (s_toByte( batch.color[3] * pixelCoverage ) << 24) | rgb;
+			row[px] = s_blend( row[px], src, premultiplied );
+		}
+	}
+}
+
+
+void SoftwareRenderBackend::drawLine( Surface& surface, const LineBatch& batch, float x1, float y1, float x2, float y2, bool premultiplied )
+{
+	const uint32_t src = (s_toByte( batch.color[3] ) << 24) | (s_toByte( batch.color[0] ) << 16)
+		| (s_toByte( batch.color[1] ) << 8) | s_toByte( batch.color[2] );
+
+	// Like GL wide lines: along the major axis, every pixel whose center the segment passes
+	// gets a span of width pixels across it, centered on the segment.
+	const bool xMajor = ::fabs( y2 - y1 ) <= ::fabs( x2 - x1 );
+	if ( !xMajor ) {
+		std::swap( x1, y1 );
+		std::swap( x2, y2 );
+	}
+	if ( x2 < x1 ) {
+		std::swap( x1, x2 );
+		std::swap( y1, y2 );
+	}
+	if ( x1 == x2 ) {
+		return;
+	}
+
+	const LONG majorExtent = xMajor ? surface.size.cx : surface.size.cy;
+	const LONG minorExtent = xMajor ? surface.size.cy : surface.size.cx;
+	const LONG span = max<LONG>( 1, LONG( batch.width + 0.5f ) );
+	const float slope = (y2 - y1) / (x2 - x1);
+
+	const LONG first = max<LONG>( 0, s_firstPixel( x1 ) );
+	const LONG last = min<LONG>( majorExtent, s_firstPixel( x2 ) );
+	for ( LONG major = first; major < last; ++major ) {
+		const float center = y1 + (major + 0.5f - x1) * slope;
+		const LONG spanFirst = max<LONG>( 0, s_firstPixel( center - span / 2.0f ) );
+		const LONG spanLast = min<LONG>( minorExtent, s_firstPixel( center - span / 2.0f ) + span );
+		for ( LONG minor = spanFirst; minor < spanLast; ++minor ) {
+			const size_t index = xMajor
+				? size_t( minor ) * surface.size.cx + major
+				: size_t( major ) * surface.size.cx + minor;
+			uint32_t& dst = surface.pixels[index];
+			dst = batch.blend ? s_blend( dst, src, premultiplied ) : src;
+		}
+	}
+}
+
+
+void SoftwareRenderBackend::drawRouteLayer( const FrameDescription& frame )
+{
+	const SIZE& size = m_framebuffer.size;
+	const POINT& origin = frame.routeLayerOrigin;
+	const LONG left = max<LONG>( 0, origin.x );
+	const LONG right = min<LONG>( size.cx, origin.x + m_routeLayer.size.cx );
+	const LONG top = max<LONG>( 0, origin.y );
+	const LONG bottom = min<LONG>( size.cy, origin.y + m_routeLayer.size.cy );
+	for ( LONG y = top; y < bottom; ++y ) {
+		const uint32_t * src = &m_routeLayer.pixels[size_t( y - origin.y ) * m_routeLayer.size.cx];
+		uint32_t * dst = &m_framebuffer.pixels[size_t( y ) * size.cx];
+		for ( LONG x = left; x < right; ++x ) {
+			// Most of the layer is empty
+			const uint32_t pixel = src[x - origin.x];
+			if ( pixel != 0 ) {
+				dst[x] = s_blendPremultiplied( dst[x], pixel );
+			}
+		}
+	}
+}
+
+
+void SoftwareRenderBackend::drawSnapshot( const FrameDescription& frame )
+{
+	const SIZE& size = m_snapshot.size;
+	if ( !m_hasSnapshot || size.cx != frame.viewSize.cx || size.cy != frame.viewSize.cy ) {
+		return;
+	}
+
+	// Same placement as the GL backend's snapshot quad
+	const MapLayout& from = m_snapshotLayout;
+	const MapLayout& to = frame.layout;
+	const float scale = to.width / from.width;
+	const float width = size.cx * scale;
+	const float height = size.cy * scale;
+	float left = to.x - from.x * scale;
+	const float top = to.y - from.y * scale;
+	left += to.width * ::floor( ((size.cx - width) / 2.0f - left) / to.width + 0.5f );
+
+	const LONG xFirst = max<LONG>( 0, s_firstPixel( left ) );
+	const LONG xLast = min<LONG>( size.cx, s_firstPixel( left + width ) );
+	const LONG yFirst = max<LONG>( 0, s_firstPixel( top ) );
+	const LONG yLast = min<LONG>( size.cy, s_firstPixel( top + height ) );
+	for ( LONG y = yFirst; y < yLast; ++y ) {
+		const LONG sy = min( size.cy - 1, LONG( (y + 0.5f - top) / scale ) );
+		const uint32_t * src = &m_snapshot.pixels[size_t( sy ) * size.cx];
+		uint32_t * dst = &m_framebuffer.pixels[size_t( y ) * size.cx];
+		for ( LONG x = xFirst; x < xLast; ++x ) {
+			dst[x] = src[min( size.cx - 1, LONG( (x + 0.5f - left) / scale ) )];
+		}
+	}
+}
+
+
+void SoftwareRenderBackend::drawShipMarkers( const FrameDescription& frame )
+{
+	const Image& icon = *frame.shipIcon;
+	const LONG markSize = FrameDescription::k_shipMarkSize;
+	const SIZE& size = m_framebuffer.size;
+	for ( const POINT& marker : frame.shipMarkers ) {
+		for ( LONG y = max<LONG>( 0, marker.y ); y < min<LONG>( size.cy, marker.y + markSize ); ++y ) {
+			const LONG row = (y - marker.y) * icon.height() / markSize;
+			for ( LONG x = max<LONG>( 0, marker.x ); x < min<LONG>( size.cx, marker.x + markSize ); ++x ) {
+				const LONG column = (x - marker.x) * icon.width() / markSize;
+				uint32_t& dst = m_framebuffer.pixels[size_t( y ) * size.cx + x];
+				dst = s_blend( dst, s_imagePixel( icon, column, row ), false );
+			}
+		}
+	}
+}
+
+
+void SoftwareRenderBackend::drawSpeedMeterText( const std::wstring& text, Surface& surface )
+{
+	const LONG width = (LONG( text.size() ) * k_glyphAdvance + 1) * k_glyphScale;
+	const SIZE size = { width + (4 - width % 4) % 4, k_glyphLineHeight * k_glyphScale };
+	surface.resize( size );
+	clear( surface, 0xFFFFFFFF );
+
+	for ( size_t i = 0; i < text.size(); ++i ) {
+		const Glyph * glyph = std::find_if( std::begin( k_glyphs ), std::end( k_glyphs ),
+			[&]( const Glyph& g ) { return g.character == text[i]; } );
+		if ( glyph == std::end( k_glyphs ) ) {
+			continue;
+		}
+		const LONG left = (1 + LONG( i ) * k_glyphAdvance) * k_glyphScale;
+		for ( LONG y = 0; y < 7 * k_glyphScale; ++y ) {
+			const uint8_t row = glyph->rows[y / k_glyphScale];
+			uint32_t * dst = &surface.pixels[size_t( k_glyphScale + y ) * size.cx + left];
+			for ( LONG x = 0; x < 5 * k_glyphScale; ++x ) {
+				if ( (row >> (4 - x / k_glyphScale)) & 1 ) {
+					dst[x] = 0xFF000000;
+				}
+			}
+		}
+	}
+}
+
+
+void SoftwareRenderBackend::drawSpeedMeter( const FrameDescription& frame )
+{
+	// The text only changes when the speed does, so keep its pixels until then
+	if ( m_speedMeter.pixels.empty() || frame.speedText != m_speedMeterText ) {
+		drawSpeedMeterText( frame.speedText, m_speedMeter );
+		m_speedMeterText = frame.speedText;
+	}
+
+	const SIZE& size = m_framebuffer.size;
+	const SIZE& meterSize = m_speedMeter.size;
+	const LONG left = size.cx - meterSize.cx;
+	for ( LONG y = 0; y < min( size.cy, meterSize.cy ); ++y ) {
+		for ( LONG x = max<LONG>( 0, left ); x < size.cx; ++x ) {
+			m_framebuffer.pixels[size_t( y ) * size.cx + x] = m_speedMeter.pixels[size_t( y ) * meterSize.cx + x - left];
+		}
+	}
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "RenderBackend.h"  // For the interface implemented here
+#include <cstdint>          // For pixel values
+#include <string>           // For the speed meter text
+#include <vector>           // For the framebuffers
+
+// Draws frames into a framebuffer in memory, without a window or an OpenGL context.
+// Rasterizes the same frame descriptions the GL backend draws, following the GL rules closely
+// enough for benchmarks and golden-image checks: nearest texture sampling, wide lines as
+// column or row spans, route meshes as triangles with interpolated coverage, the route layer
+// kept premultiplied, and the snapshot scaled for previews. The speed meter text is drawn with
+// built-in glyphs instead of a system font, so frames are the same on every machine.
+// Pixels are 0xAARRGGBB, rows run top-down.
+class SoftwareRenderBackend : public RenderBackend {
+private:
+    // A buffer of pixels
+    struct Surface {
+        SIZE size;                      //!< Width and height in pixels
+        std::vector<uint32_t> pixels;   //!< Rows top-down, no padding
+
+        // Resize the surface, keeping its capacity
+        void resize(const SIZE& newSize);
+    };
+
+    const Image* m_worldMap;          //!< World map image (kept alive by the caller)
+    Surface m_framebuffer;            //!< The last frame drawn
+    Surface m_routeLayer;             //!< Fixed routes around the view, premultiplied alpha
+    Surface m_snapshot;               //!< Map and routes of the last full frame
+    MapLayout m_snapshotLayout;       //!< Map placement of the last full frame
+    bool m_hasSnapshot;               //!< Whether m_snapshot holds a frame
+    Surface m_speedMeter;             //!< Speed meter text, rebuilt only when the text changes
+    std::wstring m_speedMeterText;    //!< Text currently in m_speedMeter
+
+public:
+    SoftwareRenderBackend() :
+        m_worldMap(),
+        m_framebuffer(),
+        m_routeLayer(),
+        m_snapshot(),
+        m_snapshotLayout(),
+        m_hasSnapshot(false),
+        m_speedMeter(),
+        m_speedMeterText()
+    {
+    }
+
+    virtual void setup() {}
+
+    // Release the framebuffers
+    virtual void teardown();
+
+    // Every feature is available, layers are only limited by memory
+    virtual Capabilities capabilities() const;
+
+    // Keep the world map; blocks are of no use to sampling on the CPU
+    virtual void setWorldMap(const Image& image, const CompressedImage*) { m_worldMap = &image; }
+
+    // Maps are sampled where they are, so there is nothing to prepare
+    virtual void prefetchWorldMap(const Image&, const CompressedImage*) {}
+
+    // The framebuffer is all there is, and headless runs are never hidden
+    virtual void releaseResources() {}
+
+    // Draw a frame into the framebuffer
+    virtual void drawFrame(const FrameDescription& frame);
+
+    // Size of the last frame drawn
+    const SIZE& frameSize() const { return m_framebuffer.size; }
+
+    // Pixels of the last frame drawn. Only valid while the render thread is idle.
+    const std::vector<uint32_t>& framePixels() const { return m_framebuffer.pixels; }
+
+    // FNV-1a checksum of the last frame drawn, for golden-image checks
+    uint64_t frameChecksum() const;
+
+private:
+    // Fill every pixel of the surface with one value
+    static void clear(Surface& surface, uint32_t pixel);
+
+    // Draw every visible copy of the world map
+    void drawWorldMap(const FrameDescription& frame);
+
+    // Draw line batches; into a layer, coverage is accumulated in alpha so it stays premultiplied
+    static void drawLineBatches(Surface& surface, const std::vector<LineBatch>& batches, bool premultiplied);
+
+    // Draw one wide line
+    static void drawLine(Surface& surface, const LineBatch& batch, float x1, float y1, float x2, float y2, bool premultiplied);
+
+    // Draw the route meshes of a batch; their edges always blend
+    static void drawMeshes(Surface& surface, const LineBatch& batch, bool premultiplied);
+
+    // Draw one triangle of a mesh, with coverage interpolated from its vertices
+    static void drawTriangle(Surface& surface, const LineBatch& batch, const float* x, const float* y, const float* coverage, bool premultiplied);
+
+    // Composite the route layer over the map
+    void drawRouteLayer(const FrameDescription& frame);
+
+    // Draw the snapshot moved and scaled to the current map placement
+    void drawSnapshot(const FrameDescription& frame);
+
+    // Draw every visible copy of the ship marker
+    void drawShipMarkers(const FrameDescription& frame);
+
+    // Draw the speed meter text as black glyphs on white, padded to a multiple of 4 pixels like the GL backend's
+    static void drawSpeedMeterText(const std::wstring& text, Surface& surface);
+
+    // Draw the speedometer text at the top-right corner
+    void drawSpeedMeter(const FrameDescription& frame);
+};
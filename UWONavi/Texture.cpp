@@ -1,13 +1,17 @@
 #include "stdafx.h"
 #include "Texture.h"
 #include "Image.h"
+#include "CompressedImage.h"
+#include "GLExtensions.h"
 
 // Constructor for Texture class
 // Initializes the texture ID and generates a new texture in OpenGL.
 Texture::Texture() :
     m_texID(),
     m_width(),
-    m_height()
+    m_height(),
+    m_wrapS(GL_CLAMP),
+    m_levelCount()
 {
     // Generate a texture ID using OpenGL's glGenTextures function
     ::glGenTextures(1, &m_texID);
@@ -55,10 +59,55 @@ void Texture::setImage(const Image& image)
     // Store the image dimensions (width and height) for later use
     m_width = image.width();
     m_height = image.height();
+    m_levelCount = 1;
 
     unbind();  // Unbind the texture after the operation is complete
 }
 
+// Upload S3TC blocks and their mip chain
+// The GPU samples the blocks directly, so BC1 takes a sixth of the memory and upload time of RGB, BC3 a quarter of RGBA.
+void Texture::setCompressedImage(const CompressedImage& image, const GLExtensions& gl)
+{
+    _ASSERT(!image.empty());
+    _ASSERT(gl.hasS3tcTextures());
+
+    bind();
+
+    const GLenum internalFormat = image.format() == CompressedImage::k_Format_BC3
+        ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+        : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    const std::vector<CompressedImage::Level>& levels = image.levels();
+    for (size_t i = 0; i < levels.size(); ++i) {
+        const CompressedImage::Level& level = levels[i];
+        gl.glCompressedTexImage2D(GL_TEXTURE_2D, GLint(i), internalFormat,
+            level.width, level.height,
+            0, GLsizei(level.blocks.size()), &level.blocks[0]);
+    }
+
+    m_width = levels[0].width;
+    m_height = levels[0].height;
+    m_levelCount = int(levels.size());
+
+    unbind();
+}
+
+// Allocate an RGBA texture without uploading any pixels
+// Used as the target of offscreen rendering, which fills it afterwards.
+void Texture::allocate(int width, int height)
+{
+    bind();
+    ::glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
+        width, height,
+        0, GL_BGRA_EXT,
+        GL_UNSIGNED_BYTE, NULL);
+
+    m_width = width;
+    m_height = height;
+    m_levelCount = 1;
+
+    unbind();
+}
+
 // Bind the texture to OpenGL
 // This makes the texture the active texture for subsequent rendering operations.
 void Texture::bind()
@@ -71,7 +120,12 @@ void Texture::bind()
 
     // Set texture filtering parameters
     ::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);  // Nearest neighbor filtering for magnification
-    ::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);  // Nearest neighbor filtering for minification
+    // Nearest neighbor filtering for minification, from the nearest mip level when there is a chain
+    ::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 1 < m_levelCount ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST);
+
+    // Set texture coordinate wrapping (vertical never repeats, the world only wraps east-west)
+    ::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, m_wrapS);
+    ::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
 }
 
 // Unbind the texture from OpenGL
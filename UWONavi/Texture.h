@@ -3,6 +3,9 @@
 #include "Noncopyable.h"  // Include for preventing copy operations on this class
 #include "Image.h"        // Include the image handling class to interact with image data
 
+class CompressedImage;
+class GLExtensions;
+
 //! @brief The Texture class manages OpenGL texture objects.
 //! It is responsible for creating, binding, unbinding, and setting texture data in OpenGL.
 class Texture : private Noncopyable {
@@ -10,6 +13,8 @@ private:
     GLuint m_texID;  //!< Texture ID used by OpenGL to identify this texture
     int m_width;     //!< Width of the texture
     int m_height;    //!< Height of the texture
+    GLint m_wrapS;   //!< Horizontal texture coordinate wrap mode (GL_REPEAT or GL_CLAMP)
+    int m_levelCount; //!< Number of mip levels uploaded
 
 public:
     //! @brief Default constructor
@@ -31,10 +36,34 @@ public:
         return m_height;
     }
 
+    //! @brief Returns the OpenGL name of the texture (for attaching it to a framebuffer)
+    GLuint id() const
+    {
+        return m_texID;
+    }
+
+    //! @brief Allocates an RGBA texture with undefined contents, to be rendered into
+    //! @param width Width of the texture
+    //! @param height Height of the texture
+    void allocate(int width, int height);
+
     //! @brief Sets the image data for the texture
     //! @param image The Image object containing image data to upload as the texture
     void setImage(const Image& image);
 
+    //! @brief Uploads S3TC blocks and their mip chain as they are, without decoding them
+    //! @param image The blocks of every level; the driver must support S3TC (GLExtensions::hasS3tcTextures)
+    //! @param gl Entry points of the current context
+    void setCompressedImage(const CompressedImage& image, const GLExtensions& gl);
+
+    //! @brief Selects whether texture coordinates outside [0, 1] repeat horizontally
+    //! Used by the world map so that one quad can cover every wrapped copy of the world.
+    //! @param repeat true for GL_REPEAT, false for GL_CLAMP
+    void setHorizontalRepeat(bool repeat)
+    {
+        m_wrapS = repeat ? GL_REPEAT : GL_CLAMP;
+    }
+
     //! @brief Binds the texture to OpenGL so it can be used for rendering
     void bind();
 
@@ -0,0 +1,123 @@
+#include "stdafx.h"
+#include "TextureResidency.h"
+#include "Image.h"
+#include "CompressedImage.h"
+#include "GLExtensions.h"
+
+
+Texture& TextureResidency::acquire( const Image& image, const CompressedImage * compressed, const GLExtensions& gl )
+{
+	Entry * entry = find( image );
+	if ( !entry ) {
+		Entry added;
+		added.image = &image;
+		added.texture.reset( new Texture() );
+		added.bytes = textureBytes( image, compressed, gl );
+		added.lastUse = 0;
+		if ( usesBlocks( compressed, gl ) ) {
+			added.texture->setCompressedImage( *compressed, gl );
+		}
+		else {
+			added.texture->setImage( image );
+		}
+		m_residentBytes += added.bytes;
+		m_entries.push_back( std::move( added ) );
+		entry = &m_entries.back();
+	}
+	entry->lastUse = ++m_useCounter;
+	return *entry->texture;
+}
+
+
+bool TextureResidency::prefetch( const Image& image, const CompressedImage * compressed, const GLExtensions& gl, const Texture * keep )
+{
+	if ( Entry * entry = find( image ) ) {
+		entry->lastUse = ++m_useCounter;
+		return true;
+	}
+
+	// Make room first, so the old and the new texture never take more than the budget together
+	const size_t bytes = textureBytes( image, compressed, gl );
+	if ( m_budget < bytesOf( keep ) + bytes ) {
+		return false;
+	}
+	evict( m_budget - bytes, keep );
+
+	acquire( image, compressed, gl );
+	return true;
+}
+
+
+void TextureResidency::trim( const Texture * keep )
+{
+	evict( m_budget, keep );
+}
+
+
+void TextureResidency::evict( size_t limit, const Texture * keep )
+{
+	while ( limit < m_residentBytes ) {
+		auto victim = m_entries.end();
+		for ( auto it = m_entries.begin(); it != m_entries.end(); ++it ) {
+			if ( it->texture.get() != keep && (victim == m_entries.end() || it->lastUse < victim->lastUse) ) {
+				victim = it;
+			}
+		}
+		if ( victim == m_entries.end() ) {
+			// Only the texture kept is left, and it is drawn however large it is
+			break;
+		}
+		m_residentBytes -= victim->bytes;
+		m_entries.erase( victim );
+	}
+}
+
+
+void TextureResidency::clear()
+{
+	m_entries.clear();
+	m_residentBytes = 0;
+}
+
+
+size_t TextureResidency::textureBytes( const Image& image, const CompressedImage * compressed, const GLExtensions& gl )
+{
+	if ( usesBlocks( compressed, gl ) ) {
+		size_t bytes = 0;
+		for ( const CompressedImage::Level& level : compressed->levels() ) {
+			bytes += level.blocks.size();
+		}
+		return bytes;
+	}
+
+	// Drivers keep RGB textures padded to four bytes a texel
+	return size_t( image.width() ) * image.height() * 4;
+}
+
+
+bool TextureResidency::usesBlocks( const CompressedImage * compressed, const GLExtensions& gl )
+{
+	return compressed && !compressed->empty() && gl.hasS3tcTextures();
+}
+
+
+TextureResidency::Entry * TextureResidency::find( const Image& image )
+{
+	for ( Entry& entry : m_entries ) {
+		if ( entry.image == &image ) {
+			return &entry;
+		}
+	}
+	return NULL;
+}
+
+
+size_t TextureResidency::bytesOf( const Texture * texture ) const
+{
+	for ( const Entry& entry : m_entries ) {
+		if ( entry.texture.get() == texture ) {
+			return entry.bytes;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Noncopyable.h"    // For preventing copying of the textures
+#include "Texture.h"        // For the textures kept
+#include <cstdint>          // For the use counter
+#include <memory>           // For owning the textures
+#include <vector>           // For the resident textures
+
+class Image;
+class CompressedImage;
+class GLExtensions;
+
+// Map textures kept on the GPU under a budget in bytes, so switching back to a recently shown map
+// layer binds a texture instead of uploading it again. Textures are keyed by the image they were
+// uploaded from; the least recently used ones are deleted when the budget is exceeded. Used on the
+// render thread only, with the context current.
+class TextureResidency : private Noncopyable {
+private:
+    // A texture and the image it was uploaded from
+    struct Entry {
+        const Image* image;                 //!< Source image (kept alive and unchanged by the caller)
+        std::unique_ptr<Texture> texture;
+        size_t bytes;                       //!< Estimated video memory taken by the texture
+        uint64_t lastUse;                   //!< Value of m_useCounter when last acquired
+    };
+
+    size_t m_budget;                        //!< Bytes the textures may take together
+    size_t m_residentBytes;                 //!< Bytes the textures take now
+    uint64_t m_useCounter;                  //!< Incremented on every acquisition
+    std::vector<Entry> m_entries;
+
+public:
+    explicit TextureResidency(size_t budget) :
+        m_budget(budget),
+        m_residentBytes(),
+        m_useCounter(),
+        m_entries()
+    {
+    }
+
+    // Get the texture of an image, uploading it (as blocks when compressed is given and the driver
+    // takes them) unless it is resident, and mark it as the most recently used one
+    Texture& acquire(const Image& image, const CompressedImage* compressed, const GLExtensions& gl);
+
+    // Upload the texture of an image ahead of time, if it fits the budget next to the texture kept.
+    // Returns false if it does not fit without evicting keep.
+    bool prefetch(const Image& image, const CompressedImage* compressed, const GLExtensions& gl, const Texture* keep);
+
+    // Delete the least recently used textures other than keep until the budget holds
+    void trim(const Texture* keep);
+
+    // Delete every texture
+    void clear();
+
+    // Bytes the resident textures take
+    size_t residentBytes() const { return m_residentBytes; }
+
+private:
+    // Estimate the video memory a texture of the image takes as it would be uploaded
+    static size_t textureBytes(const Image& image, const CompressedImage* compressed, const GLExtensions& gl);
+
+    // Check whether the texture of an image would be uploaded as blocks
+    static bool usesBlocks(const CompressedImage* compressed, const GLExtensions& gl);
+
+    // Delete the least recently used textures other than keep until they take at most limit bytes
+    void evict(size_t limit, const Texture* keep);
+
+    // Find the entry of an image (NULL if it is not resident)
+    Entry* find(const Image& image);
+
+    // Bytes of the entry holding a texture (0 if there is none)
+    size_t bytesOf(const Texture* texture) const;
+};
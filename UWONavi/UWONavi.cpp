@@ -42,14 +42,18 @@
 #include <vector>
 #include <list>
 #include <fstream>
+#include <sstream>
 #include <gdiplus.h>
 #pragma comment(lib, "gdiplus.lib")
 #include <Shlwapi.h>
+#include <shellapi.h>
 #pragma comment(lib, "shlwapi.lib")
 #include <CommCtrl.h>
 #pragma comment(lib, "comctl32.lib")
 #include <CommDlg.h>
 #pragma comment(lib, "Comdlg32.lib")
+#include <random>
+#include <process.h>
 
 /***********************************************************************************************/
 /*                                                                                             */
@@ -66,17 +70,23 @@
       - WorldMap: A class that represents the map or image on which the ship is rendered.
       - Ship, ShipRouteList, ShipRouteManageView: Classes that manage ship info, routes,
                                                   and route management UI.
-      - Renderer & Texture: Classes to render the map, the ship, and handle textures.
+      - Renderer & RendererBenchmark: Classes to render the map and the ship, and to measure rendering.
 */
 
 #include "UWONavi.h"
 #include "Config.h"
 #include "GameProcess.h"
 #include "WorldMap.h"
+#include "MapLayerSet.h"
 #include "Ship.h"
 #include "ShipRouteList.h"
+#include "SeaRouteFinder.h"
+#include "SeaDistanceTable.h"
+#include "PortList.h"
+#include "SeaRegionMap.h"
 #include "Renderer.h"
-#include "Texture.h"
+#include "RendererBenchmark.h"
+#include "PosterExporter.h"
 #include "ShipRouteManageView.h"
 
 // Uncommenting this define will enable performance measuring in the code
@@ -119,7 +129,17 @@ static Config s_config(k_configFileName);
 // The main modules that handle gameplay, rendering, and map state.
 static GameProcess s_GameProcess;
 static Renderer s_renderer;
-static WorldMap s_worldMap;
+static WorldMap s_worldMap;         // The map of the headless modes (benchmark, export, compression)
+static MapLayerSet s_mapLayers;     // The maps the window switches between
+
+// Posted by a map layer loader (WPARAM is the layer index, LPARAM the MapLayerSet::Stage reached)
+static const UINT k_mapLayerLoadedMessage = WM_APP + 1;
+
+// Posted by the route loader once the saved routes are read
+static const UINT k_routeListLoadedMessage = WM_APP + 2;
+
+// Posted by the sea route finder worker once the finder is built
+static const UINT k_seaRouteFinderBuiltMessage = WM_APP + 3;
 
 // A path to save or load route data
 const std::wstring&& k_routeListFilePath = g_makeFullPath(L"RouteList.dat");
@@ -127,6 +147,25 @@ const std::wstring&& k_routeListFilePath = g_makeFullPath(L"RouteList.dat");
 // This container manages our list of ship routes (with coordinates, etc.).
 static std::unique_ptr<ShipRouteList> s_shipRouteList;
 
+// Saved routes are read in the background while the window comes up; the loader fills these,
+// and they are merged into s_shipRouteList once it has posted k_routeListLoadedMessage
+static HANDLE s_routeLoaderThread;
+static std::unique_ptr<ShipRouteList> s_loadedRouteList;
+static std::string s_routeLoadError;
+
+// Startup trace: milliseconds from launch to each milestone, written to the debug output.
+// Milestones seen on screen are traced once the frame showing them has been drawn.
+enum StartupMilestone {
+    k_startupFirstFrame = 1 << 0,   // The window has drawn its first frame (without the map)
+    k_startupMapPreview = 1 << 1,   // The low-resolution map from the texture cache is on screen
+    k_startupMap = 1 << 2,          // The full map is on screen
+    k_startupRoutes = 1 << 3,       // The saved routes are on screen
+    k_startupFullFidelity = 1 << 4, // Both of the above: startup is over
+};
+static int64_t s_startupBegin;      // Performance counter at launch
+static UINT s_startupPending;       // Milestones waiting for the next frame to be drawn
+static UINT s_startupDone;          // Milestones traced so far
+
 // Variables to keep track of the latest ship information retrieved from the game process
 static POINT  s_latestSurveyCoord;
 static Vector s_latestShipVector;
@@ -140,13 +179,76 @@ static const DWORD k_surveyCoordLostThreshold = 5000;
 // The ShipRouteManageView is presumably a separate dialog/UI for route management
 static std::unique_ptr<ShipRouteManageView> s_shipRouteManageView;
 
-// A texture of the ship icon. If we want to draw the ship, we need a texture 
-// to represent it on the map.
-static std::unique_ptr<Texture> s_shipTexture;
+// Ports and landmarks naming positions in the route list and the window title (empty without a port list)
+static PortList s_portList;
+
+// Named sea areas for the window title and the route list (read on the first lookup)
+static SeaRegionMap s_seaRegionMap;
+
+// Sea routes planned from the pop-up menu on the land mask of the map drawn. Building the finder takes most
+// of a second on a full-size mask, so a worker builds it into s_builtSeaRouteFinder whenever another map is
+// drawn and posts k_seaRouteFinderBuiltMessage; planning is offered once it has moved to s_seaRouteFinder
+static std::unique_ptr<SeaRouteFinder> s_seaRouteFinder;
+static HANDLE s_seaRouteFinderThread;
+static std::unique_ptr<SeaRouteFinder> s_builtSeaRouteFinder;
+static POINT s_popupViewCoord;          // Where the pop-up menu was opened
+static bool  s_hasPlanStart = false;    // Whether a planned route has been started
+static POINT s_planStartWorldCoord;     // Where the planned route starts
+
+// Port-to-port sea routes cached by the /seadistances switch next to the map drawn (read on the first plan between ports)
+static std::unique_ptr<SeaDistanceTable> s_seaDistanceTable;
+static const LandMask* s_seaDistanceLandMask = NULL;    // Land mask the table was looked for with
+static const wchar_t k_seaDistanceCacheSuffix[] = L".seadist";
+
+// How close to a port the end of a planned route is taken to be the port
+static const int32_t k_planPortDistance = 64;
 
 // Time in milliseconds between updates from the game
 static UINT s_pollingInterval = 1000;
 
+// Time in milliseconds between frames: one display refresh, or the configured frame rate cap
+static DWORD s_frameInterval = 16;
+
+// Redraws asked for since the last frame; they are merged into one frame per frame interval
+static bool  s_redrawRequested = false;
+static DWORD s_lastRedrawTime;
+
+// Drag distance not yet applied to the view; applied in one step when the next frame is drawn
+static POINT s_pendingPanOffset;
+
+// Whether the ship is still moving on screen between polls, so frames are needed at display rate
+static bool s_isShipMoving = false;
+static DWORD s_lastAnimationTime;
+
+// Panning and zooming draw previews from the last full frame; once no such input arrived
+// for this many milliseconds, the view is drawn in full quality again
+static const UINT k_interactionSettleTime = 150;
+static const UINT_PTR k_interactionTimerId = 1;
+
+// Comes back for a redraw the frame interval held back, also while a modal loop (menu, sizing) runs
+static const UINT_PTR k_redrawTimerId = 2;
+
+// Whether the view cannot be seen: the window is minimized, covered by the foreground window, the
+// display is off or the system is going to sleep. Nothing is drawn meanwhile; game updates are still
+// recorded, and the view is drawn again as soon as it shows.
+static bool s_isViewHidden = false;
+static bool s_isDisplayOff = false;
+static bool s_isSystemSuspended = false;
+static HWINEVENTHOOK s_windowEventHook;     // Reports foreground changes and windows moved or minimized
+static HANDLE s_displayPowerNotify;         // Reports the display switched off and on (Vista and later)
+
+// Display power notifications postdate the Windows XP headers this is built with
+static const WPARAM k_powerSettingChange = 0x8013;  // PBT_POWERSETTINGCHANGE
+static const GUID k_consoleDisplayState =           // GUID_CONSOLE_DISPLAY_STATE
+    { 0x6fe69556, 0x704a, 0x47a0, { 0x8f, 0x24, 0xc2, 0x8d, 0x93, 0x6f, 0xda, 0x47 } };
+struct DisplayPowerSetting {                        // POWERBROADCAST_SETTING carrying a display state
+    GUID powerSetting;
+    DWORD dataLength;
+    DWORD displayState;                             // 0 off, 1 on, 2 dimmed
+};
+typedef HANDLE (WINAPI* RegisterPowerSettingNotificationFunc)(HANDLE, const GUID*, DWORD);
+typedef BOOL (WINAPI* UnregisterPowerSettingNotificationFunc)(HANDLE);
+
 // Variables for handling mouse dragging around the map
 static bool  s_isDragging = false;
 static SIZE  s_clientSize;
@@ -169,6 +271,18 @@ static PerfCountList s_perfCountList; // Used for performance measurements
     It's helpful for the compiler to know about them before we define them.
 */
 
+// Headless renderer benchmark (/benchmark command line switch; /benchmark record writes the golden file)
+static int s_runBenchmark(bool record);
+
+// Headless poster export (/export command line switch)
+static int s_runExport();
+
+// Encode the block-compressed map texture and land/sea mask caches (/compressmap command line switch)
+static int s_runCompressMap();
+
+// Build the port-to-port sea distance cache, or time its build (/seadistances and /seadistancebench command line switches)
+static int s_runSeaDistances(bool benchmark);
+
 // Registration & Initialization
 static ATOM MyRegisterClass(HINSTANCE hInstance);
 static BOOL InitInstance(HINSTANCE, int);
@@ -179,11 +293,38 @@ static LRESULT s_mainLoop();
 // Utility functions for file name retrieval, updating frames, window titles, etc.
 static std::wstring s_getMapFileName();
 static void s_updateFrame(HWND);
+static void s_animateFrame(HWND);
+static void s_requestRedraw();
+static DWORD s_redrawIfDue(HWND);
+static void s_paceRedraw(HWND);
+static void s_beginInteraction(HWND);
+static void s_endInteraction(HWND);
+static void s_watchViewVisibility(HWND);
+static void s_unwatchViewVisibility();
+static void s_updateViewVisibility(HWND);
+static bool s_isViewCovered(HWND);
+static void CALLBACK s_onWindowEvent(HWINEVENTHOOK, DWORD, HWND, LONG, LONG, DWORD, DWORD);
 static void s_updateWindowTitle(HWND, POINT, double);
 static void s_toggleKeepForeground(HWND);
 static void s_popupMenu(HWND, int16_t, int16_t);
 static void s_popupCoord(HWND, int16_t, int16_t);
+static void s_updateLandfall();
+static bool s_canPlanSeaRoute();
+static void s_planSeaRoute(HWND);
+static void s_prepareSeaRouteFinder();
+static UINT CALLBACK s_seaRouteFinderMain(LPVOID);
+static void s_adoptSeaRouteFinder();
 static void s_closeShipRoute();
+static void s_switchMapLayer(HWND, size_t);
+static void s_prefetchMapLayer(HWND, size_t);
+static void s_onMapLayerLoaded(HWND, size_t, MapLayerSet::Stage);
+static UINT CALLBACK s_routeLoaderMain(LPVOID);
+static void s_mergeLoadedRoutes();
+static void s_traceStartup(const char*);
+static void s_traceStartupFrame(UINT);
+#ifndef NDEBUG
+static void s_debugRouteLodBenchmark(HWND);
+#endif
 
 // Our Window Procedure for handling events
 LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
@@ -221,7 +362,29 @@ int APIENTRY _tWinMain(_In_ HINSTANCE hInstance,
     _In_ int       nCmdShow)
 {
     UNREFERENCED_PARAMETER(hPrevInstance);
-    UNREFERENCED_PARAMETER(lpCmdLine);
+    s_startupBegin = g_queryPerformanceCounter();
+
+    // Headless benchmark runs need no window or game, and may run beside a normal instance
+    if (::wcsstr(lpCmdLine, L"/benchmark"))
+    {
+        return s_runBenchmark(::wcsstr(lpCmdLine, L"/benchmark record") != NULL);
+    }
+    if (::wcsstr(lpCmdLine, L"/export"))
+    {
+        return s_runExport();
+    }
+    if (::wcsstr(lpCmdLine, L"/compressmap"))
+    {
+        return s_runCompressMap();
+    }
+    if (::wcsstr(lpCmdLine, L"/seadistancebench"))
+    {
+        return s_runSeaDistances(true);
+    }
+    if (::wcsstr(lpCmdLine, L"/seadistances"))
+    {
+        return s_runSeaDistances(false);
+    }
 
     // Create a mutex to ensure only one instance of the application is run
     ::SetLastError(NOERROR);
@@ -263,6 +426,17 @@ int APIENTRY _tWinMain(_In_ HINSTANCE hInstance,
     // Enter our main loop which handles messages and game updates
     const LRESULT retVal = s_mainLoop();
 
+    // Routes still being read when the window closed are saved along with the rest
+    s_mergeLoadedRoutes();
+
+    // A sea route finder still being built reads the land mask of a map layer
+    s_adoptSeaRouteFinder();
+
+#ifdef _PERF_CHECK
+    ::OutputDebugStringA(("frames drawn:" + std::to_string(s_renderer.renderedFrameCount())
+        + " skipped:" + std::to_string(s_renderer.skippedFrameCount()) + "\n").c_str());
+#endif
+
     // Upon exiting, attempt to save the route list data to a file
     try
     {
@@ -289,6 +463,301 @@ int APIENTRY _tWinMain(_In_ HINSTANCE hInstance,
 }
 
 
+/***********************************************************************************************/
+/*                                                                                             */
+/*  SECTION: s_runBenchmark                                                                    */
+/*                                                                                             */
+/***********************************************************************************************/
+/*
+    Renders scripted scenes with the software backend, without a window or the game.
+    Frame times go to benchmark.txt next to the executable, and every frame is checked
+    against benchmark_golden.txt; a missing golden file fails the run. The settings are the
+    defaults, never those saved in Navi.ini, so the frames only depend on map.png. The golden
+    file is assets/benchmark_golden.txt, recorded from assets/map.png and copied next to the
+    executable by the build. After an intended change to the output, record it again and copy
+    it back to assets:
+
+        UWONavi.exe /benchmark
+        UWONavi.exe /benchmark record
+
+    Returns 0 when all frames match (or the golden file was recorded).
+*/
+static int s_runBenchmark(bool record)
+{
+    Gdiplus::GdiplusStartup(&s_gdiToken, &s_gdisi, NULL);
+    const Config config(k_configFileName);  // Never loaded, so every setting is the default
+
+    int exitCode = 1;
+    if (s_worldMap.loadFromFile(config.m_mapFileName))
+    {
+        RendererBenchmark benchmark(&config, &s_worldMap);
+        benchmark.run(RendererBenchmark::defaultScenes());
+
+        std::string report = benchmark.report();
+        const std::wstring goldenFileName = g_makeFullPath(L"benchmark_golden.txt");
+        if (record)
+        {
+            if (benchmark.recordGolden(goldenFileName))
+            {
+                report += "golden file recorded\n";
+                exitCode = 0;
+            }
+        }
+        else if (benchmark.checkGolden(goldenFileName, report))
+        {
+            exitCode = 0;
+        }
+
+        std::ofstream ofs;
+        ofs.open(g_makeFullPath(L"benchmark.txt"), std::ios::out | std::ios::trunc);
+        ofs << report;
+        ::OutputDebugStringA(report.c_str());
+    }
+    else
+    {
+        ::OutputDebugString(L"benchmark: could not open the map image\n");
+    }
+
+    Gdiplus::GdiplusShutdown(s_gdiToken);
+    return exitCode;
+}
+
+
+/***********************************************************************************************/
+/*                                                                                             */
+/*  SECTION: s_runExport                                                                       */
+/*                                                                                             */
+/***********************************************************************************************/
+/*
+    Writes the world map with the saved routes as one PNG poster, without a window or the game:
+
+        UWONavi.exe /export poster.png [/routes RouteList.dat] [/map map.png] [/width 16384] [/favorites]
+
+    The map and the route file default to the configured map and the saved route list, and the
+    width defaults to the width of the map image. Returns 0 when the poster was written.
+*/
+static int s_runExport()
+{
+    int argc = 0;
+    LPWSTR* argv = ::CommandLineToArgvW(::GetCommandLineW(), &argc);
+    if (!argv)
+    {
+        return 1;
+    }
+
+    s_config.load();
+    std::wstring routeFileName = k_routeListFilePath;
+    std::wstring mapFileName = s_config.m_mapFileName;
+    PosterExporter::Options options = { L"", 0, false };
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::wstring arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == L"/export" && hasValue)
+        {
+            options.outputFileName = g_makeFullPath(argv[++i]);
+        }
+        else if (arg == L"/routes" && hasValue)
+        {
+            routeFileName = g_makeFullPath(argv[++i]);
+        }
+        else if (arg == L"/map" && hasValue)
+        {
+            mapFileName = argv[++i];
+        }
+        else if (arg == L"/width" && hasValue)
+        {
+            options.width = ::wcstol(argv[++i], NULL, 10);
+        }
+        else if (arg == L"/favorites")
+        {
+            options.favoritesOnly = true;
+        }
+    }
+    ::LocalFree(argv);
+    if (options.outputFileName.empty())
+    {
+        ::OutputDebugString(L"export: no output file\n");
+        return 1;
+    }
+
+    Gdiplus::GdiplusStartup(&s_gdiToken, &s_gdisi, NULL);
+
+    int exitCode = 1;
+    ShipRouteList routes;
+    try
+    {
+        std::ifstream ifs;
+        ifs.open(routeFileName, std::ios::in | std::ios::binary);
+        if (ifs)
+        {
+            ifs.exceptions(std::ios::badbit | std::ios::failbit);
+            ifs >> routes;
+            ifs.close();
+        }
+        if (s_worldMap.loadFromFile(mapFileName))
+        {
+            if (options.width <= 0)
+            {
+                options.width = s_worldMap.size().cx;
+            }
+            PosterExporter exporter(&s_worldMap, &routes);
+            if (exporter.run(options))
+            {
+                exitCode = 0;
+            }
+        }
+        else
+        {
+            ::OutputDebugString(L"export: could not open the map image\n");
+        }
+    }
+    catch (const std::exception& e)
+    {
+        ::OutputDebugStringA((std::string("export: file load error:") + e.what() + "\n").c_str());
+    }
+
+    Gdiplus::GdiplusShutdown(s_gdiToken);
+    return exitCode;
+}
+
+
+/***********************************************************************************************/
+/*                                                                                             */
+/*  SECTION: s_runCompressMap                                                                  */
+/*                                                                                             */
+/***********************************************************************************************/
+/*
+    Encodes the configured map into the block-compressed texture cache, the land/sea mask cache
+    and the coastline cache next to it, so the first launch does not have to (e.g. when
+    installing a new map):
+
+        UWONavi.exe /compressmap
+
+    An up-to-date cache is kept as it is. Returns 0 when the blocks, the mask and the coastline
+    are available.
+*/
+static int s_runCompressMap()
+{
+    Gdiplus::GdiplusStartup(&s_gdiToken, &s_gdisi, NULL);
+    s_config.load();
+
+    int exitCode = 1;
+    if (s_worldMap.loadFromFile(s_config.m_mapFileName) && s_worldMap.prepareLandMask() && s_worldMap.prepareCoastline()
+        && s_worldMap.prepareCompressedImage())
+    {
+        exitCode = 0;
+    }
+    else
+    {
+        ::OutputDebugString(L"compressmap: could not encode the map image\n");
+    }
+
+    Gdiplus::GdiplusShutdown(s_gdiToken);
+    return exitCode;
+}
+
+
+/***********************************************************************************************/
+/*                                                                                             */
+/*  SECTION: s_runSeaDistances                                                                 */
+/*                                                                                             */
+/***********************************************************************************************/
+/*
+    Builds the sea distance between every pair of the configured ports into a cache next to the
+    map, so that planning a route between two ports reads it from the table instead of searching:
+
+        UWONavi.exe /seadistances
+        UWONavi.exe /seadistancebench
+
+    The benchmark classifies the map into land masks of a quarter, half and the whole world size,
+    with the ports scaled to match, and builds the table on each at the default node spacing for
+    every number of workers (doubling up to one per processor, as far as the build uses them). It
+    touches no cache, logs the workers the build really ran, and writes the times to
+    seadistance_benchmark.txt next to the executable. Returns 0 when the table is available.
+*/
+static int s_runSeaDistances(bool benchmark)
+{
+    Gdiplus::GdiplusStartup(&s_gdiToken, &s_gdisi, NULL);
+    s_config.load();
+
+    int exitCode = 1;
+    PortList ports;
+    if (!ports.loadFromFile(g_makeFullPath(s_config.m_portsFileName)))
+    {
+        ::OutputDebugString(L"seadistances: could not open the port list\n");
+    }
+    else if (!s_worldMap.loadFromFile(s_config.m_mapFileName) || !s_worldMap.prepareLandMask())
+    {
+        ::OutputDebugString(L"seadistances: could not open the map image\n");
+    }
+    else if (!benchmark)
+    {
+        SeaDistanceTable table;
+        if (table.prepare(s_worldMap.landMask(), ports.worldCoords(), s_worldMap.filePath() + k_seaDistanceCacheSuffix))
+        {
+            exitCode = 0;
+        }
+    }
+    else
+    {
+        SYSTEM_INFO systemInfo;
+        ::GetSystemInfo(&systemInfo);
+        const double freq = double(g_queryPerformanceFrequency());
+        const int32_t divisors[] = { 4, 2, 1 };
+
+        std::ostringstream report;
+        report << "ports " << ports.size() << ", map " << s_worldMap.size().cx << "x" << s_worldMap.size().cy
+            << ", node spacing " << SeaDistanceTable::k_defaultNodeSpacing << "\n";
+        for (int32_t divisor : divisors)
+        {
+            LandMask landMask;
+            if (!landMask.build(s_worldMap.image(), k_worldWidth / divisor, k_worldHeight / divisor))
+            {
+                continue;
+            }
+            std::vector<POINT> portCoords = ports.worldCoords();
+            for (POINT& port : portCoords)
+            {
+                port.x /= divisor;
+                port.y /= divisor;
+            }
+
+            DWORD lastUsedCount = 0;
+            for (DWORD workerCount = 1; ; workerCount = min(workerCount * 2, systemInfo.dwNumberOfProcessors))
+            {
+                const DWORD usedCount = SeaDistanceTable::usedWorkerCount(workerCount, portCoords.size());
+                if (usedCount == lastUsedCount)
+                {
+                    break;
+                }
+                lastUsedCount = usedCount;
+
+                SeaDistanceTable table;
+                const int64_t perfBegin = g_queryPerformanceCounter();
+                table.build(landMask, portCoords, SeaDistanceTable::k_defaultNodeSpacing, workerCount);
+                const double elapsed = double(g_queryPerformanceCounter() - perfBegin) / freq * 1000.0;
+                report << "mask " << landMask.width() << "x" << landMask.height()
+                    << ", workers " << usedCount << ": " << elapsed << " ms\n";
+                if (systemInfo.dwNumberOfProcessors <= workerCount)
+                {
+                    break;
+                }
+            }
+        }
+
+        std::ofstream ofs;
+        ofs.open(g_makeFullPath(L"seadistance_benchmark.txt"), std::ios::out | std::ios::trunc);
+        ofs << report.str();
+        ::OutputDebugStringA(report.str().c_str());
+        exitCode = 0;
+    }
+
+    Gdiplus::GdiplusShutdown(s_gdiToken);
+    return exitCode;
+}
+
+
 /***********************************************************************************************/
 /*                                                                                             */
 /*  SECTION: MyRegisterClass                                                                   */
@@ -330,23 +799,24 @@ static ATOM MyRegisterClass(HINSTANCE hInstance)
 */
 static BOOL InitInstance(HINSTANCE hInstance, int nCmdShow)
 {
-    // Attempt to load the map file from config
-    if (!s_worldMap.loadFromFile(s_config.m_mapFileName))
+    // Register the map layers; the one from config is decoded in the background once the window is up
+    if (!::PathFileExists(g_makeFullPath(s_config.m_mapFileName).c_str()))
     {
-        // If that fails, prompt user for a map image file
+        // If it is missing, prompt user for a map image file
         std::wstring fileName = s_getMapFileName();
-        if (!s_worldMap.loadFromFile(fileName))
+        if (fileName.empty())
         {
-            // If we still fail, show an error
+            // If we still have none, show an error
             ::MessageBox(NULL,
                 L"Could not open the map image.",
                 k_appName,
                 MB_ICONERROR | MB_SETFOREGROUND | MB_OK);
             return FALSE;
         }
-        // If its successful, remember the file name in our config
+        // Remember the file name in our config
         s_config.m_mapFileName = fileName;
     }
+    s_mapLayers.setup(s_config.m_mapFileName, s_config.m_mapLayerFileNames, s_config.m_compressedMapEnabled);
 
     // Prepare window style bits
     DWORD exStyle = 0;
@@ -380,29 +850,45 @@ static BOOL InitInstance(HINSTANCE hInstance, int nCmdShow)
     g_hinst = hInstance;
     g_hwndMain = hwnd;
     g_hdcMain = ::GetDC(g_hwndMain);
+    s_watchViewVisibility(hwnd);
 
-    // Set up the renderer with the map and config
-    s_renderer.setup(&s_config, g_hdcMain, &s_worldMap);
+    // Set up the renderer without a map, so the window draws right away. The map is decoded on a
+    // worker: a preview from the texture cache comes first, then the map itself (whose texture
+    // blocks come from the cache too; the first launch with a map encodes them).
+    s_renderer.setup(&s_config, g_hdcMain, NULL);
+    s_mapLayers.prefetch(s_mapLayers.activeIndex(), hwnd, k_mapLayerLoadedMessage, true);
 
-    // Load any previously saved route data
-    s_shipRouteList.reset(new ShipRouteList());
-    try
+    // Draw at most once per display refresh (0 and 1 mean the hardware default), or as the cap allows
+    const int refreshRate = ::GetDeviceCaps(g_hdcMain, VREFRESH);
+    if (0 < s_config.m_frameRateLimit)
     {
-        std::ifstream ifs;
-        ifs.open(k_routeListFilePath, std::ios::in | std::ios::binary);
-        if (ifs)
-        {
-            ifs.exceptions(std::ios::badbit | std::ios::failbit);
-            ifs >> *s_shipRouteList;
-            ifs.close();
-        }
+        s_frameInterval = max(DWORD(1), DWORD(1000 / s_config.m_frameRateLimit));
     }
-    catch (const std::exception& e)
+    else if (1 < refreshRate)
     {
-        ::OutputDebugStringA((std::string("file load error:") + e.what() + "\n").c_str());
-        ::MessageBox(NULL, L"Failed to read path", k_appName, MB_ICONERROR);
+        s_frameInterval = max(DWORD(1), DWORD(1000 / refreshRate));
+    }
+
+    // Read any previously saved route data in the background; routes sailed meanwhile are kept
+    s_shipRouteList.reset(new ShipRouteList());
+    s_shipRouteList->setRouteTolerance(s_config.m_routeTolerance);
+    s_routeLoaderThread = reinterpret_cast<HANDLE>(::_beginthreadex(
+        NULL,
+        0,
+        s_routeLoaderMain,
+        NULL,
+        0,
+        NULL));
+    if (!s_routeLoaderThread)
+    {
+        // No thread to read them on: read them now, or the save on exit would drop them
+        s_routeLoaderMain(NULL);
     }
 
+    // Read the ports naming positions; a missing port list only leaves coordinates unnamed
+    s_portList.loadFromFile(g_makeFullPath(s_config.m_portsFileName));
+    s_seaRegionMap.setup(g_makeFullPath(s_config.m_seaRegionsFileName), g_makeFullPath(s_config.m_seaRegionNamesFileName));
+
     // Set polling interval from config, 
     // then connect with the game (open process handle, etc.)
     s_pollingInterval = s_config.m_pollingInterval;
@@ -413,6 +899,8 @@ static BOOL InitInstance(HINSTANCE hInstance, int nCmdShow)
 
     // Finally, show and update the window
     ShowWindow(hwnd, nCmdShow);
+    s_traceStartup("window shown");
+    s_traceStartupFrame(k_startupFirstFrame);
     UpdateWindow(hwnd);
 
     return TRUE;
@@ -438,6 +926,9 @@ static LRESULT s_mainLoop()
 
     for (;;)
     {
+        // Input handled since the last frame only asked for a redraw; draw it once the frame interval has passed
+        const DWORD redrawTimeout = s_redrawIfDue(g_hwndMain);
+
         if (::PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
         {
             // If we got a quit message, break out
@@ -471,14 +962,33 @@ static LRESULT s_mainLoop()
             continue;
         }
 
+        // Wake up for a pending redraw and, while the ship moves between polls, for the next display frame
+        DWORD timeout = redrawTimeout;
+        DWORD animationTimeout = INFINITE;
+        if (s_isShipMoving)
+        {
+            const DWORD elapsed = ::timeGetTime() - s_lastAnimationTime;
+            animationTimeout = (elapsed < s_frameInterval) ? (s_frameInterval - elapsed) : 0;
+            timeout = min(timeout, animationTimeout);
+        }
+
         DWORD waitResult = ::MsgWaitForMultipleObjects(
             static_cast<DWORD>(handles.size()),
             &handles[0],
             FALSE,
-            INFINITE,
+            timeout,
             QS_ALLINPUT
         );
 
+        if (waitResult == WAIT_TIMEOUT)
+        {
+            if (s_isShipMoving && animationTimeout <= redrawTimeout)
+            {
+                s_animateFrame(g_hwndMain);
+            }
+            continue;
+        }
+
         // If the wait caused a message to pop, handle that first
         if (handles.size() <= waitResult)
         {
@@ -525,10 +1035,24 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wp, LPARAM lp)
         return TRUE;
 
     case WM_PAINT:
-        s_onPaint(hwnd);
+        // Everything invalidated since the last frame is drawn by one frame, at most once per frame interval
+        ::ValidateRect(hwnd, NULL);
+        s_requestRedraw();
+        s_paceRedraw(hwnd);
         break;
 
     case WM_TIMER:
+        if (wp == k_interactionTimerId)
+        {
+            // Panning or zooming has paused, draw the view in full quality
+            s_endInteraction(hwnd);
+            break;
+        }
+        if (wp == k_redrawTimerId)
+        {
+            s_paceRedraw(hwnd);
+            break;
+        }
         // We use a timer to periodically update the frame
         s_updateFrame(hwnd);
         break;
@@ -541,8 +1065,41 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wp, LPARAM lp)
     case WM_SIZE:
         // Handle resizing (e.g., store new size, update renderer, etc.)
         s_onSize(hwnd, wp, LOWORD(lp), HIWORD(lp));
+        s_updateViewVisibility(hwnd);
         break;
 
+    case WM_ACTIVATE:
+        // Becoming the active window uncovers the view
+        s_updateViewVisibility(hwnd);
+        return DefWindowProc(hwnd, message, wp, lp);
+
+    case WM_POWERBROADCAST:
+        switch (wp)
+        {
+        case k_powerSettingChange:
+        {
+            // The display is switched off or on (dimmed still shows the view)
+            const DisplayPowerSetting* setting = reinterpret_cast<const DisplayPowerSetting*>(lp);
+            if (::IsEqualGUID(setting->powerSetting, k_consoleDisplayState))
+            {
+                s_isDisplayOff = setting->displayState == 0;
+                s_updateViewVisibility(hwnd);
+            }
+            return TRUE;
+        }
+        case PBT_APMSUSPEND:
+            // The system is going to sleep, or coming back from it
+            s_isSystemSuspended = true;
+            s_updateViewVisibility(hwnd);
+            return TRUE;
+        case PBT_APMRESUMEAUTOMATIC:
+            s_isSystemSuspended = false;
+            s_updateViewVisibility(hwnd);
+            return TRUE;
+        default:
+            return DefWindowProc(hwnd, message, wp, lp);
+        }
+
     case WM_COMMAND:
         wmId = LOWORD(wp);
         wmEvent = HIWORD(wp);
@@ -561,6 +1118,12 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wp, LPARAM lp)
         case IDM_ERASE_SHIP_ROUTE:
             s_shipRouteList->clearAllItems();
             break;
+        case IDM_PLAN_ROUTE_FROM:
+            s_hasPlanStart = s_renderer.worldCoordFromViewCoord(s_popupViewCoord, s_planStartWorldCoord);
+            break;
+        case IDM_PLAN_ROUTE_TO:
+            s_planSeaRoute(hwnd);
+            break;
         case IDM_TOGGLE_KEEP_FOREGROUND:
             s_toggleKeepForeground(hwnd);
             break;
@@ -586,6 +1149,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wp, LPARAM lp)
                 s_perfCountList.clear();
 #endif
                 s_updateWindowTitle(hwnd, s_latestSurveyCoord, s_renderer.viewScale());
+                s_beginInteraction(hwnd);
                 ::InvalidateRect(hwnd, NULL, FALSE);
             }
             break;
@@ -596,6 +1160,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wp, LPARAM lp)
                 s_perfCountList.clear();
 #endif
                 s_updateWindowTitle(hwnd, s_latestSurveyCoord, s_renderer.viewScale());
+                s_beginInteraction(hwnd);
                 ::InvalidateRect(hwnd, NULL, FALSE);
             }
             break;
@@ -604,7 +1169,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wp, LPARAM lp)
             if (!s_shipRouteManageView.get())
             {
                 s_shipRouteManageView.reset(new ShipRouteManageView());
-                if (!s_shipRouteManageView->setup(*s_shipRouteList.get()))
+                if (!s_shipRouteManageView->setup(*s_shipRouteList.get(), s_portList, s_seaRegionMap))
                 {
                     ::MessageBox(hwnd, L"Something went wrong", L"Error", MB_OK | MB_ICONERROR);
                 }
@@ -630,12 +1195,48 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wp, LPARAM lp)
             s_pollingInterval = 1;
             s_GameProcess.setPollingInterval(s_pollingInterval);
             break;
+        case IDM_DEBUG_ROUTE_LOD_BENCHMARK:
+            s_debugRouteLodBenchmark(hwnd);
+            break;
 #endif
         default:
+            if (IDM_MAP_LAYER_1 <= wmId && wmId <= IDM_MAP_LAYER_9)
+            {
+                s_switchMapLayer(hwnd, wmId - IDM_MAP_LAYER_1);
+                break;
+            }
+            if (IDM_PREFETCH_MAP_LAYER_1 <= wmId && wmId <= IDM_PREFETCH_MAP_LAYER_9)
+            {
+                s_prefetchMapLayer(hwnd, wmId - IDM_PREFETCH_MAP_LAYER_1);
+                break;
+            }
             return DefWindowProc(hwnd, message, wp, lp);
         }
         break;
 
+    case WM_MENUSELECT:
+        // Hovering a map layer in the menu starts loading it, so choosing it switches at once
+        wmId = LOWORD(wp);
+        if (!(HIWORD(wp) & MF_POPUP) && IDM_MAP_LAYER_1 <= wmId && wmId <= IDM_MAP_LAYER_9)
+        {
+            s_prefetchMapLayer(hwnd, wmId - IDM_MAP_LAYER_1);
+        }
+        break;
+
+    case k_mapLayerLoadedMessage:
+        s_onMapLayerLoaded(hwnd, wp, MapLayerSet::Stage(lp));
+        break;
+
+    case k_routeListLoadedMessage:
+        s_mergeLoadedRoutes();
+        break;
+
+    case k_seaRouteFinderBuiltMessage:
+        // The map drawn may have changed while the finder was built
+        s_adoptSeaRouteFinder();
+        s_prepareSeaRouteFinder();
+        break;
+
     case WM_MOUSEWHEEL:
         s_onMouseWheel(hwnd, HIWORD(wp), LOWORD(wp), int16_t(LOWORD(lp)), int16_t(HIWORD(lp)));
         break;
@@ -673,7 +1274,9 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wp, LPARAM lp)
         {
             s_shipRouteManageView.reset();
         }
+        s_unwatchViewVisibility();
         s_renderer.teardown();
+        s_mapLayers.clear();
         PostQuitMessage(0);
         break;
 
@@ -757,6 +1360,7 @@ static void s_onMouseWheel(HWND hwnd, int16_t delta, UINT /*vkey*/, int16_t /*x*
         s_perfCountList.clear();
 #endif
         s_updateWindowTitle(hwnd, s_latestSurveyCoord, s_renderer.viewScale());
+        s_beginInteraction(hwnd);
         ::InvalidateRect(hwnd, NULL, FALSE);
     }
 }
@@ -779,8 +1383,9 @@ static void s_onMouseMove(HWND hwnd, UINT /*vkey*/, int16_t x, int16_t y)
             }
         }
 
-        POINT offset = { -dx, -dy };
-        s_renderer.offsetFocusInViewCoord(offset);
+        s_pendingPanOffset.x -= dx;
+        s_pendingPanOffset.y -= dy;
+        s_beginInteraction(hwnd);
         ::InvalidateRect(hwnd, NULL, FALSE);
 
         s_dragOrg.x = x;
@@ -809,7 +1414,7 @@ static void s_onMouseLeftButtonDown(HWND hwnd, UINT /*vkey*/, int16_t x, int16_t
 }
 
 // Called when user releases left mouse button
-static void s_onMouseLeftButtonUp(HWND /*hwnd*/, UINT /*vkey*/, int16_t /*x*/, int16_t /*y*/)
+static void s_onMouseLeftButtonUp(HWND hwnd, UINT /*vkey*/, int16_t /*x*/, int16_t /*y*/)
 {
     if (s_isDragging)
     {
@@ -817,9 +1422,28 @@ static void s_onMouseLeftButtonUp(HWND /*hwnd*/, UINT /*vkey*/, int16_t /*x*/, i
         s_isDragging = false;
         s_dragOrg.x = 0;
         s_dragOrg.y = 0;
+
+        // The drag is over, no need to wait for the input to settle
+        s_endInteraction(hwnd);
     }
 }
 
+// Panning or zooming started or went on: draw previews until it settles
+static void s_beginInteraction(HWND hwnd)
+{
+    s_renderer.setInteractive(true);
+    // Setting the timer again restarts its countdown
+    ::SetTimer(hwnd, k_interactionTimerId, k_interactionSettleTime, NULL);
+}
+
+// Panning or zooming settled: draw the view in full quality
+static void s_endInteraction(HWND hwnd)
+{
+    ::KillTimer(hwnd, k_interactionTimerId);
+    s_renderer.setInteractive(false);
+    ::InvalidateRect(hwnd, NULL, FALSE);
+}
+
 // Double-click with left mouse button
 static void s_onMouseLeftButtonDoubleClick(HWND hwnd, UINT /*vkey*/, int16_t x, int16_t y)
 {
@@ -849,15 +1473,45 @@ static void s_onPaint(HWND hwnd)
     s_renderer.render(
         s_latestShipVector,
         s_latestShipVelocity,
-        s_shipTexture.get(),
+        s_GameProcess.shipIconImage(),
         s_shipRouteList.get()
     );
     ::ValidateRect(hwnd, NULL);
 
-#ifdef _PERF_CHECK
-    int64_t perfEnd = g_queryPerformanceCounter();
-    int64_t freq = g_queryPerformanceFrequency();
-    double deltaPerSec = (double(perfEnd - perfBegin) / double(freq)) * 1000.0;
+    // Startup milestones this frame shows count once it is drawn
+    if (s_startupPending)
+    {
+        static const struct { UINT milestone; const char* name; } k_milestones[] = {
+            { k_startupFirstFrame, "first frame" },
+            { k_startupMapPreview, "map preview shown" },
+            { k_startupMap, "map shown" },
+            { k_startupRoutes, "routes shown" },
+        };
+        s_renderer.waitForIdle();
+        for (const auto& m : k_milestones)
+        {
+            if (s_startupPending & m.milestone)
+            {
+                s_traceStartup(m.name);
+            }
+        }
+        s_startupDone |= s_startupPending;
+        s_startupPending = 0;
+
+        const UINT complete = k_startupMap | k_startupRoutes;
+        if ((s_startupDone & complete) == complete && !(s_startupDone & k_startupFullFidelity))
+        {
+            s_startupDone |= k_startupFullFidelity;
+            s_traceStartup("full fidelity");
+        }
+    }
+
+#ifdef _PERF_CHECK
+    // Drawing happens on the render thread; wait for it so the measurement covers the whole frame
+    s_renderer.waitForIdle();
+    int64_t perfEnd = g_queryPerformanceCounter();
+    int64_t freq = g_queryPerformanceFrequency();
+    double deltaPerSec = (double(perfEnd - perfBegin) / double(freq)) * 1000.0;
     s_perfCountList.push_back(deltaPerSec);
 
     // Average over a certain number of frames
@@ -869,7 +1523,9 @@ static void s_onPaint(HWND hwnd)
     }
 
     // Display performance measurement in the window title
-    std::wstring s = std::wstring(L"Drawing speed:") + std::to_wstring(average) + L"(ms)\n";
+    std::wstring s = std::wstring(L"Drawing speed:") + std::to_wstring(average) + L"(ms)"
+        + L" drawn:" + std::to_wstring(s_renderer.renderedFrameCount())
+        + L" skipped:" + std::to_wstring(s_renderer.skippedFrameCount()) + L"\n";
     ::SetWindowText(hwnd, s.c_str());
 #endif
 }
@@ -919,16 +1575,6 @@ static void s_updateFrame(HWND hwnd)
         return;
     }
 
-    // If ship texture wasnt created yet, try now
-    if (!s_shipTexture.get())
-    {
-        const Image* image = s_GameProcess.shipIconImage();
-        if (image)
-        {
-            s_shipTexture.reset(s_renderer.createTextureFromImage(*image));
-        }
-    }
-
     // For each new status, update our variables and ship route
     for (auto& status : gameStats)
     {
@@ -938,7 +1584,7 @@ static void s_updateFrame(HWND hwnd)
 
         // Keep the config up to date with the latest coordinate
         s_config.m_initialSurveyCoord = s_latestSurveyCoord;
-        s_renderer.setShipPositionInWorld(s_latestSurveyCoord);
+        s_renderer.addShipSample(s_latestSurveyCoord, s_latestShipVector, s_latestShipVelocity, status.m_timeStamp);
 
         // If its been too long since last update, 
         // consider closing out the route
@@ -949,22 +1595,215 @@ static void s_updateFrame(HWND hwnd)
         s_latestTimeStamp = status.m_timeStamp;
 
         // Add the new route point to our route list
-        s_shipRouteList->addRoutePoint(s_worldMap.normalizedPoint(s_latestSurveyCoord));
+        s_shipRouteList->addRoutePoint(s_mapLayers.active().normalizedPoint(s_latestSurveyCoord));
     }
+    s_updateLandfall();
 
 #ifndef _PERF_CHECK
     // Update the title with coordinate info
     s_updateWindowTitle(hwnd, s_latestSurveyCoord, s_renderer.viewScale());
 #endif
-    // Invalidate to trigger a repaint
+
+    // Covering windows resized without being moved send no event, so look once per poll as well
+    s_updateViewVisibility(hwnd);
+    s_animateFrame(hwnd);
+}
+
+// Move the ship to where it is predicted to be now and repaint if that shows on screen.
+// Called for every poll and, while the ship moves, once per display refresh in between.
+static void s_animateFrame(HWND hwnd)
+{
+    // Nothing to animate while the view cannot be seen; the ship is placed again once it shows
+    if (s_isViewHidden)
+    {
+        s_isShipMoving = false;
+        return;
+    }
+
+    s_lastAnimationTime = ::timeGetTime();
+    s_isShipMoving = s_renderer.advanceShipMotion(s_lastAnimationTime);
+
+    // Repaint only if something moved on screen; sub-pixel drift and unchanged speed text are skipped
+    if (s_renderer.checkFrameChanged(s_latestShipVector, s_latestShipVelocity, s_GameProcess.shipIconImage(), s_shipRouteList.get()))
+    {
+        ::InvalidateRect(hwnd, NULL, FALSE);
+    }
+}
+
+// Ask for the view to be drawn; every request until the next frame is served by that frame
+static void s_requestRedraw()
+{
+    s_redrawRequested = true;
+}
+
+// Draw the view if that was asked for and a frame interval has passed since the last frame.
+// Returns the milliseconds until a requested frame may be drawn, or INFINITE if none is pending.
+static DWORD s_redrawIfDue(HWND hwnd)
+{
+    // A hidden view keeps its request until it shows again
+    if (!s_redrawRequested || s_isViewHidden)
+    {
+        return INFINITE;
+    }
+
+    const DWORD now = ::timeGetTime();
+    const DWORD elapsed = now - s_lastRedrawTime;
+    if (elapsed < s_frameInterval)
+    {
+        return s_frameInterval - elapsed;
+    }
+
+    s_redrawRequested = false;
+    s_lastRedrawTime = now;
+
+    // Every drag step since the last frame is applied at once
+    if (s_pendingPanOffset.x != 0 || s_pendingPanOffset.y != 0)
+    {
+        s_renderer.offsetFocusInViewCoord(s_pendingPanOffset);
+        s_pendingPanOffset.x = 0;
+        s_pendingPanOffset.y = 0;
+    }
+
+    s_onPaint(hwnd);
+    return INFINITE;
+}
+
+// Draw a requested frame now if the frame interval allows, otherwise have the timer come back for it
+static void s_paceRedraw(HWND hwnd)
+{
+    const DWORD timeout = s_redrawIfDue(hwnd);
+    if (timeout == INFINITE)
+    {
+        ::KillTimer(hwnd, k_redrawTimerId);
+    }
+    else
+    {
+        ::SetTimer(hwnd, k_redrawTimerId, timeout, NULL);
+    }
+}
+
+// Start watching for the view being hidden: foreground changes and windows moved or minimized
+// (through a WinEvent hook), and the display switched off (where Windows reports it)
+static void s_watchViewVisibility(HWND hwnd)
+{
+    s_windowEventHook = ::SetWinEventHook(
+        EVENT_SYSTEM_FOREGROUND,
+        EVENT_SYSTEM_MINIMIZEEND,
+        NULL,
+        s_onWindowEvent,
+        0,
+        0,
+        WINEVENT_OUTOFCONTEXT);
+
+    HMODULE user32 = ::GetModuleHandle(L"user32.dll");
+    RegisterPowerSettingNotificationFunc registerPowerSettingNotification =
+        reinterpret_cast<RegisterPowerSettingNotificationFunc>(::GetProcAddress(user32, "RegisterPowerSettingNotification"));
+    if (registerPowerSettingNotification)
+    {
+        s_displayPowerNotify = registerPowerSettingNotification(hwnd, &k_consoleDisplayState, DEVICE_NOTIFY_WINDOW_HANDLE);
+    }
+}
+
+// Stop watching for the view being hidden
+static void s_unwatchViewVisibility()
+{
+    if (s_windowEventHook)
+    {
+        ::UnhookWinEvent(s_windowEventHook);
+        s_windowEventHook = NULL;
+    }
+    if (s_displayPowerNotify)
+    {
+        HMODULE user32 = ::GetModuleHandle(L"user32.dll");
+        UnregisterPowerSettingNotificationFunc unregisterPowerSettingNotification =
+            reinterpret_cast<UnregisterPowerSettingNotificationFunc>(::GetProcAddress(user32, "UnregisterPowerSettingNotification"));
+        if (unregisterPowerSettingNotification)
+        {
+            unregisterPowerSettingNotification(s_displayPowerNotify);
+        }
+        s_displayPowerNotify = NULL;
+    }
+}
+
+// Check whether the view can be seen, and suspend or resume drawing when that changed
+static void s_updateViewVisibility(HWND hwnd)
+{
+    const bool hidden = ::IsIconic(hwnd) || !::IsWindowVisible(hwnd) || s_isDisplayOff || s_isSystemSuspended
+        || s_isViewCovered(hwnd);
+    if (hidden == s_isViewHidden)
+    {
+        return;
+    }
+    s_isViewHidden = hidden;
+
+    if (hidden)
+    {
+        ::KillTimer(hwnd, k_redrawTimerId);
+        s_isShipMoving = false;
+        if (s_config.m_releaseHiddenResources)
+        {
+            s_renderer.releaseResources();
+        }
+        return;
+    }
+
+    // Shown again: place the ship where it is now and draw right away
+    s_animateFrame(hwnd);
     ::InvalidateRect(hwnd, NULL, FALSE);
 }
 
-// Refresh window title with the latest coordinates and scale
+// Check whether another window covers the whole view
+static bool s_isViewCovered(HWND hwnd)
+{
+    // Without desktop composition a covered window has nothing left to paint. The window's own DC
+    // belongs to the render thread, so ask a DC from the cache instead
+    if (HDC dc = ::GetDCEx(hwnd, NULL, DCX_CACHE | DCX_CLIPSIBLINGS))
+    {
+        RECT clip;
+        const int region = ::GetClipBox(dc, &clip);
+        ::ReleaseDC(hwnd, dc);
+        if (region == NULLREGION)
+        {
+            return true;
+        }
+    }
+
+    // With it, only windows above ours can cover it; the foreground one (the game, usually) is
+    // the one to look at, as long as ours is not kept on top
+    if (::GetWindowLong(hwnd, GWL_EXSTYLE) & WS_EX_TOPMOST)
+    {
+        return false;
+    }
+    HWND foreground = ::GetForegroundWindow();
+    if (!foreground || foreground == hwnd || ::IsIconic(foreground) || ::GetAncestor(foreground, GA_ROOTOWNER) == hwnd)
+    {
+        return false;
+    }
+    RECT viewRect, foregroundRect;
+    ::GetWindowRect(hwnd, &viewRect);
+    ::GetWindowRect(foreground, &foregroundRect);
+    return foregroundRect.left <= viewRect.left && foregroundRect.top <= viewRect.top
+        && viewRect.right <= foregroundRect.right && viewRect.bottom <= foregroundRect.bottom;
+}
+
+// WinEvent hook: the foreground window changed, or a window was moved, minimized or restored
+static void CALLBACK s_onWindowEvent(HWINEVENTHOOK, DWORD /*event*/, HWND /*window*/, LONG idObject, LONG, DWORD, DWORD)
+{
+    if (idObject == OBJID_WINDOW && g_hwndMain)
+    {
+        s_updateViewVisibility(g_hwndMain);
+    }
+}
+
+// Refresh window title with the nearby port (or the sea area), the latest coordinates and scale
 static void s_updateWindowTitle(HWND hwnd, POINT surveyCoord, double viewScale)
 {
+    const Port* port = s_portList.findNearest(surveyCoord);
+    const std::wstring& place = port ? port->name : s_seaRegionMap.regionName(s_seaRegionMap.regionAt(surveyCoord));
     std::vector<wchar_t> buf(4096);
-    ::swprintf(&buf[0], buf.size(), L"%d,%d - (%.1f%%) - %s %s",
+    ::swprintf(&buf[0], buf.size(), L"%s%s%d,%d - (%.1f%%) - %s %s",
+        place.c_str(),
+        place.empty() ? L"" : L" ",
         surveyCoord.x,
         surveyCoord.y,
         viewScale * 100.0,
@@ -1015,6 +1854,30 @@ static void s_popupMenu(HWND hwnd, int16_t x, int16_t y)
     ::CheckMenuItem(popupMenu, IDM_TOGGLE_VECTOR_LINE,
         s_config.m_shipVectorLineEnabled ? MF_CHECKED : MF_UNCHECKED);
 
+    // Route planning needs the sea route finder of the map drawn (built on a worker once the map itself is drawn)
+    s_popupViewCoord.x = x;
+    s_popupViewCoord.y = y;
+    ::EnableMenuItem(popupMenu, IDM_PLAN_ROUTE_FROM,
+        s_canPlanSeaRoute() ? MF_ENABLED : MF_GRAYED);
+    ::EnableMenuItem(popupMenu, IDM_PLAN_ROUTE_TO,
+        s_canPlanSeaRoute() && s_hasPlanStart ? MF_ENABLED : MF_GRAYED);
+
+    // Map layers, when more than one is configured (hovering one prefetches it)
+    const size_t layerCount = min(s_mapLayers.count(), Config::k_maxMapLayers);
+    if (1 < layerCount)
+    {
+        HMENU layerMenu = ::CreatePopupMenu();
+        for (size_t i = 0; i < layerCount; ++i)
+        {
+            const std::wstring label = std::wstring(::PathFindFileName(s_mapLayers.fileName(i).c_str()))
+                + L"\tCtrl+" + std::to_wstring(i + 1);
+            ::AppendMenu(layerMenu, MF_STRING, IDM_MAP_LAYER_1 + i, label.c_str());
+        }
+        ::CheckMenuRadioItem(layerMenu, IDM_MAP_LAYER_1, UINT(IDM_MAP_LAYER_1 + layerCount - 1),
+            UINT(IDM_MAP_LAYER_1 + s_mapLayers.activeIndex()), MF_BYCOMMAND);
+        ::AppendMenu(popupMenu, MF_POPUP, reinterpret_cast<UINT_PTR>(layerMenu), L"Map layer");
+    }
+
 #ifndef NDEBUG
     // Debug options for development
     MENUITEMINFO mii = { sizeof(mii) };
@@ -1038,6 +1901,10 @@ static void s_popupMenu(HWND hwnd, int16_t x, int16_t y)
     mii.wID = IDM_DEBUG_INTERVAL_HIGH;
     mii.dwTypeData = L"[DEBUG]Update interval - high";
     ::InsertMenuItem(popupMenu, ::GetMenuItemCount(popupMenu), TRUE, &mii);
+
+    mii.wID = IDM_DEBUG_ROUTE_LOD_BENCHMARK;
+    mii.dwTypeData = L"[DEBUG]Route LOD benchmark";
+    ::InsertMenuItem(popupMenu, ::GetMenuItemCount(popupMenu), TRUE, &mii);
 #endif
 
     // While the menu is open, lets keep updating 
@@ -1049,7 +1916,7 @@ static void s_popupMenu(HWND hwnd, int16_t x, int16_t y)
     ::ClientToScreen(hwnd, &p);
 
     ::TrackPopupMenu(popupMenu,
-        TPM_NONOTIFY | TPM_NOANIMATION | TPM_LEFTALIGN | TPM_TOPALIGN,
+        TPM_NOANIMATION | TPM_LEFTALIGN | TPM_TOPALIGN,
         p.x, p.y, 0, hwnd, NULL);
     ::DestroyMenu(popupMenu);
 
@@ -1057,6 +1924,280 @@ static void s_popupMenu(HWND hwnd, int16_t x, int16_t y)
     ::KillTimer(hwnd, timerID);
 }
 
+// Draw another map layer; instant when it was prefetched, otherwise it is loaded first
+static void s_switchMapLayer(HWND hwnd, size_t index)
+{
+    if (s_mapLayers.count() <= index || index == s_mapLayers.activeIndex())
+    {
+        return;
+    }
+
+    // Show the wait cursor while the layer is made resident, then put the previous one back
+    const HCURSOR previousCursor = ::SetCursor(::LoadCursor(NULL, IDC_WAIT));
+    const WorldMap* map = s_mapLayers.activate(index);
+    ::SetCursor(previousCursor);
+    if (!map)
+    {
+        ::MessageBox(hwnd, L"Could not open the map image.", k_appName, MB_ICONERROR | MB_OK);
+        return;
+    }
+    s_renderer.setWorldMap(map);
+    s_prepareSeaRouteFinder();
+
+    // Start with the same layer next time
+    s_config.m_mapFileName = s_mapLayers.fileName(index);
+    ::InvalidateRect(hwnd, NULL, FALSE);
+}
+
+// Load a map layer in the background and upload its texture, ahead of switching to it
+static void s_prefetchMapLayer(HWND hwnd, size_t index)
+{
+    if (index < s_mapLayers.count() && index != s_mapLayers.activeIndex())
+    {
+        s_mapLayers.prefetch(index, hwnd, k_mapLayerLoadedMessage);
+    }
+}
+
+// A map layer loader has reported progress
+static void s_onMapLayerLoaded(HWND hwnd, size_t index, MapLayerSet::Stage stage)
+{
+    if (index != s_mapLayers.activeIndex())
+    {
+        // A prefetched map is decoded; upload its texture while the current map stays on screen
+        if (stage == MapLayerSet::k_Stage_Loaded)
+        {
+            if (const WorldMap* map = s_mapLayers.load(index))
+            {
+                s_renderer.prefetchWorldMap(map);
+            }
+        }
+        return;
+    }
+
+    // The map shown at startup: draw its preview until the map itself is decoded
+    if (stage == MapLayerSet::k_Stage_Preview)
+    {
+        if (!s_renderer.worldMap())
+        {
+            s_renderer.setWorldMap(&s_mapLayers.preview(index));
+            s_traceStartupFrame(k_startupMapPreview);
+            ::InvalidateRect(hwnd, NULL, FALSE);
+        }
+        return;
+    }
+
+    const WorldMap* map = s_mapLayers.load(index);
+    if (!map)
+    {
+        ::MessageBox(hwnd, L"Could not open the map image.", k_appName, MB_ICONERROR | MB_OK);
+        ::DestroyWindow(hwnd);
+        return;
+    }
+    if (s_renderer.worldMap() != map)
+    {
+        s_renderer.setWorldMap(map);
+        s_traceStartupFrame(k_startupMap);
+        ::InvalidateRect(hwnd, NULL, FALSE);
+        s_prepareSeaRouteFinder();
+    }
+}
+
+// Route loader thread: read the saved routes, then tell the window to merge them
+static UINT CALLBACK s_routeLoaderMain(LPVOID /*arg*/)
+{
+    std::unique_ptr<ShipRouteList> routeList(new ShipRouteList());
+    try
+    {
+        std::ifstream ifs;
+        ifs.open(k_routeListFilePath, std::ios::in | std::ios::binary);
+        if (ifs)
+        {
+            ifs.exceptions(std::ios::badbit | std::ios::failbit);
+            ifs >> *routeList;
+            ifs.close();
+        }
+        s_loadedRouteList = std::move(routeList);
+    }
+    catch (const std::exception& e)
+    {
+        s_routeLoadError = e.what();
+    }
+    ::PostMessage(g_hwndMain, k_routeListLoadedMessage, 0, 0);
+    return 0;
+}
+
+// Put the saved routes in front of the ones sailed since startup (once the loader is done)
+static void s_mergeLoadedRoutes()
+{
+    if (s_routeLoaderThread)
+    {
+        ::WaitForSingleObject(s_routeLoaderThread, INFINITE);
+        ::CloseHandle(s_routeLoaderThread);
+        s_routeLoaderThread = NULL;
+    }
+
+    if (!s_routeLoadError.empty())
+    {
+        ::OutputDebugStringA((std::string("file load error:") + s_routeLoadError + "\n").c_str());
+        ::MessageBox(NULL, L"Failed to read path", k_appName, MB_ICONERROR);
+        s_routeLoadError.clear();
+    }
+    else if (s_loadedRouteList)
+    {
+        s_shipRouteList->prependRoutes(*s_loadedRouteList);
+        s_loadedRouteList.reset();
+    }
+    else
+    {
+        // Merged already
+        return;
+    }
+    s_traceStartupFrame(k_startupRoutes);
+    if (::IsWindow(g_hwndMain))
+    {
+        ::InvalidateRect(g_hwndMain, NULL, FALSE);
+    }
+}
+
+// Write a startup milestone with the time since launch to the debug output
+static void s_traceStartup(const char* milestone)
+{
+    const int64_t elapsed = (g_queryPerformanceCounter() - s_startupBegin) * 1000 / g_queryPerformanceFrequency();
+    ::OutputDebugStringA((std::string("startup: ") + milestone + " " + std::to_string(elapsed) + " ms\n").c_str());
+}
+
+// Trace a startup milestone with the next frame drawn, unless it has been already
+static void s_traceStartupFrame(UINT milestone)
+{
+    if (!(s_startupDone & milestone))
+    {
+        s_startupPending |= milestone;
+    }
+}
+
+// Trace the course of the ship to the coast of the map drawn, for the course line and the time to landfall.
+// Sphere tracing through the distance field takes a few dozen lookups at sea, and at worst (a course
+// along a coast) one land mask lookup per coordinate up to k_worldHeight, so it is done on every poll.
+static void s_updateLandfall()
+{
+    const WorldMap* worldMap = s_renderer.worldMap();
+    double distance = 0.0;
+    const bool hasLandfall = worldMap && worldMap->landDistanceField().findLandfall(worldMap->landMask(),
+        s_latestSurveyCoord.x, s_latestSurveyCoord.y, s_latestShipVector.x(), s_latestShipVector.y(), k_worldHeight, distance);
+    s_renderer.setLandfall(hasLandfall,
+        hasLandfall ? s_latestShipVector.pointFromOriginWithLength(s_latestSurveyCoord, LONG(distance)) : s_latestSurveyCoord);
+}
+
+// Whether the map drawn can be searched for sea routes: its finder is built
+static bool s_canPlanSeaRoute()
+{
+    const WorldMap* worldMap = s_renderer.worldMap();
+    return worldMap && s_seaRouteFinder && &s_seaRouteFinder->landMask() == &worldMap->landMask();
+}
+
+// Build the sea route finder of the map drawn on a worker, unless it is there or being built already
+static void s_prepareSeaRouteFinder()
+{
+    const WorldMap* worldMap = s_renderer.worldMap();
+    if (s_seaRouteFinderThread || !worldMap || worldMap->landMask().empty() || s_canPlanSeaRoute())
+    {
+        return;
+    }
+    s_seaRouteFinderThread = reinterpret_cast<HANDLE>(::_beginthreadex(
+        NULL,
+        0,
+        s_seaRouteFinderMain,
+        const_cast<LandMask*>(&worldMap->landMask()),
+        0,
+        NULL));
+    if (!s_seaRouteFinderThread)
+    {
+        // No thread to build it on: build it now
+        s_seaRouteFinder.reset(new SeaRouteFinder(worldMap->landMask()));
+    }
+}
+
+// Sea route finder worker: build the finder of a land mask (map layers are kept until exit), then tell the window
+static UINT CALLBACK s_seaRouteFinderMain(LPVOID arg)
+{
+    s_builtSeaRouteFinder.reset(new SeaRouteFinder(*reinterpret_cast<const LandMask*>(arg)));
+    ::PostMessage(g_hwndMain, k_seaRouteFinderBuiltMessage, 0, 0);
+    return 0;
+}
+
+// Take the sea route finder from the worker (once it is done)
+static void s_adoptSeaRouteFinder()
+{
+    if (!s_seaRouteFinderThread)
+    {
+        return;
+    }
+    ::WaitForSingleObject(s_seaRouteFinderThread, INFINITE);
+    ::CloseHandle(s_seaRouteFinderThread);
+    s_seaRouteFinderThread = NULL;
+    s_seaRouteFinder = std::move(s_builtSeaRouteFinder);
+}
+
+// Look up the sea route between the ports at two world coordinates in the cached table, which is read
+// the first time it is needed for a land mask; false if either end is not at a port or nothing is cached
+static bool s_findSeaRouteBetweenPorts(const WorldMap& worldMap, const POINT& start, const POINT& goal, std::vector<POINT>& route)
+{
+    const Port* startPort = s_portList.findNearest(start, k_planPortDistance);
+    const Port* goalPort = s_portList.findNearest(goal, k_planPortDistance);
+    if (!startPort || !goalPort || startPort == goalPort)
+    {
+        return false;
+    }
+
+    if (s_seaDistanceLandMask != &worldMap.landMask())
+    {
+        s_seaDistanceLandMask = &worldMap.landMask();
+        s_seaDistanceTable.reset(new SeaDistanceTable());
+        const uint64_t key = SeaDistanceTable::makeKey(worldMap.landMask(), s_portList.worldCoords(), SeaDistanceTable::k_defaultNodeSpacing);
+        if (!s_seaDistanceTable->loadFromFile(worldMap.filePath() + k_seaDistanceCacheSuffix, key))
+        {
+            s_seaDistanceTable.reset();
+        }
+    }
+    return s_seaDistanceTable
+        && s_seaDistanceTable->route(s_portList.indexOf(*startPort), s_portList.indexOf(*goalPort), route)
+        && !route.empty();
+}
+
+// Find the shortest sea route from the planned start to where the pop-up menu was opened, and add it as a route.
+// Between two ports the route is read from the port-to-port table when one is cached.
+static void s_planSeaRoute(HWND hwnd)
+{
+    POINT goal;
+    if (!s_hasPlanStart || !s_canPlanSeaRoute() || !s_renderer.worldCoordFromViewCoord(s_popupViewCoord, goal))
+    {
+        return;
+    }
+
+    const WorldMap* worldMap = s_renderer.worldMap();
+    std::vector<POINT> route;
+    bool found = s_findSeaRouteBetweenPorts(*worldMap, s_planStartWorldCoord, goal, route);
+    if (!found)
+    {
+        found = s_seaRouteFinder->findRoute(s_planStartWorldCoord, goal, route);
+    }
+    if (!found)
+    {
+        ::MessageBox(hwnd, L"No sea route connects these points.", k_appName, MB_ICONINFORMATION | MB_OK);
+        return;
+    }
+
+    std::vector<NormalizedPoint> points;
+    points.reserve(route.size());
+    for (const POINT& point : route)
+    {
+        points.push_back(worldMap->normalizedPoint(point));
+    }
+    s_shipRouteList->addPlannedRoute(points);
+    s_hasPlanStart = false;
+    ::InvalidateRect(hwnd, NULL, FALSE);
+}
+
 // A function called on double-click, could be extended to do something with map coords
 static void s_popupCoord(HWND /*hwnd*/, int16_t /*x*/, int16_t /*y*/)
 {
@@ -1070,6 +2211,104 @@ static void s_closeShipRoute()
     s_shipRouteList->closeRoute();
 }
 
+#ifndef NDEBUG
+// Debug benchmark: line vertices submitted per frame at every zoom level, with and without route LOD.
+// A long synthetic voyage stands in for a large route history; the results go to the debug output
+// and a message box, then the previous zoom is restored.
+static void s_debugRouteLodBenchmark(HWND hwnd)
+{
+    const int k_pointCount = 200000;        // A bit over two days of polling once a second
+    const int k_pointsPerRoute = 40000;     // Closed routes are simplified once, the last one stays live
+    const double k_stepLength = 2.0;        // World coordinates sailed per poll
+
+    ShipRouteList benchmarkList;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> turn(-0.05, 0.05);
+    double x = k_worldWidth * 0.5;
+    double y = k_worldHeight * 0.5;
+    double heading = 0.0;
+    for (int i = 0; i < k_pointCount; ++i) {
+        heading += turn(random);
+        x += ::cos(heading) * k_stepLength;
+        y += ::sin(heading) * k_stepLength;
+        if (x < 0.0) {
+            x += k_worldWidth;
+        }
+        else if (k_worldWidth <= x) {
+            x -= k_worldWidth;
+        }
+        if (y < 0.0 || k_worldHeight <= y) {
+            heading = -heading;  // Bounce off the poles
+            y = max(0.0, min(double(k_worldHeight - 1), y));
+        }
+        benchmarkList.addRoutePoint(NormalizedPoint(float(x / k_worldWidth), float(y / k_worldHeight)));
+        if ((i + 1) % k_pointsPerRoute == 0 && i + 1 < k_pointCount) {
+            benchmarkList.closeRoute();
+        }
+    }
+
+    const double previousScale = s_renderer.viewScale();
+    s_renderer.resetViewScale();
+    while (s_renderer.zoomOut()) {
+    }
+
+    // Memory of the full-detail points: packed in the fixed routes, as recorded in the live one
+    size_t pointCount[2] = {};
+    size_t pointBytes[2] = {};
+    for (const ShipRoutePtr& route : benchmarkList.getList()) {
+        const int live = route->isFixed() ? 0 : 1;
+        pointCount[live] += route->metadata().pointCount;
+        pointBytes[live] += route->pointMemoryUsage();
+    }
+
+    std::wstring report = L"Polled: " + std::to_wstring(k_pointCount) + L" points\n";
+    for (int live = 0; live < 2; ++live) {
+        wchar_t line[128];
+        ::swprintf(line, _countof(line), L"%s routes: %u points, %.2f MB per million points\n",
+            live ? L"Live" : L"Fixed", unsigned(pointCount[live]),
+            pointCount[live] ? double(pointBytes[live]) / pointCount[live] : 0.0);
+        report += line;
+    }
+    report += L"\nscale\tfull\tLOD\tfull ms\tLOD ms\n";
+    const double freq = double(g_queryPerformanceFrequency());
+    for (;;) {
+        size_t vertexCount[2] = {};
+        double elapsed[2] = {};
+        for (int lod = 0; lod < 2; ++lod) {
+            s_renderer.enableRouteLod(lod != 0);
+            const int64_t perfBegin = g_queryPerformanceCounter();
+            s_renderer.render(s_latestShipVector, s_latestShipVelocity, s_GameProcess.shipIconImage(), &benchmarkList);
+            s_renderer.waitForIdle();  // Include the time the render thread spends drawing
+            elapsed[lod] = double(g_queryPerformanceCounter() - perfBegin) / freq * 1000.0;
+            vertexCount[lod] = s_renderer.frameVertexCount();
+        }
+
+        wchar_t line[128];
+        ::swprintf(line, _countof(line), L"%.1f%%\t%u\t%u\t%.2f\t%.2f\n",
+            s_renderer.viewScale() * 100.0,
+            unsigned(vertexCount[0]), unsigned(vertexCount[1]),
+            elapsed[0], elapsed[1]);
+        report += line;
+
+        if (!s_renderer.zoomIn()) {
+            break;
+        }
+    }
+    s_renderer.enableRouteLod(true);
+
+    // Zoom back to where the user was
+    s_renderer.resetViewScale();
+    while (s_renderer.viewScale() < previousScale && s_renderer.zoomIn()) {
+    }
+    while (previousScale < s_renderer.viewScale() && s_renderer.zoomOut()) {
+    }
+
+    ::OutputDebugString(report.c_str());
+    ::MessageBox(hwnd, report.c_str(), L"Route LOD benchmark", MB_OK);
+    ::InvalidateRect(hwnd, NULL, FALSE);
+}
+#endif
+
 
 /***********************************************************************************************/
 /*                                                                                             */
@@ -42,6 +42,22 @@ inline std::wstring g_makeFullPath(const std::wstring& fileName) {
     return filePath;
 }
 
+/**
+ * @brief Converts UTF-8 text (e.g. a line of a data file) to a wide string.
+ *
+ * @param text The UTF-8 text
+ * @return The text as a std::wstring
+ */
+inline std::wstring g_wideFromUtf8(const std::string& text) {
+    if (text.empty()) {
+        return std::wstring();
+    }
+    const int length = ::MultiByteToWideChar(CP_UTF8, 0, text.c_str(), int(text.size()), NULL, 0);
+    std::wstring wide(length, L'\0');
+    ::MultiByteToWideChar(CP_UTF8, 0, text.c_str(), int(text.size()), &wide[0], length);
+    return wide;
+}
+
 /**
  * @brief Converts radians to degrees.
  *
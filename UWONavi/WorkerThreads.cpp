@@ -0,0 +1,42 @@
+#include "stdafx.h"
+#include "WorkerThreads.h"
+#include <process.h>
+
+
+DWORD g_workerCount(DWORD maxCount)
+{
+    SYSTEM_INFO systemInfo = {};
+    ::GetSystemInfo(&systemInfo);
+    return max(DWORD(1), min(maxCount, systemInfo.dwNumberOfProcessors));
+}
+
+
+// Start every thread first, then run the arguments left without one here while the others work
+void g_runWorkers(WorkerProc proc, const std::vector<LPVOID>& args)
+{
+    std::vector<HANDLE> threads;
+    std::vector<LPVOID> unstarted;
+    for (LPVOID arg : args) {
+        const HANDLE thread = reinterpret_cast<HANDLE>(::_beginthreadex(
+            NULL,
+            0,
+            proc,
+            arg,
+            0,
+            NULL
+            ));
+        if (thread) {
+            threads.push_back(thread);
+        }
+        else {
+            unstarted.push_back(arg);
+        }
+    }
+    for (LPVOID arg : unstarted) {
+        proc(arg);
+    }
+    for (HANDLE thread : threads) {
+        ::WaitForSingleObject(thread, INFINITE);
+        ::CloseHandle(thread);
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <Windows.h>  // For DWORD, HANDLE and LPVOID
+#include <vector>     // For the arguments
+
+//! @brief What a worker thread runs, called with one argument (the signature _beginthreadex takes).
+typedef UINT (CALLBACK *WorkerProc)(LPVOID arg);
+
+//! @brief Get how many workers to split a job between: one per processor, at most maxCount and at least one.
+DWORD g_workerCount(DWORD maxCount);
+
+//! @brief Run a worker on every argument at once, each on its own thread, and wait until all are done.
+//! An argument whose thread cannot be started is run on the calling thread instead, so every argument has
+//! been run when this returns whatever the system allows; workers sharing a queue of work just take more of it.
+//! @param proc The worker
+//! @param args One argument per worker (the same one may be passed to several)
+void g_runWorkers(WorkerProc proc, const std::vector<LPVOID>& args);
@@ -3,6 +3,17 @@
 #include "UWONavi.h"
 #include "WorldMap.h"
 
+namespace {
+    // Appended to the map file name to name the cache of the compressed texture
+    const wchar_t k_textureCacheSuffix[] = L".bctex";
+
+    // Appended to the map file name to name the cache of the land/sea mask
+    const wchar_t k_landMaskCacheSuffix[] = L".landmask";
+
+    // Appended to the map file name to name the cache of the coastline
+    const wchar_t k_coastlineCacheSuffix[] = L".coast";
+}
+
 /**
  * WorldMap is responsible for storing and handling a visual map of the game world.
  * It uses an internal Image object (m_mapImage) to represent the map data.
@@ -24,21 +35,117 @@ bool WorldMap::loadFromFile(const std::wstring& fileName) {
 
     m_mapImage.copy(workImage);
     workImage.reset();
+    m_compressedImage.reset();
+    m_landMask.reset();
+    m_coastline.reset();
+    m_landDistanceField.reset();
+    m_size = m_mapImage.size();
+    m_filePath = filePath;
+    return true;
+}
+
+/**
+ * Loads a preview of the map from the texture cache.
+ * - Only the levels at most maxWidth wide are read from the cache; the
+ *   largest of them is decoded into the map image.
+ * - The cache must match the current map image, like for the texture.
+ */
+bool WorldMap::loadPreview(const std::wstring& fileName, uint32_t maxWidth) {
+    const std::wstring filePath = g_makeFullPath(fileName);
+    CompressedImage levels;
+    if (!levels.loadFromFile(filePath + k_textureCacheSuffix, CompressedImage::fileStamp(filePath), maxWidth)) {
+        return false;
+    }
+    if (!levels.decodeLevel(0, m_mapImage)) {
+        return false;
+    }
+
+    m_compressedImage.reset();
+    m_landMask.reset();
+    m_coastline.reset();
+    m_landDistanceField.reset();
+    m_size.cx = LONG(levels.width());
+    m_size.cy = LONG(levels.height());
+    m_filePath = filePath;
+    return true;
+}
+
+/**
+ * Loads or builds the block-compressed map texture.
+ * - The cache file is the map file name with ".bctex" appended.
+ * - It records the size and write time of the map image, so editing or
+ *   replacing the image makes it stale and it is encoded again.
+ * - Failing to write the cache is not an error; the blocks are still used.
+ */
+bool WorldMap::prepareCompressedImage() {
+    const std::wstring cacheFileName = m_filePath + k_textureCacheSuffix;
+    const uint64_t stamp = CompressedImage::fileStamp(m_filePath);
+
+    if (m_compressedImage.loadFromFile(cacheFileName, stamp)) {
+        return true;
+    }
+    if (!m_compressedImage.compress(m_mapImage)) {
+        return false;
+    }
+    m_compressedImage.saveToFile(cacheFileName, stamp);
     return true;
 }
 
+/**
+ * Loads or builds the land/sea mask.
+ * - The cache file is the map file name with ".landmask" appended, stamped
+ *   like the texture cache.
+ * - The mask covers the whole game world (k_worldWidth x k_worldHeight),
+ *   whatever the size of the map image.
+ */
+bool WorldMap::prepareLandMask() {
+    const std::wstring cacheFileName = m_filePath + k_landMaskCacheSuffix;
+    const uint64_t stamp = CompressedImage::fileStamp(m_filePath);
+
+    if (m_landMask.loadFromFile(cacheFileName, stamp, k_worldWidth, k_worldHeight)) {
+        return true;
+    }
+    if (!m_landMask.build(m_mapImage, k_worldWidth, k_worldHeight)) {
+        return false;
+    }
+    m_landMask.saveToFile(cacheFileName, stamp);
+    return true;
+}
+
+/**
+ * Loads or traces the coastline.
+ * - The cache file is the map file name with ".coast" appended, keyed by
+ *   the contents of the land/sea mask it was traced from.
+ */
+bool WorldMap::prepareCoastline() {
+    if (m_landMask.empty()) {
+        return false;
+    }
+    return m_coastline.prepare(m_landMask, m_filePath + k_coastlineCacheSuffix);
+}
+
+/**
+ * Measures the distances from land of the land/sea mask.
+ */
+bool WorldMap::prepareLandDistanceField() {
+    if (m_landMask.empty()) {
+        return false;
+    }
+    return m_landDistanceField.build(m_landMask);
+}
+
 /**
  * Converts a point in world coordinates into a point within the map image.
  * - Normalizes the given worldCoord by dividing by k_worldWidth and k_worldHeight.
- * - Scales those normalized coordinates by the dimensions of the m_mapImage.
+ * - Scales those normalized coordinates by the size of the full map.
  */
 POINT WorldMap::imageCoordFromWorldCoord(const POINT& worldCoord) const {
     double xNormPos = worldCoord.x / static_cast<double>(k_worldWidth);
     double yNormPos = worldCoord.y / static_cast<double>(k_worldHeight);
 
     POINT worldPosInImage = {
-        static_cast<LONG>(m_mapImage.width() * xNormPos),
-        static_cast<LONG>(m_mapImage.height() * yNormPos)
+        static_cast<LONG>(m_size.cx * xNormPos),
+        static_cast<LONG>(m_size.cy * yNormPos)
     };
     return worldPosInImage;
 }
@@ -1,6 +1,10 @@
 #pragma once
 #include "Noncopyable.h"
 #include "Image.h"
+#include "CompressedImage.h"
+#include "LandMask.h"
+#include "Coastline.h"
+#include "LandDistanceField.h"
 #include "Config.h"
 #include "Vector.h"
 #include "NormalizedPoint.h"
@@ -12,7 +16,10 @@
  *   or assign a WorldMap object, preventing duplicate
  *   references to underlying resources like images.
  *
- * - Holds an Image representing the world map (m_mapImage).
+ * - Holds an Image representing the world map (m_mapImage),
+ *   which world coordinates are land (m_landMask), the coast
+ *   between them (m_coastline), and how far the sea is from it
+ *   (m_landDistanceField).
  *
  * - Provides methods to load the map image from file,
  *   fetch the map image reference, convert world coordinates
@@ -22,14 +29,20 @@ class WorldMap : private Noncopyable {
     friend class Renderer;
 
 private:
-    Image m_mapImage; // The actual image of the world map.
+    Image m_mapImage; // The actual image of the world map (smaller while it is a preview).
+    SIZE m_size; // Size of the full map in pixels.
+    CompressedImage m_compressedImage; // Blocks of the map texture (empty until prepared).
+    LandMask m_landMask; // Land and sea of the world (empty until prepared).
+    Coastline m_coastline; // Coast of the world as polylines (empty until prepared).
+    LandDistanceField m_landDistanceField; // Distance of the world from land (empty until prepared).
+    std::wstring m_filePath; // Full path of the map image file.
 
 public:
     /**
      * Constructor and destructor are trivial here,
      * but explicitly declared for clarity.
      */
-    WorldMap() {}
+    WorldMap() : m_size() {}
     virtual ~WorldMap() {}
 
     /**
@@ -38,6 +51,79 @@ public:
      */
     bool loadFromFile(const std::wstring& fileName);
 
+    /**
+     * Loads a low-resolution preview of the map from the cache file of the
+     * block-compressed texture: the largest level at most maxWidth pixels
+     * wide, decoded. Much quicker than decoding the map image, but only
+     * possible once prepareCompressedImage() has written the cache.
+     * The preview reports the size of the full map, so it is drawn in
+     * its place. Returns false if there is no valid cache.
+     */
+    bool loadPreview(const std::wstring& fileName, uint32_t maxWidth);
+
+    /**
+     * Loads the block-compressed map texture from the cache file next to
+     * the map image, or encodes it and writes the cache when the file is
+     * missing or older than the image (the first launch with a map).
+     * Returns true if the blocks are available.
+     */
+    bool prepareCompressedImage();
+
+    /**
+     * Returns the block-compressed map texture; empty unless
+     * prepareCompressedImage() succeeded.
+     */
+    const CompressedImage& compressedImage() const {
+        return m_compressedImage;
+    }
+
+    /**
+     * Loads the land/sea mask of the world from the cache file next to
+     * the map image, or classifies the map image and writes the cache
+     * when the file is missing or older than the image.
+     * Returns true if the mask is available.
+     */
+    bool prepareLandMask();
+
+    /**
+     * Returns the land/sea mask in world coordinates; empty unless
+     * prepareLandMask() succeeded.
+     */
+    const LandMask& landMask() const {
+        return m_landMask;
+    }
+
+    /**
+     * Loads the coastline from the cache file next to the map image, or
+     * traces it from the land/sea mask and writes the cache when the file
+     * is missing or was traced from another mask.
+     * Returns true if the coastline is available; needs prepareLandMask().
+     */
+    bool prepareCoastline();
+
+    /**
+     * Returns the coastline in world coordinates; empty unless
+     * prepareCoastline() succeeded.
+     */
+    const Coastline& coastline() const {
+        return m_coastline;
+    }
+
+    /**
+     * Measures how far every cell of the world is from land, from the
+     * land/sea mask (quick enough not to need a cache).
+     * Returns true if the distances are available; needs prepareLandMask().
+     */
+    bool prepareLandDistanceField();
+
+    /**
+     * Returns the distances from land; empty unless
+     * prepareLandDistanceField() succeeded.
+     */
+    const LandDistanceField& landDistanceField() const {
+        return m_landDistanceField;
+    }
+
     /**
      * Returns a constant reference to the internally stored Image.
      * Useful for rendering or other read-only operations.
@@ -46,6 +132,23 @@ public:
         return m_mapImage;
     }
 
+    /**
+     * Returns the size of the full map in pixels, which layouts and
+     * coordinates are based on. The image has this size unless the map
+     * is a preview.
+     */
+    const SIZE& size() const {
+        return m_size;
+    }
+
+    /**
+     * Returns the full path of the map image file, which the caches
+     * of the map are named after.
+     */
+    const std::wstring& filePath() const {
+        return m_filePath;
+    }
+
     /**
      * Converts a world coordinate (e.g. position in the game world)
      * into a corresponding coordinate in the map image space.